@@ -64,6 +64,11 @@
 #include "EvseRfid.h"
 #include "EvseTelnet.h"
 #include "BootCount.h"
+#include "EvseSessionLog.h"
+#include "EvseScheduler.h"
+#include "EvseSolar.h"
+#include "EvseSite.h"
+#include "EvsePhaseLimit.h"
 
 #define BAUD_RATE 115200
 #define WDT_TIMEOUT 8 
@@ -74,14 +79,23 @@ Rcm rcm;
 EvseCharge evse(pilot);
 EvseMqttController mqttController(evse, pilot);
 OCPPHandler ocppHandler(evse, pilot);
+EvseSessionLog sessionLog(evse);
+EvseScheduler scheduler(evse);
+EvseSolarController solar(evse);
+EvseSiteBalancer site(evse);
+EvsePhaseLimiter mainsLimiter(evse);
 TaskHandle_t evseTaskHandle = NULL;
+TaskHandle_t netTaskHandle = NULL;
 EvseTelnet telnetServer;
 AppConfig config;
 EvseRfid rfid;
 WebController webController(evse, pilot, mqttController, ocppHandler, config, rfid);
 String deviceId;
-bool isFallbackApMode = false;
+volatile bool isFallbackApMode = false;
 volatile bool g_otaUpdating = false;
+volatile bool g_netReady = false;             // Set by networkBootTask once all network services run
+volatile unsigned long g_pilotReadyMs = 0;    // Boot -> first EVSE loop pass (pilot/relay/RCM live)
+volatile unsigned long g_netReadyMs = 0;      // Boot -> network bring-up finished
 unsigned long g_rfidFeedbackUntil = 0;
 EvseLedState g_rfidFeedbackState = LED_OFF_STATE;
 
@@ -99,8 +113,9 @@ void updateLedState() {
         led.setState(g_rfidFeedbackState);
         return;
     }
+    EvseSnapshot snap = evse.getSnapshot();
     // Priority 1: Error States
-    if (evse.getVehicleState() == VEHICLE_ERROR || evse.getVehicleState() == VEHICLE_NO_POWER) {
+    if (snap.vehicleState == VEHICLE_ERROR || snap.vehicleState == VEHICLE_NO_POWER) {
         led.setState(LED_ERROR);
         return;
     }
@@ -115,19 +130,20 @@ void updateLedState() {
         return;
     }
     // Priority 3: Solar Throttling (Low Current)
-    if (evse.getCurrentLimit() < 6.0f && evse.isVehicleConnected()) {
+    if (snap.currentLimitDa < MIN_CURRENT_DA && snap.vehicleConnected()) {
         led.setState(LED_SOLAR_IDLE);
         return;
     }
     // Priority 4: Standard States
-    if (evse.getState() == STATE_CHARGING) led.setState(LED_CHARGING);
-    else if (evse.isVehicleConnected()) led.setState(LED_CONNECTED);
-    else led.setState(LED_READY);
+    if (snap.state == STATE_CHARGING) led.setState(LED_CHARGING);
+    else if (snap.vehicleConnected()) led.setState(LED_CONNECTED);
+    else led.setState(g_netReady ? LED_READY : LED_BOOT);
 }
 
 // --- DUAL CORE TASK ---
 // Run EVSE logic on a dedicated high-priority task to prevent WiFi/Web lag
-// from affecting safety timings.
+// from affecting safety timings. The task is event-driven: it sleeps until the ADC
+// DMA completes a pilot frame (~3.2ms) and processes every frame as soon as it lands.
 void evseLoopTask(void* parameter) {
     // Retrieve the OTA flag pointer passed during task creation
     volatile bool* pOtaUpdating = (volatile bool*)parameter;
@@ -136,30 +152,104 @@ void evseLoopTask(void* parameter) {
     // Without this, esp_task_wdt_reset() inside this loop does nothing.
     esp_task_wdt_add(NULL);
 
+    pilot.attachFrameTask(xTaskGetCurrentTaskHandle());
+    rcm.attachTask(xTaskGetCurrentTaskHandle());
+
     for (;;) {
         // SAFETY: Reset watchdog so if main loop blocks, EVSE task prevents hard reboot
         // This ensures charging safety logic continues even if WiFi/Web UI freezes
         esp_task_wdt_reset();
 
         if (pOtaUpdating && *pOtaUpdating) {
+            pilot.attachFrameTask(NULL);
+            rcm.attachTask(NULL);
             logger.info("[EVSE_TASK] OTA Flag detected. Unregistering WDT...");
             esp_task_wdt_delete(NULL);
             logger.info("[EVSE_TASK] WDT Unregistered. Deleting task...");
             vTaskDelete(NULL);
         }
 
+        // Block until the next DMA frame (timeout keeps WDT/OTA handling alive if the ADC stops;
+        // it follows the sample profile, whose frames can be several times longer). An RCM
+        // trip wakes the task early, without a frame.
+        bool frame = pilot.waitForFrame(pilot.getFrameTimeoutMs());
+
         evse.loop();
-        // Dynamic polling: Fast (2ms) when connected for safety/PWM response, Slow (50ms) when idle.
-        if (evse.getVehicleState() != VEHICLE_NOT_CONNECTED) {
-            vTaskDelay(pdMS_TO_TICKS(3));
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(50));
+        if (frame) pilot.frameProcessed();
+        // Idle until its next boundary; the commands it posts run next cycle
+        scheduler.loop();
+        solar.loop();
+        mainsLimiter.loop();
+
+        // First pass through the state machine: pilot, relay and RCM are live.
+        if (g_pilotReadyMs == 0) {
+            g_pilotReadyMs = millis();
+            logger.infof("[EVSE_TASK] Safety core ready: pilot live %lu ms after boot", g_pilotReadyMs);
         }
+
         updateLedState();
         led.loop();
     }
 }
 
+// --- NETWORK BRING-UP TASK ---
+// WiFi association can take up to 360 x 500ms. Running it (and everything that depends on
+// it) in its own task keeps the safety core independent from the network at boot.
+void networkBootTask(void* parameter) {
+    esp_task_wdt_add(NULL);
+
+    if (config.wifiSsid.length() == 0) {
+        webController.begin(deviceId, true);
+    } else {
+        if (config.useStatic) {
+            IPAddress ip, gw, sn;
+            if (ip.fromString(config.staticIp) && gw.fromString(config.staticGw) && sn.fromString(config.staticSn)) WiFi.config(ip, gw, sn);
+        }
+        WiFi.begin(config.wifiSsid.c_str(), config.wifiPass.c_str());
+        int retry = 0;
+        while (WiFi.status() != WL_CONNECTED && retry < 360) { 
+            vTaskDelay(pdMS_TO_TICKS(500));
+            retry++; 
+            esp_task_wdt_reset(); 
+        }
+
+        if (WiFi.status() != WL_CONNECTED) {
+            webController.begin(deviceId, true);
+            isFallbackApMode = true;
+        } else {
+            logger.info("[NET] WiFi Connected!");
+            logger.infof("[NET] SSID     : %s", config.wifiSsid.c_str());
+            logger.infof("[NET] IP ADDR  : %s", WiFi.localIP().toString().c_str());
+            logger.infof("[NET] MAC ADDR : %s", WiFi.macAddress().c_str());
+            logger.infof("[NET] HOSTNAME : %s", deviceId.c_str());
+            applyMqttConfig();
+            // Wall-clock time for session history, OCPP timestamps and the local schedule
+            configTzTime(config.timezone.c_str(), "pool.ntp.org", "time.nist.gov");
+            
+            // Start OCPP only after network is established to save resources during boot
+            if (config.ocppEnabled) {
+                ocppHandler.begin();
+            }
+            webController.begin(deviceId, false);
+        }
+    }
+
+    // Initialize Telnet (loads its own config from NVS)
+    telnetServer.begin(config);
+    logger.setSecondaryOutput(&telnetServer);
+
+    MDNS.begin(deviceId.c_str());
+    ArduinoOTA.begin();
+
+    g_netReadyMs = millis();
+    g_netReady = true;
+    logger.infof("[NET] Network services ready %lu ms after boot", g_netReadyMs);
+
+    esp_task_wdt_delete(NULL);
+    netTaskHandle = NULL;
+    vTaskDelete(NULL);
+}
+
 void setup() {
 
     evse.preinit_hard(); 
@@ -219,6 +309,10 @@ void setup() {
     cs.disableAtLowLimit = !config.allowBelow6AmpCharging; // Invert logic for internal struct
     cs.softStart = config.softStart;
     cs.lowLimitResumeDelayMs = config.lowLimitResumeDelayMs;
+    cs.mainsVoltage = config.mainsVoltage;
+    cs.rampUpDaPerS = ampsToDeciamps(config.rampUpRate);
+    cs.rampDownDaPerS = ampsToDeciamps(config.rampDownRate);
+    cs.phases = config.phases;
 
     // Link MQTT Failsafe commands to AppConfig
     mqttController.setFailsafeConfig(config.mqttFailsafeEnabled, config.mqttFailsafeTimeout);
@@ -232,62 +326,40 @@ void setup() {
         config.rcmEnabled = enabled;
         saveConfig(config); // Persist to NVS
     });
+    mqttController.onGridPower([](float watts){ solar.updateGridPower(watts); });
+    SolarParams sp;
+    sp.enabled = config.solarEnabled; sp.targetW = config.solarTargetW; sp.kp = config.solarKp; sp.ki = config.solarKi; sp.autoPhase = config.solarAutoPhase;
+    solar.setParams(sp);
+    SiteParams stp;
+    stp.enabled = config.siteEnabled; stp.group = config.siteGroup; stp.priority = config.sitePriority;
+    stp.siteDa = ampsToDeciamps(config.siteCurrent); stp.fallbackDa = ampsToDeciamps(config.siteFallback);
+    stp.maxDa = ampsToDeciamps(config.maxCurrent);
+    site.configure(stp);
+    mqttController.onMainsCurrent([](const ActualCurrent& mains){ mainsLimiter.updateMainsCurrent(mains); });
+    PhaseParams pp;
+    pp.fuseDa = ampsToDeciamps(config.mainsFuse); pp.line = config.phaseLine;
+    mainsLimiter.setParams(pp);
 
     // Initialize OCPP
     ocppHandler.setConfig(config.ocppEnabled, config.ocppHost, config.ocppPort, config.ocppUrl, config.ocppUseTls, config.ocppAuthKey, config.ocppHeartbeatInterval, config.ocppReconnectInterval);
 
-    if (config.wifiSsid.length() == 0) {
-        webController.begin(deviceId, true);
-    } else {
-        WiFi.mode(WIFI_STA);
-        WiFi.setSleep(false); // Disable WiFi power saving to prevent latency/crashes
-        if (config.useStatic) {
-            IPAddress ip, gw, sn;
-            if (ip.fromString(config.staticIp) && gw.fromString(config.staticGw) && sn.fromString(config.staticSn)) WiFi.config(ip, gw, sn);
-        }
-        WiFi.begin(config.wifiSsid.c_str(), config.wifiPass.c_str());
-        int retry = 0;
-        while (WiFi.status() != WL_CONNECTED && retry < 360) { 
-            unsigned long startWait = millis();
-            while (millis() - startWait < 500) {
-                led.loop();
-                delay(5);
-            }
-            retry++; 
-            esp_task_wdt_reset(); 
-        }
-
-        if (WiFi.status() != WL_CONNECTED) {
-            webController.begin(deviceId, true);
-            isFallbackApMode = true;
-            led.setState(LED_WIFI_CONFIG);
-        } else {
-            logger.info("[NET] WiFi Connected!");
-            logger.infof("[NET] SSID     : %s", config.wifiSsid.c_str());
-            logger.infof("[NET] IP ADDR  : %s", WiFi.localIP().toString().c_str());
-            led.setState(LED_READY);
-            logger.infof("[NET] MAC ADDR : %s", WiFi.macAddress().c_str());
-            logger.infof("[NET] HOSTNAME : %s", deviceId.c_str());
-            applyMqttConfig();
-            
-            // Start OCPP only after network is established to save resources during boot
-            if (config.ocppEnabled) {
-                ocppHandler.begin();
-            }
-            webController.begin(deviceId, false);
-        }
-    }
-
-    // Initialize Telnet (loads its own config from NVS)
-    telnetServer.begin(config);
-    logger.setSecondaryOutput(&telnetServer);
+    // --- RADIO INITIALIZATION ---
+    // Bring the WiFi driver up (RF calibration / NVS access) BEFORE the ADC DMA starts, to
+    // avoid Cache Error crashes from DMA interrupts while the RF/NVS init runs. The slow part
+    // (association) is deferred to networkBootTask. Credentials live in our own NVS namespace,
+    // so the WiFi driver must not write its copy to flash while the ADC DMA is running.
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+    WiFi.setSleep(false); // Disable WiFi power saving to prevent latency/crashes
 
     // --- HARDWARE INITIALIZATION ---
-    // Moved here to prevent Cache Error crashes during WiFi/NVS initialization.
-    // The ADC DMA interrupts must not fire while WiFi is initializing the RF/NVS.
+    // The safety core (pilot, relay, RCM) comes up first so a vehicle is detected within
+    // a few hundred milliseconds of power-on, independent of the network.
     logger.info("[MAIN] Initializing EVSE Hardware...");
     evse.setup(cs);
     evse.setRcmEnabled(config.rcmEnabled);
+    sessionLog.begin();
+    scheduler.begin();
 
     // RCM Initialization & Self-Test
     bool rcmBootTestPassed = true;
@@ -317,8 +389,8 @@ void setup() {
     rfid.onCardScanned([](String uid, bool authorized){
         if(authorized) {
             logger.infof("[RFID] Auth Success: %s. Toggling Charge.", uid.c_str());
-            if(evse.getState() == STATE_CHARGING) evse.stopCharging();
-            else evse.startCharging();
+            sessionLog.setPendingTag(uid.c_str());
+            evse.post(EVSE_CMD_TOGGLE, EVSE_SRC_RFID);
             g_rfidFeedbackState = LED_RFID_OK;
             g_rfidFeedbackUntil = millis() + 2000; // Show Green for 2 seconds
         } else {
@@ -328,19 +400,31 @@ void setup() {
         }
     });
 
-    MDNS.begin(deviceId.c_str());
-    ArduinoOTA.begin();
-
     // Create the Safety Task on Core 1 (App Core) with higher priority (2) than loop (1)
     // This ensures charging logic takes precedence over Network/UI.
     xTaskCreatePinnedToCore(evseLoopTask, "EVSE_Logic", 8192, (void*)&g_otaUpdating, 2, &evseTaskHandle, 1);
 
+    // Network bring-up runs concurrently on Core 0 (Protocol Core, next to the WiFi stack).
+    xTaskCreatePinnedToCore(networkBootTask, "NET_Boot", 8192, NULL, 1, &netTaskHandle, 0);
 }
 
 void loop() {
     esp_task_wdt_reset(); 
 
     bootCount.loop();
+    rfid.loop();
+    evse.persistEnergy();
+    sessionLog.loop();
+    // Runs before the network is up too: without a coordinator the fallback share applies
+    site.loop();
+
+    // Network services are started by networkBootTask; until it is done only the
+    // local services above may run here.
+    if (!g_netReady) {
+        delay(10);
+        return;
+    }
+
     // WiFi Recovery Logic (AP Fallback -> STA)
     if (isFallbackApMode) {
         static unsigned long lastWifiRetry = 0;
@@ -358,7 +442,6 @@ void loop() {
     }
 
     webController.loop();
-    rfid.loop();
     telnetServer.loop();
     if (config.mqttEnabled) mqttController.loop();
     if (config.ocppEnabled) ocppHandler.loop();
@@ -366,13 +449,19 @@ void loop() {
     
     // MQTT HEARTBEAT & FAILSAFE
     static unsigned long lastMqttSeen = 0;
+    static bool mqttFailsafePosted = false;
     if (config.mqttEnabled && mqttController.connected()) {
         lastMqttSeen = millis();
+        mqttFailsafePosted = false;
     } else if (config.mqttFailsafeEnabled && (millis() - lastMqttSeen > (config.mqttFailsafeTimeout * 1000UL))) {
         // If we are charging and haven't seen the broker for [timeout] seconds, STOP.
-        if (evse.getState() == STATE_CHARGING) {
+        // The stop runs in the EVSE task; post it once rather than every pass until it lands.
+        bool charging = (evse.getSnapshot().state == STATE_CHARGING);
+        if (charging && !mqttFailsafePosted) {
             logger.error("[SAFETY] MQTT Connection Lost. Failsafe triggered: Stopping Charge.");
-            evse.stopCharging();
+            mqttFailsafePosted = evse.post(EVSE_CMD_STOP, EVSE_SRC_SYSTEM);
+        } else if (!charging) {
+            mqttFailsafePosted = false;
         }
     }
 
@@ -380,9 +469,10 @@ void loop() {
     static unsigned long lastOcppUpdate = 0;
     if (config.ocppEnabled && (millis() - lastOcppUpdate > 1000)) {
         lastOcppUpdate = millis();
-        ActualCurrent ac = evse.getActualCurrent();
-        // Assuming 230V for power calculation
-        float totalCurrent = ac.l1 + ac.l2 + ac.l3;
-        ocppHandler.setConnectorData(totalCurrent, 230.0f, totalCurrent * 230.0f, 0.0f);
+        // Same counters as MQTT and the web UI: integrated by the EVSE task
+        EvseSnapshot snap = evse.getSnapshot();
+        float totalCurrent = snap.actual.l1 + snap.actual.l2 + snap.actual.l3;
+        ocppHandler.setConnectorData(totalCurrent, (float)snap.mainsVoltage, (float)snap.powerW,
+                                     (float)(snap.lifetimeMwh / 1000ULL));
     }
 }
\ No newline at end of file
@@ -12,14 +12,17 @@
 #include "EvseCharge.h"
 #include "Rcm.h"
 #include "EvseLogger.h"
+#include "EvseConfig.h"
 #include <Arduino.h>
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
 
 extern Rcm rcm;
 
 EvseCharge::EvseCharge(Pilot &pilotRef) {
     pilot = &pilotRef;
-    relay = new Relay();
+    relay = new Relay(PIN_RELAY_OUT, "RELAY", PIN_RELAY_FB_IN);
+    phaseRelay = new Relay(PIN_PHASE_RELAY_OUT, "PHASE", PIN_PHASE_RELAY_FB_IN);
 }
 
 void EvseCharge::preinit_hard() {
@@ -27,13 +30,27 @@ void EvseCharge::preinit_hard() {
 }
 
 void EvseCharge::setup(ChargingSettings settings_) {
+    // The EVSE task is the only writer of this state and of the snapshot seqlock; a second
+    // writer could leave the sequence odd and hang every reader
+    if (__atomic_load_n(&taskRunning, __ATOMIC_RELAXED)) {
+        logger.error("[EVSE] setup() ignored: EVSE task running (use postSettings)");
+        return;
+    }
     logger.info("[EVSE] Setup begin");
     relay->setup(LOW);
     pilot->begin();
     pilot->standby();
 
     settings = settings_;
-    currentLimit = settings.maxCurrent;
+    // Main contactor is open here, so the phase contactor can take its position at once
+    activePhases = (phaseRelay->isFitted() && settings.phases == 3) ? 3 : settings.phases;
+    phaseTarget = activePhases;
+    phaseSwitch = PHASE_SW_IDLE;
+    phaseRelay->setup(activePhases == 3 ? HIGH : LOW);
+    maxCurrentDa = ampsToDeciamps(settings.maxCurrent);
+    currentLimitDa = maxCurrentDa;
+    rampTargetDa = maxCurrentDa;
+    rampDownRate = settings.rampDownDaPerS;
     vehicleState = VEHICLE_NOT_CONNECTED;
     state = STATE_READY;
     _actualCurrentUpdated = 0;
@@ -46,15 +63,31 @@ void EvseCharge::setup(ChargingSettings settings_) {
     logger.info("[EVSE] Error lockout initialized (fail-safe)");
     lastRcmTestTime = millis(); // Initialize timer (power-on test is handled in main setup)
 
+    // The lifetime register is read once; a later re-setup must not roll back unsaved energy
+    if (!energyLoaded) {
+        lifetimeMwh = loadLifetimeEnergy();
+        persistedMwh = lifetimeMwh;
+        lastPersistMs = millis();
+        energyLoaded = true;
+        logger.infof("[EVSE] Lifetime energy: %llu Wh", lifetimeMwh / 1000ULL);
+    }
+    lastMeterUs = (uint32_t)esp_timer_get_time();
+    publishSnapshot();
+
     logger.info("[EVSE] Setup done");
 }
 
 void EvseCharge::loop() {
+    __atomic_store_n(&taskRunning, true, __ATOMIC_RELAXED);
+
     // Safety: Check Residual Current Monitor
     if (rcmEnabled && rcm.isTriggered()) {
-        logger.error("[EVSE] CRITICAL: RCM Fault Detected! Emergency Stop.");
+        RcmTripStats trip = rcm.getTripStats();
+        logger.errorf("[EVSE] CRITICAL: RCM Fault Detected! Emergency Stop. (ISR coil %lu us, task %lu us)",
+                      (unsigned long)trip.lastCoilUs, (unsigned long)trip.lastTaskUs);
         relay->open();
-        stopCharging();
+        stopSession(EVSE_STOP_FAULT);
+        if (!rcmTripped) raise(EVSE_EVT_FAULT, 1, EVSE_FAULT_RCM_TRIP);
         rcmTripped = true;
         if (!errorLockout) {
             errorLockout = true;
@@ -71,17 +104,50 @@ void EvseCharge::loop() {
             logger.info("[EVSE] Periodic RCM test PASSED");
         } else {
             logger.error("[EVSE] Periodic RCM test FAILED! Entering Lockout.");
+            raise(EVSE_EVT_FAULT, 1, EVSE_FAULT_RCM_TEST);
             rcmTripped = true;
             errorLockout = true;
             relay->open();
         }
     }
 
+    // Safety: Commanded pilot PWM must match what is measured on the CP line
+    bool pwmFault = pilot->isPwmFault();
+    if (pwmFault != lastPwmFault) {
+        lastPwmFault = pwmFault;
+        raise(EVSE_EVT_FAULT, pwmFault ? 1 : 0, EVSE_FAULT_PILOT_PWM);
+    }
+    if (pwmFault && !errorLockout) {
+        logger.error("[EVSE] CRITICAL: Pilot PWM mismatch! Stopping charge.");
+        if (state == STATE_CHARGING) stopSession(EVSE_STOP_FAULT);
+        errorLockout = true;
+        logger.warn("[EVSE] Error lockout activated due to Pilot PWM mismatch");
+    }
+
+    // External commands run here, after the safety checks and before the state machine
+    processCommands();
+
+    updatePhaseSwitch();
     relay->loop();
+    phaseRelay->loop();
+    checkContactors();
+    if (relay->isClosed() != lastRelayClosed) {
+        lastRelayClosed = relay->isClosed();
+        raise(EVSE_EVT_RELAY, lastRelayClosed ? 1 : 0);
+    }
+    updateEnergy();
     updateVehicleState();
-    managePwmAndRelay();           // SAE J1772 state machine
     checkResumeFromLowLimit();
 
+    // Cable rating (PP) is decoded asynchronously; re-offer the limit when it changes
+    uint16_t cableDa = pilot->getCableRatingDa();
+    if (cableDa != lastCableDa) {
+        lastCableDa = cableDa;
+        if (cableDa == 0) logger.warn("[EVSE] PP: no cable or invalid coding - offering 0 A");
+        else if (cableDa != PP_RATING_NOT_FITTED) logger.infof("[EVSE] PP: cable rated %u A", cableDa / 10);
+        dispatch(EVSE_EVENT_LIMIT);
+    }
+
     // Auto-Start Logic (Power Loss Recovery)
     // If the device reboots and detects a car immediately, we assume we should resume charging.
     static bool bootRecoveryChecked = false;
@@ -97,26 +163,22 @@ void EvseCharge::loop() {
     }
 
     // ThrottleAlive Logic (Centralized Safety)
-    // If enabled (>0) and charging, check if external control data is stale.
-    if (throttleAliveTimeout > 0 && state == STATE_CHARGING) {
-        unsigned long now = millis();
-        if ((now - lastThrottleAliveTime) > (throttleAliveTimeout * 1000UL)) {
-            // Data is stale. Ramp down to minimum current.
-            if (currentLimit > 6.0f) {
-                // Ramp down by 1A every 5 seconds
-                if (now - lastThrottleRampTime >= 5000UL) {
-                    float next = currentLimit - 1.0f;
-                    if (next < 6.0f) next = 6.0f;
-                    logger.warnf("[EVSE] ThrottleAlive: Stale data. Ramping %.1fA -> %.1fA", currentLimit, next);
-                    setCurrentLimit(next);
-                    lastThrottleRampTime = now;
-                }
-            }
-        } else {
-            // Data is fresh. Reset ramp timer so first drop happens immediately on timeout.
-            lastThrottleRampTime = now - 5000UL; 
+    // If enabled (>0) and charging, check if external control data is stale. The fallback
+    // to the minimum goes through the ramp engine at its own gentle rate. A schedule window
+    // sets the limit locally, so there is nothing to go stale while it holds it.
+    if (throttleAliveTimeout > 0 && state == STATE_CHARGING && !scheduleHold && rampTargetDa > MIN_CURRENT_DA) {
+        unsigned long lastAlive = __atomic_load_n(&lastThrottleAliveTime, __ATOMIC_RELAXED);
+        if ((millis() - lastAlive) > (throttleAliveTimeout * 1000UL)) {
+            logger.warnf("[EVSE] ThrottleAlive: Stale data. Ramping %u.%uA -> %u.%uA",
+                         currentLimitDa / 10, currentLimitDa % 10, MIN_CURRENT_DA / 10, MIN_CURRENT_DA % 10);
+            requestLimitDa(MIN_CURRENT_DA, THROTTLE_ALIVE_RAMP_DA_PER_S);
         }
     }
+
+    updateRamp();
+
+    publishSnapshot();
+    flushEvents();
 }
 
 bool EvseCharge::isSafetyLockoutActive() const {
@@ -133,16 +195,14 @@ void EvseCharge::updateVehicleState() {
         vehicleStateToText(newState, buf);
         logger.infof("[EVSE] Vehicle state: %s", buf);
 
-        if (vehicleState != VEHICLE_CONNECTED &&
-            vehicleState != VEHICLE_READY &&
-            vehicleState != VEHICLE_READY_VENTILATION_REQUIRED &&
-            state == STATE_CHARGING) {
-            stopCharging();
-        }
+        dispatch(EVSE_EVENT_VEHICLE);
+        raise(EVSE_EVT_VEHICLE, vehicleState);
 
-        applyCurrentLimit();
-
-        if (vehicleStateChange) vehicleStateChange();
+        // Unplugging ends a paused session; it can no longer be resumed
+        if (vehicleState == VEHICLE_NOT_CONNECTED && userPaused) {
+            userPaused = false;
+            raise(EVSE_EVT_SESSION_STOP, 0, EVSE_STOP_VEHICLE);
+        }
     }
 }
 
@@ -159,7 +219,7 @@ void EvseCharge::startCharging() {
                               vehicleState == VEHICLE_READY || 
                               vehicleState == VEHICLE_READY_VENTILATION_REQUIRED);
 
-        if (isSignalValid && !rcmTripped) {
+        if (isSignalValid && !rcmTripped && !contactorTripped) {
             logger.warn("[EVSE] Safety Lockout overridden by manual Start command. Resuming session...");
             errorLockout = false;
         } else {
@@ -186,6 +246,7 @@ void EvseCharge::startCharging() {
         logger.info("[EVSE] Pre-charge RCM self-test initiating...");
         if (!rcm.selfTest()) {
             logger.error("[EVSE] Pre-charge RCM test FAILED. Aborting charge.");
+            raise(EVSE_EVT_FAULT, 1, EVSE_FAULT_RCM_TEST);
             rcmTripped = true;
             errorLockout = true;
             relay->open();
@@ -200,6 +261,15 @@ void EvseCharge::startCharging() {
 
     state = STATE_CHARGING;
     started = millis();
+    if (!userPaused) {
+        // New session; a resume after a pause continues the same one
+        sessionStartedMs = started;
+        sessionMwh = 0;
+        sessionPeakMa = 0;
+        sessionAvgMa = 0;
+        sessionCurrentMaUs = 0;
+        sessionChargeUs = 0;
+    }
     userPaused = false; // Clear pause flag on start/resume
     lastThrottleAliveTime = millis(); // Reset ThrottleAlive timer on start
 
@@ -207,24 +277,31 @@ void EvseCharge::startCharging() {
     // This allows external controllers to ramp up current safely.
     if (settings.softStart) {
         logger.info("[EVSE] Soft-start active (Resetting to 6A)");
-        currentLimit = MIN_CURRENT;
+        rampTargetDa = MIN_CURRENT_DA;
+        if (currentLimitDa != MIN_CURRENT_DA) {
+            currentLimitDa = MIN_CURRENT_DA;
+            raise(EVSE_EVT_LIMIT, currentLimitDa);
+        }
     }
 
-    applyCurrentLimit();
-    if (stateChange) stateChange();
+    dispatch(EVSE_EVENT_START);
+    raise(EVSE_EVT_STATE, state);
+    raise(EVSE_EVT_SESSION_START, 0);
 }
 
 void EvseCharge::stopCharging() {
+    stopSession(EVSE_STOP_USER);
+}
+
+void EvseCharge::stopSession(EVSE_STOP_REASON_T reason) {
     logger.info("[EVSE] stopCharging() called");
-    
-    // SAFETY: J1772 requires PWM to +12V FIRST, then open relay
-    // This signals vehicle to stop drawing current before power is cut
-    // Prevents arcing and contactor wear from opening under load
-    pilot->standby();
-    relay->open();
-    
+
     if (state != STATE_CHARGING) {
+        // Stopping a paused session closes it
+        if (userPaused) raise(EVSE_EVT_SESSION_STOP, 0, reason);
         userPaused = false; // Ensure pause flag is cleared if we force stop from non-charging state
+        // A stop must always leave the outputs safe, even when no session is running
+        dispatch(EVSE_EVENT_STOP);
         logger.warn("[EVSE] Stop ignored: Not charging");
         return;
     }
@@ -232,18 +309,22 @@ void EvseCharge::stopCharging() {
     logger.info("[EVSE] Stop charging");
     state = STATE_READY;
     userPaused = false; // Clear pause flag on explicit stop
-    if (stateChange) stateChange();
+    // SAFETY: J1772 requires PWM to +12V FIRST, then open relay (table applies pilot first).
+    // This signals vehicle to stop drawing current before power is cut
+    // Prevents arcing and contactor wear from opening under load
+    dispatch(EVSE_EVENT_STOP);
+    raise(EVSE_EVT_STATE, state);
+    raise(EVSE_EVT_SESSION_STOP, 0, reason);
 }
 
 void EvseCharge::pauseCharging() {
     if (state == STATE_CHARGING) {
         logger.info("[EVSE] pauseCharging() called");
-        // SAFETY: J1772 requires PWM to +12V FIRST, then open relay
-        pilot->standby();
-        relay->open();
         state = STATE_READY;
         userPaused = true;
-        if (stateChange) stateChange();
+        dispatch(EVSE_EVENT_STOP);
+        raise(EVSE_EVT_STATE, state);
+        raise(EVSE_EVT_SESSION_STOP, 0, EVSE_STOP_PAUSE);
     } else {
         logger.warn("[EVSE] Pause ignored: Not charging");
     }
@@ -273,7 +354,11 @@ bool EvseCharge::isPaused() const {
 
 float EvseCharge::getCurrentLimit() const {
 //    logger.debugf("[EVSE] getCurrentLimit -> %.2f A", currentLimit);
-    return currentLimit;
+    return (float)currentLimitDa / 10.0f;
+}
+
+uint16_t EvseCharge::getCurrentLimitDa() const {
+    return currentLimitDa;
 }
 
 unsigned long EvseCharge::getElapsedTime() const {
@@ -283,21 +368,127 @@ unsigned long EvseCharge::getElapsedTime() const {
 }
 
 void EvseCharge::setCurrentLimit(float amps) {
-    if (amps < 0) amps = 0;
-    if (amps > settings.maxCurrent) amps = settings.maxCurrent;
+    setCurrentLimitDa(ampsToDeciamps(amps));
+}
+
+void EvseCharge::setCurrentLimitDa(uint16_t deciamps) {
+    requestLimitDa(deciamps, settings.rampDownDaPerS);
+}
 
-    if (amps != currentLimit) {
-        currentLimit = amps;
-        logger.infof("[EVSE] Setting current limit to %.2f A", amps);
-        applyCurrentLimit();
+uint16_t EvseCharge::getTargetLimitDa() const {
+    return rampTargetDa;
+}
+
+/* =========================
+ * Current Ramp
+ * ========================= */
+
+// Every limit source lands here: the request becomes the ramp target and the applied
+// limit follows at the up/down rate. Outside a session nothing draws current, so the
+// target is applied at once.
+void EvseCharge::requestLimitDa(uint16_t deciamps, uint16_t downRateDaPerS) {
+    if (deciamps > maxCurrentDa) deciamps = maxCurrentDa;
+    rampDownRate = downRateDaPerS;
+    if (deciamps == rampTargetDa && deciamps == currentLimitDa) return;
+
+    bool newTarget = (deciamps != rampTargetDa);
+    bool fromRest = (rampTargetDa == currentLimitDa);
+    bool reversed = !fromRest && ((deciamps > currentLimitDa) != (rampTargetDa > currentLimitDa));
+    rampTargetDa = deciamps;
+    uint16_t rate = (deciamps > currentLimitDa) ? settings.rampUpDaPerS : rampDownRate;
+    if (rate == 0 || state != STATE_CHARGING) {
+        applyLimitDa(deciamps);
+        return;
+    }
+    // Accrued fraction belongs to the old direction and rate; a reversal starts clean
+    if (fromRest || reversed) {
+        lastRampMs = millis();
+        rampRemainder = 0;
+    }
+    if (newTarget) {
+        logger.infof("[EVSE] Ramping current limit %u.%u A -> %u.%u A (%u.%u A/s)", currentLimitDa / 10, currentLimitDa % 10,
+                     deciamps / 10, deciamps % 10, rate / 10, rate % 10);
     }
 }
 
+// Tick, every EVSE cycle. Free when the applied limit is on target; otherwise moves it at
+// most every RAMP_TICK_MS by the whole deciamps accrued at the active rate.
+void EvseCharge::updateRamp() {
+    if (currentLimitDa == rampTargetDa) return;
+    unsigned long now = millis();
+    if (now - lastRampMs < RAMP_TICK_MS) return;
+
+    bool up = rampTargetDa > currentLimitDa;
+    uint16_t rate = up ? settings.rampUpDaPerS : rampDownRate;
+    if (rate == 0 || state != STATE_CHARGING) {
+        applyLimitDa(rampTargetDa);
+        return;
+    }
+
+    rampRemainder += (uint32_t)rate * (now - lastRampMs);   // 0.1A * ms
+    lastRampMs = now;
+    uint32_t step = rampRemainder / 1000;
+    if (step == 0) return;
+    rampRemainder -= step * 1000;
+    uint16_t gap = up ? rampTargetDa - currentLimitDa : currentLimitDa - rampTargetDa;
+    if (step >= gap) {
+        step = gap;
+        rampRemainder = 0;
+    }
+    applyLimitDa(up ? currentLimitDa + step : currentLimitDa - step);
+}
+
+void EvseCharge::applyLimitDa(uint16_t deciamps) {
+    if (deciamps == currentLimitDa) return;
+    uint16_t step = (deciamps > currentLimitDa) ? deciamps - currentLimitDa : currentLimitDa - deciamps;
+    if (step > rampStats.maxStepDa) rampStats.maxStepDa = step;
+    rampStats.steps++;
+
+    currentLimitDa = deciamps;
+    if (deciamps == rampTargetDa) {
+        logger.infof("[EVSE] Setting current limit to %u.%u A", deciamps / 10, deciamps % 10);
+    }
+    dispatch(EVSE_EVENT_LIMIT);
+    raise(EVSE_EVT_LIMIT, currentLimitDa);
+}
+
+// Limit actually offered on the pilot: never above the rating coded in the cable (PP),
+// this unit's share of the site supply or what the main fuse has left
+uint16_t EvseCharge::effectiveLimitDa() const {
+    uint16_t limitDa = currentLimitDa;
+    uint16_t cableDa = pilot->getCableRatingDa();      // PP_RATING_NOT_FITTED = no cap
+    if (cableDa < limitDa) limitDa = cableDa;
+    if (siteCapDa < limitDa) limitDa = siteCapDa;
+    if (phaseCapDa < limitDa) limitDa = phaseCapDa;
+    return limitDa;
+}
+
+// Site share from the load balancer. Applied at once in both directions: the site supply
+// is shared, so a reduction must not wait for the ramp.
+void EvseCharge::setSiteCapDa(uint16_t deciamps) {
+    if (deciamps == siteCapDa) return;
+    if (deciamps == EVSE_CAP_NONE) logger.info("[EVSE] Site cap removed");
+    else logger.infof("[EVSE] Site cap %u.%u A", deciamps / 10, deciamps % 10);
+    siteCapDa = deciamps;
+    dispatch(EVSE_EVENT_LIMIT);
+}
+
+// Main fuse headroom from the phase limiter; same immediate handling as the site cap
+void EvseCharge::setPhaseCapDa(uint16_t deciamps) {
+    if (deciamps == phaseCapDa) return;
+    if (deciamps == EVSE_CAP_NONE) logger.info("[EVSE] Main fuse cap removed");
+    else logger.infof("[EVSE] Main fuse cap %u.%u A", deciamps / 10, deciamps % 10);
+    phaseCapDa = deciamps;
+    dispatch(EVSE_EVENT_LIMIT);
+}
+
 void EvseCharge::updateActualCurrent(ActualCurrent current) {
-    _actualCurrent = current;
-    _actualCurrentUpdated = millis();
+    MeterReading r;
+    r.current = current;
+    r.ms = millis();
+    meterIn.publish(r);
 
-    logger.infof("[EVSE] Actual current L1,L2,L3: %.2f %.2f %.2f", current.l1, current.l2, current.l3);
+    logger.debugf("[EVSE] Actual current L1,L2,L3: %.2f %.2f %.2f", current.l1, current.l2, current.l3);
 }
 
 ActualCurrent EvseCharge::getActualCurrent() const {
@@ -312,6 +503,18 @@ float EvseCharge::getPilotDuty() const {
     return duty;
 }
 
+float EvseCharge::getPilotMeasuredDuty() const {
+    return pilot->getMeasuredDuty();
+}
+
+float EvseCharge::getPilotMeasuredFrequency() const {
+    return pilot->getMeasuredFrequency();
+}
+
+bool EvseCharge::isPilotPwmFault() const {
+    return pilot->isPwmFault();
+}
+
 void EvseCharge::enableCurrentTest(bool enable) {
     if (enable && state == STATE_CHARGING) {
         logger.warn("[EVSE] Test rejected: charging active");
@@ -320,6 +523,7 @@ void EvseCharge::enableCurrentTest(bool enable) {
     currentTest = enable;
     logger.info(enable ? "[EVSE] Test mode ENABLED" : "[EVSE] Test mode DISABLED");
     pilot->standby();
+    relay->open();
 }
 
 void EvseCharge::setCurrentTest(float amps) {
@@ -336,109 +540,138 @@ void EvseCharge::setThrottleAliveTimeout(unsigned long seconds) {
 }
 
 void EvseCharge::signalThrottleAlive() {
-    lastThrottleAliveTime = millis();
+    // Single word store, safe from any task; no need to go through the queue
+    __atomic_store_n(&lastThrottleAliveTime, millis(), __ATOMIC_RELAXED);
 }
 
-void EvseCharge::onVehicleStateChange(EvseEventHandler handler) { vehicleStateChange = handler; }
-void EvseCharge::onStateChange(EvseEventHandler handler) { stateChange = handler; }
-
 void EvseCharge::checkResumeFromLowLimit() {
     // If we are paused and the current is now high enough, check if the delay has passed.
-    if (pausedAtLowLimit && currentLimit >= MIN_CURRENT) {
-        unsigned long now = millis();
-        unsigned long elapsed = (now >= pausedSince) ? (now - pausedSince) : 0UL;
-
-        if (elapsed >= settings.lowLimitResumeDelayMs) {
+    if (pausedAtLowLimit && effectiveLimitDa() >= MIN_CURRENT_DA) {
+        if ((millis() - pausedSince) >= settings.lowLimitResumeDelayMs) {
             logger.info("[EVSE] Low-limit pause delay elapsed. Resuming.");
-            applyCurrentLimit(); // This will handle the actual resume.
+            dispatch(EVSE_EVENT_LIMIT); // offerCurrent() handles the actual resume.
         }
     }
 }
 
-void EvseCharge::applyCurrentLimit() {
-    // TEST MODE: Keep PWM running (ignore vehicle state) and force Relay OPEN
-    if (currentTest) {
-        relay->open();
+// Puts the effective limit on the pilot. Returns false while a low-limit pause is holding
+// the contactor open (limit below MIN_CURRENT in pause mode, or resume cooldown running).
+bool EvseCharge::offerCurrent() {
+    if (phaseSwitch != PHASE_SW_IDLE) {
+        // Phase change in progress: +12V; the contactor may only stay closed until the
+        // vehicle has stopped drawing (updatePhaseSwitch opens it)
+        pilot->standby();
+        return phaseSwitch == PHASE_SW_STOPPING && relay->isClosed();
+    }
+    uint16_t offeredDa = effectiveLimitDa();
+    if (offeredDa == 0 && pilot->getCableRatingDa() == 0) {
+        // PP fitted but no valid cable coding: 0 A is not a throttle level, nothing is offered
+        pilot->standby();
+        return false;
+    }
+    if (offeredDa < MIN_CURRENT_DA) {
+        // Current limit below minimum (dynamic power throttling for solar budget)
+        pilot->currentLimitDa(offeredDa);
+        if (!settings.disableAtLowLimit) {
+            // THROTTLE MODE: Allow current below MIN_CURRENT for continuous solar throttling
+            logger.infof("[EVSE] Applying low current limit: %u.%u A (solar throttling)", offeredDa / 10, offeredDa % 10);
+            pausedAtLowLimit = false;
+            return true;
+        }
+        // PAUSE MODE: Maintain PWM with reduced duty instead of hard standby; relay open
+        if (!pausedAtLowLimit) {
+            logger.infof("[EVSE] Low power pause: PWM set to %u.%u A (solar budget insufficient)", offeredDa / 10, offeredDa % 10);
+            pausedAtLowLimit = true;
+            pausedSince = millis();
+        }
+        return false;
+    }
+
+    if (pausedAtLowLimit) {
+        // Only resume after the configured cooldown to avoid rapid toggling;
+        // until then the pilot keeps the paused duty.
+        if ((millis() - pausedSince) < settings.lowLimitResumeDelayMs) return false;
+        logger.info("[EVSE] Resuming pilot PWM after low-limit pause");
+        pausedAtLowLimit = false;
+    }
+    pilot->currentLimitDa(offeredDa);
+    return true;
+}
+
+/* =========================
+ * Phase Switching
+ * ========================= */
+
+void EvseCharge::requestPhases(uint8_t phases) {
+    if (phases != 1 && phases != 3) return;
+    if (!canSwitchPhases()) {
+        logger.warn("[EVSE] Phase switch ignored: no phase contactor or 1-phase installation");
         return;
     }
+    switchPhases(phases);
+}
 
-    // J1772 Compliance: If not charging (and not in test mode), force DC Standby.
-    // Prevents sending PWM (State B2) when we are only in State B1 (EVSE Ready, but not authorized).
-    if (state != STATE_CHARGING) {
-        pilot->standby();
-        relay->open();
+// Starts (or re-targets) the switch sequence; the phase contactor must be fitted
+void EvseCharge::switchPhases(uint8_t phases) {
+    if (phases == phaseTarget) return;
+    phaseTarget = phases;
+    if (phaseSwitch == PHASE_SW_STOPPING && phases == activePhases) {
+        // Nothing switched yet: drop the pause
+        logger.infof("[EVSE] Phase switch cancelled, staying %u-phase", phases);
+        phaseSwitch = PHASE_SW_IDLE;
+        dispatch(EVSE_EVENT_LIMIT);
         return;
     }
+    if (phaseSwitch != PHASE_SW_IDLE) return;   // The running sequence picks up the new target
 
-    if (vehicleState == VEHICLE_CONNECTED ||
-        vehicleState == VEHICLE_READY ||
-        vehicleState == VEHICLE_READY_VENTILATION_REQUIRED) {
-
-        if (currentLimit >= MIN_CURRENT) {
-            // If we previously paused due to low-limit, only resume after the
-            // configured cooldown in settings.lowLimitResumeDelayMs has elapsed.
-            if (pausedAtLowLimit) {
-                unsigned long now = millis();
-                unsigned long elapsed = (now >= pausedSince) ? (now - pausedSince) : 0UL;
-                if (elapsed >= settings.lowLimitResumeDelayMs) {
-                    // Resume PWM with current limit (this attaches PWM if needed)
-                    pilot->currentLimit(currentLimit);
-                    logger.info("[EVSE] Resuming pilot PWM after low-limit pause");
-                    pausedAtLowLimit = false;
-                } else {
-                    // Still in cooldown period: keep pilot in standby and relay open
-                    // to avoid rapid toggling. Do not change relay/state here.
-                    return;
-                }
-            } else {
-                // Normal resume/apply
-                pilot->currentLimit(currentLimit);
-            }
+    logger.infof("[EVSE] Switching to %u-phase: pausing the vehicle", phases);
+    phaseSwitch = PHASE_SW_STOPPING;
+    phaseSwitchMs = millis();
+    dispatch(EVSE_EVENT_LIMIT);                 // Pilot to +12V while a session runs
+}
 
-            if (state == STATE_CHARGING &&
-                (vehicleState == VEHICLE_READY || vehicleState == VEHICLE_READY_VENTILATION_REQUIRED))
-                relay->close();
-            else
-                relay->open();
-        } else {
-            // Current limit below minimum (dynamic power throttling for solar budget)
-            if (settings.disableAtLowLimit) {
-                // PAUSE MODE: Maintain PWM with reduced duty instead of hard standby
-                // Vehicle interprets continuous low-duty PWM as reduced charging capacity
-                // Relay controlled per configuration; resume after delay
-                pilot->currentLimit(currentLimit);  // Keep PWM, just lower duty
-                
-                relay->open();
-
-                if (!pausedAtLowLimit) {
-                    logger.infof("[EVSE] Low power pause: PWM set to %.2f A (solar budget insufficient)", currentLimit);
-                    pausedAtLowLimit = true;
-                    pausedSince = millis();
-                }
-            } else {
-                // THROTTLE MODE: Allow current below MIN_CURRENT for continuous solar throttling
-                // No pause/resume delay logic - direct PWM adjustment
-                logger.infof("[EVSE] Applying low current limit: %.2f A (solar throttling)", currentLimit);
-                pilot->currentLimit(currentLimit);
-                // Clear pause flag since we're not actually pausing, just throttling
-                pausedAtLowLimit = false;
-            }
-        }
-    } else {
-        relay->open();
-        pilot->standby();
-        // If car is unplugged, we are no longer "paused at low limit"
-        if (pausedAtLowLimit) {
-            pausedAtLowLimit = false;
+// Tick, every EVSE cycle before the relays. The phase contactor is only ever switched
+// with the main contactor physically open.
+void EvseCharge::updatePhaseSwitch() {
+    if (phaseSwitch == PHASE_SW_IDLE) return;
+    unsigned long now = millis();
+
+    if (phaseSwitch == PHASE_SW_STOPPING) {
+        if (!relay->isOpen()) {
+            // Wait for the vehicle to leave C (S2 open) or give it the IEC 61851 reaction time
+            bool drawing = (vehicleState == VEHICLE_READY || vehicleState == VEHICLE_READY_VENTILATION_REQUIRED);
+            if (drawing && (now - phaseSwitchMs) < PHASE_SWITCH_STOP_TIMEOUT_MS) return;
+            relay->open();
+            return;                             // Opens in relay->loop() this cycle
         }
+        if (relay->isPending()) return;
+        if (phaseTarget == 3) phaseRelay->close();
+        else phaseRelay->open();
+        phaseSwitch = PHASE_SW_SETTLING;
+        phaseSwitchMs = now;
+        return;
     }
+
+    // SETTLING
+    if (phaseRelay->isPending() || (now - phaseSwitchMs) < PHASE_SWITCH_SETTLE_MS) return;
+    uint8_t reached = phaseRelay->isClosed() ? 3 : 1;
+    if (reached != phaseTarget) {
+        // Target changed while settling: switch again, the main contactor is still open
+        phaseSwitch = PHASE_SW_STOPPING;
+        return;
+    }
+    if (reached != activePhases) phaseSwitchCount++;
+    activePhases = reached;
+    phaseSwitch = PHASE_SW_IDLE;
+    logger.infof("[EVSE] Now charging %u-phase. Resuming", activePhases);
+    dispatch(EVSE_EVENT_LIMIT);
 }
 
 void EvseCharge::setAllowBelow6AmpCharging(bool allow) {
     settings.disableAtLowLimit = !allow; // Inverted logic: Allow=true means DisablePause=true (wait, DisablePause=false) -> DisableAtLowLimit=false
     logger.infof("[EVSE] AllowBelow6AmpCharging set to %s", allow ? "TRUE (Throttle)" : "FALSE (Strict J1772)");
     // Immediately apply behavior in case currentLimit is below threshold
-    applyCurrentLimit();
+    dispatch(EVSE_EVENT_LIMIT);
 }
 
 bool EvseCharge::getAllowBelow6AmpCharging() const {
@@ -451,111 +684,340 @@ void EvseCharge::setLowLimitResumeDelay(unsigned long ms) {
     logger.infof("[EVSE] lowLimitResumeDelayMs set to %lu ms", ms);
 }
 
+/* =========================
+ * Energy Metering
+ * ========================= */
+
+static uint32_t phaseMilliamps(float amps) {
+    if (!(amps > 0.0f)) return 0;
+    uint32_t ma = (uint32_t)(amps * 1000.0f + 0.5f);
+    return ma > ENERGY_MAX_PHASE_MA ? ENERGY_MAX_PHASE_MA : ma;
+}
+
+// Runs every EVSE cycle. Float is only touched when a new meter reading arrives; the
+// per-cycle step is integer multiply/add.
+void EvseCharge::updateEnergy() {
+    MeterReading r;
+    if (meterIn.tryTake(r)) {
+        _actualCurrent = r.current;
+        _actualCurrentUpdated = r.ms;
+        phaseMa[0] = phaseMilliamps(r.current.l1);
+        phaseMa[1] = phaseMilliamps(r.current.l2);
+        phaseMa[2] = phaseMilliamps(r.current.l3);
+    }
+
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+    uint32_t dtUs = nowUs - lastMeterUs;
+    lastMeterUs = nowUs;
+    if (dtUs > ENERGY_MAX_STEP_US) dtUs = ENERGY_MAX_STEP_US;
+
+    bool fresh = _actualCurrentUpdated != 0 && (millis() - _actualCurrentUpdated) < ENERGY_METER_STALE_MS;
+    if (!fresh || !relay->isClosed()) {
+        powerW = 0;
+        return;
+    }
+
+    // 3 x 100 A x 260 V = 78e6 mW, well inside 32 bits
+    uint32_t milliW = (phaseMa[0] + phaseMa[1] + phaseMa[2]) * settings.mainsVoltage;
+    powerW = milliW / 1000;
+    energyMwUs += (uint64_t)milliW * dtUs;
+    if (energyMwUs >= ENERGY_MWUS_PER_MWH) {
+        uint64_t whole = energyMwUs / ENERGY_MWUS_PER_MWH;
+        energyMwUs -= whole * ENERGY_MWUS_PER_MWH;
+        sessionMwh += whole;
+        lifetimeMwh += whole;
+    }
+
+    // Session current statistics on the highest loaded phase (the one the limit applies to)
+    uint32_t maxMa = phaseMa[0];
+    if (phaseMa[1] > maxMa) maxMa = phaseMa[1];
+    if (phaseMa[2] > maxMa) maxMa = phaseMa[2];
+    if (maxMa > sessionPeakMa) sessionPeakMa = maxMa;
+    sessionCurrentMaUs += (uint64_t)maxMa * dtUs;
+    sessionChargeUs += dtUs;
+    if (sessionChargeUs) sessionAvgMa = (uint32_t)(sessionCurrentMaUs / sessionChargeUs);
+}
+
+// Reads the published counter, so it never races the EVSE task. NVS pages wear, so the
+// register is written on a timer while charging and once when it settles afterwards.
+void EvseCharge::persistEnergy() {
+    EvseSnapshot snap = getSnapshot();
+    if (snap.lifetimeMwh == persistedMwh) return;
+    unsigned long interval = (snap.state == STATE_CHARGING && snap.relayClosed)
+                                 ? ENERGY_PERSIST_INTERVAL_MS : ENERGY_PERSIST_MIN_GAP_MS;
+    if (millis() - lastPersistMs < interval) return;
+    saveLifetimeEnergy(snap.lifetimeMwh);
+    persistedMwh = snap.lifetimeMwh;
+    lastPersistMs = millis();
+    logger.debugf("[EVSE] Lifetime energy saved: %llu Wh", snap.lifetimeMwh / 1000ULL);
+}
+
+/* =========================
+ * State Snapshot (seqlock)
+ * ========================= */
+
+// Single writer: the EVSE task, once per cycle (setup() publishes once at boot, before the
+// task starts, and refuses afterwards). The sequence is odd while the copy is in progress;
+// readers retry until they see the same even value before and after their copy.
+void EvseCharge::publishSnapshot() {
+    EvseSnapshot next;
+    next.seq = snapshot.seq + 1;
+    next.timeMs = millis();
+    next.state = state;
+    next.vehicleState = vehicleState;
+    next.currentLimitDa = currentLimitDa;
+    next.targetLimitDa = rampTargetDa;
+    next.offeredLimitDa = effectiveLimitDa();
+    next.pwmDutyCounts = pilot->getPwmDutyCounts();
+    next.pilotMv = pilot->getVoltageMv();
+    next.relayClosed = relay->isClosed();
+    next.paused = userPaused;
+    next.lockout = errorLockout;
+    next.rcmEnabled = rcmEnabled;
+    next.rcmTripped = rcmTripped;
+    next.contactorFault = contactorFault;
+    next.pwmFault = pilot->isPwmFault();
+    next.measuredDuty = pilot->getMeasuredDuty();
+    next.measuredFrequency = pilot->getMeasuredFrequency();
+    next.actual = _actualCurrent;
+    next.powerW = powerW;
+    next.sessionMwh = sessionMwh;
+    next.sessionStartedMs = sessionStartedMs;
+    next.sessionPeakMa = sessionPeakMa;
+    next.sessionAvgMa = sessionAvgMa;
+    next.lifetimeMwh = lifetimeMwh;
+    next.mainsVoltage = settings.mainsVoltage;
+    next.phases = activePhases;
+    next.phaseSwitching = (phaseSwitch != PHASE_SW_IDLE);
+    next.startedMs = started;
+
+    uint32_t seq = snapshotSeq;
+    __atomic_store_n(&snapshotSeq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    snapshot = next;
+    __atomic_store_n(&snapshotSeq, seq + 2, __ATOMIC_RELEASE);
+}
+
+EvseSnapshot EvseCharge::getSnapshot() const {
+    EvseSnapshot copy;
+    for (;;) {
+        uint32_t before = __atomic_load_n(&snapshotSeq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;   // Writer mid-copy (it runs at higher priority; this is brief)
+        copy = snapshot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&snapshotSeq, __ATOMIC_RELAXED) == before) return copy;
+    }
+}
+
+/* =========================
+ * Event Bus
+ * ========================= */
+
+// Events are held until the end of the cycle so subscribers can read the snapshot that
+// matches them; a burst larger than the buffer is flushed early rather than lost.
+void EvseCharge::raise(EVSE_EVT_T type, int32_t value, uint8_t code) {
+    if (pendingEventCount >= EVSE_BUS_RING_LEN) flushEvents();
+    EvseEvent& ev = pendingEvents[pendingEventCount++];
+    ev.type = (uint8_t)type;
+    ev.code = code;
+    ev.reserved = 0;
+    ev.value = value;
+    ev.seq = snapshot.seq + 1;     // Published at the end of this cycle
+    ev.timeMs = millis();
+}
+
+void EvseCharge::flushEvents() {
+    for (uint8_t i = 0; i < pendingEventCount; i++) eventBus.publish(pendingEvents[i]);
+    pendingEventCount = 0;
+}
+
+/* =========================
+ * Command Queue
+ * ========================= */
+
+bool EvseCharge::postSettings(const ChargingSettings& settings_, EVSE_CMD_SOURCE_T source) {
+    settingsIn.publish(settings_);
+    return post(EVSE_CMD_APPLY_SETTINGS, source);
+}
+
+bool EvseCharge::post(EVSE_CMD_T type, EVSE_CMD_SOURCE_T source, uint16_t arg) {
+    EvseCommand cmd;
+    cmd.type = (uint8_t)type;
+    cmd.source = (uint8_t)source;
+    cmd.arg = arg;
+    cmd.enqueuedUs = (uint32_t)esp_timer_get_time();
+    if (commandQueue.push(cmd)) return true;
+
+    __atomic_fetch_add(&commandStats[source].dropped, 1, __ATOMIC_RELAXED);
+    logger.warnf("[EVSE] Command queue full: %s command %u dropped", evseCommandSourceName(source), (unsigned)type);
+    return false;
+}
+
+const EvseCommandStats& EvseCharge::getCommandStats(EVSE_CMD_SOURCE_T source) const {
+    return commandStats[source];
+}
+
+void EvseCharge::processCommands() {
+    EvseCommand cmd;
+    while (commandQueue.pop(cmd)) {
+        executeCommand(cmd);
+
+        // Actuation point: pilot/relay requests for this command have been issued
+        uint32_t latency = (uint32_t)esp_timer_get_time() - cmd.enqueuedUs;
+        EvseCommandStats& st = commandStats[cmd.source < EVSE_SRC_COUNT ? cmd.source : EVSE_SRC_SYSTEM];
+        st.count++;
+        st.lastUs = latency;
+        st.totalUs += latency;
+        if (latency > st.maxUs) st.maxUs = latency;
+    }
+}
+
+void EvseCharge::executeCommand(const EvseCommand& cmd) {
+    switch (cmd.type) {
+        case EVSE_CMD_START:          startCharging(); break;
+        case EVSE_CMD_STOP:           stopSession(cmd.source == EVSE_SRC_SCHEDULE ? EVSE_STOP_SCHEDULE : EVSE_STOP_USER); break;
+        case EVSE_CMD_PAUSE:          pauseCharging(); break;
+        case EVSE_CMD_TOGGLE:
+            if (state == STATE_CHARGING) stopCharging();
+            else startCharging();
+            break;
+        case EVSE_CMD_SET_LIMIT:      setCurrentLimitDa(cmd.arg); break;
+        case EVSE_CMD_SITE_CAP:       setSiteCapDa(cmd.arg); break;
+        case EVSE_CMD_PHASE_CAP:      setPhaseCapDa(cmd.arg); break;
+        case EVSE_CMD_SET_PHASES:     requestPhases((uint8_t)cmd.arg); break;
+        case EVSE_CMD_ALLOW_BELOW_6A: setAllowBelow6AmpCharging(cmd.arg != 0); break;
+        case EVSE_CMD_CURRENT_TEST:   enableCurrentTest(cmd.arg != 0); break;
+        case EVSE_CMD_TEST_CURRENT:
+            if (!currentTest) enableCurrentTest(true);
+            setCurrentTest((float)cmd.arg / 10.0f);
+            break;
+        case EVSE_CMD_APPLY_SETTINGS: {
+            ChargingSettings next;
+            if (settingsIn.tryTake(next)) applySettings(next);
+            break;
+        }
+        case EVSE_CMD_SET_RCM:        setRcmEnabled(cmd.arg != 0); break;
+        case EVSE_CMD_SET_THROTTLE_TIMEOUT: setThrottleAliveTimeout(cmd.arg); break;
+        default:
+            logger.warnf("[EVSE] Unknown command %u from %s", (unsigned)cmd.type, evseCommandSourceName(cmd.source));
+            break;
+    }
+}
+
+// New settings at run time. The pilot and the relays keep running: the limit goes through
+// the ramp, a phase count change through the phase switch sequence, and the state machine
+// re-applies the low-limit behaviour. A running session is not interrupted.
+void EvseCharge::applySettings(const ChargingSettings& settings_) {
+    logger.info("[EVSE] Applying new charging settings");
+    settings = settings_;
+    maxCurrentDa = ampsToDeciamps(settings.maxCurrent);
+    requestLimitDa(maxCurrentDa, settings.rampDownDaPerS);
+
+    uint8_t phases = (phaseRelay->isFitted() && settings.phases == 3) ? 3 : settings.phases;
+    if (phaseRelay->isFitted()) {
+        switchPhases(phases);
+    } else {
+        activePhases = phases;
+        phaseTarget = phases;
+    }
+    dispatch(EVSE_EVENT_LIMIT);
+}
+
 /* =========================
  * SAE J1772 State Machine
  * ========================= */
 
-void EvseCharge::managePwmAndRelay() {
-    // TEST MODE: Skip J1772 state enforcement to keep PWM running
+// Executes the J1772_TABLE cell for (state, vehicleState, event). Called only on events,
+// never per loop, so steady state costs nothing.
+void EvseCharge::dispatch(EVSE_EVENT_T event) {
+    // TEST MODE: PWM is driven by setCurrentTest(); keep the relay open, skip J1772 enforcement
     if (currentTest) {
         relay->open();
         return;
     }
 
-    // Detect vehicle state transitions for error handling
-    if (vehicleState != lastManagedVehicleState) {
-        lastManagedVehicleState = vehicleState;
-        
-        // Handle error and no-power states
-        if (vehicleState == VEHICLE_ERROR || vehicleState == VEHICLE_NO_POWER) {
-            if (!errorLockout) {
-                errorLockout = true;
-                char stateBuf[32];
-                vehicleStateToText(vehicleState, stateBuf);
-                logger.warnf("[EVSE] Error lockout activated: %s", stateBuf);
-                if (state == STATE_CHARGING) {
-                    stopCharging();  // Emergency stop
-                }
-            }
-        }
-        // SAFETY: Clear error lockout only when vehicle is safely disconnected (fail-safe recovery)
-        // This is the only safe path to recover from error/no-power states
-        else if (vehicleState == VEHICLE_NOT_CONNECTED && errorLockout) {
-            errorLockout = false;
-            rcmTripped = false; // Reset RCM trip flag when vehicle is unplugged
-            logger.warn("[EVSE] Error lockout CLEARED: Vehicle fully disconnected (safe to accept new start commands)");
+    uint8_t act = J1772_TABLE.lookup(state, vehicleState, event);
+
+    if (act & J1772_LOCKOUT) {
+        if (!errorLockout) {
+            char stateBuf[32];
+            vehicleStateToText(vehicleState, stateBuf);
+            logger.warnf("[EVSE] Error lockout activated: %s", stateBuf);
         }
+        errorLockout = true;
+        raise(EVSE_EVT_FAULT, 1, EVSE_FAULT_VEHICLE);
     }
-    
-    // State machine: Manage PWM and relay based on vehicle state and charging state
-    // 
-    // SAE J1772 Spec Firmware Actions:
-    // State A (NOT_CONNECTED):      PWM Off; Relay Open
-    // State B (CONNECTED):          PWM On (low); Relay Open (vehicle in standby)
-    // State C (READY):              PWM On (full); Relay Closed (if charging)
-    // State D (VENTILATION):        PWM On (full); Relay Closed (if charging, log vent)
-    // State E/F (ERROR):            Emergency Stop; Lockout
-    // State 4 (NO_POWER):           PWM Off; Relay Open; Lockout
-    
-    switch (vehicleState) {
-        case VEHICLE_NOT_CONNECTED:
-            // State A: No vehicle detected
+    // SAFETY: Clear error lockout only when vehicle is safely disconnected (fail-safe recovery)
+    if ((act & J1772_CLEAR_LOCKOUT) && errorLockout) {
+        errorLockout = false;
+        rcmTripped = false; // Reset RCM trip flag when vehicle is unplugged
+        contactorTripped = false;
+        rcm.clearLatch();   // Contactor and PWM may be driven again
+        logger.warn("[EVSE] Error lockout CLEARED: Vehicle fully disconnected (safe to accept new start commands)");
+        raise(EVSE_EVT_FAULT, 0, EVSE_FAULT_LOCKOUT);
+    }
+
+    bool offered = true;
+    switch (act & J1772_PILOT_MASK) {
+        case J1772_PILOT_STANDBY:
             pilot->standby();
-            relay->open();
+            pausedAtLowLimit = false; // No PWM, so no low-limit pause in progress
             break;
-            
-        case VEHICLE_CONNECTED:
-            // State B: Vehicle detected but not ready
-            // J1772: If not charging, offer DC (Standby), not PWM.
-            // PWM implies "Power Available" which might confuse the car if we aren't started.
-            if (state != STATE_CHARGING) pilot->standby();
-            relay->open();
-            break;
-            
-        case VEHICLE_READY:
-            // State C: Vehicle ready for charging
-            if (state == STATE_CHARGING) {
-                // SAFETY: Only apply PWM after relay is confirmed closed
-                // This ensures vehicle only sees "power available" when power IS available
-                relay->close();
-                pilot->currentLimit(currentLimit);
-            } else {
-                // Not charging: Force DC Standby. Tells car "Wait".
-                pilot->standby();
-                relay->open();
-            }
+        case J1772_PILOT_OFFER:
+            offered = offerCurrent();
             break;
-            
-        case VEHICLE_READY_VENTILATION_REQUIRED:
-            // State D: Vehicle ready with ventilation requirement
-            if (state == STATE_CHARGING) {
-                pilot->currentLimit(currentLimit);
-                relay->close();
-            } else {
-                // Not charging: Force DC Standby.
-                pilot->standby();
-                relay->open();
-            }
+        default:
             break;
-            
-        case VEHICLE_NO_POWER:
-            // State 4: No power detected - error condition
-            pilot->standby();
+    }
+
+    switch (act & J1772_RELAY_MASK) {
+        case J1772_RELAY_OPEN:
             relay->open();
             break;
-            
-        case VEHICLE_ERROR:
-            // State E/F: Error condition - emergency stop
-            pilot->standby();
-            relay->open();
+        case J1772_RELAY_CLOSE:
+            if (offered) relay->close();
+            else relay->open();
             break;
-            
         default:
-            pilot->standby();
-            relay->open();
             break;
     }
+
+    if (act & J1772_END_SESSION) {
+        logger.info("[EVSE] Vehicle left charging states. Session ended.");
+        state = STATE_READY;
+        userPaused = false;
+        raise(EVSE_EVT_STATE, state);
+        raise(EVSE_EVT_SESSION_STOP, 0, EVSE_STOP_VEHICLE);
+    }
+}
+
+// Safety: contactor feedback (when fitted) must agree with the coil. A welded or failed
+// contactor opens the main contactor and locks out until unplug, even when the feedback
+// agrees again once the coil is released (a contact that never closed); a weld keeps
+// re-locking after unplug.
+void EvseCharge::checkContactors() {
+    RELAY_FAULT_T fault = relay->getFault();
+    if (fault == RELAY_FAULT_NONE) fault = phaseRelay->getFault();
+    if (fault != contactorFault) {
+        if (contactorFault != RELAY_FAULT_NONE) {
+            raise(EVSE_EVT_FAULT, 0, contactorFault == RELAY_FAULT_WELDED ? EVSE_FAULT_CONTACTOR_WELD : EVSE_FAULT_CONTACTOR_OPEN);
+        }
+        if (fault != RELAY_FAULT_NONE) {
+            raise(EVSE_EVT_FAULT, 1, fault == RELAY_FAULT_WELDED ? EVSE_FAULT_CONTACTOR_WELD : EVSE_FAULT_CONTACTOR_OPEN);
+        }
+        contactorFault = fault;
+    }
+    if (fault == RELAY_FAULT_NONE) return;
+
+    contactorTripped = true;
+    relay->open();
+    if (state == STATE_CHARGING) stopSession(EVSE_STOP_FAULT);
+    if (!errorLockout) {
+        errorLockout = true;
+        logger.warn("[EVSE] Error lockout activated due to contactor feedback mismatch");
+    }
 }
+
 unsigned long EvseCharge::getLowLimitResumeDelay() const {
 //    logger.debugf("[EVSE] getLowLimitResumeDelay -> %lu ms", settings.lowLimitResumeDelayMs);
     return settings.lowLimitResumeDelayMs;
@@ -563,6 +1025,7 @@ unsigned long EvseCharge::getLowLimitResumeDelay() const {
 
 void EvseCharge::setRcmEnabled(bool enable) {
     rcmEnabled = enable;
+    rcm.arm(enable);
     logger.infof("[EVSE] RCM Safety Check %s", enable ? "ENABLED" : "DISABLED");
 }
 
@@ -579,10 +1042,11 @@ void EvseCharge::setSafetyLockout(bool locked) {
         errorLockout = locked;
         if (locked) {
             logger.warn("[EVSE] Safety Lockout Externally ACTIVATED");
-            if (state == STATE_CHARGING) stopCharging();
+            if (state == STATE_CHARGING) stopSession(EVSE_STOP_FAULT);
             relay->open();
         } else {
             logger.info("[EVSE] Safety Lockout Externally CLEARED");
         }
+        raise(EVSE_EVT_FAULT, locked ? 1 : 0, EVSE_FAULT_LOCKOUT);
     }
 }
@@ -19,13 +19,201 @@
 #include "Pilot.h"
 #include "Relay.h"
 #include "EvseTypes.h"
+#include "EvseCommand.h"
+#include "EvseEvents.h"
 
-typedef void (*EvseEventHandler)();
+/* =========================
+ * SAE J1772 Transition Table
+ * ========================= */
+// Pilot and contactor are only touched when one of these happens; in steady state the
+// loop does nothing but read the pilot. Worst-case reaction time is therefore the pilot
+// debounce dwell plus one table lookup.
+enum EVSE_EVENT_T {
+    EVSE_EVENT_VEHICLE = 0,   // Debounced vehicle state changed (table indexed by the new state)
+    EVSE_EVENT_START,         // Session started (state is already STATE_CHARGING)
+    EVSE_EVENT_STOP,          // Session stopped or paused (state is already STATE_READY)
+    EVSE_EVENT_LIMIT,         // Offered current changed (limit, cable rating, low-limit resume)
+    EVSE_EVENT_COUNT
+};
+
+// Action word: one pilot action, one relay action, plus side-effect flags.
+// Pilot is always applied before the relay (J1772: +12V first, then open).
+constexpr uint8_t J1772_ACT_NONE      = 0x00;
+constexpr uint8_t J1772_PILOT_STANDBY = 0x01;   // Steady +12V (State A / B1)
+constexpr uint8_t J1772_PILOT_OFFER   = 0x02;   // PWM at the effective current limit
+constexpr uint8_t J1772_PILOT_MASK    = 0x03;
+constexpr uint8_t J1772_RELAY_OPEN    = 0x04;
+constexpr uint8_t J1772_RELAY_CLOSE   = 0x08;   // Downgraded to OPEN while a low-limit pause holds
+constexpr uint8_t J1772_RELAY_MASK    = 0x0C;
+constexpr uint8_t J1772_END_SESSION   = 0x10;   // Vehicle left B/C/D while charging
+constexpr uint8_t J1772_LOCKOUT       = 0x20;   // State E/F or no power: enter error lockout
+constexpr uint8_t J1772_CLEAR_LOCKOUT = 0x40;   // Unplugged: the only way out of lockout
+
+constexpr bool j1772VehiclePresent(VEHICLE_STATE_T v) {
+    return v == VEHICLE_CONNECTED || v == VEHICLE_READY || v == VEHICLE_READY_VENTILATION_REQUIRED;
+}
+
+// State A:  PWM Off; Relay Open (clears lockout)
+// State B:  PWM On when charging (B2), DC standby otherwise (B1); Relay Open
+// State C/D: PWM On; Relay Closed when charging, DC standby and Open otherwise
+// State E/F, No Power: PWM Off; Relay Open; Lockout; session ended
+constexpr uint8_t j1772Action(STATE_T s, VEHICLE_STATE_T v, EVSE_EVENT_T e) {
+    return !j1772VehiclePresent(v)
+               ? (uint8_t)(J1772_PILOT_STANDBY | J1772_RELAY_OPEN
+                           | (s == STATE_CHARGING ? J1772_END_SESSION : 0)
+                           | (e != EVSE_EVENT_VEHICLE ? 0
+                              : v == VEHICLE_NOT_CONNECTED ? J1772_CLEAR_LOCKOUT : J1772_LOCKOUT))
+         : (e == EVSE_EVENT_STOP) ? (uint8_t)(J1772_PILOT_STANDBY | J1772_RELAY_OPEN)
+         // Not authorised: stay in B1; a limit change has nothing to apply
+         : (s != STATE_CHARGING) ? (e == EVSE_EVENT_LIMIT ? J1772_ACT_NONE
+                                                         : (uint8_t)(J1772_PILOT_STANDBY | J1772_RELAY_OPEN))
+         : (uint8_t)(J1772_PILOT_OFFER | (v == VEHICLE_CONNECTED ? J1772_RELAY_OPEN : J1772_RELAY_CLOSE));
+}
+
+struct J1772Table {
+    uint8_t act[STATE_COUNT][VEHICLE_STATE_COUNT][EVSE_EVENT_COUNT];
+    constexpr J1772Table() : act() {
+        for (int s = 0; s < STATE_COUNT; s++)
+            for (int v = 0; v < VEHICLE_STATE_COUNT; v++)
+                for (int e = 0; e < EVSE_EVENT_COUNT; e++)
+                    act[s][v][e] = j1772Action((STATE_T)s, (VEHICLE_STATE_T)v, (EVSE_EVENT_T)e);
+    }
+    constexpr uint8_t lookup(STATE_T s, VEHICLE_STATE_T v, EVSE_EVENT_T e) const {
+        return act[s][v][e];
+    }
+    // Walks every cell at compile time and checks the J1772 safety invariants
+    constexpr bool verify() const {
+        for (int s = 0; s < STATE_COUNT; s++)
+            for (int v = 0; v < VEHICLE_STATE_COUNT; v++)
+                for (int e = 0; e < EVSE_EVENT_COUNT; e++) {
+                    uint8_t a = act[s][v][e];
+                    bool charging = (s == STATE_CHARGING);
+                    bool present = j1772VehiclePresent((VEHICLE_STATE_T)v);
+                    bool draws = (v == VEHICLE_READY || v == VEHICLE_READY_VENTILATION_REQUIRED);
+                    if ((a & J1772_PILOT_MASK) == J1772_PILOT_MASK) return false;
+                    if ((a & J1772_RELAY_MASK) == J1772_RELAY_MASK) return false;
+                    // PWM only inside a session with a vehicle present
+                    if ((a & J1772_PILOT_OFFER) && !(charging && present)) return false;
+                    // Contactor only closes while offering PWM to a vehicle in C/D
+                    if ((a & J1772_RELAY_CLOSE) && !(charging && draws && (a & J1772_PILOT_OFFER))) return false;
+                    // Vehicle gone or faulted: +12V and open, always
+                    if (!present && (a & (J1772_PILOT_MASK | J1772_RELAY_MASK)) != (J1772_PILOT_STANDBY | J1772_RELAY_OPEN)) return false;
+                    if (!present && charging && !(a & J1772_END_SESSION)) return false;
+                    // Stop always lands in +12V / open
+                    if (e == EVSE_EVENT_STOP && (a & (J1772_PILOT_MASK | J1772_RELAY_MASK)) != (J1772_PILOT_STANDBY | J1772_RELAY_OPEN)) return false;
+                    // Lockout is entered on E/F/no-power and left only by unplugging
+                    if ((a & J1772_LOCKOUT) && (present || v == VEHICLE_NOT_CONNECTED || e != EVSE_EVENT_VEHICLE)) return false;
+                    if ((a & J1772_CLEAR_LOCKOUT) && (v != VEHICLE_NOT_CONNECTED || e != EVSE_EVENT_VEHICLE)) return false;
+                    if (e == EVSE_EVENT_VEHICLE && !present && !(a & (J1772_LOCKOUT | J1772_CLEAR_LOCKOUT))) return false;
+                }
+        return true;
+    }
+};
+
+inline constexpr J1772Table J1772_TABLE{};
+
+static_assert(J1772_TABLE.verify(), "J1772 transition table violates a safety invariant");
+static_assert(J1772_TABLE.lookup(STATE_CHARGING, VEHICLE_READY, EVSE_EVENT_VEHICLE) == (J1772_PILOT_OFFER | J1772_RELAY_CLOSE),
+              "J1772: C while charging -> PWM, relay closed");
+static_assert(J1772_TABLE.lookup(STATE_CHARGING, VEHICLE_CONNECTED, EVSE_EVENT_START) == (J1772_PILOT_OFFER | J1772_RELAY_OPEN),
+              "J1772: start in B -> B2, relay open");
+static_assert(J1772_TABLE.lookup(STATE_READY, VEHICLE_READY, EVSE_EVENT_LIMIT) == J1772_ACT_NONE,
+              "J1772: limit change outside a session is a no-op");
+
+/* =========================
+ * Current Ramp
+ * ========================= */
+// Requested limits become a target; the applied (pilot) limit slews toward it at the
+// configured up/down rate so the vehicle's charger sees bounded steps. Safety reductions
+// (cable rating, site share, main fuse headroom) are caps in effectiveLimitDa() and skip the ramp.
+constexpr unsigned long RAMP_TICK_MS = 250;                     // Applied limit moves at most 4x per second
+constexpr uint16_t THROTTLE_ALIVE_RAMP_DA_PER_S = 2;            // Stale control data: 1A per 5 s down to 6A
+
+struct EvseRampStats {
+    uint32_t steps = 0;                 // Applied limit changes
+    uint16_t maxStepDa = 0;             // Largest single change (0.1A)
+};
+
+/* =========================
+ * Phase Switching
+ * ========================= */
+// 1-phase / 3-phase change with the optional phase contactor: pilot to +12V, main
+// contactor open once the vehicle stops drawing (or after the timeout), phase contactor
+// switched, a settle period with the contactor open, then the limit is offered again.
+constexpr unsigned long PHASE_SWITCH_STOP_TIMEOUT_MS = 3000;    // Vehicle reaction to +12V (IEC 61851)
+constexpr unsigned long PHASE_SWITCH_SETTLE_MS = 10000;         // Off time around the change
+
+enum PHASE_SWITCH_T {
+    PHASE_SW_IDLE = 0,
+    PHASE_SW_STOPPING,          // Pilot at +12V, waiting to open the main contactor
+    PHASE_SW_SETTLING           // Phase contactor switched, main contactor held open
+};
+
+/* =========================
+ * Energy Metering
+ * ========================= */
+// Phase currents (mA) times the nominal voltage give power in mW, integrated every EVSE
+// cycle into a mW*us remainder; whole mWh are moved into 64-bit counters, so a session
+// or a lifetime of charging accumulates without float rounding drift.
+constexpr uint64_t ENERGY_MWUS_PER_MWH = 3600000000ULL;        // 1 mWh = 3.6e9 mW*us
+constexpr uint32_t ENERGY_MAX_PHASE_MA = 100000;                // Plausibility cap per phase
+constexpr uint32_t ENERGY_MAX_STEP_US = 1000000;                // Never credit a stall longer than 1 s
+constexpr unsigned long ENERGY_METER_STALE_MS = 10000;          // Readings older than this count as 0 W
+// Lifetime register NVS writes: at most every 15 min while charging, plus one write once
+// the counter stops moving (session end), never closer than 1 min apart
+constexpr unsigned long ENERGY_PERSIST_INTERVAL_MS = 900000UL;
+constexpr unsigned long ENERGY_PERSIST_MIN_GAP_MS = 60000UL;
+
+/* =========================
+ * Published State Snapshot
+ * ========================= */
+// One consistent view of the EVSE, published by the EVSE task once per cycle through a
+// seqlock. Readers in other tasks (web, MQTT, OCPP, LED) copy it instead of calling a
+// dozen getters that can each see a different cycle.
+struct EvseSnapshot {
+    uint32_t seq = 0;                   // Cycle number of this publication
+    uint32_t timeMs = 0;                // millis() at publication
+    STATE_T state = STATE_READY;
+    VEHICLE_STATE_T vehicleState = VEHICLE_NOT_CONNECTED;
+    uint16_t currentLimitDa = 0;        // Applied limit (0.1A)
+    uint16_t targetLimitDa = 0;         // Requested limit the ramp is heading for
+    uint16_t offeredLimitDa = 0;        // Limit after the cable (PP), site and fuse caps
+    uint16_t pwmDutyCounts = 0;         // Commanded LEDC counts (0 = standby)
+    int pilotMv = 0;                    // Pilot high plateau (mV)
+    bool relayClosed = false;           // Physical contactor output
+    bool paused = false;
+    bool lockout = true;
+    bool rcmEnabled = true;
+    bool rcmTripped = false;
+    bool pwmFault = false;
+    RELAY_FAULT_T contactorFault = RELAY_FAULT_NONE;   // Main or phase contactor feedback
+    float measuredDuty = 0.0f;          // Measured back from the CP line (%)
+    float measuredFrequency = 0.0f;     // Hz
+    ActualCurrent actual;
+    uint32_t powerW = 0;                // Sum of all phases at mainsVoltage (0 while relay open)
+    uint64_t sessionMwh = 0;            // Since the last start (kept across a user pause)
+    unsigned long sessionStartedMs = 0; // millis() at session start (not reset by a resume)
+    uint32_t sessionPeakMa = 0;         // Highest phase current seen this session
+    uint32_t sessionAvgMa = 0;          // Highest-phase current averaged over relay-closed time
+    uint64_t lifetimeMwh = 0;           // Meter register, persisted in NVS
+    uint16_t mainsVoltage = 0;
+    uint8_t phases = 3;                 // Phases currently connected to the vehicle
+    bool phaseSwitching = false;
+    unsigned long startedMs = 0;
+
+    bool vehicleConnected() const { return j1772VehiclePresent(vehicleState); }
+    float currentLimit() const { return (float)currentLimitDa / 10.0f; }
+    float pwmDuty() const { return (float)pwmDutyCounts * 100.0f / (float)PILOT_PWM_MAX_DUTY; }
+    float sessionKwh() const { return (float)sessionMwh / 1000000.0f; }
+    float lifetimeKwh() const { return (float)(lifetimeMwh / 1000ULL) / 1000.0f; }
+};
 
 class EvseCharge {
 public:
     EvseCharge(Pilot &pilotRef);
     void preinit_hard();
+    // Boot only, before the EVSE task runs: initialises pilot, relays and state. Ignored
+    // once loop() has run; use postSettings() then
     void setup(ChargingSettings settings_);
     void loop();
 
@@ -33,14 +221,33 @@ public:
     void stopCharging();
     void pauseCharging();
 
+    // Thread-safe entry point for controllers outside the EVSE task (MQTT, OCPP, web, RFID).
+    // Executed by loop() at the start of the next cycle; false if the queue is full.
+    bool post(EVSE_CMD_T type, EVSE_CMD_SOURCE_T source, uint16_t arg = 0);
+    // Loop task: new charging settings, taken over by the EVSE task (EVSE_CMD_APPLY_SETTINGS)
+    bool postSettings(const ChargingSettings& settings_, EVSE_CMD_SOURCE_T source);
+    const EvseCommandStats& getCommandStats(EVSE_CMD_SOURCE_T source) const;
+
+    // Consistent copy of the state published at the end of the last EVSE cycle (any task)
+    EvseSnapshot getSnapshot() const;
+
     STATE_T getState() const;
     VEHICLE_STATE_T getVehicleState() const;
     bool isVehicleConnected() const;
     bool isPaused() const;
     float getCurrentLimit() const;
+    uint16_t getCurrentLimitDa() const;     // Fixed point, 0.1A units
     unsigned long getElapsedTime() const;
 
+    // Requested limit: reached through the up/down ramp (EVSE task; use post() elsewhere)
     void setCurrentLimit(float amps);
+    void setCurrentLimitDa(uint16_t deciamps);
+    uint16_t getTargetLimitDa() const;
+    // Site load balancer share, caps the offered limit (EVSE_CAP_NONE = no cap)
+    void setSiteCapDa(uint16_t deciamps);
+    // Headroom under the main fuse on the charger's phases, caps the offered limit
+    void setPhaseCapDa(uint16_t deciamps);
+    const EvseRampStats& getRampStats() const { return rampStats; }
     // Configure behavior when current limit is below MIN_CURRENT (6A)
     // true = Allow continuous throttling (Solar mode); false = Strict J1772 (Pause/Stop)
     void setAllowBelow6AmpCharging(bool allow);
@@ -48,10 +255,14 @@ public:
     // Configure cooldown (ms) to wait after low-limit pause before auto-resume
     void setLowLimitResumeDelay(unsigned long ms);
     unsigned long getLowLimitResumeDelay() const;
+    // Measured phase currents from an external meter (one feeding task). Picked up by the
+    // EVSE task on its next cycle and integrated into the energy counters.
     void updateActualCurrent(ActualCurrent current);
     ActualCurrent getActualCurrent() const;
+    // Loop task: writes the lifetime energy register to NVS at a bounded rate
+    void persistEnergy();
 
-    // RCM / RCD Control
+    // RCM / RCD Control (EVSE task or boot; use post(EVSE_CMD_SET_RCM) elsewhere)
     void setRcmEnabled(bool enable);
     bool isRcmEnabled() const;
     bool isRcmTripped() const;
@@ -59,36 +270,99 @@ public:
     bool isSafetyLockoutActive() const;
 
     float getPilotDuty() const;
+    // Duty/frequency measured back from the CP line (edge timing on the ADC stream)
+    float getPilotMeasuredDuty() const;
+    float getPilotMeasuredFrequency() const;
+    bool isPilotPwmFault() const;
 
     void enableCurrentTest(bool enable);
+    bool isCurrentTestActive() const { return currentTest; }
     void setCurrentTest(float amps);
 
-    // ThrottleAlive (Safety Timeout)
+    // ThrottleAlive (Safety Timeout; EVSE task or boot, use post(EVSE_CMD_SET_THROTTLE_TIMEOUT) elsewhere)
     void setThrottleAliveTimeout(unsigned long seconds);
     void signalThrottleAlive();
+    // EVSE task: a schedule window holds the limit (ThrottleAlive does not apply)
+    void setScheduleHold(bool hold) { scheduleHold = hold; }
+    bool isScheduleHold() const { return scheduleHold; }
+
+    const ChargingSettings& getSettings() const { return settings; }
+    // Phase contactor fitted and a 3-phase installation: EVSE_CMD_SET_PHASES can switch
+    bool canSwitchPhases() const { return phaseRelay->isFitted() && settings.phases == 3; }
+    uint8_t getActivePhases() const { return activePhases; }
+    uint32_t getPhaseSwitchCount() const { return phaseSwitchCount; }
+    // Contactor feedback and switching-time histograms (written by the EVSE task;
+    // other tasks read them as diagnostics and may see a count mid-update)
+    const Relay& getRelay() const { return *relay; }
+    const Relay& getPhaseRelay() const { return *phaseRelay; }
 
-    void onVehicleStateChange(EvseEventHandler handler);
-    void onStateChange(EvseEventHandler handler);
+    // State change, limit, fault, relay and session events (subscribe from any task)
+    EvseEventBus& getEventBus() { return eventBus; }
 
 private:
+    void stopSession(EVSE_STOP_REASON_T reason);
+    void raise(EVSE_EVT_T type, int32_t value, uint8_t code = 0);
+    void flushEvents();
+    void publishSnapshot();
+    void processCommands();
+    void executeCommand(const EvseCommand& cmd);
+    void applySettings(const ChargingSettings& settings_);
     void updateVehicleState();
-    void applyCurrentLimit();
+    void dispatch(EVSE_EVENT_T event);     // SAE J1772 state machine: execute one table cell
+    bool offerCurrent();
+    uint16_t effectiveLimitDa() const;
     void checkResumeFromLowLimit();
-    void managePwmAndRelay();      // SAE J1772 state machine (PWM/relay automation)
+    void updateEnergy();
+    void requestLimitDa(uint16_t deciamps, uint16_t downRateDaPerS);
+    void updateRamp();
+    void applyLimitDa(uint16_t deciamps);
+    void requestPhases(uint8_t phases);
+    void switchPhases(uint8_t phases);
+    void updatePhaseSwitch();
+    void checkContactors();
 
 private:
     Pilot* pilot;
     Relay* relay;
+    Relay* phaseRelay;
 
     STATE_T state = STATE_READY;
     VEHICLE_STATE_T vehicleState = VEHICLE_NOT_CONNECTED;
     ChargingSettings settings{};
-    float currentLimit = 0.0f;
+    // Current limit in deciamps (0.1A); kept integer so the loop never touches float
+    uint16_t currentLimitDa = 0;
+    uint16_t maxCurrentDa = 0;
     unsigned long started = 0;
 
     ActualCurrent _actualCurrent{};
     unsigned long _actualCurrentUpdated = 0;
 
+    // Meter input handoff (feeding task -> EVSE task)
+    struct MeterReading {
+        ActualCurrent current;
+        unsigned long ms;               // millis() when it arrived
+    };
+    SeqMailbox<MeterReading> meterIn;
+    SeqMailbox<ChargingSettings> settingsIn;
+
+    // Energy integration (EVSE task only)
+    uint32_t phaseMa[3] = {0, 0, 0};
+    uint32_t powerW = 0;
+    uint32_t lastMeterUs = 0;
+    uint64_t energyMwUs = 0;            // Sub-mWh remainder
+    uint64_t sessionMwh = 0;
+    uint64_t lifetimeMwh = 0;
+    bool energyLoaded = false;
+    unsigned long sessionStartedMs = 0;
+    uint32_t sessionPeakMa = 0;
+    uint32_t sessionAvgMa = 0;
+    uint64_t sessionCurrentMaUs = 0;
+    uint64_t sessionChargeUs = 0;
+
+    // Lifetime register persistence (loop task only)
+    uint64_t persistedMwh = 0;
+    unsigned long lastPersistMs = 0;
+
     bool currentTest = false;
     // When true the pilot was paused due to low current limit
     bool pausedAtLowLimit = false;
@@ -100,21 +374,50 @@ private:
     bool errorLockout = true;
     bool rcmEnabled = true; // Default to enabled for safety
     bool rcmTripped = false; // Track specific RCM fault
+    RELAY_FAULT_T contactorFault = RELAY_FAULT_NONE;
+    bool contactorTripped = false; // A contactor fault since the last unplug (even if cleared since)
 
     // ThrottleAlive State
     unsigned long throttleAliveTimeout = 0;
     unsigned long lastThrottleAliveTime = 0;
-    unsigned long lastThrottleRampTime = 0;
+    bool scheduleHold = false;
+    uint16_t siteCapDa = EVSE_CAP_NONE;
+    uint16_t phaseCapDa = EVSE_CAP_NONE;
+
+    // Phase switching (EVSE task)
+    uint8_t activePhases = 3;
+    uint8_t phaseTarget = 3;
+    PHASE_SWITCH_T phaseSwitch = PHASE_SW_IDLE;
+    unsigned long phaseSwitchMs = 0;
+    uint32_t phaseSwitchCount = 0;
+
+    // Current ramp: currentLimitDa follows rampTargetDa
+    uint16_t rampTargetDa = 0;
+    uint16_t rampDownRate = 0;          // Down rate of the active request (0.1A/s, 0 = instant)
+    unsigned long lastRampMs = 0;
+    uint32_t rampRemainder = 0;         // Accrued 0.1A*ms not yet applied
+    EvseRampStats rampStats;
 
     // RCM Periodic Test
     unsigned long lastRcmTestTime = 0;
     static const unsigned long RCM_TEST_INTERVAL = 86400000UL; // 24 Hours
 
-    // Track previous vehicle state to detect error transitions
-    VEHICLE_STATE_T lastManagedVehicleState = VEHICLE_NOT_CONNECTED;
+    uint16_t lastCableDa = PP_RATING_NOT_FITTED;
+
+    // Seqlock: odd while the EVSE task is writing snapshot
+    uint32_t snapshotSeq = 0;
+    bool taskRunning = false;           // Set by the first loop(); setup() is refused from then on
+    EvseSnapshot snapshot;
+
+    EvseCommandQueue commandQueue;
+    EvseCommandStats commandStats[EVSE_SRC_COUNT];
 
-    EvseEventHandler vehicleStateChange = nullptr;
-    EvseEventHandler stateChange = nullptr;
+    // Events raised during a cycle, published after that cycle's snapshot
+    EvseEventBus eventBus;
+    EvseEvent pendingEvents[EVSE_BUS_RING_LEN];
+    uint8_t pendingEventCount = 0;
+    bool lastRelayClosed = false;
+    bool lastPwmFault = false;
 };
 
 #endif
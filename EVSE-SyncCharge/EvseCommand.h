@@ -0,0 +1,174 @@
+/*****************************************************************************
+ * @file EvseCommand.h
+ * Commands from external controllers into the EVSE task.
+ *
+ * @details
+ * MQTT, OCPP, the web UI and RFID run in the Arduino loop task; the state
+ * machine runs in the EVSE task. Controllers post an `EvseCommand` into a
+ * bounded lock-free multi-producer / single-consumer queue and the EVSE task
+ * executes it at the start of its next cycle, so `EvseCharge` state is only
+ * ever mutated from one task. Each command carries its source and enqueue
+ * time so command-to-actuation latency can be tracked per source.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_COMMAND_H_
+#define EVSE_COMMAND_H_
+
+#include <Arduino.h>
+
+typedef enum EVSE_CMD {
+    EVSE_CMD_START = 0,
+    EVSE_CMD_STOP,
+    EVSE_CMD_PAUSE,
+    EVSE_CMD_TOGGLE,            // Stop if charging, start otherwise (RFID)
+    EVSE_CMD_SET_LIMIT,         // arg: deciamps
+    EVSE_CMD_ALLOW_BELOW_6A,    // arg: 0/1
+    EVSE_CMD_CURRENT_TEST,      // arg: 0/1 (enable/disable test mode)
+    EVSE_CMD_TEST_CURRENT,      // arg: deciamps (enables test mode if needed)
+    EVSE_CMD_SITE_CAP,          // arg: deciamps share of the site supply, EVSE_CAP_NONE = no cap
+    EVSE_CMD_PHASE_CAP,         // arg: deciamps left under the main fuse, EVSE_CAP_NONE = no cap
+    EVSE_CMD_SET_PHASES,        // arg: 1 or 3, switched with the phase contactor
+    EVSE_CMD_APPLY_SETTINGS,    // Settings handed over by EvseCharge::postSettings()
+    EVSE_CMD_SET_RCM,           // arg: 0/1 (RCM check disabled/enabled)
+    EVSE_CMD_SET_THROTTLE_TIMEOUT, // arg: ThrottleAlive timeout in s, 0 = off
+    EVSE_CMD_COUNT
+} EVSE_CMD_T;
+
+typedef enum EVSE_CMD_SOURCE {
+    EVSE_SRC_WEB = 0,
+    EVSE_SRC_MQTT,
+    EVSE_SRC_OCPP,
+    EVSE_SRC_RFID,
+    EVSE_SRC_SYSTEM,            // Local failsafes
+    EVSE_SRC_SCHEDULE,          // Local time-of-use schedule
+    EVSE_SRC_SOLAR,             // Local solar surplus controller
+    EVSE_SRC_SITE,              // Site load balancer
+    EVSE_SRC_MAINS,             // Per-phase main fuse limiter
+    EVSE_SRC_COUNT
+} EVSE_CMD_SOURCE_T;
+
+constexpr uint16_t EVSE_CAP_NONE = 0xFFFF;
+
+struct EvseCommand {
+    uint8_t type;               // EVSE_CMD_T
+    uint8_t source;             // EVSE_CMD_SOURCE_T
+    uint16_t arg;
+    uint32_t enqueuedUs;        // esp_timer_get_time() at post (wraps after ~71 min; only deltas used)
+};
+
+// Per-source command-to-actuation latency (post -> executed in the EVSE task)
+struct EvseCommandStats {
+    uint32_t count = 0;
+    uint32_t dropped = 0;       // Queue full at post
+    uint32_t lastUs = 0;
+    uint32_t maxUs = 0;
+    uint64_t totalUs = 0;
+};
+
+constexpr int EVSE_CMD_QUEUE_LEN = 16;      // Power of two
+static_assert((EVSE_CMD_QUEUE_LEN & (EVSE_CMD_QUEUE_LEN - 1)) == 0, "EVSE_CMD_QUEUE_LEN must be a power of two");
+
+inline const char* evseCommandSourceName(uint8_t source) {
+    static const char* const names[EVSE_SRC_COUNT] = { "web", "mqtt", "ocpp", "rfid", "system", "schedule", "solar", "site", "mains" };
+    return source < EVSE_SRC_COUNT ? names[source] : "?";
+}
+
+/* =========================
+ * Bounded MPSC Queue
+ * ========================= */
+// Sequence-numbered ring (Vyukov): producers claim a slot with one CAS on _head and
+// publish it by bumping the slot sequence; the single consumer never writes _head.
+// No locks, no allocation, safe to post from any task.
+class EvseCommandQueue {
+public:
+    EvseCommandQueue() {
+        for (uint32_t i = 0; i < EVSE_CMD_QUEUE_LEN; i++) _cells[i].seq = i;
+    }
+
+    bool push(const EvseCommand& cmd) {
+        uint32_t pos = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & (EVSE_CMD_QUEUE_LEN - 1)];
+            int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+            if (diff == 0) {
+                if (__atomic_compare_exchange_n(&_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+            } else if (diff < 0) {
+                return false;   // Full
+            } else {
+                pos = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+            }
+        }
+        cell->cmd = cmd;
+        __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Consumer side (EVSE task only)
+    bool pop(EvseCommand& out) {
+        Cell* cell = &_cells[_tail & (EVSE_CMD_QUEUE_LEN - 1)];
+        if ((int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (_tail + 1)) < 0) return false;
+        out = cell->cmd;
+        __atomic_store_n(&cell->seq, _tail + EVSE_CMD_QUEUE_LEN, __ATOMIC_RELEASE);
+        _tail++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        uint32_t seq;
+        EvseCommand cmd;
+    };
+    Cell _cells[EVSE_CMD_QUEUE_LEN];
+    uint32_t _head = 0;         // Next slot to claim (producers)
+    uint32_t _tail = 0;         // Next slot to read (consumer)
+};
+
+/* =========================
+ * Latest-Value Mailbox
+ * ========================= */
+// Seqlock handoff of a value too large for one atomic store (meter readings, settings,
+// tables): one writer task publishes, one reader task takes. The sequence is odd while
+// the writer copies. The EVSE task preempts the loop task, so the reader never waits for
+// the writer: a torn copy is dropped and taken again on its next poll. Only the newest
+// value is kept.
+template <typename T>
+class SeqMailbox {
+public:
+    // Writer task only
+    void publish(const T& value) {
+        uint32_t seq = _seq;
+        __atomic_store_n(&_seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        _value = value;
+        __atomic_store_n(&_seq, seq + 2, __ATOMIC_RELEASE);
+    }
+
+    // Writer task only: the value it published last
+    const T& peek() const { return _value; }
+
+    // Reader task only: true with a consistent copy when a value was published since the
+    // last take; false when there is nothing new or the writer is mid-copy
+    bool tryTake(T& out) {
+        uint32_t seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE);
+        if (seq == _seen || (seq & 1)) return false;
+        T copy = _value;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&_seq, __ATOMIC_RELAXED) != seq) return false;
+        _seen = seq;
+        out = copy;
+        return true;
+    }
+
+private:
+    uint32_t _seq = 0;          // Writer
+    uint32_t _seen = 0;         // Reader: sequence of the last value taken
+    T _value{};
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include <Preferences.h>
 
 static const char* PREFS_NAMESPACE = "evse_cfg";
+static const char* ENERGY_NAMESPACE = "evse_nrg";
 
 void loadConfig(AppConfig &config) {
     Preferences prefs;
@@ -40,6 +41,23 @@ void loadConfig(AppConfig &config) {
     config.mqttFailsafeTimeout = prefs.getULong("m_safe_t", 600);
     config.rcmEnabled = prefs.getBool("e_rcm_en", false);
     config.solarStopTimeout = prefs.getULong("e_sol_to", 0); // Default 0 (Disabled)
+    config.mainsVoltage = prefs.getUShort("e_volt", 230);
+    config.rampUpRate = prefs.getFloat("e_ramp_up", 2.0f);
+    config.rampDownRate = prefs.getFloat("e_ramp_dn", 0.0f);
+    config.phases = prefs.getUChar("e_phases", 3);
+    config.timezone = prefs.getString("n_tz", "UTC0");
+    config.solarEnabled = prefs.getBool("s_en", false);
+    config.solarTargetW = prefs.getInt("s_tgt", 0);
+    config.solarKp = prefs.getFloat("s_kp", 0.5f);
+    config.solarKi = prefs.getFloat("s_ki", 0.1f);
+    config.solarAutoPhase = prefs.getBool("s_1p3p", false);
+    config.phaseLine = prefs.getUChar("e_line", 1);
+    config.mainsFuse = prefs.getFloat("m_fuse", 0.0f);
+    config.siteEnabled = prefs.getBool("st_en", false);
+    config.siteCurrent = prefs.getFloat("st_cur", 32.0f);
+    config.siteFallback = prefs.getFloat("st_fb", 6.0f);
+    config.sitePriority = prefs.getUChar("st_pri", 5);
+    config.siteGroup = prefs.getUShort("st_grp", 1);
     //config.rfidEnabled = prefs.getBool("rfid_en", false);
     //config.rfidBuzzerEnabled = prefs.getBool("rfid_bz", false);
 
@@ -75,6 +93,17 @@ void saveConfig(const AppConfig &config) {
     prefs.putULong("m_safe_t", config.mqttFailsafeTimeout);
     prefs.putBool("e_rcm_en", config.rcmEnabled);
     prefs.putULong("e_sol_to", config.solarStopTimeout);
+    prefs.putUShort("e_volt", config.mainsVoltage);
+    prefs.putFloat("e_ramp_up", config.rampUpRate); prefs.putFloat("e_ramp_dn", config.rampDownRate);
+    prefs.putUChar("e_phases", config.phases);
+    prefs.putString("n_tz", config.timezone);
+    prefs.putBool("s_en", config.solarEnabled); prefs.putInt("s_tgt", config.solarTargetW);
+    prefs.putFloat("s_kp", config.solarKp); prefs.putFloat("s_ki", config.solarKi);
+    prefs.putBool("s_1p3p", config.solarAutoPhase);
+    prefs.putUChar("e_line", config.phaseLine); prefs.putFloat("m_fuse", config.mainsFuse);
+    prefs.putBool("st_en", config.siteEnabled);
+    prefs.putFloat("st_cur", config.siteCurrent); prefs.putFloat("st_fb", config.siteFallback);
+    prefs.putUChar("st_pri", config.sitePriority); prefs.putUShort("st_grp", config.siteGroup);
 //    prefs.putBool("rfid_en", config.rfidEnabled);
 //    prefs.putBool("rfid_bz", config.rfidBuzzerEnabled);
 
@@ -89,4 +118,19 @@ void saveConfig(const AppConfig &config) {
     prefs.putInt("o_to", config.ocppConnTimeout);
     
     prefs.end();
-}
\ No newline at end of file
+}
+
+uint64_t loadLifetimeEnergy() {
+    Preferences prefs;
+    prefs.begin(ENERGY_NAMESPACE, true);
+    uint64_t milliWh = prefs.getULong64("lifetime", 0);
+    prefs.end();
+    return milliWh;
+}
+
+void saveLifetimeEnergy(uint64_t milliWh) {
+    Preferences prefs;
+    prefs.begin(ENERGY_NAMESPACE, false);
+    prefs.putULong64("lifetime", milliWh);
+    prefs.end();
+}
@@ -41,6 +41,23 @@ struct AppConfig {
     unsigned long mqttFailsafeTimeout = 600; // Seconds
     bool rcmEnabled = false;
     unsigned long solarStopTimeout = 0; // 0 = Disabled
+    uint16_t mainsVoltage = 230;        // Nominal phase voltage (V) for power/energy metering
+    float rampUpRate = 2.0f;            // Current limit slew rates (A/s), 0 = immediate
+    float rampDownRate = 0.0f;
+    uint8_t phases = 3;                 // Phases wired to the vehicle (1 or 3)
+    uint8_t phaseLine = 1;              // 1-phase: supply line the charger is on (1..3)
+    float mainsFuse = 0.0f;             // Main fuse per phase (A), 0 = no fuse limiter
+    String timezone = "UTC0";           // POSIX TZ string for local-time schedules
+    bool solarEnabled = false;          // On-device surplus controller (grid power input)
+    int32_t solarTargetW = 0;           // Grid setpoint (W), import positive
+    float solarKp = 0.5f;
+    float solarKi = 0.1f;
+    bool solarAutoPhase = false;        // 1/3-phase switching on surplus (phase contactor)
+    bool siteEnabled = false;           // Share a site supply with other units (UDP multicast)
+    float siteCurrent = 32.0f;          // Site budget per phase (A)
+    float siteFallback = 6.0f;          // Per-unit share while no coordinator is heard (A)
+    uint8_t sitePriority = 5;           // 1 (low) .. 9 (high)
+    uint16_t siteGroup = 1;             // Units with the same group share one budget
     //bool rfidEnabled = false;
     //bool rfidBuzzerEnabled = true;
     // OCPP Configuration
@@ -68,4 +85,9 @@ void loadConfig(AppConfig &config);
 // Save configuration to NVS (Preferences)
 void saveConfig(const AppConfig &config);
 
+// Lifetime energy register (mWh). Kept in its own namespace so a factory reset of the
+// configuration does not zero the meter.
+uint64_t loadLifetimeEnergy();
+void saveLifetimeEnergy(uint64_t milliWh);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*****************************************************************************
+ * @file EvseEvents.h
+ * Typed event bus from the EVSE task to its observers.
+ *
+ * @details
+ * The EVSE task publishes discrete events (state change, limit change,
+ * fault, relay switch, session start/stop). Each subscriber owns a
+ * fixed-size single-producer / single-consumer ring and drains it from its
+ * own task, so MQTT, OCPP etc. react to changes instead of comparing every
+ * getter on every pass. Events of one EVSE cycle are delivered after that
+ * cycle's `EvseSnapshot` is published, so a subscriber reading the
+ * snapshot on an event always sees the state that caused it.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_EVENTS_H_
+#define EVSE_EVENTS_H_
+
+#include <Arduino.h>
+
+typedef enum EVSE_EVT {
+    EVSE_EVT_STATE = 0,         // value: STATE_T
+    EVSE_EVT_VEHICLE,           // value: VEHICLE_STATE_T
+    EVSE_EVT_LIMIT,             // value: current limit (0.1A)
+    EVSE_EVT_FAULT,             // code: EVSE_FAULT_T, value: 1 raised / 0 cleared
+    EVSE_EVT_RELAY,             // value: 1 closed / 0 open (physical output)
+    EVSE_EVT_SESSION_START,
+    EVSE_EVT_SESSION_STOP,      // code: EVSE_STOP_REASON_T
+    EVSE_EVT_RESYNC,            // Bus only: events were lost, refresh from the snapshot
+    EVSE_EVT_COUNT
+} EVSE_EVT_T;
+
+typedef enum EVSE_FAULT {
+    EVSE_FAULT_LOCKOUT = 0,     // Safety lockout set/cleared (external or unplug)
+    EVSE_FAULT_RCM_TRIP,
+    EVSE_FAULT_RCM_TEST,        // RCM self-test failed
+    EVSE_FAULT_PILOT_PWM,       // Commanded vs measured PWM mismatch
+    EVSE_FAULT_VEHICLE,         // State E/F or no power
+    EVSE_FAULT_CONTACTOR_WELD,  // Contactor feedback closed while commanded open
+    EVSE_FAULT_CONTACTOR_OPEN   // Contactor feedback open while commanded closed
+} EVSE_FAULT_T;
+
+typedef enum EVSE_STOP_REASON {
+    EVSE_STOP_USER = 0,
+    EVSE_STOP_PAUSE,
+    EVSE_STOP_VEHICLE,          // Vehicle left B/C/D or faulted
+    EVSE_STOP_FAULT,            // RCM, pilot PWM mismatch or safety lockout
+    EVSE_STOP_SCHEDULE          // Schedule window closed
+} EVSE_STOP_REASON_T;
+
+inline const char* evseStopReasonName(uint8_t reason) {
+    static const char* const names[] = { "user", "pause", "vehicle", "fault", "schedule" };
+    return reason < sizeof(names) / sizeof(names[0]) ? names[reason] : "?";
+}
+
+struct EvseEvent {
+    uint8_t type;               // EVSE_EVT_T
+    uint8_t code;               // Fault / stop reason, event specific
+    uint16_t reserved;
+    int32_t value;
+    uint32_t seq;               // EvseSnapshot::seq the event belongs to
+    uint32_t timeMs;
+};
+
+constexpr uint32_t evseEventBit(EVSE_EVT_T type) { return 1UL << type; }
+constexpr uint32_t EVSE_EVT_ALL = (1UL << EVSE_EVT_COUNT) - 1;
+
+constexpr int EVSE_BUS_MAX_SUBSCRIBERS = 4;
+constexpr int EVSE_BUS_RING_LEN = 16;       // Power of two
+static_assert((EVSE_BUS_RING_LEN & (EVSE_BUS_RING_LEN - 1)) == 0, "EVSE_BUS_RING_LEN must be a power of two");
+
+/* =========================
+ * Event Bus
+ * ========================= */
+// publish() runs in the EVSE task only. subscribe() may be called from any task at any
+// time (slots are claimed atomically and enabled last); poll() only from the subscriber's
+// own task. A full ring drops the event and makes the next poll() return EVSE_EVT_RESYNC.
+class EvseEventBus {
+public:
+    int subscribe(const char* name, uint32_t mask) {
+        int id = __atomic_fetch_add(&_count, 1, __ATOMIC_ACQ_REL);
+        if (id >= EVSE_BUS_MAX_SUBSCRIBERS) {
+            __atomic_fetch_sub(&_count, 1, __ATOMIC_ACQ_REL);
+            return -1;
+        }
+        Subscriber& sub = _subs[id];
+        sub.name = name;
+        sub.mask = mask | evseEventBit(EVSE_EVT_RESYNC);
+        __atomic_store_n(&sub.active, true, __ATOMIC_RELEASE);
+        return id;
+    }
+
+    void publish(const EvseEvent& ev) {
+        int n = __atomic_load_n(&_count, __ATOMIC_ACQUIRE);
+        if (n > EVSE_BUS_MAX_SUBSCRIBERS) n = EVSE_BUS_MAX_SUBSCRIBERS;
+        for (int i = 0; i < n; i++) {
+            Subscriber& sub = _subs[i];
+            if (!__atomic_load_n(&sub.active, __ATOMIC_ACQUIRE) || !(sub.mask & evseEventBit((EVSE_EVT_T)ev.type))) continue;
+            uint32_t head = sub.head;
+            if (head - __atomic_load_n(&sub.tail, __ATOMIC_ACQUIRE) >= EVSE_BUS_RING_LEN) {
+                __atomic_fetch_add(&sub.dropped, 1, __ATOMIC_RELAXED);
+                __atomic_store_n(&sub.resync, true, __ATOMIC_RELEASE);
+                continue;
+            }
+            sub.ring[head & (EVSE_BUS_RING_LEN - 1)] = ev;
+            __atomic_store_n(&sub.head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    bool poll(int id, EvseEvent& out) {
+        if (id < 0 || id >= EVSE_BUS_MAX_SUBSCRIBERS) return false;
+        Subscriber& sub = _subs[id];
+        uint32_t tail = sub.tail;
+        if (tail == __atomic_load_n(&sub.head, __ATOMIC_ACQUIRE)) {
+            // Ring drained: report a loss only now, so the resync follows every surviving event
+            if (!__atomic_exchange_n(&sub.resync, false, __ATOMIC_ACQ_REL)) return false;
+            out = EvseEvent{ EVSE_EVT_RESYNC, 0, 0, 0, 0, (uint32_t)millis() };
+            return true;
+        }
+        out = sub.ring[tail & (EVSE_BUS_RING_LEN - 1)];
+        __atomic_store_n(&sub.tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    uint32_t getDropped(int id) const {
+        return (id >= 0 && id < EVSE_BUS_MAX_SUBSCRIBERS) ? _subs[id].dropped : 0;
+    }
+
+private:
+    struct Subscriber {
+        const char* name = nullptr;
+        uint32_t mask = 0;
+        bool active = false;
+        bool resync = false;
+        uint32_t head = 0;          // Written by the EVSE task
+        uint32_t tail = 0;          // Written by the subscriber
+        uint32_t dropped = 0;
+        EvseEvent ring[EVSE_BUS_RING_LEN];
+    };
+    Subscriber _subs[EVSE_BUS_MAX_SUBSCRIBERS];
+    int _count = 0;
+};
+
+#endif
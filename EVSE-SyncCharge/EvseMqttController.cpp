@@ -40,6 +40,10 @@ void EvseMqttController::begin(const char* mqttServer, int mqttPort,
     topicCurrent                = "evse/" + deviceId + "/current";
     topicCurrentLimitState      = "evse/" + deviceId + "/currentLimit";
     topicPwmDuty                = "evse/" + deviceId + "/pwmDuty";
+    topicPwmDutyMeasured        = "evse/" + deviceId + "/pwmDutyMeasured";
+    topicPwmFrequency           = "evse/" + deviceId + "/pwmFrequency";
+    topicPilotFault             = "evse/" + deviceId + "/pilot/fault";
+    topicContactorFault         = "evse/" + deviceId + "/contactor/fault";
     topicSetAllowBelow6AmpCharging = "evse/" + deviceId + "/setAllowBelow6AmpCharging";
     topicDisableAtLowLimitState = "evse/" + deviceId + "/allowBelow6AmpCharging";
     topicLowLimitResumeDelay    = "evse/" + deviceId + "/lowLimitResumeDelay";
@@ -51,6 +55,12 @@ void EvseMqttController::begin(const char* mqttServer, int mqttPort,
     topicRcmConfig              = "evse/" + deviceId + "/config/rcm";
     topicRcmState               = "evse/" + deviceId + "/rcm/enabled";
     topicRcmFault               = "evse/" + deviceId + "/rcm/fault";
+    topicSetActualCurrent       = "evse/" + deviceId + "/setActualCurrent";
+    topicSetGridPower           = "evse/" + deviceId + "/setGridPower";
+    topicSetMainsCurrent        = "evse/" + deviceId + "/setMainsCurrent";
+    topicPower                  = "evse/" + deviceId + "/power";
+    topicEnergySession          = "evse/" + deviceId + "/energySession";
+    topicEnergyTotal            = "evse/" + deviceId + "/energyTotal";
 
     mqttClient.setServer(mqttServer, mqttPort);
     mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length) {
@@ -93,6 +103,9 @@ void EvseMqttController::loop()
             mqttClient.subscribe(topicSetFailsafe.c_str());
             mqttClient.subscribe(topicSetFailsafeTimeout.c_str());
             mqttClient.subscribe(topicRcmConfig.c_str());
+            mqttClient.subscribe(topicSetActualCurrent.c_str());
+            mqttClient.subscribe(topicSetGridPower.c_str());
+            mqttClient.subscribe(topicSetMainsCurrent.c_str());
 
             mqttClient.publish(topicState.c_str(), "online", true);
 
@@ -109,9 +122,9 @@ void EvseMqttController::loop()
             snprintf(buf, sizeof(buf), "%lu", _fsTimeout);
             mqttClient.publish(topicFailsafeTimeoutState.c_str(), buf, true);
 
-            // Sync RCM state
+            // Sync RCM config, then the full EVSE state (events missed while offline are moot)
             mqttClient.publish(topicRcmState.c_str(), evse->isRcmEnabled() ? "1" : "0", true);
-            mqttClient.publish(topicRcmFault.c_str(), evse->isRcmTripped() ? "1" : "0", true);
+            publishEvseState(evse->getSnapshot(), MQTT_PUB_ALL);
 
             publishHADiscovery();
         }
@@ -125,30 +138,47 @@ void EvseMqttController::loop()
     // Run the internal PubSubClient processing
     mqttClient.loop();
 
-    // --- State Reporting (Only on change) ---
-    STATE_T s = evse->getState();
-    if (s != lastState) {
-        char buf[8]; itoa((int)s, buf, 10);
-        mqttClient.publish(topicState.c_str(), buf, true);
-        lastState = s;
-    }
-
-    VEHICLE_STATE_T v = evse->getVehicleState();
-    if (v != lastVehicleState) {
-        char buf[8]; itoa((int)v, buf, 10);
-        mqttClient.publish(topicVehicle.c_str(), buf, true);
-        lastVehicleState = v;
-    }
-
-    float currentLimit = evse->getCurrentLimit();
-    if (currentLimit != lastCurrentLimit) {
+    // --- Event-driven State Reporting ---
+    // State, vehicle, limit and faults are published the moment the EVSE task raises them.
+    EvseEventBus& bus = evse->getEventBus();
+    if (eventSub < 0) eventSub = bus.subscribe("mqtt", MQTT_EVENT_MASK);
+    EvseEvent ev;
+    while (bus.poll(eventSub, ev)) {
+        if (!mqttClient.connected()) continue;      // Reconnect republishes everything
         char buf[16];
-        snprintf(buf, sizeof(buf), "%.1f", currentLimit);
-        mqttClient.publish(topicCurrentLimitState.c_str(), buf, true);
-        lastCurrentLimit = currentLimit;
+        switch (ev.type) {
+            case EVSE_EVT_STATE:
+                itoa((int)ev.value, buf, 10);
+                mqttClient.publish(topicState.c_str(), buf, true);
+                publishEvseState(evse->getSnapshot(), MQTT_PUB_DUTY);
+                break;
+            case EVSE_EVT_VEHICLE:
+                itoa((int)ev.value, buf, 10);
+                mqttClient.publish(topicVehicle.c_str(), buf, true);
+                break;
+            case EVSE_EVT_LIMIT:
+                snprintf(buf, sizeof(buf), "%.1f", (float)ev.value / 10.0f);
+                mqttClient.publish(topicCurrentLimitState.c_str(), buf, true);
+                publishEvseState(evse->getSnapshot(), MQTT_PUB_DUTY);
+                break;
+            case EVSE_EVT_FAULT:
+                publishEvseState(evse->getSnapshot(), MQTT_PUB_FAULTS);
+                break;
+            case EVSE_EVT_RESYNC:
+                publishEvseState(evse->getSnapshot(), MQTT_PUB_ALL);
+                break;
+            default:
+                break;
+        }
     }
 
-    ActualCurrent c = evse->getActualCurrent();
+    // --- Measurements (1Hz, only on change) ---
+    static unsigned long lastMeasurePublish = 0;
+    if (!mqttClient.connected() || millis() - lastMeasurePublish < 1000) return;
+    lastMeasurePublish = millis();
+    EvseSnapshot snap = evse->getSnapshot();
+
+    ActualCurrent c = snap.actual;
     if (c.l1 != lastCurrentL1 || c.l2 != lastCurrentL2 || c.l3 != lastCurrentL3) {
         char buf[48];
         snprintf(buf, sizeof(buf), "%.2f,%.2f,%.2f", c.l1, c.l2, c.l3);
@@ -156,21 +186,49 @@ void EvseMqttController::loop()
         lastCurrentL1 = c.l1; lastCurrentL2 = c.l2; lastCurrentL3 = c.l3;
     }
 
-    float pwmDuty = evse->getPilotDuty();
-    if (pwmDuty != lastPwmDuty) {
+    // Duty also follows cable rating and low-limit pauses, which raise no event of their own
+    publishEvseState(snap, MQTT_PUB_DUTY);
+
+    // Measured values jitter by a fraction of a sample; publish on 0.1% / 1Hz steps only
+    float pwmMeasured = roundf(snap.measuredDuty * 10.0f) / 10.0f;
+    if (pwmMeasured != lastPwmDutyMeasured) {
         char buf[16];
-        snprintf(buf, sizeof(buf), "%.2f", pwmDuty);
-        mqttClient.publish(topicPwmDuty.c_str(), buf, true);
-        lastPwmDuty = pwmDuty;
+        snprintf(buf, sizeof(buf), "%.1f", pwmMeasured);
+        mqttClient.publish(topicPwmDutyMeasured.c_str(), buf, true);
+        lastPwmDutyMeasured = pwmMeasured;
     }
 
-    bool rcmTripped = evse->isRcmTripped();
-    if (rcmTripped != lastRcmTripped) {
-        mqttClient.publish(topicRcmFault.c_str(), rcmTripped ? "1" : "0", true);
-        lastRcmTripped = rcmTripped;
+    float pwmFreq = roundf(snap.measuredFrequency);
+    if (pwmFreq != lastPwmFrequency) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%.0f", pwmFreq);
+        mqttClient.publish(topicPwmFrequency.c_str(), buf, true);
+        lastPwmFrequency = pwmFreq;
     }
 
-    bool rcmEn = evse->isRcmEnabled();
+    // Energy: published per Wh step so retained values stay in step with OCPP and the web UI
+    if (snap.powerW != lastPowerW) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%lu", (unsigned long)snap.powerW);
+        mqttClient.publish(topicPower.c_str(), buf, true);
+        lastPowerW = snap.powerW;
+    }
+    uint64_t sessionWh = snap.sessionMwh / 1000ULL;
+    if (sessionWh != lastSessionWh) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%llu.%03llu", sessionWh / 1000ULL, sessionWh % 1000ULL);
+        mqttClient.publish(topicEnergySession.c_str(), buf, true);
+        lastSessionWh = sessionWh;
+    }
+    uint64_t totalWh = snap.lifetimeMwh / 1000ULL;
+    if (totalWh != lastTotalWh) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%llu.%03llu", totalWh / 1000ULL, totalWh % 1000ULL);
+        mqttClient.publish(topicEnergyTotal.c_str(), buf, true);
+        lastTotalWh = totalWh;
+    }
+
+    bool rcmEn = snap.rcmEnabled;
     if (rcmEn != lastRcmEnabled) {
         // This handles updates from Web UI reflecting in MQTT
         mqttClient.publish(topicRcmState.c_str(), rcmEn ? "1" : "0", true);
@@ -178,6 +236,33 @@ void EvseMqttController::loop()
     }
 }
 
+// Publishes the selected groups from one snapshot; duty only when it actually changed
+void EvseMqttController::publishEvseState(const EvseSnapshot& snap, uint8_t groups)
+{
+    char buf[16];
+    if (groups & MQTT_PUB_STATE) {
+        itoa((int)snap.state, buf, 10);
+        mqttClient.publish(topicState.c_str(), buf, true);
+        itoa((int)snap.vehicleState, buf, 10);
+        mqttClient.publish(topicVehicle.c_str(), buf, true);
+        snprintf(buf, sizeof(buf), "%.1f", snap.currentLimit());
+        mqttClient.publish(topicCurrentLimitState.c_str(), buf, true);
+    }
+    if (groups & MQTT_PUB_DUTY) {
+        float pwmDuty = snap.pwmDuty();
+        if (pwmDuty != lastPwmDuty || groups == MQTT_PUB_ALL) {
+            snprintf(buf, sizeof(buf), "%.2f", pwmDuty);
+            mqttClient.publish(topicPwmDuty.c_str(), buf, true);
+            lastPwmDuty = pwmDuty;
+        }
+    }
+    if (groups & MQTT_PUB_FAULTS) {
+        mqttClient.publish(topicRcmFault.c_str(), snap.rcmTripped ? "1" : "0", true);
+        mqttClient.publish(topicPilotFault.c_str(), snap.pwmFault ? "1" : "0", true);
+        mqttClient.publish(topicContactorFault.c_str(), snap.contactorFault != RELAY_FAULT_NONE ? "1" : "0", true);
+    }
+}
+
 void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int length)
 {
     String msg;
@@ -188,15 +273,15 @@ void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int l
     if (strcmp(topic, topicCommand.c_str()) == 0)
     {
         if (msg == "start") {
-            evse->startCharging();
+            evse->post(EVSE_CMD_START, EVSE_SRC_MQTT);
             evse->signalThrottleAlive();
         }
-        else if (msg == "stop")  evse->stopCharging();
+        else if (msg == "stop")  evse->post(EVSE_CMD_STOP, EVSE_SRC_MQTT);
     }
     else if (strcmp(topic, topicSetCurrent.c_str()) == 0)
     {
         float amps = msg.toFloat();
-        evse->setCurrentLimit(amps);
+        evse->post(EVSE_CMD_SET_LIMIT, EVSE_SRC_MQTT, ampsToDeciamps(amps));
         evse->signalThrottleAlive();
     }
     else if (strcmp(topic, topicSetAllowBelow6AmpCharging.c_str()) == 0)
@@ -204,11 +289,11 @@ void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int l
         String lower = msg;
         lower.toLowerCase();
         if (lower == "1" || lower == "on" || lower == "true" || lower == "enable") {
-            evse->setAllowBelow6AmpCharging(true);
+            evse->post(EVSE_CMD_ALLOW_BELOW_6A, EVSE_SRC_MQTT, 1);
             // Publish updated state
             mqttClient.publish(topicDisableAtLowLimitState.c_str(), "1", true);
         } else {
-            evse->setAllowBelow6AmpCharging(false);
+            evse->post(EVSE_CMD_ALLOW_BELOW_6A, EVSE_SRC_MQTT, 0);
             mqttClient.publish(topicDisableAtLowLimitState.c_str(), "0", true);
         }
     }
@@ -219,12 +304,12 @@ void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int l
 
         if (lower == "on" || lower == "enable")
         {
-            evse->enableCurrentTest(true);
+            evse->post(EVSE_CMD_CURRENT_TEST, EVSE_SRC_MQTT, 1);
             mqttClient.publish(topicPwmDuty.c_str(), "current_test_enabled", true);
         }
         else if (lower == "off" || lower == "disable")
         {
-            evse->enableCurrentTest(false);
+            evse->post(EVSE_CMD_CURRENT_TEST, EVSE_SRC_MQTT, 0);
             mqttClient.publish(topicPwmDuty.c_str(), "current_test_disabled", true);
         }
         else
@@ -236,8 +321,7 @@ void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int l
             // Convert PWM duty (%) to approximate amps using Pilot mapping
             float amps = pilot->dutyToAmps(duty);
 
-            evse->enableCurrentTest(true);
-            evse->setCurrentTest(amps);
+            evse->post(EVSE_CMD_TEST_CURRENT, EVSE_SRC_MQTT, ampsToDeciamps(amps));
 
             char buf[64];
             snprintf(buf, sizeof(buf), "current_test:%.1f%%->%.2fA", duty, amps);
@@ -269,12 +353,39 @@ void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int l
             if (_fsCallback) _fsCallback(_fsEnabled, _fsTimeout);
         }
     }
+    else if (strcmp(topic, topicSetActualCurrent.c_str()) == 0)
+    {
+        ActualCurrent c;
+        if (sscanf(msg.c_str(), "%f,%f,%f", &c.l1, &c.l2, &c.l3) >= 1) {
+            evse->updateActualCurrent(c);
+        } else {
+            logger.warn("[MQTT] setActualCurrent: expected L1,L2,L3");
+        }
+    }
+    else if (strcmp(topic, topicSetGridPower.c_str()) == 0)
+    {
+        float watts;
+        if (sscanf(msg.c_str(), "%f", &watts) == 1) {
+            if (_gridPowerCallback) _gridPowerCallback(watts);
+        } else {
+            logger.warn("[MQTT] setGridPower: expected watts");
+        }
+    }
+    else if (strcmp(topic, topicSetMainsCurrent.c_str()) == 0)
+    {
+        ActualCurrent c;
+        if (sscanf(msg.c_str(), "%f,%f,%f", &c.l1, &c.l2, &c.l3) == 3) {
+            if (_mainsCurrentCallback) _mainsCurrentCallback(c);
+        } else {
+            logger.warn("[MQTT] setMainsCurrent: expected L1,L2,L3");
+        }
+    }
     else if (strcmp(topic, topicRcmConfig.c_str()) == 0)
     {
         String lower = msg;
         lower.toLowerCase();
         bool newState = (lower == "1" || lower == "on" || lower == "true" || lower == "enable");
-        evse->setRcmEnabled(newState);
+        evse->post(EVSE_CMD_SET_RCM, EVSE_SRC_MQTT, newState ? 1 : 0);
         if (_rcmConfigCallback) _rcmConfigCallback(newState);
         // State update handled in loop()
     }
@@ -284,7 +395,7 @@ void EvseMqttController::mqttCallback(char* topic, byte* payload, unsigned int l
 
 void EvseMqttController::enableCurrentTest(bool enable)
 {
-    evse->enableCurrentTest(enable);
+    evse->post(EVSE_CMD_CURRENT_TEST, EVSE_SRC_MQTT, enable ? 1 : 0);
 }
 
 bool EvseMqttController::connected()
@@ -312,6 +423,14 @@ void EvseMqttController::onRcmConfigChanged(std::function<void(bool)> callback)
     _rcmConfigCallback = callback;
 }
 
+void EvseMqttController::onGridPower(std::function<void(float)> callback) {
+    _gridPowerCallback = callback;
+}
+
+void EvseMqttController::onMainsCurrent(std::function<void(const ActualCurrent&)> callback) {
+    _mainsCurrentCallback = callback;
+}
+
 // ---------------------- Home Assistant Discovery ----------------------
 void EvseMqttController::publishHADiscovery()
 {
@@ -344,6 +463,18 @@ void EvseMqttController::publishHADiscovery()
              topicPwmDuty.c_str(), deviceId.c_str(), deviceId.c_str());
     mqttClient.publish(topicBuf, payloadBuf, true);
 
+    // --- Sensor: PWM Duty (measured on CP line) ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/sensor/%s_pwm_meas/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE PWM Duty Measured\",\"state_topic\":\"%s\",\"unit_of_measurement\":\"%%\",\"unique_id\":\"%s_pwm_meas\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicPwmDutyMeasured.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
+    // --- Sensor: PWM Frequency (measured on CP line) ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/sensor/%s_pwm_freq/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE PWM Frequency\",\"state_topic\":\"%s\",\"unit_of_measurement\":\"Hz\",\"device_class\":\"frequency\",\"unique_id\":\"%s_pwm_freq\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicPwmFrequency.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
     // --- Sensor: Vehicle State ---
     snprintf(topicBuf, sizeof(topicBuf), "%s/sensor/%s_vehicle/config", base, deviceId.c_str());
     snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE Vehicle\",\"state_topic\":\"%s\",\"unique_id\":\"%s_vehicle\",\"device\":{\"identifiers\":[\"%s\"]}}",
@@ -381,11 +512,41 @@ void EvseMqttController::publishHADiscovery()
              topicRcmFault.c_str(), deviceId.c_str(), deviceId.c_str());
     mqttClient.publish(topicBuf, payloadBuf, true);
 
+    // --- Binary Sensor: Pilot PWM Fault ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/binary_sensor/%s_pilot_fault/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE Pilot PWM Fault\",\"state_topic\":\"%s\",\"payload_on\":\"1\",\"payload_off\":\"0\",\"device_class\":\"problem\",\"unique_id\":\"%s_pilot_fault\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicPilotFault.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
+    // --- Binary Sensor: Contactor Fault ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/binary_sensor/%s_contactor_fault/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE Contactor Fault\",\"state_topic\":\"%s\",\"payload_on\":\"1\",\"payload_off\":\"0\",\"device_class\":\"safety\",\"unique_id\":\"%s_contactor_fault\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicContactorFault.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
     // --- Switch: RCM Enable ---
     snprintf(topicBuf, sizeof(topicBuf), "%s/switch/%s_rcm_enable/config", base, deviceId.c_str());
     snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE RCM Protection\",\"command_topic\":\"%s\",\"state_topic\":\"%s\",\"payload_on\":\"1\",\"payload_off\":\"0\",\"unique_id\":\"%s_rcm_enable\",\"device\":{\"identifiers\":[\"%s\"]}}",
              topicRcmConfig.c_str(), topicRcmState.c_str(), deviceId.c_str(), deviceId.c_str());
     mqttClient.publish(topicBuf, payloadBuf, true);
 
+    // --- Sensor: Power ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/sensor/%s_power/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE Power\",\"state_topic\":\"%s\",\"unit_of_measurement\":\"W\",\"device_class\":\"power\",\"state_class\":\"measurement\",\"unique_id\":\"%s_power\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicPower.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
+    // --- Sensor: Session Energy ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/sensor/%s_energy_session/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE Session Energy\",\"state_topic\":\"%s\",\"unit_of_measurement\":\"kWh\",\"device_class\":\"energy\",\"state_class\":\"total\",\"unique_id\":\"%s_energy_session\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicEnergySession.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
+    // --- Sensor: Lifetime Energy ---
+    snprintf(topicBuf, sizeof(topicBuf), "%s/sensor/%s_energy_total/config", base, deviceId.c_str());
+    snprintf(payloadBuf, sizeof(payloadBuf), "{\"name\":\"EVSE Total Energy\",\"state_topic\":\"%s\",\"unit_of_measurement\":\"kWh\",\"device_class\":\"energy\",\"state_class\":\"total_increasing\",\"unique_id\":\"%s_energy_total\",\"device\":{\"identifiers\":[\"%s\"]}}",
+             topicEnergyTotal.c_str(), deviceId.c_str(), deviceId.c_str());
+    mqttClient.publish(topicBuf, payloadBuf, true);
+
     logger.info("[MQTT] HA discovery published");
 }
@@ -69,6 +69,42 @@
  *   -t "evse/EVSE-A1B2C3/test/current" -m "50"
  * ```
  * 
+ * ### 4. Meter Input
+ * **Topic:** `evse/{DEVICE_ID}/setActualCurrent`
+ *
+ * Payload: Measured phase currents `L1,L2,L3` in Amperes from an external meter.
+ * Integrated by the EVSE into the session and lifetime energy counters.
+ *
+ * Example:
+ * ```
+ * mosquitto_pub -h 192.168.0.149 -u mqttnoeluser -P mqttpassword \
+ *   -t "evse/EVSE-A1B2C3/setActualCurrent" -m "15.9,16.1,16.0"
+ * ```
+ *
+ * ### 5. Grid Power Input
+ * **Topic:** `evse/{DEVICE_ID}/setGridPower`
+ *
+ * Payload: Grid connection power in W, import positive, export negative.
+ * Drives the on-device solar surplus controller when it is enabled.
+ *
+ * Example:
+ * ```
+ * mosquitto_pub -h 192.168.0.149 -u mqttnoeluser -P mqttpassword \
+ *   -t "evse/EVSE-A1B2C3/setGridPower" -m "-2350"
+ * ```
+ *
+ * ### 6. Mains Current Input
+ * **Topic:** `evse/{DEVICE_ID}/setMainsCurrent`
+ *
+ * Payload: Phase currents `L1,L2,L3` in Amperes at the main fuse, this charger
+ * included. Drives the per-phase fuse limiter when a main fuse is configured.
+ *
+ * Example:
+ * ```
+ * mosquitto_pub -h 192.168.0.149 -u mqttnoeluser -P mqttpassword \
+ *   -t "evse/EVSE-A1B2C3/setMainsCurrent" -m "18.2,9.5,12.0"
+ * ```
+ * 
  * ## MQTT Status Topics (Publish)
  * 
  * **State Topic:** `evse/{DEVICE_ID}/state`
@@ -87,9 +123,18 @@
  * - Format: `L1,L2,L3` (e.g., "16.50,16.45,16.55")
  * - Current measurements in Amperes for all three phases
  * 
+ * **Energy Topics:** `evse/{DEVICE_ID}/power`, `evse/{DEVICE_ID}/energySession`, `evse/{DEVICE_ID}/energyTotal`
+ * - Power (W) and energy (kWh) from the EVSE counters; the same values OCPP and the web UI report
+ * 
  * **PWM Duty Topic:** `evse/{DEVICE_ID}/pwmDuty`
  * - Pilot signal PWM duty cycle (0-100%)
  * 
+ * **Measured PWM Topics:** `evse/{DEVICE_ID}/pwmDutyMeasured`, `evse/{DEVICE_ID}/pwmFrequency`
+ * - Duty cycle (%) and frequency (Hz) measured back from the CP line
+ * 
+ * **Pilot Fault Topic:** `evse/{DEVICE_ID}/pilot/fault`
+ * - `1` = Measured PWM deviates from the commanded value (charging locked out)
+ * 
  * ## Home Assistant MQTT Discovery
  * 
  * All entities are published with Home Assistant MQTT Discovery enabled
@@ -119,11 +164,14 @@ public:
     void setFailsafeConfig(bool enabled, unsigned long timeout);
     void onFailsafeCommand(std::function<void(bool, unsigned long)> callback);
     void onRcmConfigChanged(std::function<void(bool)> callback);
+    void onGridPower(std::function<void(float)> callback);
+    void onMainsCurrent(std::function<void(const ActualCurrent&)> callback);
     bool connected();
 
 private:
     void mqttCallback(char* topic, byte* payload, unsigned int length);
     void publishHADiscovery();
+    void publishEvseState(const EvseSnapshot& snap, uint8_t groups);
     
     String serverHost; // Store host to check if configured
     EvseCharge* evse;
@@ -136,6 +184,8 @@ private:
     unsigned long _fsTimeout = 600;
     std::function<void(bool, unsigned long)> _fsCallback;
     std::function<void(bool)> _rcmConfigCallback;
+    std::function<void(float)> _gridPowerCallback;
+    std::function<void(const ActualCurrent&)> _mainsCurrentCallback;
 
     String deviceId;
     String mqttUser;
@@ -149,6 +199,10 @@ private:
     String topicCurrent;
     String topicCurrentLimitState;
     String topicPwmDuty;
+    String topicPwmDutyMeasured;
+    String topicPwmFrequency;
+    String topicPilotFault;
+    String topicContactorFault;
     String topicSetAllowBelow6AmpCharging;
     // Published state topics for configuration/status
     String topicDisableAtLowLimitState;
@@ -162,17 +216,33 @@ private:
     String topicRcmConfig;      // Command to enable/disable
     String topicRcmState;       // Status of config (1/0)
     String topicRcmFault;       // Fault status (1=Tripped, 0=OK)
+    String topicSetActualCurrent;
+    String topicSetGridPower;
+    String topicSetMainsCurrent;
+    String topicPower;
+    String topicEnergySession;
+    String topicEnergyTotal;
+
+    // --- EVSE event subscription (state, vehicle, limit, faults) ---
+    static constexpr uint32_t MQTT_EVENT_MASK = evseEventBit(EVSE_EVT_STATE) | evseEventBit(EVSE_EVT_VEHICLE) |
+                                                evseEventBit(EVSE_EVT_LIMIT) | evseEventBit(EVSE_EVT_FAULT);
+    static constexpr uint8_t MQTT_PUB_STATE  = 0x01;    // state, vehicle, limit
+    static constexpr uint8_t MQTT_PUB_DUTY   = 0x02;
+    static constexpr uint8_t MQTT_PUB_FAULTS = 0x04;    // RCM trip, pilot PWM fault
+    static constexpr uint8_t MQTT_PUB_ALL    = 0x07;
+    int eventSub = -1;
 
-    // --- Last values for change detection ---
-    STATE_T lastState = STATE_COUNT;
-    VEHICLE_STATE_T lastVehicleState = VEHICLE_STATE_COUNT;
+    // --- Last values for change detection (measurements only) ---
     float lastCurrentL1 = -1;
     float lastCurrentL2 = -1;
     float lastCurrentL3 = -1;
-    float lastCurrentLimit = -1;
     float lastPwmDuty = -1;
-    bool lastRcmTripped = false;
+    float lastPwmDutyMeasured = -1;
+    float lastPwmFrequency = -1;
     bool lastRcmEnabled = true;
+    uint32_t lastPowerW = UINT32_MAX;
+    uint64_t lastSessionWh = UINT64_MAX;
+    uint64_t lastTotalWh = UINT64_MAX;
 };
 
 #endif
@@ -0,0 +1,121 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Implementation of the per-phase main fuse limiter. Turns mains phase
+ *              currents into the household load per phase and posts the headroom left on
+ *              the charger's phases as a cap on the offered limit.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvsePhaseLimit.h"
+#include "EvseCharge.h"
+#include "EvseLogger.h"
+
+EvsePhaseLimiter::EvsePhaseLimiter(EvseCharge& evseCharge) : evse(evseCharge) {}
+
+void EvsePhaseLimiter::updateMainsCurrent(const ActualCurrent& mains) {
+    MainsReading r;
+    r.mains = mains;
+    r.ms = millis();
+    readingIn.publish(r);
+}
+
+void EvsePhaseLimiter::setParams(const PhaseParams& p) {
+    paramsIn.publish(p);
+    if (p.fuseDa == 0) logger.info("[MAINS] Fuse limiter disabled");
+    else logger.infof("[MAINS] Fuse %u.%u A per phase (1-phase on L%u)", p.fuseDa / 10, p.fuseDa % 10, p.line);
+}
+
+void EvsePhaseLimiter::loop() {
+    paramsIn.tryTake(params);
+    MainsReading r;
+    bool sample = readingIn.tryTake(r);
+
+    if (params.fuseDa == 0) {
+        if (statusActive) {
+            __atomic_store_n(&statusActive, false, __ATOMIC_RELAXED);
+            stale = true;
+            post(EVSE_CAP_NONE);
+        }
+        return;
+    }
+
+    if (sample) {
+        if (stale) logger.info("[MAINS] Mains readings received, limiting to fuse headroom");
+        stale = false;
+        lastSampleMs = r.ms;
+        __atomic_store_n(&statusActive, true, __ATOMIC_RELAXED);
+        uint16_t headDa = headroomDa(r.mains, evse.getSnapshot());
+
+        if (headDa < postedDa) {
+            // Less headroom: follow at once
+            raising = false;
+            post(headDa);
+        } else if (headDa > postedDa) {
+            // More headroom: only what every reading of the hold period allowed
+            if (!raising) {
+                raising = true;
+                raiseSinceMs = r.ms;
+                raiseDa = headDa;
+            } else if (headDa < raiseDa) {
+                raiseDa = headDa;
+            }
+            if (r.ms - raiseSinceMs >= PHASE_RAISE_HOLD_MS) {
+                raising = false;
+                post(raiseDa);
+            }
+        } else {
+            raising = false;
+        }
+    } else if (!stale && (millis() - lastSampleMs) > PHASE_STALE_MS) {
+        // The household load is unknown: fall back to the minimum charge current
+        logger.warn("[MAINS] Mains readings stale. Capping at 6 A");
+        stale = true;
+        raising = false;
+        if (MIN_CURRENT_DA < postedDa) post(MIN_CURRENT_DA);
+    }
+}
+
+/* =========================
+ * Headroom
+ * ========================= */
+
+uint16_t EvsePhaseLimiter::headroomDa(const ActualCurrent& mains, const EvseSnapshot& snap) {
+    const float mainsA[3] = { mains.l1, mains.l2, mains.l3 };
+    bool used[3] = { true, true, true };
+    if (snap.phases == 1) {
+        for (int p = 0; p < 3; p++) used[p] = (p + 1 == params.line);
+    }
+
+    // What this charger contributes to the mains reading, per phase
+    float ownA[3] = { 0.0f, 0.0f, 0.0f };
+    if (snap.relayClosed) {
+        if (snap.powerW > 0) {
+            // Charger meter is live (setActualCurrent)
+            ownA[0] = snap.actual.l1;
+            ownA[1] = snap.actual.l2;
+            ownA[2] = snap.actual.l3;
+        } else {
+            for (int p = 0; p < 3; p++) ownA[p] = used[p] ? snap.offeredLimitDa / 10.0f : 0.0f;
+        }
+    }
+
+    int32_t headDa = EVSE_CAP_NONE - 1;
+    for (int p = 0; p < 3; p++) {
+        float houseA = mainsA[p] - ownA[p];
+        uint16_t houseDa = ampsToDeciamps(houseA);
+        __atomic_store_n(&statusHouseDa[p], houseDa, __ATOMIC_RELAXED);
+        if (!used[p]) continue;
+        int32_t freeDa = (int32_t)params.fuseDa - PHASE_MARGIN_DA - houseDa;
+        if (freeDa < headDa) headDa = freeDa;
+    }
+    return headDa < 0 ? 0 : (uint16_t)headDa;
+}
+
+void EvsePhaseLimiter::post(uint16_t capDa) {
+    if (capDa == postedDa) return;
+    if (evse.post(EVSE_CMD_PHASE_CAP, EVSE_SRC_MAINS, capDa)) __atomic_store_n(&postedDa, capDa, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * @file EvsePhaseLimit.h
+ * Per-phase main fuse limiter.
+ *
+ * @details
+ * Takes the current per phase at the main fuse (pushed over MQTT
+ * `setMainsCurrent` or HTTP `/api/mains`, this charger included) and works
+ * out the household load on each phase by taking off what the charger itself
+ * draws: the phase currents from `setActualCurrent` when that meter is live,
+ * otherwise the offered limit on each phase the charger uses. The largest
+ * safe charge current is then the smallest fuse headroom over the phases
+ * the charger is using now (L1..L3 for 3-phase, the configured line for
+ * 1-phase, following the phase contactor).
+ *
+ * The result caps the offered limit (EVSE_CMD_PHASE_CAP). A lower value is
+ * applied on the reading that shows it; a higher one only once every reading
+ * for PHASE_RAISE_HOLD_MS allowed it, so a fluctuating household load does
+ * not walk the charger up and down. Without a reading for PHASE_STALE_MS
+ * the cap falls to 6 A.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_PHASE_LIMIT_H_
+#define EVSE_PHASE_LIMIT_H_
+
+#include <Arduino.h>
+#include "EvseTypes.h"
+#include "EvseCommand.h"
+
+class EvseCharge;
+struct EvseSnapshot;
+
+constexpr unsigned long PHASE_STALE_MS = 15000;         // No mains reading this long: 6 A
+constexpr unsigned long PHASE_RAISE_HOLD_MS = 10000;    // Headroom must last this long to raise
+constexpr uint16_t PHASE_MARGIN_DA = 5;                 // Kept free under the fuse (0.1A)
+
+struct PhaseParams {
+    uint16_t fuseDa = 0;        // Main fuse per phase (0.1A), 0 = limiter off
+    uint8_t line = 1;           // 1-phase: line the charger is wired to (1..3)
+};
+
+class EvsePhaseLimiter {
+public:
+    explicit EvsePhaseLimiter(EvseCharge& evseCharge);
+
+    // Loop task (MQTT, web): current per phase at the main fuse, this charger included
+    void updateMainsCurrent(const ActualCurrent& mains);
+    // Loop task: limiter settings, picked up by the EVSE task on its next cycle
+    void setParams(const PhaseParams& params);
+    // EVSE task, once per cycle after EvseCharge::loop()
+    void loop();
+
+    // Published by the EVSE task for the UI
+    bool isActive() const { return __atomic_load_n(&statusActive, __ATOMIC_RELAXED); }
+    uint16_t getCapDa() const { return __atomic_load_n(&postedDa, __ATOMIC_RELAXED); }
+    // Household load per phase (0.1A) from the last reading
+    uint16_t getHouseDa(int phase) const { return __atomic_load_n(&statusHouseDa[phase], __ATOMIC_RELAXED); }
+
+private:
+    uint16_t headroomDa(const ActualCurrent& mains, const EvseSnapshot& snap);
+    void post(uint16_t capDa);
+
+    struct MainsReading {
+        ActualCurrent mains;
+        unsigned long ms;               // millis() when it arrived
+    };
+
+    EvseCharge& evse;
+
+    // Loop task -> EVSE task
+    SeqMailbox<PhaseParams> paramsIn;
+    SeqMailbox<MainsReading> readingIn;
+
+    // EVSE task state
+    PhaseParams params;
+    unsigned long lastSampleMs = 0;
+    bool stale = true;
+    bool raising = false;
+    uint16_t raiseDa = 0;               // Lowest headroom seen since raiseSinceMs
+    unsigned long raiseSinceMs = 0;
+    uint16_t postedDa = EVSE_CAP_NONE;
+
+    bool statusActive = false;
+    uint16_t statusHouseDa[3] = {0, 0, 0};
+};
+
+#endif
@@ -0,0 +1,189 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Implementation of the local time-of-use schedule. Works out the active
+ *              window and the next boundary in local time, and drives start, stop and
+ *              the current limit through the EVSE command queue.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvseScheduler.h"
+#include "EvseCharge.h"
+#include "EvseLogger.h"
+#include <Preferences.h>
+
+static const char* SCHEDULE_NAMESPACE = "evse_sched";
+
+EvseScheduler::EvseScheduler(EvseCharge& evseCharge) : evse(evseCharge) {}
+
+void EvseScheduler::begin() {
+    Preferences prefs;
+    prefs.begin(SCHEDULE_NAMESPACE, true);
+    ScheduleTable stored;
+    size_t len = prefs.getBytes("table", &stored, sizeof(stored));
+    prefs.end();
+    // A layout change invalidates the stored blob instead of misreading it
+    if (len != sizeof(stored) || stored.version != SCHEDULE_TABLE_VERSION) stored = ScheduleTable();
+    tableIn.publish(stored);
+
+    const ScheduleTable& table = tableIn.peek();
+    int windows = 0;
+    for (int i = 0; i < SCHEDULE_MAX_WINDOWS; i++) windows += table.windows[i].enabled ? 1 : 0;
+    logger.infof("[SCHED] %d window(s), departure target %s", windows, table.departure.enabled ? "on" : "off");
+}
+
+void EvseScheduler::setTable(const ScheduleTable& newTable) {
+    ScheduleTable table = newTable;
+    table.version = SCHEDULE_TABLE_VERSION;
+    tableIn.publish(table);
+
+    Preferences prefs;
+    prefs.begin(SCHEDULE_NAMESPACE, false);
+    prefs.putBytes("table", &table, sizeof(table));
+    prefs.end();
+    logger.info("[SCHED] Schedule saved");
+}
+
+void EvseScheduler::loop() {
+    // Pick up an edited table
+    if (tableIn.tryTake(active)) nextEval = 0;
+
+    EvseSnapshot snap = evse.getSnapshot();
+    bool connected = snap.vehicleConnected();
+    if (connected != lastConnected) {
+        lastConnected = connected;
+        startIssued = false;
+        startedSession = false;
+        plugInMwh = snap.lifetimeMwh;
+        departureEpoch = 0;
+        nextEval = 0;
+    }
+
+    time_t now = time(nullptr);
+    if (now < CLOCK_VALID_EPOCH) return;
+    if ((uint32_t)now < nextEval) return;
+    evaluate(now, snap);
+}
+
+/* =========================
+ * Evaluation
+ * ========================= */
+
+void EvseScheduler::evaluate(time_t now, const EvseSnapshot& snap) {
+    struct tm lt;
+    localtime_r(&now, &lt);
+    const uint32_t mow = lt.tm_wday * 1440 + lt.tm_hour * 60 + lt.tm_min;   // Minute of week
+    uint32_t sleepS = SCHEDULE_MAX_SLEEP_S;
+    auto boundaryIn = [&](uint32_t s) { if (s > 0 && s < sleepS) sleepS = s; };
+    // Minute-of-week delta to seconds from now (boundaries fall on whole minutes)
+    auto minutesToS = [&](uint32_t minutes) { return minutes * 60 - lt.tm_sec; };
+
+    // Windows: overlapping ones resolve to the highest limit
+    int window = -1;
+    uint16_t windowDa = 0;
+    for (int i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+        const ScheduleWindow& w = active.windows[i];
+        if (!w.enabled) continue;
+        bool in = false;
+        if (w.days) {
+            uint32_t dur = (w.endMin + 1440 - w.startMin) % 1440;
+            if (dur == 0) dur = 1440;
+            for (int d = 0; d < 7; d++) {
+                if (!(w.days & (1 << d))) continue;
+                uint32_t since = (mow + SCHEDULE_MINUTES_PER_WEEK - (d * 1440 + w.startMin)) % SCHEDULE_MINUTES_PER_WEEK;
+                if (since < dur) {
+                    in = true;
+                    boundaryIn(minutesToS(dur - since));
+                } else {
+                    boundaryIn(minutesToS(SCHEDULE_MINUTES_PER_WEEK - since));
+                }
+            }
+        } else if (w.onceStart && (uint32_t)now < w.onceEnd) {
+            in = (uint32_t)now >= w.onceStart;
+            boundaryIn(in ? w.onceEnd - (uint32_t)now : w.onceStart - (uint32_t)now);
+        }
+        if (in && (window < 0 || w.limitDa > windowDa)) {
+            window = i;
+            windowDa = w.limitDa;
+        }
+    }
+
+    // Departure target: start at full current once the remaining energy needs all the
+    // time left. Progress counts from plug-in or from the previous departure.
+    bool departure = false;
+    const DepartureTarget& dep = active.departure;
+    const ChargingSettings& cs = evse.getSettings();
+    const uint16_t maxDa = ampsToDeciamps(cs.maxCurrent);
+    if (dep.enabled && dep.days && dep.energyWh && snap.vehicleConnected()) {
+        uint32_t toDepartMin = SCHEDULE_MINUTES_PER_WEEK;
+        for (int d = 0; d < 7; d++) {
+            if (!(dep.days & (1 << d))) continue;
+            uint32_t m = (d * 1440 + dep.departMin + SCHEDULE_MINUTES_PER_WEEK - mow) % SCHEDULE_MINUTES_PER_WEEK;
+            if (m > 0 && m < toDepartMin) toDepartMin = m;
+        }
+        uint32_t toDepartS = minutesToS(toDepartMin);
+        uint32_t departAt = (uint32_t)now + toDepartS;
+        if (departureEpoch && (uint32_t)now >= departureEpoch) plugInMwh = snap.lifetimeMwh;
+        departureEpoch = departAt;
+
+        uint32_t doneWh = (uint32_t)((snap.lifetimeMwh - plugInMwh) / 1000ULL);
+        uint32_t powerW = (uint32_t)snap.mainsVoltage * cs.phases * maxDa / 10;
+        if (doneWh < dep.energyWh && powerW > 0) {
+            uint32_t needS = (uint32_t)((uint64_t)(dep.energyWh - doneWh) * 3600ULL / powerW) + SCHEDULE_DEPARTURE_MARGIN_S;
+            if (needS >= toDepartS) {
+                departure = true;
+                boundaryIn(SCHEDULE_DEPARTURE_RECHECK_S);
+            } else {
+                boundaryIn(toDepartS - needS);
+            }
+        }
+        boundaryIn(toDepartS);
+    }
+
+    if (departure != statusDeparture) {
+        logger.infof("[SCHED] Departure target: %s", departure ? "charging at full current" : "done");
+    }
+    if (window != statusWindow) {
+        if (window >= 0) logger.infof("[SCHED] Window %d active (%u.%uA)", window + 1, windowDa / 10, windowDa % 10);
+        else logger.info("[SCHED] Window closed");
+    }
+
+    apply(window >= 0 || departure, departure ? maxDa : windowDa, snap);
+
+    nextEval = (uint32_t)now + sleepS;
+    __atomic_store_n(&statusWindow, window, __ATOMIC_RELAXED);
+    __atomic_store_n(&statusDeparture, departure, __ATOMIC_RELAXED);
+    __atomic_store_n(&statusNext, nextEval, __ATOMIC_RELAXED);
+}
+
+void EvseScheduler::apply(bool charge, uint16_t limitDa, const EvseSnapshot& snap) {
+    if (charge) {
+        if (!owning) {
+            owning = true;
+            restoreDa = snap.targetLimitDa;
+            startIssued = false;
+            evse.setScheduleHold(true);
+        }
+        if (limitDa != appliedDa) {
+            evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_SCHEDULE, limitDa);
+            appliedDa = limitDa;
+        }
+        // One start per activation or plug-in: a user stop or pause is not overridden
+        if (!startIssued && snap.vehicleConnected() && snap.state == STATE_READY && !snap.paused && !snap.lockout) {
+            if (evse.post(EVSE_CMD_START, EVSE_SRC_SCHEDULE)) {
+                startIssued = true;
+                startedSession = true;
+            }
+        }
+    } else if (owning) {
+        owning = false;
+        appliedDa = 0;
+        evse.setScheduleHold(false);
+        evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_SCHEDULE, restoreDa);
+        if (startedSession && snap.state == STATE_CHARGING) evse.post(EVSE_CMD_STOP, EVSE_SRC_SCHEDULE);
+        startedSession = false;
+    }
+}
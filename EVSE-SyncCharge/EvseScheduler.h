@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * @file EvseScheduler.h
+ * Local time-of-use charging schedule.
+ *
+ * @details
+ * Holds up to SCHEDULE_MAX_WINDOWS charging windows (weekly on a set of
+ * weekdays, or one-shot between two dates) each with a current limit, and
+ * one departure target ("X kWh by HH:MM"). The schedule runs in the EVSE
+ * task without any network: it works out the active window and the time of
+ * the next boundary (window start/end, latest start for the departure
+ * target) and does nothing until that boundary, a schedule edit or a plug
+ * event. Decisions go through the command queue like any other controller.
+ *
+ * While a window or departure charge is active the schedule owns the limit:
+ * it is set on entry, the previous limit is restored on exit, and a session
+ * the schedule started is stopped when the window closes. A user pause or
+ * stop is respected until the next window. Windows are in local time
+ * (AppConfig::timezone); nothing is evaluated before the clock is set.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_SCHEDULER_H_
+#define EVSE_SCHEDULER_H_
+
+#include <Arduino.h>
+#include <time.h>
+#include "EvseCommand.h"
+
+class EvseCharge;
+struct EvseSnapshot;
+
+constexpr int SCHEDULE_MAX_WINDOWS = 8;
+constexpr uint8_t SCHEDULE_TABLE_VERSION = 1;
+constexpr uint16_t SCHEDULE_MINUTES_PER_WEEK = 7 * 1440;
+constexpr uint32_t SCHEDULE_MAX_SLEEP_S = 3600;         // Re-anchor hourly (DST, clock steps)
+constexpr uint32_t SCHEDULE_DEPARTURE_RECHECK_S = 60;   // Progress check while a departure charge runs
+constexpr uint32_t SCHEDULE_DEPARTURE_MARGIN_S = 900;   // Added to the estimate (ramp, taper, BMS)
+
+// One charging window. Weekly when days != 0, one-shot when onceStart != 0.
+struct ScheduleWindow {
+    uint8_t enabled;
+    uint8_t days;               // Weekly: bit 0 = Sunday ... bit 6 = Saturday (tm_wday)
+    uint16_t limitDa;           // Current limit inside the window, 0.1A
+    uint16_t startMin;          // Weekly: local minute of day
+    uint16_t endMin;            // Weekly: end <= start runs past midnight, equal = 24 h
+    uint32_t onceStart;         // One-shot: Unix time
+    uint32_t onceEnd;
+};
+
+// Charge at least energyWh by departMin on the selected days (at full current)
+struct DepartureTarget {
+    uint8_t enabled;
+    uint8_t days;
+    uint16_t departMin;
+    uint32_t energyWh;
+};
+
+struct ScheduleTable {
+    uint8_t version = SCHEDULE_TABLE_VERSION;
+    uint8_t reserved[3] = {0, 0, 0};
+    ScheduleWindow windows[SCHEDULE_MAX_WINDOWS] = {};
+    DepartureTarget departure = {};
+};
+
+class EvseScheduler {
+public:
+    explicit EvseScheduler(EvseCharge& evseCharge);
+    // Setup: load the table from NVS
+    void begin();
+    // EVSE task, once per cycle after EvseCharge::loop()
+    void loop();
+
+    // Loop task: persist an edited table and hand it to the EVSE task
+    void setTable(const ScheduleTable& table);
+    const ScheduleTable& getTable() const { return tableIn.peek(); }
+
+    // Published by the EVSE task for the UI
+    int getActiveWindow() const { return __atomic_load_n(&statusWindow, __ATOMIC_RELAXED); }
+    bool isDepartureCharging() const { return __atomic_load_n(&statusDeparture, __ATOMIC_RELAXED); }
+    uint32_t getNextBoundary() const { return __atomic_load_n(&statusNext, __ATOMIC_RELAXED); }
+
+private:
+    void evaluate(time_t now, const EvseSnapshot& snap);
+    void apply(bool charge, uint16_t limitDa, const EvseSnapshot& snap);
+
+    EvseCharge& evse;
+
+    // Edited table, loop task -> EVSE task
+    SeqMailbox<ScheduleTable> tableIn;
+
+    // EVSE task state
+    ScheduleTable active;
+    uint32_t nextEval = 0;
+    bool lastConnected = false;
+    uint64_t plugInMwh = 0;             // Lifetime register at plug-in (departure progress)
+    uint32_t departureEpoch = 0;        // Departure being charged for
+    bool owning = false;                // Schedule holds the current limit
+    bool startIssued = false;           // One start attempt per activation / plug-in
+    bool startedSession = false;
+    uint16_t appliedDa = 0;
+    uint16_t restoreDa = 0;
+
+    int statusWindow = -1;
+    bool statusDeparture = false;
+    uint32_t statusNext = 0;
+};
+
+#endif
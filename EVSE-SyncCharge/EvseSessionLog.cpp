@@ -0,0 +1,177 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Implementation of the charging session history. Builds one record per
+ *              session from EVSE events and the state snapshot, and stores it in an
+ *              append-only ring of fixed-size records on a raw flash partition.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvseSessionLog.h"
+#include "EvseCharge.h"
+#include "EvseLogger.h"
+#include <esp_rom_crc.h>
+#include <stddef.h>
+
+static uint32_t recordCrc(const SessionRecord& rec) {
+    return esp_rom_crc32_le(0, (const uint8_t*)&rec, offsetof(SessionRecord, crc));
+}
+
+EvseSessionLog::EvseSessionLog(EvseCharge& evseCharge) : evse(evseCharge) {
+    for (uint32_t s = 0; s < SESSION_LOG_MAX_SECTORS; s++) sectorFirstSeq[s] = SESSION_LOG_EMPTY;
+}
+
+bool EvseSessionLog::begin() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "sessions");
+    // The firmware mounts no filesystem, so the stock SPIFFS partition is free to use
+    if (!partition) partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+    if (!partition) {
+        logger.warn("[HIST] No data partition found. Session history disabled.");
+        return false;
+    }
+    sectors = partition->size / SESSION_LOG_SECTOR_SIZE;
+    if (sectors > SESSION_LOG_MAX_SECTORS) sectors = SESSION_LOG_MAX_SECTORS;
+    if (sectors < 2) {
+        // Wrapping erases a whole sector; with one sector the history would empty itself
+        logger.warn("[HIST] Data partition too small. Session history disabled.");
+        partition = nullptr;
+        return false;
+    }
+
+    // Rebuild the index from the first record of each sector; the newest one is the head
+    bool any = false;
+    uint32_t headSeq = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        SessionRecord rec;
+        sectorFirstSeq[s] = readSlot(s * SESSION_RECORDS_PER_SECTOR, rec) ? rec.seq : SESSION_LOG_EMPTY;
+        if (sectorFirstSeq[s] != SESSION_LOG_EMPTY && (!any || rec.seq > headSeq)) {
+            headSeq = rec.seq;
+            any = true;
+        }
+    }
+
+    nextSeq = 0;
+    if (any) {
+        // Walk the head sector up to the first slot that does not hold the expected record
+        nextSeq = headSeq + 1;
+        SessionRecord rec;
+        while (nextSeq % SESSION_RECORDS_PER_SECTOR != 0 &&
+               readSlot(nextSeq % getCapacity(), rec) && rec.seq == nextSeq) {
+            nextSeq++;
+        }
+    }
+
+    logger.infof("[HIST] %lu sectors on '%s', %lu sessions (next #%lu)",
+                 (unsigned long)sectors, partition->label,
+                 (unsigned long)(nextSeq - getOldestSeq()), (unsigned long)nextSeq);
+    return true;
+}
+
+void EvseSessionLog::loop() {
+    EvseEventBus& bus = evse.getEventBus();
+    if (eventSub < 0) {
+        eventSub = bus.subscribe("history", evseEventBit(EVSE_EVT_SESSION_START) | evseEventBit(EVSE_EVT_SESSION_STOP));
+    }
+
+    EvseEvent ev;
+    while (bus.poll(eventSub, ev)) {
+        if (ev.type == EVSE_EVT_SESSION_START && !sessionOpen) {
+            // A resume after a pause raises another start; only the first one opens a record
+            sessionOpen = true;
+            memset(&current, 0, sizeof(current));
+            currentStartMs = ev.timeMs;
+            time_t now = time(nullptr);
+            current.startEpoch = (now > CLOCK_VALID_EPOCH) ? (uint32_t)now : 0;
+            if (pendingTag[0] && millis() - pendingTagMs < SESSION_TAG_HOLD_MS) {
+                memcpy(current.tag, pendingTag, SESSION_TAG_LEN);
+            }
+            pendingTag[0] = '\0';
+        } else if (ev.type == EVSE_EVT_SESSION_STOP && sessionOpen && ev.code != EVSE_STOP_PAUSE) {
+            // Session counters freeze once the relay opens, so the snapshot still holds them
+            EvseSnapshot snap = evse.getSnapshot();
+            current.durationS = (ev.timeMs - currentStartMs) / 1000UL;
+            current.energyWh = (uint32_t)(snap.sessionMwh / 1000ULL);
+            current.peakCurrentDa = (uint16_t)((snap.sessionPeakMa + 50) / 100);
+            current.avgCurrentDa = (uint16_t)((snap.sessionAvgMa + 50) / 100);
+            current.stopReason = ev.code;
+            sessionOpen = false;
+            if (append(current)) {
+                logger.infof("[HIST] Session #%lu: %lu Wh in %lu s (%s)", (unsigned long)current.seq,
+                             (unsigned long)current.energyWh, (unsigned long)current.durationS,
+                             evseStopReasonName(current.stopReason));
+            }
+        }
+    }
+}
+
+void EvseSessionLog::setPendingTag(const char* tag) {
+    // Stored as-is in the record and echoed in JSON: keep it to UID / idTag characters
+    size_t n = 0;
+    for (; tag && *tag && n < SESSION_TAG_LEN - 1; tag++) {
+        if (isalnum((unsigned char)*tag) || *tag == ':' || *tag == '-') pendingTag[n++] = *tag;
+    }
+    memset(pendingTag + n, 0, SESSION_TAG_LEN - n);
+    pendingTagMs = millis();
+}
+
+uint32_t EvseSessionLog::getOldestSeq() const {
+    uint32_t oldest = nextSeq;
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (sectorFirstSeq[s] != SESSION_LOG_EMPTY && sectorFirstSeq[s] < oldest) oldest = sectorFirstSeq[s];
+    }
+    return oldest;
+}
+
+bool EvseSessionLog::read(uint32_t seq, SessionRecord& out) const {
+    if (!partition || seq >= nextSeq || seq < getOldestSeq()) return false;
+    return readSlot(seq % getCapacity(), out) && out.seq == seq;
+}
+
+bool EvseSessionLog::readSlot(uint32_t slot, SessionRecord& out) const {
+    if (esp_partition_read(partition, slot * sizeof(SessionRecord), &out, sizeof(out)) != ESP_OK) return false;
+    if (out.seq == SESSION_LOG_EMPTY || out.crc != recordCrc(out)) return false;
+    // Guards against a capacity change (partition resized) remapping old records
+    return out.seq % getCapacity() == slot;
+}
+
+bool EvseSessionLog::append(SessionRecord& rec) {
+    if (!partition) return false;
+
+    uint32_t slot = nextSeq % getCapacity();
+    if (slot % SESSION_RECORDS_PER_SECTOR != 0) {
+        // A slot left dirty by a torn write cannot be programmed; skip to the next sector
+        SessionRecord probe;
+        esp_partition_read(partition, slot * sizeof(SessionRecord), &probe, sizeof(probe));
+        const uint8_t* p = (const uint8_t*)&probe;
+        for (size_t i = 0; i < sizeof(probe); i++) {
+            if (p[i] != 0xFF) {
+                nextSeq += SESSION_RECORDS_PER_SECTOR - (nextSeq % SESSION_RECORDS_PER_SECTOR);
+                slot = nextSeq % getCapacity();
+                break;
+            }
+        }
+    }
+
+    uint32_t sector = slot / SESSION_RECORDS_PER_SECTOR;
+    if (slot % SESSION_RECORDS_PER_SECTOR == 0) {
+        // Entering a sector drops its oldest records
+        sectorFirstSeq[sector] = SESSION_LOG_EMPTY;
+        if (esp_partition_erase_range(partition, sector * SESSION_LOG_SECTOR_SIZE, SESSION_LOG_SECTOR_SIZE) != ESP_OK) {
+            logger.error("[HIST] Sector erase failed");
+            return false;
+        }
+    }
+
+    rec.seq = nextSeq;
+    rec.crc = recordCrc(rec);
+    if (esp_partition_write(partition, slot * sizeof(SessionRecord), &rec, sizeof(rec)) != ESP_OK) {
+        logger.error("[HIST] Record write failed");
+        return false;
+    }
+    if (slot % SESSION_RECORDS_PER_SECTOR == 0) sectorFirstSeq[sector] = rec.seq;
+    nextSeq++;
+    return true;
+}
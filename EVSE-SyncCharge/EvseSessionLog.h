@@ -0,0 +1,92 @@
+/*****************************************************************************
+ * @file EvseSessionLog.h
+ * Flash-backed charging session history.
+ *
+ * @details
+ * Every finished session is stored as one fixed-size 64-byte record in an
+ * append-only ring on a raw data partition (label "sessions", falling back
+ * to the unused "spiffs" partition). Record N always lives in slot
+ * N % capacity, so no allocation table is needed: the only index is the
+ * first sequence number of each sector, rebuilt at boot by reading one
+ * record per sector. Entering a sector erases it, dropping the oldest
+ * sector's worth of records. A torn write fails its CRC and ends the log.
+ *
+ * Session boundaries come from the EVSE event bus; a pause/resume stays
+ * within one session.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_SESSION_LOG_H_
+#define EVSE_SESSION_LOG_H_
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <time.h>
+
+class EvseCharge;
+
+constexpr uint32_t SESSION_LOG_SECTOR_SIZE = 4096;
+constexpr uint32_t SESSION_LOG_MAX_SECTORS = 32;           // 128 KB, 2048 sessions
+constexpr uint32_t SESSION_LOG_EMPTY = 0xFFFFFFFFUL;       // Erased flash
+constexpr unsigned long SESSION_TAG_HOLD_MS = 60000;        // RFID scan -> session start window
+constexpr size_t SESSION_TAG_LEN = 32;                      // RFID UID hex or OCPP idTag (20), NUL padded
+
+struct SessionRecord {
+    uint32_t seq;                   // Record number, SESSION_LOG_EMPTY = erased slot
+    uint32_t startEpoch;            // Unix time at start, 0 = clock not set
+    uint32_t durationS;             // Start to final stop, pauses included
+    uint32_t energyWh;
+    uint16_t peakCurrentDa;         // Highest phase, 0.1A
+    uint16_t avgCurrentDa;          // Highest phase averaged over relay-closed time, 0.1A
+    uint8_t stopReason;             // EVSE_STOP_REASON_T
+    // Zero. Follow-up: the OCPP transaction id belongs here once OCPPhandler reports the id
+    // from StartTransaction.conf to the session log.
+    uint8_t reserved[7];
+    char tag[SESSION_TAG_LEN];      // Authorizing RFID UID, NUL padded
+    uint32_t crc;                   // CRC32 of all bytes above
+};
+static_assert(sizeof(SessionRecord) == 64, "SessionRecord must stay 64 bytes");
+static_assert(SESSION_LOG_SECTOR_SIZE % sizeof(SessionRecord) == 0, "Records must not straddle sectors");
+
+constexpr uint32_t SESSION_RECORDS_PER_SECTOR = SESSION_LOG_SECTOR_SIZE / sizeof(SessionRecord);
+
+class EvseSessionLog {
+public:
+    explicit EvseSessionLog(EvseCharge& evseCharge);
+    bool begin();
+    // Loop task: follows session events and appends a record per finished session
+    void loop();
+
+    // Identity for the next session start (RFID UID); expires after SESSION_TAG_HOLD_MS
+    void setPendingTag(const char* tag);
+
+    bool isReady() const { return partition != nullptr; }
+    uint32_t getCapacity() const { return sectors * SESSION_RECORDS_PER_SECTOR; }
+    uint32_t getNextSeq() const { return nextSeq; }
+    uint32_t getOldestSeq() const;
+    // Reads one record by sequence number; false if overwritten, not yet written or corrupt
+    bool read(uint32_t seq, SessionRecord& out) const;
+
+private:
+    bool append(SessionRecord& rec);
+    bool readSlot(uint32_t slot, SessionRecord& out) const;
+
+    EvseCharge& evse;
+    const esp_partition_t* partition = nullptr;
+    uint32_t sectors = 0;
+    uint32_t sectorFirstSeq[SESSION_LOG_MAX_SECTORS];   // The index
+    uint32_t nextSeq = 0;
+
+    int eventSub = -1;
+    bool sessionOpen = false;
+    SessionRecord current{};
+    unsigned long currentStartMs = 0;
+    char pendingTag[SESSION_TAG_LEN] = {0};
+    unsigned long pendingTagMs = 0;
+};
+
+#endif
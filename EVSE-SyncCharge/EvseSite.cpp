@@ -0,0 +1,79 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Implementation of the site load balancer: the UDP multicast transport of
+ *              the balancing node and the cap it posts to the EVSE task.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvseSite.h"
+#include "EvseCharge.h"
+
+static const IPAddress SITE_GROUP_ADDR(239, 255, 42, 99);
+
+/* =========================
+ * UDP Transport
+ * ========================= */
+
+bool SiteUdpTransport::linkUp() {
+    if (WiFi.status() != WL_CONNECTED) {
+        if (joined) {
+            udp.stop();
+            joined = false;
+        }
+        return false;
+    }
+    if (!joined) joined = udp.beginMulticast(SITE_GROUP_ADDR, SITE_UDP_PORT);
+    return joined;
+}
+
+uint32_t SiteUdpTransport::localId() {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    return ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+}
+
+void SiteUdpTransport::send(const uint8_t* data, size_t len) {
+    udp.beginPacket(SITE_GROUP_ADDR, SITE_UDP_PORT);
+    udp.write(data, len);
+    udp.endPacket();
+}
+
+int SiteUdpTransport::receive(uint8_t* buf, size_t size) {
+    if (udp.parsePacket() <= 0) return 0;
+    return udp.read(buf, size);
+}
+
+void SiteUdpTransport::close() {
+    if (joined) udp.stop();
+    joined = false;
+}
+
+/* =========================
+ * Balancer
+ * ========================= */
+
+EvseSiteBalancer::EvseSiteBalancer(EvseCharge& evseCharge) : evse(evseCharge), node(transport) {}
+
+void EvseSiteBalancer::configure(const SiteParams& p) {
+    node.configure(p);
+    // Disabling hands the cap back at once; loop() no longer runs for it
+    if (!p.enabled) postCap();
+}
+
+void EvseSiteBalancer::loop() {
+    if (!node.getParams().enabled) return;
+    EvseSnapshot snap = evse.getSnapshot();
+    node.loop(snap.vehicleConnected() && !snap.paused && !snap.lockout, millis());
+    postCap();
+}
+
+// A full queue leaves appliedCapDa behind, so the next loop posts again
+void EvseSiteBalancer::postCap() {
+    uint16_t capDa = node.getCapDa();
+    if (capDa == appliedCapDa) return;
+    if (evse.post(EVSE_CMD_SITE_CAP, EVSE_SRC_SITE, capDa)) appliedCapDa = capDa;
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * @file EvseSite.h
+ * Site load balancing between chargers sharing one supply.
+ *
+ * @details
+ * Units of one site (same group number) find each other over UDP multicast
+ * and exchange a small status every SITE_HEARTBEAT_MS: node id, priority,
+ * maximum current and whether a vehicle wants current. Any change is sent
+ * at once. The live node with the lowest id is the coordinator: no
+ * election messages, every node reaches the same answer from the same
+ * heartbeats. The coordinator shares the site budget and multicasts the
+ * result; each node applies its share as a cap on the offered limit
+ * (EVSE_CMD_SITE_CAP), so a plug event is rebalanced within a few hundred
+ * milliseconds.
+ *
+ * Allocation: vehicles are served in priority order with 6 A each as far
+ * as the budget goes (the rest get 0 A and wait), then the remainder is
+ * shared in proportion to priority up to each unit's maximum. Idle units
+ * keep a 6 A cap so a vehicle can begin its handshake before the next
+ * allocation; none is drawn until the contactor closes.
+ *
+ * The protocol and allocation live in EvseSiteNode (EvseSiteNode.h, with
+ * the fallback rules); this class carries its packets over UDP multicast on
+ * the WiFi station interface and posts the resulting cap to the EVSE task.
+ * The coordinator reserves the fallback share for every peer it lost during
+ * the last SITE_PEER_FORGET_MS, so an isolated unit and the rest of the
+ * site never add up to more than the budget.
+ *
+ * Packets are raw little-endian structs; all units run this firmware.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_SITE_H_
+#define EVSE_SITE_H_
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "EvseSiteNode.h"
+
+class EvseCharge;
+
+constexpr uint16_t SITE_UDP_PORT = 50421;
+
+// UDP multicast group on the WiFi station interface. The membership goes with the
+// association, so it is dropped with the link and joined again when it returns.
+class SiteUdpTransport : public SiteTransport {
+public:
+    bool linkUp() override;
+    uint32_t localId() override;
+    void send(const uint8_t* data, size_t len) override;
+    int receive(uint8_t* buf, size_t size) override;
+    void close() override;
+
+private:
+    WiFiUDP udp;
+    bool joined = false;
+};
+
+class EvseSiteBalancer {
+public:
+    explicit EvseSiteBalancer(EvseCharge& evseCharge);
+    void configure(const SiteParams& params);
+    // Loop task
+    void loop();
+
+    bool isEnabled() const { return node.getParams().enabled; }
+    bool isCoordinator() const { return node.isCoordinator(); }
+    bool isFallback() const { return node.isFallback(); }
+    int getNodeCount() const { return node.getNodeCount(); }
+    uint16_t getCapDa() const { return appliedCapDa; }
+    // Demand change -> allocation answering it received (ms)
+    unsigned long getLastConvergeMs() const { return node.getLastConvergeMs(); }
+    unsigned long getMaxConvergeMs() const { return node.getMaxConvergeMs(); }
+
+private:
+    void postCap();
+
+    EvseCharge& evse;
+    SiteUdpTransport transport;
+    EvseSiteNode node;
+    uint16_t appliedCapDa = EVSE_CAP_NONE;
+};
+
+#endif
@@ -0,0 +1,369 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Implementation of the site balancing node: heartbeats, implicit lowest-id
+ *              coordinator, priority fair-share allocation and the fallback share, over
+ *              any SiteTransport.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvseSiteNode.h"
+#include "Pilot.h"
+#include "EvseLogger.h"
+#include <stddef.h>
+
+EvseSiteNode::EvseSiteNode(SiteTransport& siteTransport) : transport(siteTransport) {}
+
+void EvseSiteNode::configure(const SiteParams& p) {
+    bool wasEnabled = params.enabled;
+    params = p;
+    allocDirty = true;
+    if (wasEnabled && !params.enabled) {
+        stop();
+        transport.close();
+        fallback = false;
+        capDa = EVSE_CAP_NONE;
+        logger.info("[SITE] Load balancing disabled");
+    }
+}
+
+void EvseSiteNode::start(unsigned long now) {
+    nodeId = transport.localId();
+    started = true;
+    listening = true;
+    startedMs = now;
+    lastAllocRxMs = now;
+    lastStatusMs = now - SITE_HEARTBEAT_MS;     // Announce at once
+    allocDirty = true;
+    logger.infof("[SITE] Node %08lX joined group %u (site %u.%u A, priority %u), listening", (unsigned long)nodeId,
+                 params.group, params.siteDa / 10, params.siteDa % 10, params.priority);
+    // Until the site has been heard (or allocates to us) nothing tells us what the others draw
+    fallback = true;
+    setCap(params.fallbackDa, 0, now);
+}
+
+void EvseSiteNode::stop() {
+    started = false;
+    peerCount = 0;
+    coordinatorId = 0;
+}
+
+void EvseSiteNode::loop(bool active, unsigned long now) {
+    if (!params.enabled) return;
+
+    if (!transport.linkUp()) {
+        // No network: the other units are out of reach, and we are out of theirs
+        if (started) {
+            logger.warn("[SITE] Link down");
+            stop();
+        }
+        enterFallback("Link down", now);
+        return;
+    }
+    if (!started) start(now);
+    if (listening && now - startedMs >= SITE_PEER_TIMEOUT_MS) {
+        listening = false;
+        allocDirty = true;
+    }
+
+    receive(now);
+
+    // Own demand: a change goes out at once so the coordinator can rebalance. So does a
+    // new cap: raises elsewhere wait for this unit to report a lower one.
+    if (active != selfActive) {
+        selfActive = active;
+        statusSeq++;
+        demandChangedMs = now;
+        awaitingAck = true;
+        allocDirty = true;
+        sendStatus(now);
+    } else if (capDa != reportedCapDa || now - lastStatusMs >= SITE_HEARTBEAT_MS) {
+        sendStatus(now);
+    }
+
+    // Peer aging: lost peers keep a reservation until they are forgotten
+    int live = 0;
+    for (int i = 0; i < peerCount; i++) {
+        Peer& p = peers[i];
+        if (!p.lost && now - p.lastSeenMs > SITE_PEER_TIMEOUT_MS) {
+            p.lost = true;
+            allocDirty = true;
+            logger.warnf("[SITE] Node %08lX lost", (unsigned long)p.nodeId);
+        }
+        if (!p.lost) live++;
+    }
+    // ...but only while some of the site is still heard: an isolated unit keeps them, and
+    // with them its fallback share, instead of taking the whole budget for itself
+    if (live > 0) {
+        for (int i = 0; i < peerCount; i++) {
+            if (peers[i].lost && now - peers[i].lastSeenMs > SITE_PEER_FORGET_MS) {
+                peers[i--] = peers[--peerCount];
+                allocDirty = true;
+            }
+        }
+    }
+
+    uint32_t coord = electCoordinator(now);
+    if (coord != coordinatorId) {
+        coordinatorId = coord;
+        if (coord) logger.infof("[SITE] Coordinator: %08lX%s", (unsigned long)coord, coord == nodeId ? " (this unit)" : "");
+        allocDirty = true;
+    }
+
+    if (coordinatorId == 0) {
+        // Listening keeps the share start() set; otherwise every known peer is lost
+        if (!listening) enterFallback("All peers lost", now);
+        return;
+    }
+    if (coordinatorId == nodeId) {
+        if (allocDirty || now - lastAllocMs >= SITE_HEARTBEAT_MS) allocate(now);
+    } else if (now - lastAllocRxMs > SITE_ALLOC_TIMEOUT_MS) {
+        enterFallback("No allocation from coordinator", now);
+    }
+}
+
+int EvseSiteNode::getNodeCount() const {
+    int n = 1;
+    for (int i = 0; i < peerCount; i++) n += peers[i].lost ? 0 : 1;
+    return n;
+}
+
+// Lowest live id. A unit only counts once it has listened for SITE_PEER_TIMEOUT_MS after a
+// (re)start (peers announce what is left of it), and this one not at all while isolated:
+// with known peers and none of them live. 0 = no coordinator.
+uint32_t EvseSiteNode::electCoordinator(unsigned long now) const {
+    uint32_t id = 0;
+    int live = 0;
+    for (int i = 0; i < peerCount; i++) {
+        if (peers[i].lost) continue;
+        live++;
+        if ((long)(now - peers[i].candidateMs) < 0) continue;
+        if (id == 0 || peers[i].nodeId < id) id = peers[i].nodeId;
+    }
+    if (!listening && (live > 0 || peerCount == 0) && (id == 0 || nodeId < id)) id = nodeId;
+    return id;
+}
+
+EvseSiteNode::Peer* EvseSiteNode::findPeer(uint32_t id, bool create) {
+    for (int i = 0; i < peerCount; i++) {
+        if (peers[i].nodeId == id) return &peers[i];
+    }
+    if (!create || peerCount >= SITE_MAX_NODES - 1) return nullptr;
+    Peer& p = peers[peerCount++];
+    // Until its status says otherwise it may hold anything: no raise counts on it
+    p = Peer{ id, 0, 0, 0, false, false, 0, 0, params.siteDa, 0 };
+    logger.infof("[SITE] Node %08lX joined", (unsigned long)id);
+    return &p;
+}
+
+void EvseSiteNode::enterFallback(const char* reason, unsigned long now) {
+    if (!fallback) {
+        logger.warnf("[SITE] %s. Fallback share %u.%u A", reason, params.fallbackDa / 10, params.fallbackDa % 10);
+        fallback = true;
+    }
+    setCap(params.fallbackDa, 0, now);
+}
+
+void EvseSiteNode::setCap(uint16_t cap, uint16_t ackSeq, unsigned long now) {
+    if (awaitingAck && !fallback && ackSeq == (uint16_t)statusSeq) {
+        awaitingAck = false;
+        lastConvergeMs = now - demandChangedMs;
+        if (lastConvergeMs > maxConvergeMs) maxConvergeMs = lastConvergeMs;
+    }
+    capDa = cap;
+}
+
+/* =========================
+ * Messages
+ * ========================= */
+
+SiteHeader EvseSiteNode::header(SITE_MSG_T type) const {
+    return SiteHeader{ SITE_MAGIC, SITE_PROTO_VERSION, (uint8_t)type, params.group, nodeId, statusSeq };
+}
+
+void EvseSiteNode::sendStatus(unsigned long now) {
+    uint16_t listenLeftMs = listening ? (uint16_t)(SITE_PEER_TIMEOUT_MS - (now - startedMs)) : 0;
+    SiteStatusMsg msg{ header(SITE_MSG_STATUS), params.maxDa, params.priority, (uint8_t)(selfActive ? 1 : 0),
+                       listenLeftMs, capDa };
+    transport.send((const uint8_t*)&msg, sizeof(msg));
+    lastStatusMs = now;
+    reportedCapDa = capDa;
+}
+
+void EvseSiteNode::receive(unsigned long now) {
+    SiteAllocMsg buf;
+    int len;
+    while ((len = transport.receive((uint8_t*)&buf, sizeof(buf))) > 0) {
+        if (len < (int)sizeof(SiteHeader)) continue;
+        const SiteHeader& h = buf.h;
+        if (h.magic != SITE_MAGIC || h.version != SITE_PROTO_VERSION || h.group != params.group || h.nodeId == nodeId) continue;
+        if (h.type == SITE_MSG_STATUS && len >= (int)sizeof(SiteStatusMsg)) {
+            handleStatus(*(const SiteStatusMsg*)&buf, now);
+        } else if (h.type == SITE_MSG_ALLOC) {
+            handleAlloc(buf, len, now);
+        }
+    }
+}
+
+void EvseSiteNode::handleStatus(const SiteStatusMsg& msg, unsigned long now) {
+    Peer* p = findPeer(msg.h.nodeId, true);
+    if (!p) return;
+    bool active = msg.active != 0;
+    if (p->lost || p->lastSeenMs == 0 || p->active != active || p->maxDa != msg.maxDa || p->priority != msg.priority
+        || p->heldDa != msg.capDa) {
+        allocDirty = true;
+    }
+    p->heldDa = msg.capDa;
+    p->statusSeq = msg.h.seq;
+    p->maxDa = msg.maxDa;
+    p->priority = msg.priority;
+    p->active = active;
+    // Absolute, so units that restarted together turn candidate in the same pass
+    p->candidateMs = now + msg.listenLeftMs;
+    p->lost = false;
+    p->lastSeenMs = now;
+}
+
+void EvseSiteNode::handleAlloc(const SiteAllocMsg& msg, int len, unsigned long now) {
+    // Every entry the count announces must be in the packet; the rest of the buffer is stale
+    if (len < (int)offsetof(SiteAllocMsg, entries) || msg.count > SITE_MAX_NODES
+        || len < (int)(offsetof(SiteAllocMsg, entries) + msg.count * sizeof(SiteAllocEntry))) {
+        return;
+    }
+
+    // An allocation also proves the sender alive
+    Peer* p = findPeer(msg.h.nodeId, true);
+    if (p) {
+        if (p->lost) allocDirty = true;
+        p->lost = false;
+        p->lastSeenMs = now;
+    }
+    if (msg.h.nodeId != electCoordinator(now)) return;
+
+    for (int i = 0; i < msg.count; i++) {
+        if (msg.entries[i].nodeId != nodeId) continue;
+        if (fallback) logger.info("[SITE] Allocation received, leaving fallback");
+        fallback = false;
+        lastAllocRxMs = now;
+        setCap(msg.entries[i].capDa, msg.entries[i].ackSeq, now);
+        return;
+    }
+    // Not included yet: the coordinator has not heard our status; keep the current cap
+}
+
+/* =========================
+ * Allocation (coordinator)
+ * ========================= */
+
+void EvseSiteNode::allocate(unsigned long now) {
+    struct Node {
+        uint32_t id;
+        uint16_t maxDa;
+        uint16_t capDa;
+        uint16_t heldDa;        // Most it may hold until this allocation reaches it
+        uint16_t ackSeq;
+        uint8_t priority;
+        bool active;
+        int8_t peer;            // Index in peers, -1 = this unit
+    };
+    Node nodes[SITE_MAX_NODES];
+    int n = 0;
+    int32_t budget = params.siteDa;
+
+    nodes[n++] = Node{ nodeId, params.maxDa, 0, capDa, (uint16_t)statusSeq, params.priority, selfActive, -1 };
+    for (int i = 0; i < peerCount; i++) {
+        const Peer& p = peers[i];
+        uint16_t held = p.heldDa > p.sentDa ? p.heldDa : p.sentDa;
+        if (p.lost) {
+            // May still hold its last cap, or be running on its fallback share by now
+            budget -= held > params.fallbackDa ? held : params.fallbackDa;
+            continue;
+        }
+        nodes[n++] = Node{ p.nodeId, p.maxDa, 0, held, (uint16_t)p.statusSeq, p.priority, p.active, (int8_t)i };
+    }
+    if (budget < 0) budget = 0;
+    int32_t freeDa = budget;
+    for (int i = 0; i < n; i++) freeDa -= nodes[i].heldDa;
+
+    // Serving order: priority, then node id (same order on every coordinator)
+    for (int i = 1; i < n; i++) {
+        Node key = nodes[i];
+        int j = i - 1;
+        while (j >= 0 && (nodes[j].priority < key.priority || (nodes[j].priority == key.priority && nodes[j].id > key.id))) {
+            nodes[j + 1] = nodes[j];
+            j--;
+        }
+        nodes[j + 1] = key;
+    }
+
+    // Minimum current first, as far as the budget goes
+    uint32_t weightSum = 0;
+    for (int i = 0; i < n; i++) {
+        if (!nodes[i].active || budget < (int32_t)MIN_CURRENT_DA) continue;
+        nodes[i].capDa = MIN_CURRENT_DA;
+        budget -= MIN_CURRENT_DA;
+        weightSum += nodes[i].priority;
+    }
+    // Idle units keep the minimum, inside the budget, so a new vehicle can start before the
+    // next round; once the budget runs out they get 0 and wait for the allocation their
+    // plug-in status triggers
+    for (int i = 0; i < n; i++) {
+        if (nodes[i].active || budget < (int32_t)MIN_CURRENT_DA) continue;
+        nodes[i].capDa = MIN_CURRENT_DA;
+        budget -= MIN_CURRENT_DA;
+    }
+
+    // Remainder in proportion to priority; a unit at its maximum passes its part on
+    while (budget > 0 && weightSum > 0) {
+        int32_t handed = 0;
+        uint32_t nextWeight = 0;
+        for (int i = 0; i < n; i++) {
+            Node& nd = nodes[i];
+            if (!nd.active || nd.capDa == 0 || nd.capDa >= nd.maxDa) continue;
+            int32_t share = budget * nd.priority / (int32_t)weightSum;
+            if (share == 0) share = 1;
+            if (share > budget - handed) share = budget - handed;
+            if (share > nd.maxDa - nd.capDa) share = nd.maxDa - nd.capDa;
+            nd.capDa += share;
+            handed += share;
+            if (nd.capDa < nd.maxDa) nextWeight += nd.priority;
+        }
+        budget -= handed;
+        weightSum = nextWeight;
+        if (handed == 0) break;
+    }
+
+    // Make before break: lowered units give their current up only once the packet reaches
+    // them, so raises get what is free now, in serving order; the rest follows as the
+    // lowered units report in
+    for (int i = 0; i < n; i++) {
+        Node& nd = nodes[i];
+        if (nd.capDa <= nd.heldDa) continue;
+        int32_t raise = nd.capDa - nd.heldDa;
+        if (raise > freeDa) raise = freeDa > 0 ? freeDa : 0;
+        nd.capDa = nd.heldDa + raise;
+        freeDa -= raise;
+    }
+
+    SiteAllocMsg msg{};
+    msg.h = header(SITE_MSG_ALLOC);
+    msg.budgetDa = params.siteDa;
+    msg.count = (uint8_t)n;
+    for (int i = 0; i < n; i++) {
+        uint16_t cap = nodes[i].capDa;
+        msg.entries[i] = SiteAllocEntry{ nodes[i].id, cap, nodes[i].ackSeq };
+        if (nodes[i].peer >= 0) peers[nodes[i].peer].sentDa = cap;
+        if (nodes[i].id == nodeId) {
+            if (fallback) logger.info("[SITE] Coordinating, leaving fallback");
+            fallback = false;
+            lastAllocRxMs = now;
+            setCap(cap, nodes[i].ackSeq, now);
+        }
+    }
+    transport.send((const uint8_t*)&msg, offsetof(SiteAllocMsg, entries) + n * sizeof(SiteAllocEntry));
+    lastAllocMs = now;
+    allocDirty = false;
+}
@@ -0,0 +1,182 @@
+/*****************************************************************************
+ * @file EvseSiteNode.h
+ * Site load balancing logic of one unit, independent of the network stack.
+ *
+ * @details
+ * Wire format, peer table, coordinator election, allocation and the
+ * fallback share. Packets go through a SiteTransport: on the charger
+ * that is UDP multicast over WiFi (EvseSiteBalancer), in the host test an
+ * in-process bus carrying many nodes. The node only computes the cap;
+ * posting it to the EVSE is the owner's job.
+ *
+ * Fallback: the node holds the configured safe share whenever it cannot
+ * know what the other units draw:
+ * - the link is down (WiFi lost, AP gone); the node restarts when it
+ *   returns,
+ * - for SITE_PEER_TIMEOUT_MS after each (re)start, while it listens for
+ *   the site before it may elect itself (an allocation from a live
+ *   coordinator ends this early),
+ * - every known peer is lost: an isolated unit never allocates itself
+ *   the site budget,
+ * - no allocation from the coordinator for SITE_ALLOC_TIMEOUT_MS.
+ *
+ * Allocation is make-before-break: every status carries the cap the unit
+ * holds, and the coordinator raises a unit only by what the caps still held
+ * leave free. A lowered unit keeps its old cap until the allocation reaches
+ * it, so the raise that uses its current waits for its next status; a lost
+ * packet delays a raise instead of overcommitting the site.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_SITE_NODE_H_
+#define EVSE_SITE_NODE_H_
+
+#include <Arduino.h>
+#include "EvseCommand.h"
+
+constexpr uint32_t SITE_MAGIC = 0x42535645UL;           // "EVSB"
+constexpr uint8_t SITE_PROTO_VERSION = 2;
+constexpr int SITE_MAX_NODES = 16;
+constexpr unsigned long SITE_HEARTBEAT_MS = 300;
+constexpr unsigned long SITE_PEER_TIMEOUT_MS = 1500;    // ~5 missed heartbeats: peer lost
+constexpr unsigned long SITE_PEER_FORGET_MS = 60000;    // Lost peers keep a fallback reservation
+constexpr unsigned long SITE_ALLOC_TIMEOUT_MS = 1500;   // No allocation: use the fallback share
+
+typedef enum SITE_MSG {
+    SITE_MSG_STATUS = 1,
+    SITE_MSG_ALLOC
+} SITE_MSG_T;
+
+struct SiteHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;               // SITE_MSG_T
+    uint16_t group;             // Site number: units of other sites on the LAN are ignored
+    uint32_t nodeId;
+    uint32_t seq;               // STATUS: bumped on every demand change
+};
+
+struct SiteStatusMsg {
+    SiteHeader h;
+    uint16_t maxDa;
+    uint8_t priority;           // 1 (low) .. 9 (high)
+    uint8_t active;             // Vehicle connected and wants current
+    uint16_t listenLeftMs;      // Just (re)started: not a coordinator candidate for this long
+    uint16_t capDa;             // Cap this unit holds right now
+};
+
+struct SiteAllocEntry {
+    uint32_t nodeId;
+    uint16_t capDa;
+    uint16_t ackSeq;            // Low bits of the status seq this share answers
+};
+
+struct SiteAllocMsg {
+    SiteHeader h;
+    uint16_t budgetDa;
+    uint8_t count;
+    uint8_t reserved;
+    SiteAllocEntry entries[SITE_MAX_NODES];
+};
+
+struct SiteParams {
+    bool enabled = false;
+    uint16_t group = 1;
+    uint16_t siteDa = 320;      // Site supply per phase (0.1A)
+    uint16_t fallbackDa = 60;   // Safe share without a coordinator
+    uint8_t priority = 5;
+    uint16_t maxDa = 320;       // This unit's maximum
+};
+
+// Packet I/O of one node: every packet sent reaches all other nodes of the site
+class SiteTransport {
+public:
+    virtual ~SiteTransport() {}
+    // Connected and joined (joins on demand); false while the network is down
+    virtual bool linkUp() = 0;
+    // Unique, stable id of this unit on the site
+    virtual uint32_t localId() = 0;
+    virtual void send(const uint8_t* data, size_t len) = 0;
+    // Copies the next pending packet into buf; its length, 0 = nothing pending
+    virtual int receive(uint8_t* buf, size_t size) = 0;
+    virtual void close() = 0;
+};
+
+class EvseSiteNode {
+public:
+    explicit EvseSiteNode(SiteTransport& transport);
+    void configure(const SiteParams& params);
+    // `active`: a vehicle is connected and wants current
+    void loop(bool active, unsigned long now);
+
+    const SiteParams& getParams() const { return params; }
+    uint32_t getNodeId() const { return nodeId; }
+    uint32_t getCoordinatorId() const { return coordinatorId; }
+    bool isCoordinator() const { return started && coordinatorId == nodeId; }
+    bool isFallback() const { return fallback; }
+    int getNodeCount() const;
+    // Cap this unit must apply (EVSE_CAP_NONE while disabled)
+    uint16_t getCapDa() const { return capDa; }
+    // Demand change -> allocation answering it received (ms)
+    unsigned long getLastConvergeMs() const { return lastConvergeMs; }
+    unsigned long getMaxConvergeMs() const { return maxConvergeMs; }
+
+private:
+    struct Peer {
+        uint32_t nodeId;
+        uint32_t statusSeq;
+        uint16_t maxDa;
+        uint8_t priority;
+        bool active;
+        bool lost;
+        unsigned long lastSeenMs;
+        unsigned long candidateMs;  // Done listening from then on
+        uint16_t heldDa;            // Cap it reported holding
+        uint16_t sentDa;            // Cap this unit last allocated it (as coordinator)
+    };
+
+    void start(unsigned long now);
+    void stop();
+    void receive(unsigned long now);
+    void handleStatus(const SiteStatusMsg& msg, unsigned long now);
+    void handleAlloc(const SiteAllocMsg& msg, int len, unsigned long now);
+    void sendStatus(unsigned long now);
+    void allocate(unsigned long now);
+    void enterFallback(const char* reason, unsigned long now);
+    void setCap(uint16_t capDa, uint16_t ackSeq, unsigned long now);
+    Peer* findPeer(uint32_t id, bool create);
+    uint32_t electCoordinator(unsigned long now) const;
+    SiteHeader header(SITE_MSG_T type) const;
+
+    SiteTransport& transport;
+    SiteParams params;
+    bool started = false;
+    bool listening = false;                 // First SITE_PEER_TIMEOUT_MS after a (re)start
+    uint32_t nodeId = 0;
+    unsigned long startedMs = 0;
+
+    Peer peers[SITE_MAX_NODES];
+    int peerCount = 0;
+    uint32_t coordinatorId = 0;             // 0 = none (listening, isolated or link down)
+    bool allocDirty = true;
+
+    bool selfActive = false;
+    uint32_t statusSeq = 0;
+    unsigned long lastStatusMs = 0;
+    uint16_t reportedCapDa = EVSE_CAP_NONE; // capDa in the last status sent
+    unsigned long lastAllocMs = 0;          // Coordinator: last allocation sent
+    unsigned long lastAllocRxMs = 0;        // Last allocation that included this unit
+    bool fallback = false;
+    uint16_t capDa = EVSE_CAP_NONE;
+
+    bool awaitingAck = false;
+    unsigned long demandChangedMs = 0;
+    unsigned long lastConvergeMs = 0;
+    unsigned long maxConvergeMs = 0;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Implementation of the solar surplus controller. Turns grid power readings
+ *              into a charge current with a velocity-form PI loop and posts it as the
+ *              current limit through the EVSE command queue.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvseSolar.h"
+#include "EvseCharge.h"
+#include "EvseLogger.h"
+
+EvseSolarController::EvseSolarController(EvseCharge& evseCharge) : evse(evseCharge) {}
+
+void EvseSolarController::updateGridPower(float watts) {
+    GridReading r;
+    r.gridW = watts;
+    r.ms = millis();
+    readingIn.publish(r);
+
+    // A live reading is fresh control data for ThrottleAlive too
+    if (paramsIn.peek().enabled) evse.signalThrottleAlive();
+}
+
+void EvseSolarController::setParams(const SolarParams& p) {
+    paramsIn.publish(p);
+    logger.infof("[SOLAR] %s, target %ld W, Kp %.2f, Ki %.3f%s", p.enabled ? "Enabled" : "Disabled",
+                 (long)p.targetW, p.kp, p.ki, p.autoPhase ? ", 1/3-phase switching" : "");
+}
+
+void EvseSolarController::loop() {
+    paramsIn.tryTake(params);
+    GridReading r;
+    bool sample = readingIn.tryTake(r);
+
+    if (!params.enabled || evse.isScheduleHold()) {
+        if (statusActive) {
+            // Stop steering; the next activation starts from the measured surplus
+            __atomic_store_n(&statusActive, false, __ATOMIC_RELAXED);
+            wasDrawing = false;
+            stale = true;
+            postedDa = 0xFFFF;
+            phaseWant = 0;
+            // Whoever takes over expects the installation's full phase count
+            if (evse.canSwitchPhases() && evse.getActivePhases() != 3) evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_SOLAR, 3);
+        }
+        // Disabled: put back the limit solar took over (a 0 A dusk offer must not stay).
+        // A schedule window owns the limit meanwhile, so wait until it ends; if solar is
+        // still enabled then, it takes over again instead.
+        if (owning && !params.enabled && !evse.isScheduleHold()) {
+            if (evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_SOLAR, restoreDa)) {
+                owning = false;
+                logger.infof("[SOLAR] Limit handed back: %u.%u A", restoreDa / 10, restoreDa % 10);
+            }
+        }
+        return;
+    }
+
+    if (sample) {
+        if (!owning) {
+            owning = true;
+            restoreDa = evse.getSnapshot().targetLimitDa;
+        }
+        float dtS = stale ? 0.0f : (float)(r.ms - lastSampleMs) / 1000.0f;
+        if (dtS > SOLAR_MAX_DT_S) dtS = SOLAR_MAX_DT_S;
+        if (stale) logger.info("[SOLAR] Grid readings received, tracking surplus");
+        lastSampleMs = r.ms;
+        stale = false;
+        __atomic_store_n(&statusActive, true, __ATOMIC_RELAXED);
+        __atomic_store_n(&statusGridW, (int32_t)r.gridW, __ATOMIC_RELAXED);
+        step(r.gridW, dtS, evse.getSnapshot());
+    } else if (!stale && (millis() - lastSampleMs) > SOLAR_STALE_MS) {
+        // Without readings there is no known surplus: stop drawing rather than import
+        logger.warn("[SOLAR] Grid readings stale. Offering 0 A");
+        stale = true;
+        wasDrawing = false;
+        offer(0.0f);
+    }
+}
+
+/* =========================
+ * PI Step
+ * ========================= */
+
+void EvseSolarController::step(float gridW, float dtS, const EvseSnapshot& snap) {
+    float wattsPerAmp = (float)snap.mainsVoltage * (float)snap.phases;
+    if (wattsPerAmp <= 0.0f) return;
+    if (snap.phaseSwitching) {
+        // Contactor open for the change; restart from the measured surplus afterwards
+        wasDrawing = false;
+        lastErrorA = ((float)params.targetW - gridW) / wattsPerAmp;
+        return;
+    }
+    // Surplus (+) or shortfall (-) at the grid, in charge-current terms
+    float errorA = ((float)params.targetW - gridW) / wattsPerAmp;
+
+    float out;
+    if (!snap.relayClosed) {
+        // Nothing draws the offer: track the plant so nothing winds up while idle or paused
+        out = errorA;
+        wasDrawing = false;
+    } else {
+        if (!wasDrawing) lastErrorA = errorA;   // No proportional kick on the first step
+        out = offerA + params.kp * (errorA - lastErrorA) + params.ki * errorA * dtS;
+        // Vehicle taking less than offered (own limit, taper): stay close to its draw
+        if (snap.powerW > 0) {
+            float ceilingA = (float)snap.powerW / wattsPerAmp + SOLAR_HEADROOM_A;
+            if (out > ceilingA) out = ceilingA;
+        }
+        wasDrawing = true;
+    }
+    lastErrorA = errorA;
+    offer(out);
+    if (params.autoPhase && evse.canSwitchPhases()) choosePhases(gridW, snap, (float)snap.mainsVoltage);
+}
+
+// Power available to the charger (own draw plus surplus) decides 1-phase or 3-phase
+void EvseSolarController::choosePhases(float gridW, const EvseSnapshot& snap, float voltage) {
+    float drawW = 0.0f;
+    if (snap.relayClosed) {
+        drawW = snap.powerW > 0 ? (float)snap.powerW : (snap.offeredLimitDa / 10.0f) * voltage * snap.phases;
+    }
+    float availW = drawW + (float)params.targetW - gridW;
+    float perPhase3A = availW / (voltage * 3.0f);
+    float perPhase1A = availW / voltage;
+
+    uint8_t want = snap.phases;
+    if (snap.phases == 3 && perPhase3A < MIN_CURRENT) {
+        // Strict J1772 pauses on either side below 6 A: only worth it when 1-phase can run
+        if (!evse.getSettings().disableAtLowLimit || perPhase1A >= MIN_CURRENT) want = 1;
+    } else if (snap.phases == 1 && perPhase3A >= MIN_CURRENT + SOLAR_PHASE_HYST_A) {
+        want = 3;
+    }
+
+    if (want == snap.phases) {
+        phaseWant = 0;
+        return;
+    }
+    if (want != phaseWant) {
+        phaseWant = want;
+        phaseWantSinceMs = lastSampleMs;
+        return;
+    }
+    if (lastSampleMs - phaseWantSinceMs < SOLAR_PHASE_DWELL_MS) return;
+    if (phaseSwitched && lastSampleMs - lastPhaseSwitchMs < SOLAR_PHASE_MIN_GAP_MS) return;
+
+    logger.infof("[SOLAR] %.0f W available: switching to %u-phase", availW, want);
+    if (evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_SOLAR, want)) {
+        phaseSwitched = true;
+        lastPhaseSwitchMs = lastSampleMs;
+        phaseWant = 0;
+    }
+}
+
+void EvseSolarController::offer(float amps) {
+    float maxA = evse.getSettings().maxCurrent;
+    offerA = constrain(amps, 0.0f, maxA);
+    uint16_t da = ampsToDeciamps(offerA);
+    __atomic_store_n(&statusOfferDa, da, __ATOMIC_RELAXED);
+    if (da == postedDa) return;
+    if (evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_SOLAR, da)) postedDa = da;
+}
@@ -0,0 +1,118 @@
+/*****************************************************************************
+ * @file EvseSolar.h
+ * On-device solar surplus controller.
+ *
+ * @details
+ * Closes the loop on a grid power measurement (import positive, export
+ * negative) pushed over MQTT (`setGridPower`) or HTTP (`/api/grid`). Every
+ * new reading runs one PI step in the EVSE task and the result is posted as
+ * the current limit, so the charger follows the surplus within one
+ * measurement interval instead of a broker round-trip.
+ *
+ * The PI runs in velocity form: each step moves the offered current by
+ * Kp * d(error) + Ki * error * dt and the result is clamped to 0..max, so
+ * saturation never accumulates. While the contactor is open (idle, or a
+ * low-limit pause) nothing responds to the output, so the controller tracks
+ * the plant instead: the offer is the measured surplus itself. While
+ * charging, the offer is kept within SOLAR_HEADROOM_A of what the vehicle
+ * actually draws when a meter feeds `setActualCurrent`.
+ *
+ * Limits below 6 A go through the existing low-limit handling: throttle
+ * with allowBelow6AmpCharging, otherwise pause and resume after
+ * lowLimitResumeDelayMs. A schedule window holding the limit takes
+ * precedence over surplus tracking. The limit in force when the first
+ * reading arrives is put back when the controller is disabled (after the
+ * window, if one holds the limit then).
+ *
+ * With a phase contactor fitted and autoPhase set, the controller also picks
+ * 1-phase or 3-phase from the power available to the charger (its own draw
+ * plus the surplus). It goes 1-phase when 3-phase would get less than 6 A:
+ * always in throttle mode (allowBelow6AmpCharging), and in strict mode only
+ * when 1-phase reaches 6 A, since both would pause otherwise. It goes back to
+ * 3-phase at 6 A + SOLAR_PHASE_HYST_A per phase. A side must hold for
+ * SOLAR_PHASE_DWELL_MS, and switches are at least SOLAR_PHASE_MIN_GAP_MS
+ * apart.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_SOLAR_H_
+#define EVSE_SOLAR_H_
+
+#include <Arduino.h>
+#include "EvseCommand.h"
+
+class EvseCharge;
+struct EvseSnapshot;
+
+constexpr unsigned long SOLAR_STALE_MS = 60000;     // No grid reading this long: offer 0 A
+constexpr float SOLAR_MAX_DT_S = 30.0f;             // Integration step cap after missed readings
+constexpr float SOLAR_HEADROOM_A = 3.0f;            // Offer above the measured draw while charging
+constexpr float SOLAR_PHASE_HYST_A = 1.0f;          // Back to 3-phase above 6 A + this per phase
+constexpr unsigned long SOLAR_PHASE_DWELL_MS = 60000;   // Surplus must stay on one side this long
+constexpr unsigned long SOLAR_PHASE_MIN_GAP_MS = 300000; // Between two phase switches
+
+struct SolarParams {
+    bool enabled = false;
+    int32_t targetW = 0;        // Grid setpoint: 0 = zero export, > 0 allows some import
+    float kp = 0.5f;            // A per A of surplus change
+    float ki = 0.1f;            // A per A of surplus per second
+    bool autoPhase = false;     // 1-phase / 3-phase switching (phase contactor fitted)
+};
+
+class EvseSolarController {
+public:
+    explicit EvseSolarController(EvseCharge& evseCharge);
+
+    // Loop task (MQTT, web): one grid power reading in W, import positive
+    void updateGridPower(float watts);
+    // Loop task: controller settings, picked up by the EVSE task on its next cycle
+    void setParams(const SolarParams& params);
+    // EVSE task, once per cycle after EvseCharge::loop()
+    void loop();
+
+    // Published by the EVSE task for the UI
+    bool isActive() const { return __atomic_load_n(&statusActive, __ATOMIC_RELAXED); }
+    int32_t getGridW() const { return __atomic_load_n(&statusGridW, __ATOMIC_RELAXED); }
+    uint16_t getOfferDa() const { return __atomic_load_n(&statusOfferDa, __ATOMIC_RELAXED); }
+
+private:
+    void step(float gridW, float dtS, const EvseSnapshot& snap);
+    void offer(float amps);
+    void choosePhases(float gridW, const EvseSnapshot& snap, float voltage);
+
+    struct GridReading {
+        float gridW;
+        unsigned long ms;               // millis() when it arrived
+    };
+
+    EvseCharge& evse;
+
+    // Loop task -> EVSE task
+    SeqMailbox<SolarParams> paramsIn;
+    SeqMailbox<GridReading> readingIn;
+
+    // EVSE task state
+    SolarParams params;
+    unsigned long lastSampleMs = 0;
+    float offerA = 0.0f;
+    float lastErrorA = 0.0f;
+    bool wasDrawing = false;
+    bool stale = true;
+    uint16_t postedDa = 0xFFFF;
+    bool owning = false;                // Solar holds the current limit
+    uint16_t restoreDa = 0;             // Limit in force when solar took it over
+    uint8_t phaseWant = 0;              // Side the surplus is on, 0 = none pending
+    unsigned long phaseWantSinceMs = 0;
+    unsigned long lastPhaseSwitchMs = 0;
+    bool phaseSwitched = false;
+
+    bool statusActive = false;
+    int32_t statusGridW = 0;
+    uint16_t statusOfferDa = 0;
+};
+
+#endif
@@ -58,8 +58,21 @@ struct ChargingSettings {
     // automatically resuming PWM when the current limit is raised above
     // MIN_CURRENT. Default is 5 minutes (300000 ms) to avoid rapid toggling.
     unsigned long lowLimitResumeDelayMs = 300000UL;
+    // Nominal phase voltage (V) used to turn measured phase currents into
+    // power and energy; no voltage is measured on the mains side.
+    uint16_t mainsVoltage = 230;
+    // Slew rates (0.1A per second) between a requested and the applied
+    // current limit; 0 applies changes immediately.
+    uint16_t rampUpDaPerS = 20;
+    uint16_t rampDownDaPerS = 0;
+    // Phases wired to the vehicle (1 or 3); used to estimate charging power
+    // before any current has been measured.
+    uint8_t phases = 3;
 };
 
+// System time below this means the clock was never set (no NTP yet)
+constexpr long CLOCK_VALID_EPOCH = 1700000000L;
+
 
 // Pause behavior mode for EVSE "pause" operations
 // - PAUSE_STATE_A: Force CP to steady +12V (appears as State A if no EV; as B if EV connected); open relay immediately
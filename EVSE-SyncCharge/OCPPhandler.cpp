@@ -14,6 +14,10 @@
 #include "EvseCharge.h"
 #include "Pilot.h"
 #include "EvseLogger.h"
+#include "EvseSessionLog.h"
+#include <time.h>
+
+extern EvseSessionLog sessionLog;
 
 OCPPHandler::OCPPHandler(EvseCharge& evseCharge, Pilot& pilotRef) 
     : evse(evseCharge), pilot(pilotRef) 
@@ -57,6 +61,31 @@ void OCPPHandler::begin() {
 void OCPPHandler::loop() {
     if (enabled) webSocket.loop();
 
+    // Connector status follows EVSE events instead of being polled
+    EvseEventBus& bus = evse.getEventBus();
+    if (eventSub < 0) {
+        eventSub = bus.subscribe("ocpp", evseEventBit(EVSE_EVT_STATE) | evseEventBit(EVSE_EVT_VEHICLE) | evseEventBit(EVSE_EVT_FAULT));
+    }
+    EvseEvent ev;
+    bool statusDirty = false;
+    while (bus.poll(eventSub, ev)) statusDirty = true;
+    if (statusDirty) {
+        EvseSnapshot snap = evse.getSnapshot();
+        ConnectorStatus status = getStatus();
+        String errorCode = snap.rcmTripped ? "GroundFailure" : (snap.pwmFault ? "OtherError" : "");
+        if (status != connector.status || errorCode != connector.errorCode) {
+            // Close the charging period with the final register reading
+            if (connected && connector.status == CHARGING && status != CHARGING) sendMeterValues();
+            connector.status = status;
+            connector.errorCode = errorCode;
+            if (connected) sendStatusNotification();
+        }
+    }
+
+    if (connected && connector.status == CHARGING && millis() - lastMeterValues > meterValueInterval) {
+        sendMeterValues();
+    }
+
     if (connected && millis() - lastHeartbeat > heartbeatInterval) {
         sendHeartbeat();
         lastHeartbeat = millis();
@@ -68,10 +97,10 @@ float OCPPHandler::getCurrentLimit() {
 }
 
 ConnectorStatus OCPPHandler::getStatus() {
-    STATE_T s = evse.getState();
-    if (s == STATE_CHARGING) return CHARGING;
+    EvseSnapshot snap = evse.getSnapshot();
+    if (snap.state == STATE_CHARGING) return CHARGING;
 
-    VEHICLE_STATE_T v = evse.getVehicleState();
+    VEHICLE_STATE_T v = snap.vehicleState;
     if (v != VEHICLE_NOT_CONNECTED && v != VEHICLE_ERROR && v != VEHICLE_NO_POWER) {
         return SUSPENDED;
     }
@@ -96,6 +125,8 @@ void OCPPHandler::wsEvent(WStype_t type, uint8_t* payload, size_t length) {
             logger.info("[OCPP] Connected!");
             connected = true;
             sendBootNotification();
+            connector.status = getStatus();
+            sendStatusNotification();
             break;
         case WStype_TEXT:
             onMessage(String((char*)payload));
@@ -165,7 +196,7 @@ void OCPPHandler::handleSetChargingProfile(const String& messageId, JsonObject p
                 if (periods.size() > 0) {
                     float limit = periods[0]["limit"];
                     connector.currentLimitA = limit;
-                    evse.setCurrentLimit(limit);
+                    evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_OCPP, ampsToDeciamps(limit));
                     evse.signalThrottleAlive();
                     logger.infof("[OCPP] Set limit to %.1f A", limit);
                 }
@@ -178,15 +209,17 @@ void OCPPHandler::handleSetChargingProfile(const String& messageId, JsonObject p
 
 void OCPPHandler::handleRemoteStartTransaction(const String& messageId, JsonObject payload) {
     // In a real scenario, validate idTag here
-    evse.startCharging();
+    const char* idTag = payload["idTag"] | "";
+    sessionLog.setPendingTag(idTag);
+    evse.post(EVSE_CMD_START, EVSE_SRC_OCPP);
     evse.signalThrottleAlive();
-    logger.info("[OCPP] Remote Start");
+    logger.infof("[OCPP] Remote Start (idTag %s)", idTag);
     String msg = sendAccepted(messageId);
     webSocket.sendTXT(msg);
 }
 
 void OCPPHandler::handleRemoteStopTransaction(const String& messageId, JsonObject payload) {
-    evse.stopCharging();
+    evse.post(EVSE_CMD_STOP, EVSE_SRC_OCPP);
     logger.info("[OCPP] Remote Stop");
     String msg = sendAccepted(messageId);
     webSocket.sendTXT(msg);
@@ -207,11 +240,57 @@ void OCPPHandler::sendHeartbeat() {
 }
 
 void OCPPHandler::sendStatusNotification() {
-    // Placeholder
+    static const char* const names[] = { "Available", "Charging", "SuspendedEVSE", "Unavailable" };
+    JsonDocument doc;
+    JsonObject payload = doc.to<JsonObject>();
+    payload["connectorId"] = 1;
+    payload["errorCode"] = connector.errorCode.length() ? connector.errorCode.c_str() : "NoError";
+    payload["status"] = names[connector.status];
+    sendCall("StatusNotification", payload);
 }
 
+// Reads the EVSE snapshot directly so the register matches MQTT and the web UI exactly
 void OCPPHandler::sendMeterValues() {
-    // Placeholder
+    EvseSnapshot snap = evse.getSnapshot();
+    connector.measuredCurrentA = snap.actual.l1 + snap.actual.l2 + snap.actual.l3;
+    connector.measuredVoltageV = (float)snap.mainsVoltage;
+    connector.measuredPowerW = (float)snap.powerW;
+    connector.measuredEnergyWh = (float)(snap.lifetimeMwh / 1000ULL);
+
+    char ts[24];
+    time_t now = time(nullptr);
+    struct tm tmUtc;
+    gmtime_r(&now, &tmUtc);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", &tmUtc);
+
+    JsonDocument doc;
+    JsonObject payload = doc.to<JsonObject>();
+    payload["connectorId"] = 1;
+    JsonObject mv = payload["meterValue"].add<JsonObject>();
+    mv["timestamp"] = ts;
+    JsonArray sv = mv["sampledValue"].to<JsonArray>();
+
+    char buf[24];
+    JsonObject e = sv.add<JsonObject>();
+    snprintf(buf, sizeof(buf), "%llu", snap.lifetimeMwh / 1000ULL);
+    e["value"] = buf;
+    e["measurand"] = "Energy.Active.Import.Register";
+    e["unit"] = "Wh";
+
+    JsonObject p = sv.add<JsonObject>();
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)snap.powerW);
+    p["value"] = buf;
+    p["measurand"] = "Power.Active.Import";
+    p["unit"] = "W";
+
+    JsonObject c = sv.add<JsonObject>();
+    snprintf(buf, sizeof(buf), "%.1f", connector.measuredCurrentA);
+    c["value"] = buf;
+    c["measurand"] = "Current.Import";
+    c["unit"] = "A";
+
+    sendCall("MeterValues", payload);
+    lastMeterValues = millis();
 }
 
 void OCPPHandler::sendCall(const char* action, JsonObject& payload) {
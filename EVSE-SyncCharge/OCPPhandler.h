@@ -65,7 +65,10 @@ private:
 
     unsigned long lastHeartbeat = 0;
     unsigned long heartbeatInterval = 60000; // 60 seconds
+    unsigned long lastMeterValues = 0;
+    unsigned long meterValueInterval = 60000; // MeterValues while charging
     bool connected = false;
+    int eventSub = -1;              // EvseEventBus subscription (state/vehicle/fault)
     uint32_t messageCounter = 0;  // Incrementing counter for unique message IDs
     String bootNotificationMsgId;
 
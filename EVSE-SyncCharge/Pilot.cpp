@@ -13,12 +13,15 @@
 #include <Arduino.h>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
 #include <esp32-hal-ledc.h>
 #include <limits.h> // Added for INT_MAX
+#include <esp_timer.h>
 
 
 #include "EvseLogger.h"
 #include "Pilot.h"
+#include "Rcm.h"
 
 // Constructor - Clean and empty because variables are initialized in the header
 Pilot::Pilot() 
@@ -28,6 +31,7 @@ Pilot::Pilot()
     // Use MALLOC_CAP_INTERNAL to ensure DMA-capable memory (SRAM), avoiding PSRAM crashes on S3.
     _dma_buffer = (uint8_t*)heap_caps_malloc(ADC_READ_BYTE_LEN, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
 #endif
+    resetDebounceDwell();
 }
 
 Pilot::~Pilot()
@@ -38,6 +42,10 @@ Pilot::~Pilot()
         _dma_buffer = nullptr;
     }
 #endif
+    if (_capRing) {
+        heap_caps_free(_capRing);
+        _capRing = nullptr;
+    }
 }
 
 void Pilot::begin()
@@ -58,7 +66,7 @@ void Pilot::begin()
     #if USE_CONTINUAL_AD_READS
         // 1. Setup DMA Handle
         adc_continuous_handle_cfg_t adc_config = {
-            .max_store_buf_size = ADC_READ_BYTE_LEN * 4, // Must be a multiple of conv_frame_size
+            .max_store_buf_size = ADC_READ_BYTE_LEN * ADC_POOL_FRAMES, // Must be a multiple of conv_frame_size
             .conv_frame_size = ADC_READ_BYTE_LEN ,
         };
         if (adc_continuous_new_handle(&adc_config, &_continuous_handle) != ESP_OK) {
@@ -66,36 +74,33 @@ void Pilot::begin()
             return;
         }
 
-        // 2. Configure 20kHz background sampling
-        adc_continuous_config_t dig_cfg = {
-            .sample_freq_hz = ADC_SAMPLE_RATE_HZ, 
-            .conv_mode = ADC_CONV_MODE,
-            .format = ADC_OUTPUT_TYPE,
-        };
-
-        adc_digi_pattern_config_t adc_pattern = {
-            .atten = ADC_ATTEN_DB_12,
-            .channel = (uint8_t)_adc_channel,
-            .unit = ADC_UNIT_1,
-            .bit_width = ADC_BITWIDTH_12,
-        };
-
-        dig_cfg.pattern_num = 1;
-        dig_cfg.adc_pattern = &adc_pattern;
-        
-        if (adc_continuous_config(_continuous_handle, &dig_cfg) != ESP_OK) {
+        // 2. One shared pattern: pilot plus the fitted aux channels, full-rate profile
+        _ppChannel = auxChannel(PIN_PP_IN, "PP");
+        _ntcChannel = auxChannel(PIN_NTC_IN, "NTC");
+        if (!configureDma(ADC_SAMPLE_RATE_HZ)) {
             logger.error("[PILOT] Failed to configure ADC");
             adc_continuous_deinit(_continuous_handle);
             _continuous_handle = nullptr;
             return;
         }
+
+        // 3. Frame-done callback wakes the EVSE task (must be registered before start)
+        adc_continuous_evt_cbs_t cbs = {
+            .on_conv_done = onConvDone,
+            .on_pool_ovf = onPoolOverflow,
+        };
+        if (adc_continuous_register_event_callbacks(_continuous_handle, &cbs, this) != ESP_OK) {
+            logger.warn("[PILOT] Failed to register ADC frame callback (falling back to polling)");
+        }
+
         if (adc_continuous_start(_continuous_handle) != ESP_OK) {
             logger.error("[PILOT] Failed to start ADC");
             adc_continuous_deinit(_continuous_handle);
             _continuous_handle = nullptr;
             return;
         }
-        logger.info("[PILOT] DMA Continuous ADC Started (40kHz)");
+        logger.infof("[PILOT] DMA Continuous ADC Started (pilot %lu Hz, conversion %lu Hz)",
+                     (unsigned long)_pilotRateHz, (unsigned long)_convRateHz);
 
     #else
         // Legacy Oneshot Setup
@@ -122,12 +127,37 @@ void Pilot::begin()
     };
     adc_cali_create_scheme_curve_fitting(&cali_config, &cali_handle);
     #endif
+
+    buildMvTable();
 #endif
     logger.info("[PILOT] ADC and PWM Pins configured");
 }
 
+#if RAW_AD_USE
+// Precompute calibration + divider conversion for every raw code, so read() only does
+// integer table lookups on the safety task.
+void Pilot::buildMvTable()
+{
+    for (int raw = 0; raw < ADC_RAW_CODES; raw++) {
+        int adMv = raw;
+        if (cali_handle) {
+            adc_cali_raw_to_voltage(cali_handle, raw, &adMv);
+        }
+        float mv = convertMv(adMv);
+        if (mv > INT16_MAX) mv = INT16_MAX;
+        if (mv < INT16_MIN) mv = INT16_MIN;
+        _rawToMv[raw] = (int16_t)mv;
+    }
+    logger.infof("[PILOT] Raw->mV table built (%s): raw 0=%dmV, raw %d=%dmV", cali_handle ? "calibrated" : "uncalibrated",
+                 _rawToMv[0], ADC_RAW_CODES - 1, _rawToMv[ADC_RAW_CODES - 1]);
+}
+#endif
+
 void Pilot::standby()
 {
+    // Drop any queued duty change: standby always wins
+    __atomic_store_n(&_pendingDuty, PILOT_DUTY_NONE, __ATOMIC_RELEASE);
+
     // Pre-set GPIO to HIGH to prevent glitch to 0V (VEHICLE_NO_POWER) during detach
     digitalWrite(PIN_PILOT_PWM_OUT, HIGH);
     pinMode(PIN_PILOT_PWM_OUT, OUTPUT);
@@ -136,6 +166,7 @@ void Pilot::standby()
         logger.info("[PILOT] Detaching PWM for Standby (Static HIGH)");
         pwmAttached = false;
         ledcDetach(PIN_PILOT_PWM_OUT);
+        _measDiscard = true;
     }    
 }
 
@@ -159,33 +190,106 @@ void Pilot::stop()
 
 void Pilot::currentLimit(float amps)
 {
-    float dutyPercent = ampsToDuty(amps);
+    currentLimitDa(ampsToDeciamps(amps));
+}
 
-    // Prevent log flooding: only update if value changed or PWM was off
-    if (pwmAttached && fabs(currentDutyPercent - dutyPercent) < 0.05f) {
+void Pilot::currentLimitDa(uint16_t deciamps)
+{
+    uint16_t dutyCounts = J1772_DUTY_TABLE.lookup(deciamps);
+    uint32_t request = ((uint32_t)deciamps << 16) | dutyCounts;
+
+    // The state machine re-applies the limit every loop: ignore what is already queued or active
+    uint32_t pending = __atomic_load_n(&_pendingDuty, __ATOMIC_ACQUIRE);
+    if (pending == request) return;
+    if (pending == PILOT_DUTY_NONE && pwmAttached && dutyCounts == _dutyCounts) return;
+
+    uint32_t replaced = __atomic_exchange_n(&_pendingDuty, request, __ATOMIC_ACQ_REL);
+    if (replaced != PILOT_DUTY_NONE) __atomic_fetch_add(&_dutyCoalesced, 1, __ATOMIC_RELAXED);   // Any task may call this
+}
+
+void Pilot::applyPendingDuty()
+{
+    if (__atomic_load_n(&_pendingDuty, __ATOMIC_ACQUIRE) == PILOT_DUTY_NONE) return;
+
+    // The RCM ISR took the pin from the LEDC: neither re-attach it nor re-arm a duty that
+    // any task may have queued since. Dropped like standby() drops it.
+    if (Rcm::isLatched()) {
+        if (__atomic_exchange_n(&_pendingDuty, PILOT_DUTY_NONE, __ATOMIC_ACQ_REL) != PILOT_DUTY_NONE) {
+            logger.warn("[PILOT] PWM refused: RCM trip latched");
+        }
         return;
     }
 
-    currentDutyPercent = dutyPercent;
+    // At most one hardware update per PWM period
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+    if (pwmAttached && (nowUs - _dutyWriteUs) < PILOT_PWM_PERIOD_US) return;
+
+    uint32_t request = __atomic_exchange_n(&_pendingDuty, PILOT_DUTY_NONE, __ATOMIC_ACQ_REL);
+    if (request == PILOT_DUTY_NONE) return;
+
+    uint16_t deciamps = (uint16_t)(request >> 16);
+    uint16_t dutyCounts = (uint16_t)(request & 0xFFFF);
+    if (pwmAttached && dutyCounts == _dutyCounts) return;
 
-    uint32_t dutyCounts = (uint32_t)roundf((dutyPercent / 100.0f) * PILOT_PWM_MAX_DUTY);
+    _dutyCounts = dutyCounts;
+    _dutyDeciamps = deciamps;
+    _measDiscard = true;
 
     if(!pwmAttached) {
-        logger.infof("[PILOT] PWM Enabled: %.2f A (Duty: %.1f%%)", amps, dutyPercent);
+        logger.infof("[PILOT] PWM Enabled: %u.%u A (Duty: %u/%d)", deciamps / 10, deciamps % 10, dutyCounts, PILOT_PWM_MAX_DUTY);
         ledcAttach(PIN_PILOT_PWM_OUT, PILOT_PWM_FREQ, PILOT_PWM_RESOLUTION);
         pwmAttached = true;
     } else {
-        logger.infof("[PILOT] PWM Adjusted: %.2f A (Duty: %.1f%%)", amps, dutyPercent);
+        logger.infof("[PILOT] PWM Adjusted: %u.%u A (Duty: %u/%d)", deciamps / 10, deciamps % 10, dutyCounts, PILOT_PWM_MAX_DUTY);
     }
+    // Latched by the LEDC at the next counter overflow (period boundary)
     ledcWrite(PIN_PILOT_PWM_OUT, dutyCounts);
+    _dutyWriteUs = nowUs;
+    _dutyUpdates++;
 }
 
 
 
+/* =========================
+ * Plateau Estimation
+ * ========================= */
+int PilotHistogram::high(int trim) const
+{
+    if (total == 0) return 0;
+    if (trim > (total - 1) / 2) trim = (total - 1) / 2;
+    int acc = 0;
+    for (int bin = PILOT_HIST_BINS - 1; bin >= 0; bin--) {
+        acc += count[bin];
+        if (acc > trim) return (int)(sum[bin] / count[bin]);
+    }
+    return 0;
+}
+
+int PilotHistogram::low(int trim) const
+{
+    if (total == 0) return 0;
+    if (trim > (total - 1) / 2) trim = (total - 1) / 2;
+    int acc = 0;
+    for (int bin = 0; bin < PILOT_HIST_BINS; bin++) {
+        acc += count[bin];
+        if (acc > trim) return (int)(sum[bin] / count[bin]);
+    }
+    return 0;
+}
+
 VEHICLE_STATE_T Pilot::read() {
     int highRaw = 0;
-    int lowRaw = INT_MAX;
+    int lowRaw = 0;
     int counts_ = 0;
+    // PWM, capture and duty changes need the full-rate profile
+    if (_watchProfile && (pwmAttached || _capActive ||
+                          __atomic_load_n(&_pendingDuty, __ATOMIC_ACQUIRE) != PILOT_DUTY_NONE)) {
+        setWatchProfile(false);
+    }
+    applyPendingDuty();     // Frame boundary: hand queued duty changes to the LEDC
+    _hist.reset();
+    _ppStats.reset();
+    _ntcStats.reset();
 #if USE_CONTINUAL_AD_READS && RAW_AD_USE
     if (!_dma_buffer) return lastVehicleState; // Safety check if allocation failed
     if (!_continuous_handle) return lastVehicleState; // Safety check if driver init failed
@@ -203,20 +307,43 @@ VEHICLE_STATE_T Pilot::read() {
             break;
         }
 
-        for (int i = 0; i < ret_num; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        PilotCaptureFrame* cap = captureSlot();
+        int capCount = 0;
+
+        for (uint32_t i = 0; i < ret_num; i += SOC_ADC_DIGI_RESULT_BYTES) {
             adc_digi_output_data_t *p = (adc_digi_output_data_t*)&_dma_buffer[i];
             #if CONFIG_IDF_TARGET_ESP32
             int val = p->type1.data;
+            int ch = p->type1.channel;
             #endif 
             #if CONFIG_IDF_TARGET_ESP32S3
             int val = p->type2.data;
+            int ch = p->type2.channel;
             #endif
-            if (val > highRaw) highRaw = val;
-            if (val < lowRaw)  lowRaw = val;
+            // Demultiplex the shared pattern
+            if (ch != (int)_adc_channel) {
+                if (ch == _ppChannel) _ppStats.add(val);
+                else if (ch == _ntcChannel) _ntcStats.add(val);
+                continue;
+            }
+            _hist.add(val);
+            trackEdge(val);
+            if (cap) cap->raw[capCount++] = (uint16_t)val;
             counts_++;
         }
+
+        if (cap) captureCommit(cap, capCount);
+    }
+
+    if (_capActive && (millis() - _capStartMs) >= _capDurationMs) {
+        _capActive = false;
+        logger.infof("[PILOT] Capture finished (%lu frames, %lu dropped)",
+                     (unsigned long)_capSeq, (unsigned long)_capDropped);
     }
 
+    if (_ppStats.count)  _ppMv = rawToAdcMv(_ppStats.mean());
+    if (_ntcStats.count) _ntcMv = rawToAdcMv(_ntcStats.mean());
+
     if (counts_ == 0) 
     {
         return lastVehicleState;
@@ -232,29 +359,57 @@ VEHICLE_STATE_T Pilot::read() {
         #else
             val = analogReadMilliVolts(PIN_PILOT_IN);
         #endif
-        if (val > highRaw) highRaw = val;
-        if (val < lowRaw)  lowRaw = val;
+        _hist.add(val);
         counts_++;
     }
     //logger.debugf("[PILOT] - MAN #samples : %d", counts_);
 #endif
 
+    // 1. Robust plateau estimate (trimmed histogram instead of absolute min/max)
+    int trim = counts_ / PILOT_PLATEAU_TRIM_DIV;
+    int trimHigh = trim;
+    int trimLow = trim;
+    if (pwmAttached) {
+        int highSamples = (int)((uint32_t)counts_ * _dutyCounts / PILOT_PWM_MAX_DUTY);
+        // Sampling is locked to the PWM, so edge ringing lands at the same phase in every
+        // period: trim one overshoot sample per period off the top while half stays
+        int periods = (counts_ + PILOT_SAMPLES_PER_PERIOD - 1) / PILOT_SAMPLES_PER_PERIOD;
+        trimHigh = std::max(std::min(trim, highSamples / PILOT_PLATEAU_KEEP_DIV), std::min(periods, highSamples / 2));
+        trimLow  = std::min(trim, (counts_ - highSamples) / PILOT_PLATEAU_KEEP_DIV);
+    }
+    highRaw = _hist.high(trimHigh);
+    lowRaw  = _hist.low(trimLow);
 
-    // Calibration
-#if RAW_AD_USE
-    if (cali_handle) {
-        int tHigh, tLow;
-        adc_cali_raw_to_voltage(cali_handle, highRaw, &tHigh);
-        adc_cali_raw_to_voltage(cali_handle, lowRaw, &tLow);
-        highRaw = tHigh;
-        lowRaw = tLow;
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+    // Re-arm the edge detector on the current plateaus (used from the next frame on)
+    if (highRaw - lowRaw >= PILOT_EDGE_MIN_SWING_RAW) {
+        if (_edgeThresholdRaw == 0) _measDiscard = true; // First edge after arming is not a real edge
+        _edgeThresholdRaw = (highRaw + lowRaw) / 2;
+        _edgeHystRaw = (highRaw - lowRaw) / 8;
+    } else {
+        _edgeThresholdRaw = 0;
+    }
+    if (_edgeSampleIdx >= (PILOT_MEAS_WINDOW_MS * ADC_SAMPLE_RATE_HZ) / 1000) {
+        finishMeasurementWindow();
     }
 #endif
+
+
     //logger.debugf("[PILOT] - samples - HI %d , LOW: %d", highRaw, lowRaw);
     
-    // 2. Conversion
+    // 2. Calibration + Conversion
+#if RAW_AD_USE
+    highVoltageMv = _rawToMv[highRaw & (ADC_RAW_CODES - 1)];
+    lowVoltageMv  = _rawToMv[lowRaw & (ADC_RAW_CODES - 1)];
+#else
     highVoltageMv = (int)convertMv(highRaw);
     lowVoltageMv  = (int)convertMv(lowRaw);
+#endif
+
+    // Plateau left the State A band: back to full rate for the next frame
+    if (_watchProfile && highVoltageMv < VOLTAGE_STATE_NOT_CONNECTED) {
+        setWatchProfile(false);
+    }
 
     // 3. Temporary state determination
     VEHICLE_STATE_T detectedState;
@@ -271,34 +426,455 @@ VEHICLE_STATE_T Pilot::read() {
         }
     }
 
-    // 4. "Best of 3" Debouncing
-    // We only update lastVehicleState if we see the same detectedState multiple times
-    static VEHICLE_STATE_T candidateState = VEHICLE_ERROR;
-    static int stabilityCounter = 0;
-
-    if (detectedState == candidateState) {
-        stabilityCounter++;
-    } else {
-        candidateState = detectedState;
-        stabilityCounter = 0;
+    // 4. Debouncing (time based, per transition)
+    // The candidate must be seen continuously for the dwell of lastVehicleState -> candidate
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+    uint32_t nowUs = _frameReadyUs;     // Time the newest drained frame completed (ISR stamp)
+#else
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+#endif
+    if (detectedState != _candidateState) {
+        _candidateState = detectedState;
+        _candidateSinceUs = nowUs;
     }
 
-    // Only commit to the change if it has been stable for 3 checks
-    if (stabilityCounter >= 3 && candidateState != lastVehicleState) {
-        lastVehicleState = candidateState;
+    if (_candidateState != lastVehicleState &&
+        (nowUs - _candidateSinceUs) >= _dwellUs[lastVehicleState][_candidateState]) {
+        lastVehicleState = _candidateState;
         
         char stateBuf[50];
         vehicleStateToText(lastVehicleState, stateBuf);
-        logger.debugf("[PILOT] Stable Change: %s (H:%dmV L:%dmV)", 
-                      stateBuf, highVoltageMv, lowVoltageMv);
+        logger.debugf("[PILOT] Stable Change: %s after %lu us (H:%dmV L:%dmV)", 
+                      stateBuf, (unsigned long)(nowUs - _candidateSinceUs), highVoltageMv, lowVoltageMv);
     }
 
+    updateSampleProfile();
+
     return lastVehicleState;
 }
 
+/* =========================
+ * Event-driven frame handling
+ * ========================= */
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+bool IRAM_ATTR Pilot::onConvDone(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    Pilot* self = (Pilot*)user_data;
+    self->_frameReadyUs = (uint32_t)esp_timer_get_time();
+    self->_frameCount = self->_frameCount + 1;
+
+    // Watch profile: one wakeup per batch; read() drains the whole batch
+    uint32_t pending = self->_framesSinceWake + 1;
+    if (pending < self->_framesPerWake) {
+        self->_framesSinceWake = pending;
+        return false;
+    }
+    self->_framesSinceWake = 0;
+
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    TaskHandle_t task = self->_frameTask;
+    if (task != nullptr) {
+        self->_frameNotified = true;
+        vTaskNotifyGiveFromISR(task, &xHigherPriorityTaskWoken);
+    }
+    return xHigherPriorityTaskWoken == pdTRUE;
+}
+
+bool IRAM_ATTR Pilot::onPoolOverflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    Pilot* self = (Pilot*)user_data;
+    self->_poolOverflows = self->_poolOverflows + 1;
+    return false;
+}
+#endif
+
+void Pilot::attachFrameTask(TaskHandle_t task)
+{
+    _frameTask = task;
+}
+
+bool Pilot::waitForFrame(uint32_t timeoutMs)
+{
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+    if (_continuous_handle && _frameTask) {
+        bool notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+        bool frame = __atomic_exchange_n(&_frameNotified, false, __ATOMIC_ACQ_REL);
+        if (frame) _frameWakeups++;
+        else if (!notified) _frameTimeouts++;
+        return frame;
+    }
+#endif
+    // No DMA notification available: fall back to a fixed poll of one frame period
+    vTaskDelay(pdMS_TO_TICKS(3));
+    return false;
+}
+
+uint32_t Pilot::getFrameTimeoutMs() const
+{
+    return (_wakePeriodUs + 999) / 1000 + PILOT_FRAME_TIMEOUT_MS;
+}
+
+void Pilot::frameProcessed()
+{
+    uint32_t latency = (uint32_t)esp_timer_get_time() - _frameReadyUs;
+    _frameLatencyUs = latency;
+    if (latency > _frameLatencyMaxUs) _frameLatencyMaxUs = latency;
+    // Exponential moving average (1/16 weight), integer only
+    _frameLatencyAvgUs = _frameLatencyAvgUs - (_frameLatencyAvgUs >> 4) + (latency >> 4);
+}
+
+/* =========================
+ * DMA Pattern / Sample Profiles
+ * ========================= */
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+// Driver must be stopped (or not yet started). Pilot gets every slot but one per aux channel;
+// the conversion rate is raised so the pilot itself is sampled at pilotRateHz.
+bool Pilot::configureDma(uint32_t pilotRateHz)
+{
+    int auxCount = (_ppChannel >= 0) + (_ntcChannel >= 0);
+    int patternLen = auxCount ? ADC_PATTERN_LEN : 1;
+
+    adc_digi_pattern_config_t adc_pattern[ADC_PATTERN_LEN];
+    for (int i = 0; i < patternLen; i++) {
+        adc_pattern[i].atten = ADC_ATTEN_DB_12;
+        adc_pattern[i].channel = (uint8_t)_adc_channel;
+        adc_pattern[i].unit = ADC_UNIT_1;
+        adc_pattern[i].bit_width = ADC_BITWIDTH_12;
+    }
+    int slot = patternLen;
+    if (_ppChannel >= 0)  adc_pattern[--slot].channel = (uint8_t)_ppChannel;
+    if (_ntcChannel >= 0) adc_pattern[--slot].channel = (uint8_t)_ntcChannel;
+
+    uint32_t convRate = pilotRateHz * patternLen / (patternLen - auxCount);
+
+    adc_continuous_config_t dig_cfg = {
+        .sample_freq_hz = convRate, 
+        .conv_mode = ADC_CONV_MODE,
+        .format = ADC_OUTPUT_TYPE,
+    };
+    dig_cfg.pattern_num = patternLen;
+    dig_cfg.adc_pattern = adc_pattern;
+
+    if (adc_continuous_config(_continuous_handle, &dig_cfg) != ESP_OK) return false;
+    _pilotRateHz = pilotRateHz;
+    _convRateHz = convRate;
+
+    // Below full rate the task only needs a wakeup every PILOT_WATCH_WAKE_MS
+    uint32_t frameUs = (uint32_t)((uint64_t)(ADC_READ_BYTE_LEN / SOC_ADC_DIGI_RESULT_BYTES) * 1000000ULL / convRate);
+    uint32_t batch = 1;
+    if (pilotRateHz < ADC_SAMPLE_RATE_HZ && frameUs < PILOT_WATCH_WAKE_MS * 1000UL) {
+        batch = (PILOT_WATCH_WAKE_MS * 1000UL) / frameUs;
+    }
+    _framesPerWake = batch;
+    _framesSinceWake = 0;
+    _wakePeriodUs = frameUs * batch;
+    return true;
+}
+#endif
+
+// Runs in the EVSE task only (same context as read()), so the driver is never read mid-switch
+void Pilot::setWatchProfile(bool watch)
+{
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+    if (watch == _watchProfile || !_continuous_handle) return;
+
+    adc_continuous_stop(_continuous_handle);
+    if (!configureDma(watch ? ADC_WATCH_RATE_HZ : ADC_SAMPLE_RATE_HZ)) {
+        logger.error("[PILOT] Sample profile switch failed, staying at full rate");
+        configureDma(ADC_SAMPLE_RATE_HZ);
+        watch = false;
+    }
+    adc_continuous_start(_continuous_handle);
+
+    _watchProfile = watch;
+    _watchCandidateMs = 0;
+    _measDiscard = true;        // Window timing assumes one rate
+    _profileSwitches++;
+    logger.debugf("[PILOT] ADC profile: %s (pilot %lu Hz)", watch ? "WATCH" : "FULL", (unsigned long)_pilotRateHz);
+#endif
+}
+
+// State A with a static pilot: drop to the presence-watch rate once that has held for a while
+void Pilot::updateSampleProfile()
+{
+    if (!PILOT_ADAPTIVE_RATE || _watchProfile) return;
+
+    bool idle = lastVehicleState == VEHICLE_NOT_CONNECTED && !pwmAttached && !_capActive &&
+                __atomic_load_n(&_pendingDuty, __ATOMIC_ACQUIRE) == PILOT_DUTY_NONE;
+    if (!idle) {
+        _watchCandidateMs = 0;
+        return;
+    }
+    unsigned long now = millis();
+    if (_watchCandidateMs == 0) {
+        _watchCandidateMs = now ? now : 1;
+    } else if (now - _watchCandidateMs >= PILOT_WATCH_ENTER_MS) {
+        setWatchProfile(true);
+    }
+}
+
+/* =========================
+ * Auxiliary Analog Inputs
+ * ========================= */
+int Pilot::auxChannel(int pin, const char* name)
+{
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+    if (pin < 0) return -1;
+    adc_unit_t unit;
+    adc_channel_t channel;
+    if (adc_continuous_io_to_channel(pin, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1 ||
+        channel == _adc_channel) {
+        logger.errorf("[PILOT] %s input GPIO %d is not a free ADC1 channel - disabled", name, pin);
+        return -1;
+    }
+    logger.infof("[PILOT] %s input on GPIO %d (ADC1 CH%d)", name, pin, (int)channel);
+    return (int)channel;
+#else
+    return -1;
+#endif
+}
+
+int Pilot::rawToAdcMv(int raw)
+{
+#if RAW_AD_USE
+    int mv = 0;
+    if (raw < 0) return -1;
+    if (cali_handle) {
+        adc_cali_raw_to_voltage(cali_handle, raw, &mv);
+    } else {
+        mv = raw * ADC_VREF_MV / (ADC_RAW_CODES - 1);
+    }
+    return mv;
+#else
+    return -1;
+#endif
+}
+
+// Divider with the sensor to GND: R = Rpullup * V / (Vref - V)
+static int dividerOhms(int mv, int pullupOhms)
+{
+    if (mv < 0 || mv >= ADC_VREF_MV - 20) return -1;   // No data / open
+    return (int)((uint32_t)pullupOhms * (uint32_t)mv / (uint32_t)(ADC_VREF_MV - mv));
+}
+
+int Pilot::getProximityOhms() const
+{
+    if (_ppChannel < 0) return -1;
+    return dividerOhms(_ppMv, PP_PULLUP_OHMS);
+}
+
+uint16_t Pilot::getCableRatingDa() const
+{
+    if (_ppChannel < 0) return PP_RATING_NOT_FITTED;
+    int ohms = getProximityOhms();
+    if (ohms < 0) return 0;
+    for (const ProximityRange& r : PP_RANGES) {
+        if (ohms >= r.minOhms && ohms <= r.maxOhms) return r.deciamps;
+    }
+    return 0;
+}
+
+float Pilot::getConnectorTemperature() const
+{
+    if (_ntcChannel < 0) return NAN;
+    int ohms = dividerOhms(_ntcMv, NTC_PULLUP_OHMS);
+    if (ohms <= 0) return NAN;
+    // Beta equation, T0 = 25C
+    float invT = 1.0f / 298.15f + logf((float)ohms / (float)NTC_R25_OHMS) / (float)NTC_BETA;
+    return 1.0f / invT - 273.15f;
+}
+
+/* =========================
+ * Debounce Configuration
+ * ========================= */
+void Pilot::setDebounceDwell(VEHICLE_STATE_T from, VEHICLE_STATE_T to, uint32_t ms)
+{
+    if (from >= VEHICLE_STATE_COUNT || to >= VEHICLE_STATE_COUNT) return;
+    _dwellUs[from][to] = ms * 1000UL;
+}
+
+uint32_t Pilot::getDebounceDwell(VEHICLE_STATE_T from, VEHICLE_STATE_T to) const
+{
+    if (from >= VEHICLE_STATE_COUNT || to >= VEHICLE_STATE_COUNT) return 0;
+    return _dwellUs[from][to] / 1000UL;
+}
+
+void Pilot::resetDebounceDwell()
+{
+    for (int from = 0; from < VEHICLE_STATE_COUNT; from++) {
+        for (int to = 0; to < VEHICLE_STATE_COUNT; to++) {
+            _dwellUs[from][to] = pilotDefaultDwellMs((VEHICLE_STATE_T)from, (VEHICLE_STATE_T)to) * 1000UL;
+        }
+    }
+}
+
+/* =========================
+ * Waveform Capture
+ * ========================= */
+bool Pilot::startCapture(uint32_t durationMs)
+{
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+    static_assert(ADC_SAMPLES_COUNT <= PILOT_CAPTURE_FRAME_SAMPLES, "capture slot smaller than a DMA frame");
+
+    if (_capActive) return true;
+    if (!_continuous_handle) return false;
+
+    if (!_capRing) {
+        // Allocated once and kept: capturing must not fragment the heap or allocate per frame
+        size_t bytes = sizeof(PilotCaptureFrame) * PILOT_CAPTURE_SLOTS;
+        _capRing = (PilotCaptureFrame*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!_capRing) _capRing = (PilotCaptureFrame*)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+        if (!_capRing) {
+            logger.errorf("[PILOT] Capture buffer allocation failed (%u bytes)", (unsigned)bytes);
+            return false;
+        }
+    }
+
+    if (durationMs == 0) durationMs = PILOT_CAPTURE_DEFAULT_MS;
+    if (durationMs > PILOT_CAPTURE_MAX_MS) durationMs = PILOT_CAPTURE_MAX_MS;
+
+    // The producer is idle here, so the consumer may discard whatever is left in the ring
+    _capTail = _capHead;
+    _capSeq = 0;
+    _capDropped = 0;
+    _capDurationMs = durationMs;
+    _capStartMs = millis();
+    _capActive = true;
+    logger.infof("[PILOT] Capture started (%lu ms)", (unsigned long)durationMs);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Pilot::stopCapture()
+{
+    if (_capActive) {
+        _capActive = false;
+        logger.info("[PILOT] Capture stopped");
+    }
+}
+
+const PilotCaptureFrame* Pilot::peekCaptureFrame() const
+{
+    if (!_capRing || _capTail == _capHead) return nullptr;
+    return &_capRing[_capTail % PILOT_CAPTURE_SLOTS];
+}
+
+void Pilot::releaseCaptureFrame()
+{
+    if (_capTail != _capHead) _capTail = _capTail + 1;
+}
+
+int Pilot::rawToMv(int raw) const
+{
+#if RAW_AD_USE
+    return _rawToMv[raw & (ADC_RAW_CODES - 1)];
+#else
+    return 0;
+#endif
+}
+
+inline PilotCaptureFrame* Pilot::captureSlot()
+{
+    if (!_capActive || _watchProfile) return nullptr;
+    uint32_t head = _capHead;
+    if (head - _capTail >= (uint32_t)PILOT_CAPTURE_SLOTS) {
+        // Consumer is behind: drop rather than stall the safety loop
+        _capSeq++;
+        _capDropped++;
+        return nullptr;
+    }
+    return &_capRing[head % PILOT_CAPTURE_SLOTS];
+}
+
+inline void Pilot::captureCommit(PilotCaptureFrame* frame, int samples)
+{
+    frame->seq = _capSeq++;
+    frame->samples = (uint16_t)samples;
+    frame->dropped = (uint16_t)(_capDropped > 0xFFFF ? 0xFFFF : _capDropped);
+    __sync_synchronize(); // Slot contents must be visible before the index moves
+    _capHead = _capHead + 1;
+}
+
+/* =========================
+ * PWM Verification
+ * ========================= */
+inline void Pilot::trackEdge(int raw)
+{
+    uint32_t idx = _edgeSampleIdx++;
+    if (_edgeThresholdRaw == 0) return;
+
+    if (!_edgeHigh && raw > _edgeThresholdRaw + _edgeHystRaw) {
+        _edgeHigh = true;
+        if (_firstRiseIdx < 0) {
+            _firstRiseIdx = (int32_t)idx;
+            _highCount = 0;
+        } else {
+            _lastRiseIdx = idx;
+            _highAtLastRise = _highCount;
+        }
+        _riseCount++;
+    } else if (_edgeHigh && raw < _edgeThresholdRaw - _edgeHystRaw) {
+        _edgeHigh = false;
+    }
+
+    if (_firstRiseIdx >= 0 && _edgeHigh) _highCount++;
+}
+
+void Pilot::finishMeasurementWindow()
+{
+    bool valid = !_measDiscard && (_poolOverflows == _windowOverflowMark);
+
+    if (valid) {
+        if (_riseCount >= 2) {
+            uint32_t span = _lastRiseIdx - (uint32_t)_firstRiseIdx;
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+            _measuredFreq = (float)(_riseCount - 1) * ADC_SAMPLE_RATE_HZ / (float)span;
+#endif
+            _measuredDuty = 100.0f * (float)_highAtLastRise / (float)span;
+        } else {
+            // Static level: +12V (standby) reads as 100%, anything at/below 0V as 0%
+            _measuredFreq = 0.0f;
+            _measuredDuty = (highVoltageMv > 0) ? 100.0f : 0.0f;
+        }
+
+        // Compare against what we command. Only meaningful while the pilot is loaded by
+        // a valid state (A-D); E/F have no swing by definition and are handled in read().
+        if (lastVehicleState == VEHICLE_NOT_CONNECTED || lastVehicleState == VEHICLE_CONNECTED ||
+            lastVehicleState == VEHICLE_READY || lastVehicleState == VEHICLE_READY_VENTILATION_REQUIRED) {
+            float expectedDuty = pwmAttached ? getPwmDuty() : 100.0f;
+            float expectedFreq = pwmAttached ? (float)PILOT_PWM_FREQ : 0.0f;
+            bool mismatch = fabsf(_measuredDuty - expectedDuty) > PILOT_DUTY_TOLERANCE ||
+                            fabsf(_measuredFreq - expectedFreq) > PILOT_FREQ_TOLERANCE_HZ;
+            if (mismatch) {
+                if (++_pwmMismatchCount >= PILOT_PWM_FAULT_WINDOWS && !_pwmFault) {
+                    _pwmFault = true;
+                    logger.errorf("[PILOT] PWM mismatch: commanded %.1f%% @ %.0fHz, measured %.1f%% @ %.0fHz",
+                                  expectedDuty, expectedFreq, _measuredDuty, _measuredFreq);
+                }
+            } else {
+                if (_pwmFault) logger.info("[PILOT] PWM verification OK again");
+                _pwmMismatchCount = 0;
+                _pwmFault = false;
+            }
+        }
+    }
+
+    // Start a new window
+    _edgeSampleIdx = 0;
+    _firstRiseIdx = -1;
+    _lastRiseIdx = 0;
+    _riseCount = 0;
+    _highCount = 0;
+    _highAtLastRise = 0;
+    _windowOverflowMark = _poolOverflows;
+    _measDiscard = false;
+}
+
 /* API & Helper Methods */
 float Pilot::getVoltage() { return (float)highVoltageMv / 1000.0f; }
-float Pilot::getPwmDuty() { return currentDutyPercent; }
+float Pilot::getPwmDuty() { return (float)_dutyCounts * 100.0f / (float)PILOT_PWM_MAX_DUTY; }
 float Pilot::convertMv(int adMv) {
     return ((float)adMv - ZERO_OFFSET_MV) * SCALE;
 }
@@ -30,6 +30,16 @@ const float SCALE = 6.90f;           // mV_out per mV_in
 constexpr float MIN_CURRENT = 6.0f;
 constexpr float MAX_CURRENT = 80.0f;
 
+// Same limits in fixed-point deciamps (0.1A), used on the integer PWM path
+constexpr uint16_t MIN_CURRENT_DA = 60;
+constexpr uint16_t MAX_CURRENT_DA = 800;
+
+inline uint16_t ampsToDeciamps(float amps) {
+    if (amps <= 0.0f) return 0;
+    if (amps >= 6553.0f) return 65530;
+    return (uint16_t)(amps * 10.0f + 0.5f);
+}
+
 // J1772 PWM Conversion Constants
 constexpr float J1772_LOW_RANGE_MAX_AMPS   = 51.0f;
 constexpr float J1772_LOW_RANGE_MAX_DUTY   = 85.0f;
@@ -64,10 +74,47 @@ constexpr int PIN_PILOT_IN         = 1;
 #endif
 
 constexpr int PILOT_PWM_FREQ       = 1000;
+constexpr uint32_t PILOT_PWM_PERIOD_US = 1000000UL / PILOT_PWM_FREQ;
 
 constexpr int PILOT_PWM_RESOLUTION = 12;
 constexpr int PILOT_PWM_MAX_DUTY   = (1 << PILOT_PWM_RESOLUTION) - 1;
 
+/* =========================
+ * J1772 Duty Table (compile time)
+ * ========================= */
+// LEDC counts for every 0.1A step from MIN_CURRENT to MAX_CURRENT, generated from the
+// J1772_* mapping above with the same float arithmetic ampsToDuty() uses, so the integer
+// path is bit-exact with the float one. Limits outside the range clamp to its ends.
+constexpr int J1772_DUTY_TABLE_SIZE = MAX_CURRENT_DA - MIN_CURRENT_DA + 1;
+
+constexpr uint16_t j1772DutyCounts(uint16_t deciamps) {
+    float amps = (float)deciamps / 10.0f;
+    float duty = (amps <= J1772_LOW_RANGE_MAX_AMPS) ? amps / J1772_LOW_RANGE_FACTOR
+                                                    : (amps / J1772_HIGH_RANGE_FACTOR) + J1772_HIGH_RANGE_OFFSET;
+    return (uint16_t)((duty / 100.0f) * PILOT_PWM_MAX_DUTY + 0.5f);
+}
+
+struct J1772DutyTable {
+    uint16_t counts[J1772_DUTY_TABLE_SIZE];
+    constexpr J1772DutyTable() : counts() {
+        for (int i = 0; i < J1772_DUTY_TABLE_SIZE; i++) counts[i] = j1772DutyCounts(MIN_CURRENT_DA + i);
+    }
+    constexpr uint16_t lookup(uint16_t deciamps) const {
+        return counts[(deciamps < MIN_CURRENT_DA ? MIN_CURRENT_DA : deciamps > MAX_CURRENT_DA ? MAX_CURRENT_DA : deciamps) - MIN_CURRENT_DA];
+    }
+};
+
+inline constexpr J1772DutyTable J1772_DUTY_TABLE{};
+
+// Duty changes are queued (last request wins) and written by the EVSE task at the start of
+// the next frame, at most once per PWM period. The LEDC latches a new duty on counter
+// overflow, so a pulse in progress is never truncated or stretched.
+constexpr uint32_t PILOT_DUTY_NONE = 0xFFFFFFFFUL;
+
+static_assert(J1772_DUTY_TABLE.lookup(60)  == 410,  "J1772: 6A -> 10% duty");
+static_assert(J1772_DUTY_TABLE.lookup(510) == 3481, "J1772: 51A -> 85% duty");
+static_assert(J1772_DUTY_TABLE.lookup(800) == 3931, "J1772: 80A -> 96% duty");
+
 /* =========================
  * Analog Sampling Configuration
  * ========================= */
@@ -78,6 +125,9 @@ constexpr unsigned long PILOT_SAMPLE_DURATION_US = (2 * 1000000) / PILOT_PWM_FRE
 
 #define RAW_AD_USE 1 
 
+// Number of 12-bit raw ADC codes (size of the raw -> pilot mV lookup table)
+constexpr int ADC_RAW_CODES = 1 << 12;
+
 #if RAW_AD_USE
 #define USE_CONTINUAL_AD_READS 1 // USE DMA AD SAMPLING ! 
 #include <hal/adc_types.h>
@@ -113,27 +163,257 @@ constexpr int ADC_READ_BYTE_LEN = ADC_SAMPLES_COUNT * 2; // 4 bytes per sample (
 #endif
 #endif
 
+/* =========================
+ * Auxiliary Analog Inputs (shared DMA pattern)
+ * ========================= */
+// Proximity pilot (IEC 61851-1 Annex B cable coding) and connector NTC are sampled in the
+// same DMA pattern as the control pilot and demultiplexed in Pilot::read(). ADC1 GPIOs only;
+// -1 = not fitted on this board (the pattern then holds the pilot channel alone).
+#if CONFIG_IDF_TARGET_ESP32
+constexpr int PIN_PP_IN            = -1;
+constexpr int PIN_NTC_IN           = -1;
+#elif CONFIG_IDF_TARGET_ESP32S3
+constexpr int PIN_PP_IN            = -1;
+constexpr int PIN_NTC_IN           = -1;
+#endif
+
+// Pattern: the pilot fills every slot except one per fitted aux channel. The conversion
+// rate is raised so the pilot itself is still sampled at ADC_SAMPLE_RATE_HZ.
+constexpr int ADC_PATTERN_LEN      = 16;
+
+constexpr int ADC_VREF_MV          = 3300;  // Pull-up supply of the PP / NTC dividers
+constexpr int PP_PULLUP_OHMS       = 1000;  // PP resistor to PE, pull-up to ADC_VREF_MV
+constexpr int NTC_PULLUP_OHMS      = 10000; // NTC to GND, pull-up to ADC_VREF_MV
+constexpr int NTC_R25_OHMS         = 10000;
+constexpr int NTC_BETA             = 3950;
+
+// Cable rating from the PP resistor (IEC 61851-1 Table B.2 ranges incl. tolerances)
+struct ProximityRange { uint16_t minOhms; uint16_t maxOhms; uint16_t deciamps; };
+constexpr ProximityRange PP_RANGES[] = {
+    { 1100, 2460, 130 },    // 1k5  -> 13A
+    {  400,  936, 200 },    // 680R -> 20A
+    {  164,  308, 320 },    // 220R -> 32A
+    {   75,  130, 630 },    // 100R -> 63A
+};
+// getCableRatingDa() when no PP input is fitted (no cap). A fitted input without a valid
+// coding (no cable, open, or outside every range) reads 0 and offers nothing.
+constexpr uint16_t PP_RATING_NOT_FITTED = 0xFFFF;
+
+struct AdcChannelStats {
+    uint32_t sum;
+    uint16_t count;
+
+    void reset() { sum = 0; count = 0; }
+    inline void add(int raw) { sum += raw; count++; }
+    int mean() const { return count ? (int)(sum / count) : -1; }
+};
+
+/* =========================
+ * Adaptive Sample Rate
+ * ========================= */
+// In State A with a static pilot nothing changes for hours, so the driver is switched to a
+// low-rate "presence watch" profile (stop / reconfigure / start). It returns to full rate
+// within one frame when the high plateau leaves the State A band, and whenever PWM, a duty
+// change or a capture needs it. ESP32 cannot convert below SOC_ADC_SAMPLE_FREQ_THRES_LOW.
+constexpr bool     PILOT_ADAPTIVE_RATE   = true;
+constexpr uint32_t PILOT_WATCH_ENTER_MS  = 2000;    // Static State A this long before dropping rate
+#if USE_CONTINUAL_AD_READS && RAW_AD_USE
+constexpr uint32_t ADC_WATCH_RATE_HZ     = (SOC_ADC_SAMPLE_FREQ_THRES_LOW > 4000) ? SOC_ADC_SAMPLE_FREQ_THRES_LOW : 4000;
+#endif
+
+/* =========================
+ * Plateau Estimation
+ * ========================= */
+// Coarse histogram of raw codes: 64 bins of 64 codes (~350mV pilot-side per bin).
+// The plateau value is the mean of the samples in the bin holding the first sample
+// after trimming PILOT_PLATEAU_TRIM_DIV-th of the samples at each end, so isolated spikes
+// and switching-edge ringing no longer move the high/low readings.
+constexpr int PILOT_HIST_SHIFT       = 6;
+constexpr int PILOT_HIST_BINS        = ADC_RAW_CODES >> PILOT_HIST_SHIFT;
+constexpr int PILOT_PLATEAU_TRIM_DIV = 64;   // Trim 1/64 (~1.5%) -> 2 samples per 128-sample frame
+// With PWM the trim is also capped at 1/PILOT_PLATEAU_KEEP_DIV of the samples the commanded duty
+// puts on that plateau: at 96% a frame holds as few as 3 low samples, and trimming 2 of them
+// would leave the low reading (the diode check) resting on a single sample. The -12V plateau
+// clips at raw 0, so an untrimmed low end cannot be pulled down by spikes.
+constexpr int PILOT_PLATEAU_KEEP_DIV = 8;
+// The ADC clock and the LEDC share the APB clock, so a sample that catches the overshoot
+// after a rising edge repeats once per PWM period: the high end trims at least one sample
+// per period in the frame. Undershoot below -12V clips and needs no trim.
+constexpr int PILOT_SAMPLES_PER_PERIOD = ADC_SAMPLE_RATE_HZ / PILOT_PWM_FREQ;
+
+/* =========================
+ * State Debouncing (time based)
+ * ========================= */
+// A newly classified state is committed once it has been seen continuously for the dwell
+// time of that transition, measured on the frame timestamps (not on the number of calls).
+// Worst-case commit latency = dwell + one DMA frame (3.2ms) + EVSE task scheduling.
+constexpr uint32_t PILOT_DWELL_FAST_MS    = 3;    // Unplug (-> A) and faults (-> E/F): 2nd agreeing frame
+constexpr uint32_t PILOT_DWELL_PLUG_MS    = 50;   // A -> B/C/D: ride out connector insertion bounce
+constexpr uint32_t PILOT_DWELL_DEFAULT_MS = 20;   // B <-> C <-> D and recovery from E/F
+
+constexpr uint32_t pilotDefaultDwellMs(VEHICLE_STATE_T from, VEHICLE_STATE_T to) {
+    return (to == VEHICLE_NOT_CONNECTED || to == VEHICLE_NO_POWER || to == VEHICLE_ERROR) ? PILOT_DWELL_FAST_MS
+         : (from == VEHICLE_NOT_CONNECTED) ? PILOT_DWELL_PLUG_MS
+         : PILOT_DWELL_DEFAULT_MS;
+}
+
+struct PilotHistogram {
+    uint16_t count[PILOT_HIST_BINS];
+    uint32_t sum[PILOT_HIST_BINS];
+    int total;
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+    inline void add(int raw) {
+        int bin = raw >> PILOT_HIST_SHIFT;
+        if (bin >= PILOT_HIST_BINS) bin = PILOT_HIST_BINS - 1;
+        if (bin < 0) bin = 0;
+        count[bin]++;
+        sum[bin] += raw;
+        total++;
+    }
+    int high(int trim) const;
+    int low(int trim) const;
+};
+
+// The EVSE task blocks on the DMA "frame done" notification (one frame = 128 samples = 3.2ms
+// at full rate). If nothing arrives within the expected wake period of the active profile plus
+// this margin (ADC stopped for OTA, driver init failed) the task wakes anyway so the watchdog
+// and OTA flag are still serviced. See Pilot::getFrameTimeoutMs().
+constexpr uint32_t PILOT_FRAME_TIMEOUT_MS = 20;
+// In the presence-watch profile the ISR wakes the task once per this much sampled time
+// (whole frames, at least one): ESP32 cannot convert below 20kHz, so frames still complete
+// every 6.4ms and only the batching brings the task down to ~50 wakeups/s.
+constexpr uint32_t PILOT_WATCH_WAKE_MS = 20;
+// DMA pool in frames; must hold one watch batch plus the frames completing while it is read
+constexpr int ADC_POOL_FRAMES = 8;
+
+/* =========================
+ * PWM Verification (measured duty / frequency)
+ * ========================= */
+// Edges are timed on the DMA sample stream (threshold = midpoint of the plateaus, with
+// hysteresis) and evaluated over a fixed window. At 40kHz one period is 40 samples, so a
+// 100ms window (100 periods) resolves duty to ~0.03% on average.
+constexpr uint32_t PILOT_MEAS_WINDOW_MS      = 100;
+constexpr int      PILOT_EDGE_MIN_SWING_RAW  = 512;    // Plateaus closer than this = static level (no PWM)
+constexpr float    PILOT_DUTY_TOLERANCE      = 3.0f;   // Absolute % between commanded and measured duty
+constexpr float    PILOT_FREQ_TOLERANCE_HZ   = 50.0f;  // Allowed deviation from PILOT_PWM_FREQ
+constexpr int      PILOT_PWM_FAULT_WINDOWS   = 3;      // Consecutive mismatching windows before fault
+
+/* =========================
+ * Waveform Capture (scope)
+ * ========================= */
+// While a capture is active every raw DMA frame is copied into a fixed ring of slots
+// (allocated once on first use, PSRAM preferred). Pilot::read() never waits for the
+// consumer: when the ring is full the frame is dropped and counted. A capture always
+// stops by itself after its duration (bounded by PILOT_CAPTURE_MAX_MS).
+constexpr int      PILOT_CAPTURE_FRAME_SAMPLES = 128;    // Must hold one adc_continuous_read() chunk
+constexpr int      PILOT_CAPTURE_SLOTS         = 128;    // ~410ms of samples at 40kHz (~33KB)
+constexpr uint32_t PILOT_CAPTURE_DEFAULT_MS    = 2000;
+constexpr uint32_t PILOT_CAPTURE_MAX_MS        = 10000;
+
+struct PilotCaptureFrame {
+    uint32_t seq;        // Frame number since capture start (gaps = dropped frames)
+    uint16_t samples;    // Valid entries in raw[]
+    uint16_t dropped;    // Frames dropped so far in this capture (saturating)
+    uint16_t raw[PILOT_CAPTURE_FRAME_SAMPLES];
+};
+constexpr size_t PILOT_CAPTURE_HEADER_BYTES = offsetof(PilotCaptureFrame, raw);
+
 
 class Pilot {
 private:    
     int highVoltageMv = 0; 
     int lowVoltageMv = 0;
-    float currentDutyPercent = 0.0f;
+    uint16_t _dutyCounts = 0;           // LEDC counts currently commanded (J1772_DUTY_TABLE)
+    uint16_t _dutyDeciamps = 0;
+    uint32_t _pendingDuty = PILOT_DUTY_NONE;   // (deciamps << 16) | counts, any task -> EVSE task
+    uint32_t _dutyWriteUs = 0;
+    uint32_t _dutyUpdates = 0;                 // Hardware duty writes
+    uint32_t _dutyCoalesced = 0;               // Requests replaced before reaching the hardware
     bool pwmAttached = false;
     VEHICLE_STATE_T lastVehicleState = VEHICLE_NOT_CONNECTED; 
+    PilotHistogram _hist;
+
+    // Sample profile (adaptive rate)
+    bool _watchProfile = false;
+    unsigned long _watchCandidateMs = 0;
+    uint32_t _profileSwitches = 0;
+    uint32_t _pilotRateHz = 0;
+    uint32_t _convRateHz = 0;
+
+    // Auxiliary channels (demultiplexed from the DMA stream, averaged per read)
+    AdcChannelStats _ppStats{};
+    AdcChannelStats _ntcStats{};
+    int _ppMv = -1;                     // ADC-side mV, -1 = no data
+    int _ntcMv = -1;
+
+    // Debounce: candidate state and the frame time it was first seen
+    VEHICLE_STATE_T _candidateState = VEHICLE_NOT_CONNECTED;
+    uint32_t _candidateSinceUs = 0;
+    uint32_t _dwellUs[VEHICLE_STATE_COUNT][VEHICLE_STATE_COUNT];
 
 #if RAW_AD_USE
     adc_channel_t _adc_channel;
+    int _ppChannel = -1;                // -1 = not fitted / not in the DMA pattern
+    int _ntcChannel = -1;
     adc_cali_handle_t cali_handle = nullptr;
+    // Raw 12-bit code -> pilot-side mV (calibration + divider), built once in begin()
+    int16_t _rawToMv[ADC_RAW_CODES];
     
     #if USE_CONTINUAL_AD_READS
     adc_continuous_handle_t _continuous_handle = nullptr;
     uint8_t* _dma_buffer = nullptr;
+    static bool IRAM_ATTR onConvDone(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data);
+    static bool IRAM_ATTR onPoolOverflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data);
     #else
     adc_oneshot_unit_handle_t _adc_handle; 
     #endif
 #endif
 
+    // Frame notification (written from the ADC ISR)
+    volatile TaskHandle_t _frameTask = nullptr;
+    volatile uint32_t _frameReadyUs = 0;
+    volatile uint32_t _frameCount = 0;
+    volatile bool _frameNotified = false;   // Set with the notification; others may notify too
+    volatile uint32_t _poolOverflows = 0;
+    volatile uint32_t _framesSinceWake = 0;
+    uint32_t _framesPerWake = 1;        // Set with the profile (driver stopped)
+    uint32_t _wakePeriodUs = 0;
+    uint32_t _frameWakeups = 0;         // waitForFrame() returns with / without a frame
+    uint32_t _frameTimeouts = 0;
+
+    // PWM verification (edge timing on the DMA stream)
+    int _edgeThresholdRaw = 0;      // 0 = not armed (no PWM swing seen)
+    int _edgeHystRaw = 0;
+    bool _edgeHigh = false;
+    uint32_t _edgeSampleIdx = 0;    // Samples since window start
+    int32_t _firstRiseIdx = -1;
+    uint32_t _lastRiseIdx = 0;
+    uint32_t _riseCount = 0;
+    uint32_t _highCount = 0;        // High samples since first rising edge
+    uint32_t _highAtLastRise = 0;
+    uint32_t _windowOverflowMark = 0;
+    bool _measDiscard = true;       // Commanded duty changed during the window
+    float _measuredDuty = 0.0f;
+    float _measuredFreq = 0.0f;
+    int _pwmMismatchCount = 0;
+    bool _pwmFault = false;
+
+    // Waveform capture ring (single producer: read(), single consumer: web task)
+    PilotCaptureFrame* _capRing = nullptr;
+    volatile uint32_t _capHead = 0;     // Next slot to fill (producer)
+    volatile uint32_t _capTail = 0;     // Next slot to send (consumer)
+    volatile bool _capActive = false;
+    unsigned long _capStartMs = 0;
+    uint32_t _capDurationMs = 0;
+    uint32_t _capSeq = 0;
+    uint32_t _capDropped = 0;
+
+    // Frame-ready -> processed latency statistics (EVSE task only)
+    uint32_t _frameLatencyUs = 0;
+    uint32_t _frameLatencyMaxUs = 0;
+    uint32_t _frameLatencyAvgUs = 0;
+
 public:
     Pilot();
     ~Pilot();
@@ -142,15 +422,80 @@ public:
     void disable();
     void stop();
     void currentLimit(float amps);
+    void currentLimitDa(uint16_t deciamps);     // Integer path (0.1A units)
     VEHICLE_STATE_T read();
     float getVoltage();
+    int getVoltageMv() const { return highVoltageMv; }   // High plateau, pilot-side mV
+    int getLowVoltageMv() const { return lowVoltageMv; } // Low plateau, pilot-side mV
     float getPwmDuty();
+    uint16_t getPwmDutyCounts() const { return _dutyCounts; }
+    uint32_t getDutyUpdates() const { return _dutyUpdates; }
+    uint32_t getDutyCoalesced() const { return __atomic_load_n(&_dutyCoalesced, __ATOMIC_RELAXED); }
     float ampsToDuty(float amps);
     float dutyToAmps(float duty);
 
+    // Event-driven sampling: the given task is notified for every completed DMA frame
+    // (every batch of frames in the watch profile).
+    void attachFrameTask(TaskHandle_t task);
+    // True for a frame; false on timeout or when something else notified the task (RCM trip)
+    bool waitForFrame(uint32_t timeoutMs);
+    uint32_t getFrameTimeoutMs() const;     // Wake period of the active profile + PILOT_FRAME_TIMEOUT_MS
+    void frameProcessed();
+    uint32_t getFrameLatencyUs() const { return _frameLatencyUs; }
+    uint32_t getFrameLatencyMaxUs() const { return _frameLatencyMaxUs; }
+    uint32_t getFrameLatencyAvgUs() const { return _frameLatencyAvgUs; }
+    uint32_t getFrameCount() const { return _frameCount; }
+    uint32_t getPoolOverflows() const { return _poolOverflows; }
+    uint32_t getFrameWakeups() const { return _frameWakeups; }
+    uint32_t getFrameTimeouts() const { return _frameTimeouts; }
+
+    // Measured pilot waveform (edge timing) and commanded-vs-measured fault
+    float getMeasuredDuty() const { return _measuredDuty; }
+    float getMeasuredFrequency() const { return _measuredFreq; }
+    bool isPwmFault() const { return _pwmFault; }
+
+    // Adaptive sample rate (presence-watch profile in State A)
+    bool isWatchProfile() const { return _watchProfile; }
+    uint32_t getPilotSampleRate() const { return _pilotRateHz; }
+    uint32_t getProfileSwitches() const { return _profileSwitches; }
+
+    // Proximity pilot / connector temperature (shared DMA pattern)
+    bool hasProximityPilot() const { return _ppChannel >= 0; }
+    bool hasConnectorNtc() const { return _ntcChannel >= 0; }
+    int getProximityOhms() const;           // -1 = open / not fitted
+    uint16_t getCableRatingDa() const;      // 0 = no cable / invalid coding, PP_RATING_NOT_FITTED = no PP input
+    float getConnectorTemperature() const;  // NAN = not fitted / sensor open or shorted
+
+    // Debounce dwell per transition (from -> to), in milliseconds
+    void setDebounceDwell(VEHICLE_STATE_T from, VEHICLE_STATE_T to, uint32_t ms);
+    uint32_t getDebounceDwell(VEHICLE_STATE_T from, VEHICLE_STATE_T to) const;
+    void resetDebounceDwell();
+
+    // Raw waveform capture for the live scope (see PilotCaptureFrame)
+    bool startCapture(uint32_t durationMs);
+    void stopCapture();
+    bool isCapturing() const { return _capActive; }
+    const PilotCaptureFrame* peekCaptureFrame() const;
+    void releaseCaptureFrame();
+    uint32_t getCaptureDropped() const { return _capDropped; }
+    int rawToMv(int raw) const;
+
 private:
     int analogReadMax();
     float convertMv(int adMv);
+#if RAW_AD_USE
+    void buildMvTable();
+    bool configureDma(uint32_t pilotRateHz);
+    int auxChannel(int pin, const char* name);
+    int rawToAdcMv(int raw);
+#endif
+    void applyPendingDuty();
+    void setWatchProfile(bool watch);
+    void updateSampleProfile();
+    inline PilotCaptureFrame* captureSlot();
+    inline void captureCommit(PilotCaptureFrame* frame, int samples);
+    inline void trackEdge(int raw);
+    void finishMeasurementWindow();
 };
 
 void vehicleStateToText(VEHICLE_STATE_T vehicleState, char* buffer);
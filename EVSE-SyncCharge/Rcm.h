@@ -3,12 +3,37 @@
 
 #include <Arduino.h>
 
+// Trip fast path timing, microseconds. Coil: ISR entry -> contactor coil and pilot pins
+// written; the contact itself opens milliseconds later (with feedback fitted, the relay's
+// open timing runs from the trip to the feedback edge). Task: ISR entry -> EVSE task
+// bookkeeping (session stop, lockout); the ISR wakes the task, so this is scheduling
+// latency rather than a pilot frame.
+struct RcmTripStats {
+    uint32_t trips = 0;
+    uint32_t lastCoilUs = 0;
+    uint32_t maxCoilUs = 0;
+    uint32_t lastTaskUs = 0;
+};
+
 class Rcm {
 public:
     Rcm();
     void begin();
     bool selfTest();
+    // A trip not yet reported to the EVSE task (reports each once)
     bool isTriggered();
+    // Task notified by a trip (the EVSE task): it handles the trip at once instead of at
+    // its next pilot frame. NULL = none.
+    void attachTask(TaskHandle_t task);
+    // While armed, a trip opens the contactor and sets the pilot to +12V in the ISR itself
+    void arm(bool armed);
+    // Set by that fast path and held until clearLatch(), whatever the task has seen: no
+    // contactor closes and the pilot PWM stays detached meanwhile
+    static bool isLatched();
+    // esp_timer time (us) of the ISR entry that set the latch
+    static uint32_t getLatchUs();
+    void clearLatch();
+    RcmTripStats getTripStats() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,8 @@
 /* =========================================================================================
  * Project:     Evse-SyncCharge
  * Description: Implementation of the Relay driver. Provides non-blocking control of the
- *              main contactor with anti-chatter hysteresis and safety delays.
+ *              main contactor with anti-chatter hysteresis and safety delays, and checks
+ *              the optional contactor feedback input with switching-time histograms.
  *
  * Author:      Noel Vellemans
  * Copyright:   (C) 2026 Noel Vellemans
@@ -11,16 +12,17 @@
 
 #include "Relay.h"
 #include "EvseLogger.h"
+#include "Rcm.h"
+#include <esp_timer.h>
 
-/* =========================
- * Hardware constants
- * ========================= */
-constexpr int PIN_RELAY_OUT = 16; // Digital output to control relay coil
 #define RELAY_SWITCH_DELAY  3000UL
 
 
-Relay::Relay()
-        : _currentState(false),
+Relay::Relay(int pin, const char* name, int feedbackPin)
+        : _pin(pin),
+          _name(name),
+          _fbPin(feedbackPin),
+          _currentState(false),
           _desiredState(false),
           _lastSwitchTime(0UL)
 {
@@ -30,10 +32,18 @@ void Relay::setup(bool initialState)
 {
     _currentState = initialState;
     _desiredState = initialState;
+    if (_pin < 0) return;
 
-    pinMode(PIN_RELAY_OUT, OUTPUT);
-    digitalWrite(PIN_RELAY_OUT, initialState);
-    logger.infof("[RELAY] Initialized: %s", initialState ? "CLOSED" : "OPEN");
+    pinMode(_pin, OUTPUT);
+    digitalWrite(_pin, initialState);
+    if (_fbPin >= 0) {
+        pinMode(_fbPin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(_fbPin), onFeedbackEdge, this, CHANGE);
+        // The contactor gets the usual time to reach its initial state
+        _fbAwaiting = true;
+        _fbSwitchUs = (uint32_t)esp_timer_get_time();
+    }
+    logger.infof("[%s] Initialized: %s%s", _name, initialState ? "CLOSED" : "OPEN", _fbPin >= 0 ? " (feedback fitted)" : "");
 }
 
 void Relay::loop()
@@ -43,21 +53,90 @@ void Relay::loop()
         // Anti-chatter: only switch if enough time has passed since the last physical switch.
         // The check for _lastSwitchTime == 0 allows the very first switch to be immediate.
         // We also allow immediate OPEN (LOW) for safety and responsiveness.
-        if (_desiredState == LOW || _lastSwitchTime == 0 || (millis() - _lastSwitchTime) >= RELAY_SWITCH_DELAY)
+        // Nothing closes while an RCM trip is latched, whatever the state machine asks for.
+        bool latched = Rcm::isLatched();
+        if (_desiredState == HIGH && latched)
+        {
+            if (!_closeBlocked) logger.warnf("[%s] Close refused: RCM trip latched", _name);
+            _closeBlocked = true;
+        }
+        else if (_desiredState == LOW || _lastSwitchTime == 0 || (millis() - _lastSwitchTime) >= RELAY_SWITCH_DELAY)
         {
             _currentState = _desiredState;
-            digitalWrite(PIN_RELAY_OUT, _currentState);
-            logger.infof("[RELAY] Switched to %s", _currentState ? "CLOSED" : "OPEN");
+            if (_pin >= 0) digitalWrite(_pin, _currentState);
+            logger.infof("[%s] Switched to %s", _name, _currentState ? "CLOSED" : "OPEN");
             _lastSwitchTime = millis(); // Record the time of this switch
+            _fbAwaiting = true;
+            _fbSwitchUs = (uint32_t)esp_timer_get_time();
+            // The RCM ISR drove the main contactor's coil low already: time its opening from there
+            if (_pin == PIN_RELAY_OUT && !_currentState && latched) _fbSwitchUs = Rcm::getLatchUs();
+        }
+        if (!latched) _closeBlocked = false;
+    }
+    if (_fbPin >= 0) checkFeedback();
+}
+
+void IRAM_ATTR Relay::onFeedbackEdge(void* arg)
+{
+    ((Relay*)arg)->_fbEdgeUs = (uint32_t)esp_timer_get_time();
+}
+
+bool Relay::isFeedbackClosed() const
+{
+    return _fbPin >= 0 && digitalRead(_fbPin) == LOW;
+}
+
+// Once per loop(): the contactor must follow the coil within RELAY_FB_TIMEOUT_MS and then
+// stay there. Faults are seen one EVSE cycle late at most; the switching time itself runs
+// to the edge the interrupt stamped, not to this poll.
+void Relay::checkFeedback()
+{
+    bool closed = isFeedbackClosed();
+    bool commanded = isClosed();
+    uint32_t nowUs = (uint32_t)esp_timer_get_time();
+
+    if (_fbAwaiting) {
+        uint32_t elapsedUs = nowUs - _fbSwitchUs;
+        if (closed == commanded) {
+            _fbAwaiting = false;
+            // An edge older than the switch (contact already there) leaves the poll time
+            uint32_t edgeUs = _fbEdgeUs;
+            if ((int32_t)(edgeUs - _fbSwitchUs) >= 0) elapsedUs = edgeUs - _fbSwitchUs;
+            uint32_t* hist = commanded ? _timing.closeHist : _timing.openHist;
+            int bin = 0;
+            while (bin < RELAY_HIST_BINS - 1 && elapsedUs > (uint32_t)RELAY_HIST_EDGES_MS[bin] * 1000UL) bin++;
+            hist[bin]++;
+            if (commanded) {
+                _timing.closeOps++;
+                _timing.lastCloseUs = elapsedUs;
+                if (elapsedUs > _timing.maxCloseUs) _timing.maxCloseUs = elapsedUs;
+            } else {
+                _timing.openOps++;
+                _timing.lastOpenUs = elapsedUs;
+                if (elapsedUs > _timing.maxOpenUs) _timing.maxOpenUs = elapsedUs;
+            }
+            logger.debugf("[%s] %s confirmed after %lu us", _name, commanded ? "Close" : "Open", (unsigned long)elapsedUs);
+        } else if (elapsedUs < RELAY_FB_TIMEOUT_MS * 1000UL) {
+            return;
+        } else {
+            _fbAwaiting = false;
         }
     }
+
+    RELAY_FAULT_T fault = (closed == commanded) ? RELAY_FAULT_NONE
+                        : commanded ? RELAY_FAULT_NO_CLOSE : RELAY_FAULT_WELDED;
+    if (fault == _fault) return;
+    if (fault == RELAY_FAULT_WELDED) logger.errorf("[%s] Contactor closed while commanded OPEN (welded?)", _name);
+    else if (fault == RELAY_FAULT_NO_CLOSE) logger.errorf("[%s] Contactor open while commanded CLOSED", _name);
+    else logger.infof("[%s] Contactor feedback agrees again", _name);
+    _fault = fault;
 }
 
 void Relay::open()
 {
     if (_desiredState != LOW) {
         _desiredState = LOW;
-        logger.debug("[RELAY] Open requested");
+        logger.debugf("[%s] Open requested", _name);
     }
 }
 
@@ -65,6 +144,6 @@ void Relay::close()
 {
     if (_desiredState != HIGH) {
         _desiredState = HIGH;
-        logger.debug("[RELAY] Close requested");
+        logger.debugf("[%s] Close requested", _name);
     }
 }
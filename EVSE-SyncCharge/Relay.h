@@ -4,7 +4,16 @@
  *
  * @details
  * Declares `Relay` which provides delayed switching and immediate open
- * behavior required by the EVSE safety logic.
+ * behavior required by the EVSE safety logic. One instance drives the main
+ * contactor; an optional second one the 1-phase / 3-phase contactor.
+ *
+ * With a feedback input fitted (auxiliary contact or mains sense, pulled
+ * low while the contactor is closed) every loop() samples it: each
+ * operation's latency, from the coil write (or the RCM trip that opened it)
+ * to the feedback edge stamped by its interrupt, goes into a close or open
+ * histogram, and a contactor that does not follow its coil within
+ * RELAY_FB_TIMEOUT_MS, or changes on its own, is reported by getFault() on
+ * that pass.
  *
  * @copyright (C) Noel Vellemans 2026
  * @license GNU General Public License v2.0 (GPLv2)
@@ -17,15 +26,70 @@
 
 #include <Arduino.h>
 
+/* =========================
+ * Hardware constants
+ * ========================= */
+constexpr int PIN_RELAY_OUT = 16;       // Digital output to control the main contactor coil
+// Phase contactor: energised = L2/L3 connected (3-phase), released = 1-phase.
+// -1 = not fitted on this board (no phase switching); boards with one set
+// PHASE_RELAY_PIN at build time.
+#ifndef PHASE_RELAY_PIN
+#define PHASE_RELAY_PIN -1
+#endif
+constexpr int PIN_PHASE_RELAY_OUT = PHASE_RELAY_PIN;
+// Contactor feedback inputs (internal pull-up, low = closed); -1 = not fitted. Boards with
+// an auxiliary contact on the main contactor set RELAY_FB_PIN at build time.
+#ifndef RELAY_FB_PIN
+#define RELAY_FB_PIN -1
+#endif
+constexpr int PIN_RELAY_FB_IN = RELAY_FB_PIN;
+constexpr int PIN_PHASE_RELAY_FB_IN = -1;
+
+constexpr unsigned long RELAY_FB_TIMEOUT_MS = 200;      // Contactor must follow its coil within this
+constexpr int RELAY_HIST_BINS = 8;
+// Upper bin edges (ms); the last bin takes everything above RELAY_HIST_EDGES_MS[6]
+constexpr uint16_t RELAY_HIST_EDGES_MS[RELAY_HIST_BINS - 1] = { 10, 15, 20, 30, 50, 75, 100 };
+
+typedef enum RELAY_FAULT {
+    RELAY_FAULT_NONE = 0,
+    RELAY_FAULT_WELDED,         // Still closed (or closed by itself) while commanded open
+    RELAY_FAULT_NO_CLOSE,       // Did not close, or dropped out, while commanded closed
+} RELAY_FAULT_T;
+
+struct RelayTiming {
+    uint32_t closeOps = 0;
+    uint32_t openOps = 0;
+    uint32_t lastCloseUs = 0;
+    uint32_t maxCloseUs = 0;
+    uint32_t lastOpenUs = 0;
+    uint32_t maxOpenUs = 0;
+    uint32_t closeHist[RELAY_HIST_BINS] = {};
+    uint32_t openHist[RELAY_HIST_BINS] = {};
+};
+
 class Relay
 {
 private:
+    int _pin;
+    const char* _name;
+    int _fbPin;
     bool _currentState;
     bool _desiredState;
     unsigned long _lastSwitchTime;
+    bool _closeBlocked = false;         // Close refused under the present RCM latch (logged once)
+
+    // Feedback (EVSE task)
+    bool _fbAwaiting = false;
+    uint32_t _fbSwitchUs = 0;
+    volatile uint32_t _fbEdgeUs = 0;    // Last feedback edge (ISR)
+    RELAY_FAULT_T _fault = RELAY_FAULT_NONE;
+    RelayTiming _timing;
+
+    void checkFeedback();
+    static void onFeedbackEdge(void* arg);
 
 public:
-    Relay();
+    explicit Relay(int pin = PIN_RELAY_OUT, const char* name = "RELAY", int feedbackPin = PIN_RELAY_FB_IN);
 
     void setup(bool initialState);
     void loop();
@@ -37,6 +101,15 @@ public:
     bool isClosed() const { return _currentState == HIGH; }
     bool isOpen() const { return _currentState == LOW; }
     bool isPending() const { return _desiredState != _currentState; }
+    bool isFitted() const { return _pin >= 0; }
+
+    // Contactor feedback
+    bool hasFeedback() const { return _fbPin >= 0; }
+    bool isFeedbackClosed() const;
+    // Latched until the contactor agrees with its coil again
+    RELAY_FAULT_T getFault() const { return _fault; }
+    const RelayTiming& getTiming() const { return _timing; }
+    const char* getName() const { return _name; }
 };
 
 #endif // RELAY_H_
@@ -19,13 +19,27 @@
 #include <esp_task_wdt.h>
 #include "RGBWL2812.h"
 #include "EvseTelnet.h"
+#include "EvseSessionLog.h"
+#include "EvseScheduler.h"
+#include "EvseSolar.h"
+#include "EvseSite.h"
+#include "EvsePhaseLimit.h"
+#include "Rcm.h"
 
 extern EvseTelnet telnetServer;
+extern EvseSessionLog sessionLog;
+extern EvseScheduler scheduler;
+extern EvseSolarController solar;
+extern EvseSiteBalancer site;
+extern EvsePhaseLimiter mainsLimiter;
+extern Rcm rcm;
 
 WebController::WebController(EvseCharge& evse, Pilot& pilot, EvseMqttController& mqtt, OCPPHandler& ocpp, AppConfig& config, EvseRfid& rfid)
-    : webServer(80), evse(evse), pilot(pilot), mqtt(mqtt), ocpp(ocpp), config(config), rfid(rfid), apMode(false), _rebootPending(false), _rebootTimestamp(0) {}
+    : webServer(80), scopeSocket(SCOPE_WS_PORT), evse(evse), pilot(pilot), mqtt(mqtt), ocpp(ocpp), config(config), rfid(rfid), apMode(false), _rebootPending(false), _rebootTimestamp(0) {}
 
 extern volatile bool g_otaUpdating;
+extern volatile unsigned long g_pilotReadyMs;
+extern volatile unsigned long g_netReadyMs;
 
 void WebController::begin(const String& deviceId, bool apMode) {
     this->deviceId = deviceId;
@@ -43,8 +57,14 @@ void WebController::begin(const String& deviceId, bool apMode) {
     // Register Routes
     webServer.on("/", HTTP_GET, [this](){ handleRoot(); });
     webServer.on("/status", HTTP_GET, [this](){ handleStatus(); });
+    webServer.on("/api/sessions", HTTP_GET, [this](){ handleSessions(); });
+    webServer.on("/api/grid", HTTP_ANY, [this](){ handleGridPower(); });
+    webServer.on("/api/mains", HTTP_ANY, [this](){ handleMainsCurrent(); });
+    webServer.on("/api/relays", HTTP_GET, [this](){ handleRelays(); });
     webServer.on("/settings", HTTP_GET, [this](){ handleSettingsMenu(); });
     webServer.on("/config/evse", HTTP_GET, [this](){ handleConfigEvse(); });
+    webServer.on("/config/schedule", HTTP_GET, [this](){ handleConfigSchedule(); });
+    webServer.on("/saveSchedule", HTTP_POST, [this](){ handleSaveSchedule(); });
     webServer.on("/config/rcm", HTTP_GET, [this](){ handleConfigRcm(); });
     webServer.on("/config/mqtt", HTTP_GET, [this](){ handleConfigMqtt(); });
     webServer.on("/config/wifi", HTTP_GET, [this](){ handleConfigWifi(); });
@@ -56,6 +76,8 @@ void WebController::begin(const String& deviceId, bool apMode) {
     webServer.on("/cmd", HTTP_GET, [this](){ handleCmd(); });
     webServer.on("/test", HTTP_GET, [this](){ handleTestMode(); });
     webServer.on("/testCmd", HTTP_GET, [this](){ handleTestCmd(); });
+    webServer.on("/scope", HTTP_GET, [this](){ handleScope(); });
+    webServer.on("/scopeCmd", HTTP_GET, [this](){ handleScopeCmd(); });
     webServer.on("/scan", HTTP_GET, [this](){ handleWifiScan(); });
     webServer.on("/factory_reset", HTTP_GET, [this](){ handleFactoryReset(); });
     webServer.on("/factReset", HTTP_POST, [this](){ handleFactoryReset(); });
@@ -180,10 +202,18 @@ void WebController::begin(const String& deviceId, bool apMode) {
 
     webServer.onNotFound([this](){ handleRoot(); });
     webServer.begin();
+    // Scope stream carries raw pilot samples: a client must present the one-shot token
+    // issued by /scopeCmd?act=start, which sits behind the web UI auth
+    scopeSocket.onEvent([this](uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+        onScopeEvent(num, type, payload, length);
+    });
+    scopeSocket.begin();
 }
 
 void WebController::loop() {
     webServer.handleClient();
+    scopeSocket.loop();
+    pumpScope();
     if (apMode) dnsServer.processNextRequest();
     if (_rebootPending && millis() > _rebootTimestamp) {
         ESP.restart();
@@ -203,6 +233,20 @@ bool WebController::checkAuth() {
     return true;
 }
 
+/**
+ * @brief Escapes a string for use inside a JSON string literal
+ */
+static String jsonEscape(const String& in) {
+    String out;
+    for (size_t i = 0; i < in.length(); i++) {
+        char c = in[i];
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((uint8_t)c < 0x20) { char b[8]; snprintf(b, sizeof(b), "\\u%04x", c); out += b; }
+        else out += c;
+    }
+    return out;
+}
+
 /**
  * @brief Formats system uptime as human-readable string
  * @return String in format "Xd XXh XXm XXs"
@@ -229,6 +273,36 @@ String WebController::getRebootReason() {
     }
 }
 
+/**
+ * @brief Grid power push for the solar controller: /api/grid?w=<watts> (import positive)
+ */
+void WebController::handleGridPower() {
+    if (!checkAuth()) return;
+    if (!webServer.hasArg("w")) {
+        webServer.send(400, "text/plain", "missing w");
+        return;
+    }
+    solar.updateGridPower(webServer.arg("w").toFloat());
+    webServer.send(200, "text/plain", "OK");
+}
+
+/**
+ * @brief Mains phase currents for the fuse limiter: /api/mains?l1=&l2=&l3= (A, charger included)
+ */
+void WebController::handleMainsCurrent() {
+    if (!checkAuth()) return;
+    if (!webServer.hasArg("l1") || !webServer.hasArg("l2") || !webServer.hasArg("l3")) {
+        webServer.send(400, "text/plain", "missing l1/l2/l3");
+        return;
+    }
+    ActualCurrent c;
+    c.l1 = webServer.arg("l1").toFloat();
+    c.l2 = webServer.arg("l2").toFloat();
+    c.l3 = webServer.arg("l3").toFloat();
+    mainsLimiter.updateMainsCurrent(c);
+    webServer.send(200, "text/plain", "OK");
+}
+
 /**
  * @brief Converts current vehicle state enum to display text
  */
@@ -238,6 +312,25 @@ String WebController::getVehicleStateText() {
     return String(buffer);
 }
 
+/**
+ * @brief One-line schedule state for the dashboard ("WINDOW 2, next 06:00")
+ */
+String WebController::scheduleSummary() {
+    const ScheduleTable& t = scheduler.getTable();
+    bool any = t.departure.enabled;
+    for (int i = 0; i < SCHEDULE_MAX_WINDOWS; i++) any |= t.windows[i].enabled;
+    if (!any) return "OFF";
+    time_t next = scheduler.getNextBoundary();
+    if (next == 0) return "WAITING FOR CLOCK";
+    String s = scheduler.isDepartureCharging() ? String("DEPARTURE") :
+               scheduler.getActiveWindow() >= 0 ? "WINDOW " + String(scheduler.getActiveWindow() + 1) : String("IDLE");
+    struct tm lt;
+    char buf[8];
+    localtime_r(&next, &lt);
+    strftime(buf, sizeof(buf), "%H:%M", &lt);
+    return s + ", next " + buf;
+}
+
 // =============================================================================
 // HTTP Route Handlers
 // =============================================================================
@@ -249,25 +342,79 @@ String WebController::getVehicleStateText() {
 void WebController::handleStatus() {
     webServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
     String json = "{";
-    float amps = evse.getCurrentLimit();
-    String pwmStr = (evse.getState() == STATE_CHARGING) ? (String(evse.getPilotDuty(), 1) + "%") : "DISABLED";
-    json += "\"vst\":\"" + getVehicleStateText() + "\",";
-    json += "\"clim\":" + String(amps, 1) + ",";
+    // One consistent EVSE cycle for every field below
+    EvseSnapshot snap = evse.getSnapshot();
+    char vst[50];
+    vehicleStateToText(snap.vehicleState, vst);
+    String pwmStr = (snap.state == STATE_CHARGING) ? (String(snap.pwmDuty(), 1) + "%") : "DISABLED";
+    json += "\"vst\":\"" + String(vst) + "\",";
+    json += "\"clim\":" + String(snap.currentLimit(), 1) + ",";
+    json += "\"ctgt\":" + String(snap.targetLimitDa / 10.0f, 1) + ",";
     json += "\"pwm\":\"" + pwmStr + "\",";
-    json += "\"pvolt\":" + String(pilot.getVoltage(), 2) + ",";
-    
-    // Relay is only physically closed if Session is Active AND Vehicle is requesting power (State C/D)
-    bool relayClosed = (evse.getState() == STATE_CHARGING) && 
-                       (evse.getVehicleState() == VEHICLE_READY || evse.getVehicleState() == VEHICLE_READY_VENTILATION_REQUIRED);
-
-    json += "\"acrel\":\"" + String(relayClosed ? "CLOSED" : "OPEN") + "\",";
+    json += "\"pvolt\":" + String(snap.pilotMv / 1000.0f, 2) + ",";
+    json += "\"acrel\":\"" + String(snap.relayClosed ? "CLOSED" : "OPEN") + "\",";
     json += "\"upt\":\"" + getUptime() + "\",";
     json += "\"rssi\":" + String(WiFi.RSSI()) + ",";
-    json += "\"state\":" + String((int)evse.getState()) + ",";
-    json += "\"paused\":" + String(evse.isPaused() ? "true" : "false") + ",";
-    json += "\"conn\":" + String(evse.isVehicleConnected() ? "true" : "false") + ",";
-    json += "\"lock\":" + String(evse.isSafetyLockoutActive() ? "true" : "false");
-    json += "}";
+    json += "\"state\":" + String((int)snap.state) + ",";
+    json += "\"paused\":" + String(snap.paused ? "true" : "false") + ",";
+    json += "\"conn\":" + String(snap.vehicleConnected() ? "true" : "false") + ",";
+    json += "\"lock\":" + String(snap.lockout ? "true" : "false") + ",";
+    json += "\"snap\":" + String(snap.seq) + ",";
+    json += "\"bootpr\":" + String(g_pilotReadyMs) + ",";
+    json += "\"bootnet\":" + String(g_netReadyMs) + ",";
+    json += "\"flat\":" + String(pilot.getFrameLatencyAvgUs()) + ",";
+    json += "\"flatmax\":" + String(pilot.getFrameLatencyMaxUs()) + ",";
+    json += "\"frames\":" + String(pilot.getFrameCount()) + ",";
+    json += "\"adcrate\":" + String(pilot.getPilotSampleRate()) + ",";
+    json += "\"adcwatch\":" + String(pilot.isWatchProfile() ? "true" : "false") + ",";
+    json += "\"fovf\":" + String(pilot.getPoolOverflows()) + ",";
+    json += "\"fwake\":" + String(pilot.getFrameWakeups()) + ",";
+    json += "\"ftmo\":" + String(pilot.getFrameTimeouts()) + ",";
+    json += "\"pwmm\":" + String(snap.measuredDuty, 1) + ",";
+    json += "\"pwmf\":" + String(snap.measuredFrequency, 0) + ",";
+    json += "\"pwmflt\":" + String(snap.pwmFault ? "true" : "false") + ",";
+    json += "\"pwmupd\":" + String(pilot.getDutyUpdates()) + ",";
+    json += "\"pwmco\":" + String(pilot.getDutyCoalesced()) + ",";
+    json += "\"ppohm\":" + String(pilot.getProximityOhms()) + ",";
+    uint16_t cableDa = pilot.getCableRatingDa();
+    json += "\"cable\":" + (cableDa == PP_RATING_NOT_FITTED ? String("null") : String(cableDa / 10.0f, 1)) + ",";
+    // Energy from the EVSE counters (same source as MQTT and OCPP MeterValues)
+    json += "\"pwr\":" + String(snap.powerW) + ",";
+    json += "\"esess\":" + String(snap.sessionKwh(), 3) + ",";
+    json += "\"etot\":" + String(snap.lifetimeKwh(), 3) + ",";
+    float ctemp = pilot.getConnectorTemperature();
+    json += "\"ctemp\":" + (isnan(ctemp) ? String("null") : String(ctemp, 1)) + ",";
+    json += "\"sched\":\"" + scheduleSummary() + "\",";
+    json += "\"solar\":" + (solar.isActive() ? "[" + String(solar.getGridW()) + "," + String(solar.getOfferDa() / 10.0f, 1) + "]" : String("null")) + ",";
+    // RCM trip fast path: [trips, last coil us, max coil us, last task us]
+    RcmTripStats trip = rcm.getTripStats();
+    json += "\"rcmtrip\":[" + String(trip.trips) + "," + String(trip.lastCoilUs) + "," + String(trip.maxCoilUs) + "," + String(trip.lastTaskUs) + "],";
+    // Contactor feedback (main): [fault, closes, last close ms, max close ms, opens, last open ms, max open ms]
+    const Relay& mainRelay = evse.getRelay();
+    const RelayTiming& rt = mainRelay.getTiming();
+    json += "\"contactor\":" + (mainRelay.hasFeedback() ? "[" + String((int)snap.contactorFault) + "," + String(rt.closeOps) + "," + String(rt.lastCloseUs / 1000.0f, 1) + ","
+            + String(rt.maxCloseUs / 1000.0f, 1) + "," + String(rt.openOps) + "," + String(rt.lastOpenUs / 1000.0f, 1) + "," + String(rt.maxOpenUs / 1000.0f, 1) + "]" : String("null")) + ",";
+    // Phases in use: [phases, switching, switch count]
+    json += "\"phases\":[" + String(snap.phases) + "," + String(snap.phaseSwitching ? 1 : 0) + "," + String(evse.getPhaseSwitchCount()) + "],";
+    // Fuse limiter: [house L1, L2, L3, cap A] (A)
+    json += "\"mains\":" + (mainsLimiter.isActive() ? "[" + String(mainsLimiter.getHouseDa(0) / 10.0f, 1) + "," + String(mainsLimiter.getHouseDa(1) / 10.0f, 1) + ","
+            + String(mainsLimiter.getHouseDa(2) / 10.0f, 1) + "," + String(mainsLimiter.getCapDa() / 10.0f, 1) + "]" : String("null")) + ",";
+    // Site balancing: [coordinator, nodes, cap A, last convergence ms, max convergence ms, fallback]
+    json += "\"site\":" + (site.isEnabled() ? "[" + String(site.isCoordinator() ? 1 : 0) + "," + String(site.getNodeCount()) + ","
+            + (site.getCapDa() == EVSE_CAP_NONE ? String("null") : String(site.getCapDa() / 10.0f, 1)) + ","
+            + String(site.getLastConvergeMs()) + "," + String(site.getMaxConvergeMs()) + "," + String(site.isFallback() ? 1 : 0) + "]" : String("null")) + ",";
+    const EvseRampStats& ramp = evse.getRampStats();
+    json += "\"ramp\":[" + String(ramp.steps) + "," + String(ramp.maxStepDa / 10.0f, 1) + "],";
+    // Command-to-actuation latency per source: [count, last us, max us, avg us, dropped]
+    json += "\"cmdlat\":{";
+    for (int s = 0; s < EVSE_SRC_COUNT; s++) {
+        const EvseCommandStats& st = evse.getCommandStats((EVSE_CMD_SOURCE_T)s);
+        uint32_t avg = st.count ? (uint32_t)(st.totalUs / st.count) : 0;
+        if (s) json += ",";
+        json += "\"" + String(evseCommandSourceName(s)) + "\":[" + String(st.count) + "," + String(st.lastUs) + "," +
+                String(st.maxUs) + "," + String(avg) + "," + String(st.dropped) + "]";
+    }
+    json += "}}";
     webServer.send(200, "application/json", json);
 }
 
@@ -316,13 +463,23 @@ void WebController::handleRoot() {
     float amps = evse.getCurrentLimit();
     String pwmStr = (evse.getState() == STATE_CHARGING) ? (String(evse.getPilotDuty(), 1) + "%") : "DISABLED";
     h += "<div class='stat'><b>VEHICLE STATE:</b> <span id='vst'>" + getVehicleStateText() + "</span></div>";
-    h += "<div class='stat'><b>CURRENT LIMIT:</b> <span id='clim'>" + String(amps, 1) + "</span> A<br><b>PWM DUTY:</b> <span id='pwm'>" + pwmStr + "</span></div>";
+    h += "<div class='stat'><b>CURRENT LIMIT:</b> <span id='clim'>" + String(amps, 1) + "</span> A<br><b>PWM DUTY:</b> <span id='pwm'>" + pwmStr + "</span><br><b>PWM MEASURED:</b> <span id='pwmm'>" + String(evse.getPilotMeasuredDuty(), 1) + "</span>% @ <span id='pwmf'>" + String(evse.getPilotMeasuredFrequency(), 0) + "</span> Hz</div>";
     h += "<div class='stat'><b>PILOT VOLTAGE:</b> <span id='pvolt'>" + String(pilot.getVoltage(), 2) + "</span> V</div>";
+    if (pilot.hasProximityPilot() || pilot.hasConnectorNtc()) {
+        float ctemp = pilot.getConnectorTemperature();
+        h += "<div class='stat'>";
+        uint16_t cableDa = pilot.getCableRatingDa();
+        if (pilot.hasProximityPilot()) h += "<b>CABLE RATING:</b> <span id='cable'>" + (cableDa ? String(cableDa / 10.0f, 1) + " A" : String("NONE / INVALID (0 A)")) + "</span><br>";
+        if (pilot.hasConnectorNtc()) h += "<b>CONNECTOR TEMP:</b> <span id='ctemp'>" + (isnan(ctemp) ? String("--") : String(ctemp, 1)) + "</span> &deg;C";
+        h += "</div>";
+    }
     
     bool relayClosed = (evse.getState() == STATE_CHARGING) && 
                        (evse.getVehicleState() == VEHICLE_READY || evse.getVehicleState() == VEHICLE_READY_VENTILATION_REQUIRED);
 
     h += "<div class='stat'><b>AC RELAY:</b> <span id='acrel'>" + String(relayClosed ? "CLOSED" : "OPEN") + "</span></div>";
+    EvseSnapshot snap = evse.getSnapshot();
+    h += "<div class='stat'><b>POWER:</b> <span id='pwr'>" + String(snap.powerW) + "</span> W<br><b>SESSION ENERGY:</b> <span id='esess'>" + String(snap.sessionKwh(), 3) + "</span> kWh<br><b>TOTAL ENERGY:</b> <span id='etot'>" + String(snap.lifetimeKwh(), 1) + "</span> kWh</div>";
     
     bool connected = evse.isVehicleConnected();
     
@@ -356,6 +513,20 @@ void WebController::handleRoot() {
     h += "<b>SAFETY LOCK:</b> <span id='lock' style='color:" + String(evse.isSafetyLockoutActive() ? "#ff5252" : "#00ffcc") + "'>" + (evse.isSafetyLockoutActive() ? "YES" : "NO") + "</span><br>";
     h += "<b>UPTIME:</b> <span id='upt'>" + getUptime() + "</span><br>";
     h += "<b>RESET REASON:</b> " + getRebootReason() + "<br>";
+    h += "<b>BOOT TIMING:</b> Pilot " + String(g_pilotReadyMs) + " ms / Network " + String(g_netReadyMs) + " ms<br>";
+    h += "<b>PILOT FRAME LATENCY:</b> <span id='flat'>" + String(pilot.getFrameLatencyAvgUs()) + "</span> us (max <span id='flatmax'>" + String(pilot.getFrameLatencyMaxUs()) + "</span> us)<br>";
+    h += "<b>ADC PROFILE:</b> <span id='adcprof'>" + String(pilot.isWatchProfile() ? "WATCH" : "FULL") + " (" + String(pilot.getPilotSampleRate()) + " Hz)</span><br>";
+    h += "<b>EVSE TASK WAKEUPS:</b> <span id='fwake'>" + String(pilot.getFrameWakeups()) + "</span> (timeouts <span id='ftmo'>" + String(pilot.getFrameTimeouts()) + "</span>)<br>";
+    h += "<b>COMMAND LATENCY:</b> <span id='cmdlat'>--</span><br>";
+    h += "<b>SOLAR:</b> <span id='solar'>--</span><br>";
+    h += "<b>RCM TRIP:</b> <span id='rcmtrip'>--</span><br>";
+    h += "<b>CONTACTOR:</b> <span id='contactor'>--</span><br>";
+    h += "<b>PHASES:</b> <span id='phases'>" + String(evse.getActivePhases()) + "</span><br>";
+    h += "<b>MAINS:</b> <span id='mains'>--</span><br>";
+    h += "<b>SITE:</b> <span id='site'>--</span><br>";
+    h += "<b>SCHEDULE:</b> <span id='sched'>" + scheduleSummary() + "</span><br>";
+    h += "<b>LIMIT RAMP:</b> target <span id='ctgt'>" + String(evse.getTargetLimitDa() / 10.0f, 1) + "</span> A, <span id='rsteps'>" + String(evse.getRampStats().steps) + "</span> steps (max <span id='rmax'>" + String(evse.getRampStats().maxStepDa / 10.0f, 1) + "</span> A)<br>";
+    h += "<b>PWM UPDATES:</b> <span id='pwmupd'>" + String(pilot.getDutyUpdates()) + "</span> (coalesced <span id='pwmco'>" + String(pilot.getDutyCoalesced()) + "</span>)<br>";
     h += "<b>WIFI SIGNAL:</b> <span id='rssi'>" + String(WiFi.RSSI()) + "</span> dBm<br>";
     h += "<b>IP ADDRESS:</b> " + WiFi.localIP().toString() + "</div>";
 
@@ -380,6 +551,7 @@ void WebController::handleSettingsMenu() {
     h += "<b>IP ADDRESS:</b> " + WiFi.localIP().toString() + "</div>";
     h += "<div style='margin:20px 0;'>";
     h += "<a href='/config/evse' class='btn'>EVSE PARAMETERS</a>";
+    h += "<a href='/config/schedule' class='btn'>CHARGING SCHEDULE</a>";
     h += "<a href='/config/rcm' class='btn'>RCD SETTINGS</a>";
     h += "<a href='/config/wifi' class='btn'>WIFI & NETWORK</a>";
     h += "<a href='/config/mqtt' class='btn'>MQTT CONFIGURATION</a>";
@@ -394,6 +566,77 @@ void WebController::handleSettingsMenu() {
     webServer.send(200, "text/html", h);
 }
 
+/**
+ * @brief Charging session history, newest first (JSON)
+ * @note Paged with ?before=<seq>&limit=<n> (max 50); the reply's "more" is the cursor for
+ *       the next page (-1 at the end). Records are streamed one by one from flash as chunked
+ *       content, so the history never has to fit in RAM.
+ */
+void WebController::handleSessions() {
+    if (!checkAuth()) return;
+    uint32_t next = sessionLog.getNextSeq();
+    uint32_t oldest = sessionLog.getOldestSeq();
+    uint32_t before = webServer.hasArg("before") ? (uint32_t)strtoul(webServer.arg("before").c_str(), nullptr, 10) : next;
+    if (before > next) before = next;
+    int limit = webServer.hasArg("limit") ? webServer.arg("limit").toInt() : 20;
+    limit = constrain(limit, 1, 50);
+
+    webServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    webServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    webServer.send(200, "application/json", "");
+
+    char buf[320];
+    snprintf(buf, sizeof(buf), "{\"capacity\":%lu,\"oldest\":%lu,\"next\":%lu,\"sessions\":[",
+             (unsigned long)sessionLog.getCapacity(), (unsigned long)oldest, (unsigned long)next);
+    webServer.sendContent(buf);
+
+    uint32_t seq = before;
+    int sent = 0;
+    while (seq > oldest && sent < limit) {
+        SessionRecord r;
+        if (!sessionLog.read(--seq, r)) continue;
+        snprintf(buf, sizeof(buf), "%s{\"seq\":%lu,\"start\":%lu,\"dur\":%lu,\"wh\":%lu,\"peak\":%u.%u,\"avg\":%u.%u,\"stop\":\"%s\",\"tag\":\"%.*s\"}",
+                 sent ? "," : "", (unsigned long)r.seq, (unsigned long)r.startEpoch, (unsigned long)r.durationS,
+                 (unsigned long)r.energyWh, r.peakCurrentDa / 10, r.peakCurrentDa % 10, r.avgCurrentDa / 10, r.avgCurrentDa % 10,
+                 evseStopReasonName(r.stopReason), (int)SESSION_TAG_LEN, r.tag);
+        webServer.sendContent(buf);
+        sent++;
+    }
+    snprintf(buf, sizeof(buf), "],\"more\":%ld}", seq > oldest ? (long)seq : -1L);
+    webServer.sendContent(buf);
+    webServer.sendContent("");
+}
+
+/**
+ * @brief Contactor feedback and switching-time histograms of both contactors (JSON)
+ * @note Bins are close/open latency up to RELAY_HIST_EDGES_MS (ms), the last one above
+ */
+void WebController::handleRelays() {
+    if (!checkAuth()) return;
+    webServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    String json = "{\"edges\":[";
+    for (int i = 0; i < RELAY_HIST_BINS - 1; i++) json += String(i ? "," : "") + String(RELAY_HIST_EDGES_MS[i]);
+    json += "],\"relays\":[";
+    const Relay* relays[2] = { &evse.getRelay(), &evse.getPhaseRelay() };
+    bool first = true;
+    for (const Relay* r : relays) {
+        if (!r->isFitted()) continue;
+        const RelayTiming& t = r->getTiming();
+        String closeHist, openHist;
+        for (int i = 0; i < RELAY_HIST_BINS; i++) {
+            closeHist += String(i ? "," : "") + String(t.closeHist[i]);
+            openHist += String(i ? "," : "") + String(t.openHist[i]);
+        }
+        json += String(first ? "" : ",") + "{\"name\":\"" + r->getName() + "\",\"feedback\":" + (r->hasFeedback() ? "true" : "false")
+              + ",\"closed\":" + (r->isClosed() ? "true" : "false") + ",\"fault\":" + String((int)r->getFault())
+              + ",\"close\":{\"ops\":" + String(t.closeOps) + ",\"lastUs\":" + String(t.lastCloseUs) + ",\"maxUs\":" + String(t.maxCloseUs) + ",\"hist\":[" + closeHist + "]}"
+              + ",\"open\":{\"ops\":" + String(t.openOps) + ",\"lastUs\":" + String(t.lastOpenUs) + ",\"maxUs\":" + String(t.maxOpenUs) + ",\"hist\":[" + openHist + "]}}";
+        first = false;
+    }
+    json += "]}";
+    webServer.send(200, "application/json", json);
+}
+
 /**
  * @brief Configuration page for EVSE charging parameters (max current, soft start, etc.)
  */
@@ -405,12 +648,154 @@ void WebController::handleConfigEvse() {
     h += "<label>Soft Start (Start at 6A)<select name='softstart'><option value='0' "+String(!config.softStart?"selected":"")+">No (Use Max Current)</option><option value='1' "+String(config.softStart?"selected":"")+">Yes</option></select></label>";
     h += "<label>Resume delay (ms)<input name='lldelay' type='number' value='"+String(config.lowLimitResumeDelayMs)+"'></label>";
     h += "<label>Solar / External Throttle Timeout (sec)<br><small>Throttle to 6A if no update (MQTT/OCPP) (0=Disable)</small><input name='solto' type='number' value='"+String(config.solarStopTimeout)+"'></label>";
+    h += "<label>Current Ramp Up (A/s)<br><small>Slew rate toward a higher limit (0=Immediate)</small><input name='rampup' type='number' step='0.1' min='0' value='"+String(config.rampUpRate,1)+"'></label>";
+    h += "<label>Current Ramp Down (A/s)<br><small>Slew rate toward a lower limit (0=Immediate; safety cuts are always immediate)</small><input name='rampdn' type='number' step='0.1' min='0' value='"+String(config.rampDownRate,1)+"'></label>";
+    h += "<label>Phases<select name='phases'><option value='3' "+String(config.phases!=1?"selected":"")+">3-Phase</option><option value='1' "+String(config.phases==1?"selected":"")+">1-Phase</option></select></label>";
+    h += "<label>1-Phase Supply Line<select name='phline'>";
+    for (int l = 1; l <= 3; l++) h += "<option value='" + String(l) + "' " + String(config.phaseLine == l ? "selected" : "") + ">L" + String(l) + "</option>";
+    h += "</select></label>";
+    h += "<label>Main Fuse per Phase (A)<br><small>Limit to the headroom left by the household load from <code>setMainsCurrent</code> (MQTT) or <code>/api/mains</code> (0=Disable)</small><input name='mfuse' type='number' step='0.1' min='0' value='"+String(config.mainsFuse,1)+"'></label>";
+    h += "<label>Solar Surplus Control<br><small>Follow grid export from <code>setGridPower</code> (MQTT) or <code>/api/grid?w=</code></small><select name='solen'><option value='0' "+String(!config.solarEnabled?"selected":"")+">Disabled</option><option value='1' "+String(config.solarEnabled?"selected":"")+">Enabled</option></select></label>";
+    h += "<label>Solar Grid Target (W)<br><small>0 = no export; positive allows some import</small><input name='soltgt' type='number' value='"+String(config.solarTargetW)+"'></label>";
+    h += "<label>Solar Kp / Ki<div style='display:flex; gap:10px;'><input name='solkp' type='number' step='0.01' min='0' value='"+String(config.solarKp,2)+"'><input name='solki' type='number' step='0.001' min='0' value='"+String(config.solarKi,3)+"'></div></label>";
+    h += "<label>Solar 1/3-Phase Switching<br><small>" + String(PIN_PHASE_RELAY_OUT >= 0 ? "1-phase below 6 A per phase, back to 3-phase above 7 A" : "Phase contactor not fitted on this board") + "</small><select name='sol1p3p'><option value='0' "+String(!config.solarAutoPhase?"selected":"")+">Disabled</option><option value='1' "+String(config.solarAutoPhase?"selected":"")+">Enabled</option></select></label>";
+    h += "<label>Site Load Balancing<br><small>Share one supply with other units on this network (UDP multicast)</small><select name='siten'><option value='0' "+String(!config.siteEnabled?"selected":"")+">Disabled</option><option value='1' "+String(config.siteEnabled?"selected":"")+">Enabled</option></select></label>";
+    h += "<label>Site Supply / Fallback Share (A)<br><small>Budget per phase for all units; share per unit when no coordinator is heard</small><div style='display:flex; gap:10px;'><input name='sitecur' type='number' step='0.1' min='6' value='"+String(config.siteCurrent,1)+"'><input name='sitefb' type='number' step='0.1' min='0' value='"+String(config.siteFallback,1)+"'></div></label>";
+    h += "<label>Site Priority / Group<br><small>Priority 1 (low) .. 9 (high); units with the same group share the budget</small><div style='display:flex; gap:10px;'><input name='sitepri' type='number' min='1' max='9' value='"+String(config.sitePriority)+"'><input name='sitegrp' type='number' min='1' max='65535' value='"+String(config.siteGroup)+"'></div></label>";
+    h += "<label>Mains Voltage (V)<br><small>Nominal phase voltage for power/energy metering</small><input name='volt' type='number' min='100' max='260' value='"+String(config.mainsVoltage)+"'></label>";
     h += "<button class='btn' type='submit'>SAVE</button><div id='saveMsg' style='margin-top:10px; display:none; color:#00ffcc; font-weight:bold;'></div></form>";
     h += "<a href='/test' class='btn' style='background:#673ab7; color:#fff; margin-top:15px;'>PWM TEST LAB</a>";
+    h += "<a href='/scope' class='btn' style='background:#00897b; color:#fff;'>PILOT SCOPE</a>";
+    h += "<a class='btn' style='background:#444; color:#fff;' href='/settings'>CANCEL</a></div></body></html>";
+    webServer.send(200, "text/html", h);
+}
+
+static String minutesToHhmm(uint16_t minutes) {
+    char buf[6];
+    snprintf(buf, sizeof(buf), "%02u:%02u", (unsigned)(minutes / 60) % 24, (unsigned)(minutes % 60));
+    return String(buf);
+}
+
+static uint16_t hhmmToMinutes(const String& s) {
+    int colon = s.indexOf(':');
+    if (colon < 0) return 0;
+    return (uint16_t)(constrain(s.substring(0, colon).toInt(), 0, 23) * 60 + constrain(s.substring(colon + 1).toInt(), 0, 59));
+}
+
+// Weekday checkboxes named <prefix>d0 (Sunday) .. <prefix>d6
+static String dayBoxes(const String& prefix, uint8_t days) {
+    static const char* const names[7] = { "Su", "Mo", "Tu", "We", "Th", "Fr", "Sa" };
+    String h;
+    for (int d = 0; d < 7; d++) {
+        h += "<label style='display:inline-block; margin:4px 6px 0 0;'><input type='checkbox' style='width:auto' name='" + prefix + "d" + String(d) + "'" + String((days & (1 << d)) ? " checked" : "") + "> " + names[d] + "</label>";
+    }
+    return h;
+}
+
+/**
+ * @brief Configuration page for the local charging schedule (windows and departure target)
+ */
+void WebController::handleConfigSchedule() {
+    if (!checkAuth()) return;
+    const ScheduleTable& t = scheduler.getTable();
+    String h = String("<!DOCTYPE html><html><head><meta charset='UTF-8'><title>Schedule</title>") + dashStyle + "</head><body><div class='container'><h1>Charging Schedule</h1><form method='POST' action='/saveSchedule' onsubmit=\"document.getElementById('saveMsg').style.display='block'; document.getElementById('saveMsg').innerText='Saving...';\">";
+    h.reserve(12000);
+    h += "<div class='stat-diag'>Windows start a connected vehicle and set the limit; the previous limit returns when they end. Leave the date empty for a weekly window. Status: " + scheduleSummary() + "</div>";
+    h += "<label>Timezone (POSIX TZ)<br><small>E.g. CET-1CEST,M3.5.0,M10.5.0/3</small><input name='tz' value='" + config.timezone + "'></label>";
+    for (int i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+        const ScheduleWindow& w = t.windows[i];
+        String p = "w" + String(i);
+        String date;
+        uint16_t startMin = w.startMin, endMin = w.endMin;
+        if (!w.days && w.onceStart) {
+            // One-shot windows are stored as Unix times; show them as local date and times
+            time_t s = w.onceStart, e = w.onceEnd;
+            struct tm lt;
+            char buf[12];
+            localtime_r(&s, &lt);
+            strftime(buf, sizeof(buf), "%Y-%m-%d", &lt);
+            date = buf;
+            startMin = lt.tm_hour * 60 + lt.tm_min;
+            localtime_r(&e, &lt);
+            endMin = lt.tm_hour * 60 + lt.tm_min;
+        }
+        h += "<div class='diag-header'>Window " + String(i + 1) + "</div><div style='padding:10px; background:#222; border-radius:8px;'>";
+        h += "<label style='display:inline-block'><input type='checkbox' style='width:auto' name='" + p + "en'" + String(w.enabled ? " checked" : "") + "> Enabled</label><br>";
+        h += dayBoxes(p, w.days);
+        h += "<label>Date (one-shot)<input name='" + p + "date' type='date' value='" + date + "'></label>";
+        h += "<label>Start<input name='" + p + "s' type='time' value='" + minutesToHhmm(startMin) + "'></label>";
+        h += "<label>End<input name='" + p + "e' type='time' value='" + minutesToHhmm(endMin) + "'></label>";
+        h += "<label>Current Limit (A)<input name='" + p + "a' type='number' step='0.1' min='0' value='" + String(w.limitDa / 10.0f, 1) + "'></label></div>";
+    }
+    const DepartureTarget& dep = t.departure;
+    h += "<div class='diag-header'>Departure Target</div><div style='padding:10px; background:#222; border-radius:8px;'>";
+    h += "<label style='display:inline-block'><input type='checkbox' style='width:auto' name='depen'" + String(dep.enabled ? " checked" : "") + "> Enabled</label><br>";
+    h += dayBoxes("dep", dep.days);
+    h += "<label>Departure<input name='dept' type='time' value='" + minutesToHhmm(dep.departMin) + "'></label>";
+    h += "<label>Energy (kWh)<br><small>Charges at full current from the latest start that still reaches it</small><input name='depkwh' type='number' step='0.1' min='0' value='" + String(dep.energyWh / 1000.0f, 1) + "'></label></div>";
+    h += "<button class='btn' type='submit'>SAVE</button><div id='saveMsg' style='margin-top:10px; display:none; color:#00ffcc; font-weight:bold;'></div></form>";
     h += "<a class='btn' style='background:#444; color:#fff;' href='/settings'>CANCEL</a></div></body></html>";
     webServer.send(200, "text/html", h);
 }
 
+/**
+ * @brief Saves the schedule form; applied by the EVSE task on its next cycle
+ */
+void WebController::handleSaveSchedule() {
+    if (!checkAuth()) return;
+
+    if (webServer.hasArg("tz") && webServer.arg("tz") != config.timezone) {
+        config.timezone = webServer.arg("tz");
+        saveConfig(config);
+        setenv("TZ", config.timezone.c_str(), 1);
+        tzset();
+    }
+
+    auto days = [&](const String& prefix) {
+        uint8_t mask = 0;
+        for (int d = 0; d < 7; d++) if (webServer.hasArg(prefix + "d" + String(d))) mask |= 1 << d;
+        return mask;
+    };
+
+    ScheduleTable t;
+    uint16_t maxDa = ampsToDeciamps(config.maxCurrent);
+    for (int i = 0; i < SCHEDULE_MAX_WINDOWS; i++) {
+        ScheduleWindow& w = t.windows[i];
+        String p = "w" + String(i);
+        w.enabled = webServer.hasArg(p + "en") ? 1 : 0;
+        w.startMin = hhmmToMinutes(webServer.arg(p + "s"));
+        w.endMin = hhmmToMinutes(webServer.arg(p + "e"));
+        w.limitDa = constrain(ampsToDeciamps(webServer.arg(p + "a").toFloat()), 0, maxDa);
+        String date = webServer.arg(p + "date");
+        if (date.length() >= 10) {
+            // One-shot: local date + times to Unix time (an end at or before the start is the next day)
+            struct tm lt = {};
+            lt.tm_year = date.substring(0, 4).toInt() - 1900;
+            lt.tm_mon = date.substring(5, 7).toInt() - 1;
+            lt.tm_mday = date.substring(8, 10).toInt();
+            lt.tm_hour = w.startMin / 60;
+            lt.tm_min = w.startMin % 60;
+            lt.tm_isdst = -1;
+            time_t start = mktime(&lt);
+            uint32_t dur = (w.endMin + 1440 - w.startMin) % 1440;
+            w.onceStart = (uint32_t)start;
+            w.onceEnd = (uint32_t)start + (dur ? dur : 1440) * 60;
+            w.days = 0;
+        } else {
+            w.days = days(p);
+            if (!w.days) w.enabled = 0;     // Neither a date nor a weekday: nothing to run
+        }
+    }
+    DepartureTarget& dep = t.departure;
+    dep.enabled = webServer.hasArg("depen") ? 1 : 0;
+    dep.days = days("dep");
+    dep.departMin = hhmmToMinutes(webServer.arg("dept"));
+    dep.energyWh = (uint32_t)(constrain(webServer.arg("depkwh").toFloat(), 0.0f, 200.0f) * 1000.0f);
+
+    scheduler.setTable(t);
+    webServer.sendHeader("Location", "/settings", true); webServer.send(302, "text/plain", "");
+}
+
 /**
  * @brief Configuration page for Residual Current Monitor (RCM/RCD) safety settings
  * @warning Disabling RCM is a safety risk - page includes warnings
@@ -601,6 +986,26 @@ void WebController::handleSaveConfig() {
         config.softStart = (webServer.arg("softstart") == "1");
         config.lowLimitResumeDelayMs = webServer.arg("lldelay").toInt();
         config.solarStopTimeout = webServer.arg("solto").toInt();
+        if (webServer.hasArg("volt")) config.mainsVoltage = constrain(webServer.arg("volt").toInt(), 100, 260);
+        if (webServer.hasArg("rampup")) config.rampUpRate = constrain(webServer.arg("rampup").toFloat(), 0.0f, 80.0f);
+        if (webServer.hasArg("rampdn")) config.rampDownRate = constrain(webServer.arg("rampdn").toFloat(), 0.0f, 80.0f);
+        if (webServer.hasArg("phases")) config.phases = (webServer.arg("phases") == "1") ? 1 : 3;
+        if (webServer.hasArg("phline")) config.phaseLine = constrain(webServer.arg("phline").toInt(), 1, 3);
+        if (webServer.hasArg("mfuse")) config.mainsFuse = constrain(webServer.arg("mfuse").toFloat(), 0.0f, 1000.0f);
+        if (webServer.hasArg("solen")) {
+            config.solarEnabled = (webServer.arg("solen") == "1");
+            config.solarTargetW = constrain(webServer.arg("soltgt").toInt(), -50000, 50000);
+            config.solarKp = constrain(webServer.arg("solkp").toFloat(), 0.0f, 5.0f);
+            config.solarKi = constrain(webServer.arg("solki").toFloat(), 0.0f, 5.0f);
+            config.solarAutoPhase = (webServer.arg("sol1p3p") == "1");
+        }
+        if (webServer.hasArg("siten")) {
+            config.siteEnabled = (webServer.arg("siten") == "1");
+            config.siteCurrent = constrain(webServer.arg("sitecur").toFloat(), 6.0f, 1000.0f);
+            config.siteFallback = constrain(webServer.arg("sitefb").toFloat(), 0.0f, config.siteCurrent);
+            config.sitePriority = constrain(webServer.arg("sitepri").toInt(), 1, 9);
+            config.siteGroup = constrain(webServer.arg("sitegrp").toInt(), 1, 65535);
+        }
     }
     if (webServer.hasArg("mqhost")) {
         rebootRequired = true;
@@ -665,9 +1070,20 @@ void WebController::handleSaveConfig() {
     }
     saveConfig(config);
     mqtt.setFailsafeConfig(config.mqttFailsafeEnabled, config.mqttFailsafeTimeout);
-    evse.setThrottleAliveTimeout(config.solarStopTimeout);
+    evse.post(EVSE_CMD_SET_THROTTLE_TIMEOUT, EVSE_SRC_WEB, config.solarStopTimeout > 0xFFFFUL ? 0xFFFF : (uint16_t)config.solarStopTimeout);
+    SolarParams sp;
+    sp.enabled = config.solarEnabled; sp.targetW = config.solarTargetW; sp.kp = config.solarKp; sp.ki = config.solarKi; sp.autoPhase = config.solarAutoPhase;
+    solar.setParams(sp);
+    SiteParams stp;
+    stp.enabled = config.siteEnabled; stp.group = config.siteGroup; stp.priority = config.sitePriority;
+    stp.siteDa = ampsToDeciamps(config.siteCurrent); stp.fallbackDa = ampsToDeciamps(config.siteFallback);
+    stp.maxDa = ampsToDeciamps(config.maxCurrent);
+    site.configure(stp);
+    PhaseParams pp;
+    pp.fuseDa = ampsToDeciamps(config.mainsFuse); pp.line = config.phaseLine;
+    mainsLimiter.setParams(pp);
     ocpp.setConfig(config.ocppEnabled, config.ocppHost, config.ocppPort, config.ocppUrl, config.ocppUseTls, config.ocppAuthKey, config.ocppHeartbeatInterval, config.ocppReconnectInterval);
-    evse.setRcmEnabled(config.rcmEnabled);
+    evse.post(EVSE_CMD_SET_RCM, EVSE_SRC_WEB, config.rcmEnabled ? 1 : 0);
 
     if (apMode || rebootRequired) {
         String h = "<!DOCTYPE html><html><head><meta http-equiv='refresh' content='15;url=/'><meta name='viewport' content='width=device-width'><style>body{background:#121212;color:#ffcc00;font-family:sans-serif;text-align:center;padding:50px;} .btn{background:#ffcc00;color:#121212;padding:10px 20px;text-decoration:none;border-radius:5px;font-weight:bold;display:inline-block;margin-top:20px;}</style></head><body>";
@@ -690,9 +1106,9 @@ void WebController::handleCmd() {
     logger.infof("[WEB] Command received: %s", op.c_str());
     
     // Execute the requested command
-    if (op == "start")        evse.startCharging();
-    else if (op == "pause")   evse.pauseCharging();
-    else if (op == "stop")    { evse.stopCharging(); pilot.disable(); }
+    if (op == "start")        evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+    else if (op == "pause")   evse.post(EVSE_CMD_PAUSE, EVSE_SRC_WEB);
+    else if (op == "stop")    evse.post(EVSE_CMD_STOP, EVSE_SRC_WEB);     // Stop puts the pilot in standby
     else if (op == "ledtest") { led.startTestSequence(); }
     if (webServer.hasArg("ajax")) webServer.send(200, "text/plain", "OK");
     else { webServer.sendHeader("Location", "/", true); webServer.send(302, "text/plain", ""); }
@@ -725,15 +1141,127 @@ void WebController::handleTestMode() {
 void WebController::handleTestCmd() {
     if (!checkAuth()) return;
     String act = webServer.arg("act");
-    if (act == "on") { evse.enableCurrentTest(true); webServer.send(200, "text/plain", "Enabled"); }
-    else if (act == "off") { evse.enableCurrentTest(false); webServer.send(200, "text/plain", "Disabled"); }
+    if (act == "on") { evse.post(EVSE_CMD_CURRENT_TEST, EVSE_SRC_WEB, 1); webServer.send(200, "text/plain", "Enabled"); }
+    else if (act == "off") { evse.post(EVSE_CMD_CURRENT_TEST, EVSE_SRC_WEB, 0); webServer.send(200, "text/plain", "Disabled"); }
     else if (act == "pwm") {
         float duty = webServer.arg("val").toFloat();
         float amps = pilot.dutyToAmps(duty);
-        evse.setCurrentTest(amps);
+        // Only applies while test mode is on (setCurrentTest() ignores it otherwise)
+        if (evse.isCurrentTestActive()) evse.post(EVSE_CMD_TEST_CURRENT, EVSE_SRC_WEB, ampsToDeciamps(amps));
         webServer.send(200, "text/plain", String(amps));
     } else webServer.send(400, "text/plain", "Bad Request");
 }
+/**
+ * @brief Live pilot scope page (raw 40kHz DMA samples via binary WebSocket)
+ */
+void WebController::handleScope() {
+    if (!checkAuth()) return;
+    String h = "<!DOCTYPE html><html><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1.0'><title>Pilot Scope</title>" + String(dashStyle) + "</head><body><div class='container'>";
+    h += "<h1>PILOT SCOPE</h1><span class='version-tag'>RAW ADC DMA FRAMES</span>";
+    h += "<canvas id='sc' width='500' height='260' style='width:100%; background:#111; border:1px solid #333; border-radius:6px;'></canvas>";
+    h += "<div class='stat' style='border-left-color:#00897b'>FRAMES: <span id='fr'>0</span> / DROPPED: <span id='dr'>0</span><br>STATUS: <span id='st'>IDLE</span></div>";
+    h += "<label>Duration (ms, max " + String(PILOT_CAPTURE_MAX_MS) + ")<input id='dur' type='number' value='" + String(PILOT_CAPTURE_DEFAULT_MS) + "'></label>";
+    h += "<div style='display:flex; gap:10px;'><button class='btn' onclick='capStart()'>CAPTURE</button><button class='btn btn-red' onclick=\"fetch('/scopeCmd?act=stop')\">STOP</button></div>";
+    h += "<a href='/config/evse' class='btn' style='background:#444; margin-top:20px'>BACK</a>";
+    h += "<script>var lut=[],win=400,buf=new Float32Array(win),pos=0,ws=null,fr=0;"
+         "function mv(r){var i=r>>6,f=(r&63)/64;return lut[i]+(lut[i+1]-lut[i])*f;}"
+         "function draw(){var c=document.getElementById('sc'),x=c.getContext('2d'),w=c.width,h=c.height;x.clearRect(0,0,w,h);x.strokeStyle='#333';"
+         "for(var v=-12;v<=12;v+=3){var y=h/2-v*h/28;x.beginPath();x.moveTo(0,y);x.lineTo(w,y);x.stroke();}"
+         "x.strokeStyle='#00ffcc';x.beginPath();for(var i=0;i<win;i++){var y=h/2-buf[(pos+i)%win]/1000*h/28;if(i)x.lineTo(i*w/win,y);else x.moveTo(0,y);}x.stroke();}"
+         "function capStart(){fetch('/scopeCmd?act=start&ms='+document.getElementById('dur').value).then(r=>r.json()).then(d=>{lut=d.lut;"
+         "if(d.token&&(!ws||ws.readyState>1)){ws=new WebSocket('ws://'+location.hostname+':'+d.port+'/?token='+d.token);ws.binaryType='arraybuffer';"
+         "ws.onmessage=function(e){var dv=new DataView(e.data),n=dv.getUint16(4,true);fr++;document.getElementById('fr').innerText=fr;document.getElementById('dr').innerText=dv.getUint16(6,true);"
+         "var s=new Uint16Array(e.data," + String(PILOT_CAPTURE_HEADER_BYTES) + ",n);for(var i=0;i<n;i++){buf[pos]=mv(s[i]);pos=(pos+1)%win;}};}"
+         "document.getElementById('st').innerText=d.ok?'CAPTURING':'FAILED';});}"
+         "setInterval(function(){if(lut.length)draw();},100);"
+         "setInterval(function(){fetch('/scopeCmd?act=state').then(r=>r.json()).then(d=>{if(d.ok&&!d.active)document.getElementById('st').innerText='IDLE';});},1000);</script>";
+    h += "</div></body></html>";
+    webServer.send(200, "text/html", h);
+}
+
+/**
+ * @brief Pilot scope commands (start/stop capture, state)
+ * @return JSON: {"ok":true,"active":true,"port":81,"dropped":0,"lut":[...],"token":".."}
+ * @note "lut" maps raw codes to pilot mV in steps of 64 codes so the browser can
+ *       scale the raw samples with the device calibration. "token" (start only) is a
+ *       random one-shot key for the WebSocket URL, since the browser does not reuse the
+ *       port 80 credentials for port 81; it expires after SCOPE_TOKEN_TTL_MS.
+ */
+void WebController::handleScopeCmd() {
+    if (!checkAuth()) return;
+    String act = webServer.arg("act");
+    bool ok = true;
+    if (act == "start") {
+        ok = pilot.startCapture((uint32_t)webServer.arg("ms").toInt());
+    } else if (act == "stop") {
+        pilot.stopCapture();
+    } else if (act != "state") {
+        webServer.send(400, "text/plain", "Bad Request");
+        return;
+    }
+
+    String json = "{\"ok\":" + String(ok ? "true" : "false");
+    json += ",\"active\":" + String(pilot.isCapturing() ? "true" : "false");
+    json += ",\"port\":" + String(SCOPE_WS_PORT);
+    json += ",\"dropped\":" + String(pilot.getCaptureDropped());
+    if (act == "start") {
+        json += ",\"lut\":[";
+        for (int raw = 0; raw <= ADC_RAW_CODES; raw += 64) {
+            if (raw) json += ",";
+            json += String(pilot.rawToMv(raw < ADC_RAW_CODES ? raw : ADC_RAW_CODES - 1));
+        }
+        json += "]";
+        if (ok) {
+            char token[33];
+            snprintf(token, sizeof(token), "%08lx%08lx%08lx%08lx", (unsigned long)esp_random(), (unsigned long)esp_random(),
+                     (unsigned long)esp_random(), (unsigned long)esp_random());
+            _scopeToken = token;
+            _scopeTokenMs = millis();
+            json += ",\"token\":\"" + _scopeToken + "\"";
+        }
+    }
+    json += "}";
+    webServer.send(200, "application/json", json);
+}
+
+/**
+ * @brief Admits a scope WebSocket client only with the token issued by the last capture start
+ * @note The URL arrives with WStype_CONNECTED, before any frame is broadcast; a client
+ *       without a valid token is dropped there. The token is spent by the first client
+ *       that presents it.
+ */
+void WebController::onScopeEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+    if (type != WStype_CONNECTED) return;
+    String url = (const char*)payload;
+    int at = url.indexOf("token=");
+    String token = at >= 0 ? url.substring(at + 6) : String();
+    int end = token.indexOf('&');
+    if (end >= 0) token = token.substring(0, end);
+    if (_scopeToken.length() == 0 || token != _scopeToken || millis() - _scopeTokenMs >= SCOPE_TOKEN_TTL_MS) {
+        logger.warnf("[WEB] Scope client #%u refused: missing, wrong or expired token", num);
+        scopeSocket.disconnect(num);
+        return;
+    }
+    _scopeToken = "";
+    logger.infof("[WEB] Scope client #%u connected", num);
+}
+
+/**
+ * @brief Forwards captured pilot frames to the scope WebSocket clients
+ * @note Bounded per pass; frames are released even without clients so the ring never
+ *       backs up into Pilot::read().
+ */
+void WebController::pumpScope() {
+    for (int i = 0; i < SCOPE_FRAMES_PER_LOOP; i++) {
+        const PilotCaptureFrame* f = pilot.peekCaptureFrame();
+        if (!f) break;
+        if (scopeSocket.connectedClients() > 0) {
+            scopeSocket.broadcastBIN((const uint8_t*)f, PILOT_CAPTURE_HEADER_BYTES + f->samples * sizeof(uint16_t));
+        }
+        pilot.releaseCaptureFrame();
+    }
+}
+
 /**
  * @brief Scans for available WiFi networks and returns JSON array
  * @return JSON array: [{"ssid":"NetworkName","rssi":-65}, ...]
@@ -755,7 +1283,7 @@ void WebController::handleTestCmd() {
  */
 void WebController::handleFactoryReset() {
     if (!checkAuth()) return;
-    evse.stopCharging(); pilot.disable();
+    evse.post(EVSE_CMD_STOP, EVSE_SRC_WEB);
     String h = "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width'><style>body{background:#121212;color:#ffcc00;font-family:sans-serif;text-align:center;padding:50px;} .btn{background:#ffcc00;color:#121212;padding:10px 20px;text-decoration:none;border-radius:5px;font-weight:bold;display:inline-block;margin-top:20px;}</style></head><body>";
     h += "<h1>Factory Reset</h1><p>Stopping Charge, Wiping WiFi/Settings, Rebooting...</p><a href='/' class='btn'>RETURN HOME</a></body></html>";
     webServer.send(200, "text/html", h);
@@ -786,8 +1314,9 @@ void WebController::handleEvseReset() {
     if (!checkAuth()) return;
     config.maxCurrent = 32.0f; config.rcmEnabled = true; config.allowBelow6AmpCharging = false; config.softStart = false; config.lowLimitResumeDelayMs = 300000UL;
     saveConfig(config);
-    ChargingSettings cs; cs.maxCurrent = config.maxCurrent; cs.disableAtLowLimit = !config.allowBelow6AmpCharging; cs.softStart = config.softStart; cs.lowLimitResumeDelayMs = config.lowLimitResumeDelayMs;
-    evse.setup(cs); evse.setRcmEnabled(config.rcmEnabled);
+    ChargingSettings cs; cs.maxCurrent = config.maxCurrent; cs.disableAtLowLimit = !config.allowBelow6AmpCharging; cs.softStart = config.softStart; cs.lowLimitResumeDelayMs = config.lowLimitResumeDelayMs; cs.mainsVoltage = config.mainsVoltage; cs.phases = config.phases;
+    cs.rampUpDaPerS = ampsToDeciamps(config.rampUpRate); cs.rampDownDaPerS = ampsToDeciamps(config.rampDownRate);
+    evse.postSettings(cs, EVSE_SRC_WEB); evse.post(EVSE_CMD_SET_RCM, EVSE_SRC_WEB, config.rcmEnabled ? 1 : 0);
     webServer.sendHeader("Location", "/settings", true); webServer.send(302, "text/plain", "");
 }
 
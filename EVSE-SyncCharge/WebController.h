@@ -15,6 +15,7 @@
 #include <Arduino.h>
 #include <WebServer.h>
 #include <DNSServer.h>
+#include <WebSocketsServer.h>
 #include "EvseCharge.h"
 #include "Pilot.h"
 #include "EvseMqttController.h"
@@ -22,6 +23,11 @@
 #include "OCPPHandler.h"
 #include "EvseRfid.h"
 
+// Live pilot scope: raw capture frames are pushed as binary WebSocket messages
+constexpr uint16_t SCOPE_WS_PORT         = 81;
+constexpr int      SCOPE_FRAMES_PER_LOOP = 16;   // Max frames forwarded per loop() pass
+constexpr unsigned long SCOPE_TOKEN_TTL_MS = 10000; // Capture start -> WebSocket connect
+
 class WebController {
 public:
     WebController(EvseCharge& evse, Pilot& pilot, EvseMqttController& mqtt, OCPPHandler& ocpp, AppConfig& config, EvseRfid& rfid);
@@ -32,6 +38,7 @@ public:
 private:
     WebServer webServer;
     DNSServer dnsServer;
+    WebSocketsServer scopeSocket;
     EvseCharge& evse;
     Pilot& pilot;
     EvseMqttController& mqtt;
@@ -43,18 +50,27 @@ private:
     bool apMode;
     bool _rebootPending;
     unsigned long _rebootTimestamp;
+    String _scopeToken;                 // One-shot WebSocket token from /scopeCmd?act=start
+    unsigned long _scopeTokenMs = 0;
 
     // Helpers
     bool checkAuth();
     String getUptime();
     String getRebootReason();
     String getVehicleStateText();
+    String scheduleSummary();
 
     // Handlers
     void handleRoot();
     void handleStatus();
+    void handleSessions();
+    void handleGridPower();
+    void handleMainsCurrent();
+    void handleRelays();
     void handleSettingsMenu();
     void handleConfigEvse();
+    void handleConfigSchedule();
+    void handleSaveSchedule();
     void handleConfigRcm();
     void handleConfigMqtt();
     void handleConfigWifi();
@@ -66,6 +82,10 @@ private:
     void handleCmd();
     void handleTestMode();
     void handleTestCmd();
+    void handleScope();
+    void handleScopeCmd();
+    void pumpScope();
+    void onScopeEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
     void handleWifiScan();
     void handleFactoryReset();
     void handleWifiReset();
@@ -52,10 +52,27 @@ fetch('/status?t='+Date.now()).then(r=>r.json()).then(d=>{
 document.getElementById('vst').innerText=d.vst;
 document.getElementById('clim').innerText=d.clim.toFixed(1);
 document.getElementById('pwm').innerText=d.pwm;
+var pm=document.getElementById('pwmm');if(pm){pm.innerText=d.pwmm.toFixed(1);pm.style.color=d.pwmflt?'#ff5252':'';document.getElementById('pwmf').innerText=d.pwmf;}
 document.getElementById('pvolt').innerText=d.pvolt.toFixed(2);
 document.getElementById('acrel').innerText=d.acrel;
+var pw=document.getElementById('pwr');if(pw){pw.innerText=d.pwr;document.getElementById('esess').innerText=d.esess.toFixed(3);document.getElementById('etot').innerText=d.etot.toFixed(1);}
 document.getElementById('upt').innerText=d.upt;
 document.getElementById('rssi').innerText=d.rssi;
+var ap=document.getElementById('adcprof');if(ap)ap.innerText=(d.adcwatch?'WATCH':'FULL')+' ('+d.adcrate+' Hz)';
+var fw=document.getElementById('fwake');if(fw){fw.innerText=d.fwake;document.getElementById('ftmo').innerText=d.ftmo;}
+var rt=document.getElementById('ctgt');if(rt){rt.innerText=d.ctgt.toFixed(1);document.getElementById('rsteps').innerText=d.ramp[0];document.getElementById('rmax').innerText=d.ramp[1].toFixed(1);}
+var ct=document.getElementById('contactor');if(ct)ct.innerText=d.contactor?(['OK','WELDED','NOT CLOSING'][d.contactor[0]]+', close '+d.contactor[2]+' ms (max '+d.contactor[3]+'), open '+d.contactor[5]+' ms (max '+d.contactor[6]+'), '+d.contactor[1]+' ops'):'no feedback';
+var rt2=document.getElementById('rcmtrip');if(rt2)rt2.innerText=d.rcmtrip[0]?(d.rcmtrip[0]+' trips, coil '+d.rcmtrip[1]+' us (max '+d.rcmtrip[2]+' us), task '+d.rcmtrip[3]+' us'):'none';
+var ph=document.getElementById('phases');if(ph)ph.innerText=d.phases[0]+(d.phases[1]?' (switching)':'')+', '+d.phases[2]+' switches';
+var mn=document.getElementById('mains');if(mn)mn.innerText=d.mains?('house '+d.mains[0].toFixed(1)+' / '+d.mains[1].toFixed(1)+' / '+d.mains[2].toFixed(1)+' A, cap '+d.mains[3].toFixed(1)+' A'):'--';
+var si=document.getElementById('site');if(si)si.innerText=d.site?((d.site[0]?'coordinator':'member')+', '+d.site[1]+' units, cap '+(d.site[2]===null?'--':d.site[2].toFixed(1)+' A')+', converge '+d.site[3]+' ms (max '+d.site[4]+')'+(d.site[5]?', FALLBACK':'')):'--';
+var so=document.getElementById('solar');if(so)so.innerText=d.solar?('grid '+d.solar[0]+' W, offer '+d.solar[1].toFixed(1)+' A'):'--';
+var sc=document.getElementById('sched');if(sc)sc.innerText=d.sched;
+var cl=document.getElementById('cmdlat');if(cl&&d.cmdlat){var t=[];for(var k in d.cmdlat){var c=d.cmdlat[k];if(c[0])t.push(k+' '+c[1]+'/'+c[2]+' us');}cl.innerText=t.length?t.join(', '):'--';}
+var pu=document.getElementById('pwmupd');if(pu){pu.innerText=d.pwmupd;document.getElementById('pwmco').innerText=d.pwmco;}
+var cb=document.getElementById('cable');if(cb&&d.cable!==null)cb.innerText=d.cable>0?d.cable.toFixed(1)+' A':'NONE / INVALID (0 A)';
+var ct=document.getElementById('ctemp');if(ct)ct.innerText=(d.ctemp===null)?'--':d.ctemp.toFixed(1);
+var fl=document.getElementById('flat');if(fl){fl.innerText=d.flat;document.getElementById('flatmax').innerText=d.flatmax;}
 var l=document.getElementById('lock');if(l){l.innerText=d.lock?'YES':'NO';l.style.color=d.lock?'#ff5252':'#00ffcc';}
 
 var bStart=document.getElementById('btn-start');
@@ -1,7 +1,8 @@
 /* =========================================================================================
  * Project:     Evse-SyncCharge
  * Description: Implementation of the Residual Current Monitor (RCM) driver. Handles
- *              interrupt-based fault detection and periodic self-testing logic.
+ *              interrupt-based fault detection, the in-ISR contactor open fast path and
+ *              periodic self-testing logic.
  *
  * Author:      Noel Vellemans
  * Copyright:   (C) 2026 Noel Vellemans
@@ -11,6 +12,12 @@
 
 #include "Rcm.h"
 #include "EvseLogger.h"
+#include "Relay.h"
+#include "Pilot.h"
+#include <esp_timer.h>
+#include <esp_rom_gpio.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_sig_map.h>
 
 /* =========================
  * Hardware constants
@@ -19,13 +26,44 @@ constexpr int PIN_RCM_TEST = 26; // Digital output to trigger RCM test coil
 constexpr int PIN_RCM_IN   = 25; // Digital input from RCM (Requires internal Pull-Down)
 
 static SemaphoreHandle_t rcmSemaphore = NULL;
+static volatile TaskHandle_t rcmTask = NULL;
+
+// Shared with the ISR
+static volatile bool rcmArmed = false;
+static volatile bool rcmTestActive = false;
+static volatile bool rcmTripLatched = false;     // Until clearLatch()
+static volatile bool rcmTripPending = false;     // Until isTriggered() reported it
+static volatile uint32_t rcmTripUs = 0;
+static RcmTripStats rcmStats;
 
 static void IRAM_ATTR rcmIsr()
 {
+    // Fast path: cut the supply here instead of a cycle later in the EVSE task. Register
+    // writes only (no driver calls), so this is safe with the flash cache disabled.
+    if (rcmArmed && !rcmTestActive && !rcmTripLatched && gpio_ll_get_level(&GPIO, (gpio_num_t)PIN_RCM_IN)) {
+        uint32_t t0 = (uint32_t)esp_timer_get_time();
+        gpio_ll_set_level(&GPIO, (gpio_num_t)PIN_RELAY_OUT, 0);
+        // Take the pilot pin from the LEDC and hold it at +12V (standby() detaches later)
+        esp_rom_gpio_connect_out_signal(PIN_PILOT_PWM_OUT, SIG_GPIO_OUT_IDX, false, false);
+        gpio_ll_set_level(&GPIO, (gpio_num_t)PIN_PILOT_PWM_OUT, 1);
+        uint32_t coilUs = (uint32_t)esp_timer_get_time() - t0;
+        rcmTripUs = t0;
+        rcmStats.trips++;
+        rcmStats.lastCoilUs = coilUs;
+        if (coilUs > rcmStats.maxCoilUs) rcmStats.maxCoilUs = coilUs;
+        rcmTripLatched = true;
+        rcmTripPending = true;
+    }
+
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
     if (rcmSemaphore != NULL) {
         xSemaphoreGiveFromISR(rcmSemaphore, &xHigherPriorityTaskWoken);
     }
+    // Wake the EVSE task out of its frame wait (the self-test waits on the semaphore instead)
+    TaskHandle_t task = rcmTask;
+    if (task != NULL && !rcmTestActive) {
+        vTaskNotifyGiveFromISR(task, &xHigherPriorityTaskWoken);
+    }
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
     }
@@ -63,6 +101,9 @@ bool Rcm::selfTest()
 
     if (rcmSemaphore == NULL) return false;
 
+    // The test trip must not take the fast path
+    rcmTestActive = true;
+
     // Clear any pending semaphore
     xSemaphoreTake(rcmSemaphore, 0);
 
@@ -74,6 +115,7 @@ bool Rcm::selfTest()
     
     // Reset Test Signal
     digitalWrite(PIN_RCM_TEST, LOW);
+    rcmTestActive = false;
 
     if (success) {
         logger.info("[RCM] Self-Test PASSED");
@@ -88,6 +130,14 @@ bool Rcm::isTriggered()
 {
     if (rcmSemaphore == NULL) return false;
 
+    // The ISR already opened the contactor: always report it, even if the input fell back
+    if (rcmTripPending) {
+        xSemaphoreTake(rcmSemaphore, 0);
+        rcmStats.lastTaskUs = (uint32_t)esp_timer_get_time() - rcmTripUs;
+        rcmTripPending = false;
+        return true;
+    }
+
     // Check if interrupt fired
     if (xSemaphoreTake(rcmSemaphore, 0) == pdTRUE) {
         if (digitalRead(PIN_RCM_IN) == HIGH) {
@@ -95,4 +145,43 @@ bool Rcm::isTriggered()
         }
     }
     return false;
-}
\ No newline at end of file
+}
+
+void Rcm::attachTask(TaskHandle_t task)
+{
+    rcmTask = task;
+}
+
+void Rcm::arm(bool armed)
+{
+    rcmArmed = armed;
+}
+
+bool Rcm::isLatched()
+{
+    return rcmTripLatched;
+}
+
+uint32_t Rcm::getLatchUs()
+{
+    return rcmTripUs;
+}
+
+void Rcm::clearLatch()
+{
+    if (!rcmTripLatched) return;
+    rcmTripPending = false;
+    rcmTripLatched = false;
+    logger.info("[RCM] Trip latch cleared");
+}
+
+RcmTripStats Rcm::getTripStats() const
+{
+    // Written by the ISR only on a trip; a torn copy is corrected by the next read
+    RcmTripStats s;
+    s.trips = rcmStats.trips;
+    s.lastCoilUs = rcmStats.lastCoilUs;
+    s.maxCoilUs = rcmStats.maxCoilUs;
+    s.lastTaskUs = rcmStats.lastTaskUs;
+    return s;
+}
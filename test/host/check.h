@@ -0,0 +1,46 @@
+/*****************************************************************************
+ * @file check.h
+ * Minimal assertions for the host tests.
+ *
+ * @details
+ * A failed check prints its location and keeps the test running, so one
+ * run reports every broken case; main() returns checkResult().
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+#include <math.h>
+
+inline int checkFailures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); checkFailures++; } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    if (_a != _b) { fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); checkFailures++; } \
+} while (0)
+
+#define CHECK_NEAR(a, b, tol) do { \
+    double _a = (double)(a), _b = (double)(b); \
+    if (!(fabs(_a - _b) <= (double)(tol))) { \
+        fprintf(stderr, "%s:%d: CHECK_NEAR failed: %s ~ %s (%g vs %g, tol %g)\n", __FILE__, __LINE__, #a, #b, _a, _b, (double)(tol)); \
+        checkFailures++; \
+    } \
+} while (0)
+
+inline int checkResult(const char* name) {
+    if (checkFailures) fprintf(stderr, "%s: %d check(s) FAILED\n", name, checkFailures);
+    else printf("%s: OK\n", name);
+    return checkFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host bench for the EVSE task: the firmware's Pilot, EvseCharge, Relay and
+ *              Rcm driven by the simulated clock with a vehicle on the pilot line.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "evse_bench.h"
+
+// Defined by the sketch on the target
+Rcm rcm;
+
+static void rcmTestCoil(int level) {
+    host::setInput(PIN_BENCH_RCM_IN, level);
+}
+
+EvseBench::EvseBench(const ChargingSettings& settings) : evse(pilot) {
+    line.vehicleModel = true;
+    rcm.begin();
+    host::onPinWrite(PIN_BENCH_RCM_TEST, rcmTestCoil);
+    evse.setup(settings);
+    evse.setRcmEnabled(true);
+    pilot.attachFrameTask((TaskHandle_t)&pilot);
+    rcm.attachTask((TaskHandle_t)&pilot);
+}
+
+bool EvseBench::cycle() {
+    bool frame = pilot.waitForFrame(pilot.getFrameTimeoutMs());
+    evse.loop();
+    if (frame) pilot.frameProcessed();
+    line.update();
+    return frame;
+}
+
+void EvseBench::runMs(uint32_t ms, const std::function<void()>& each) {
+    uint64_t end = host::nowUs() + (uint64_t)ms * 1000ULL;
+    while (host::nowUs() < end) {
+        cycle();
+        if (each) each();
+    }
+}
+
+bool EvseBench::runUntil(const std::function<bool()>& done, uint32_t timeoutMs,
+                         const std::function<void()>& each) {
+    uint64_t end = host::nowUs() + (uint64_t)timeoutMs * 1000ULL;
+    while (host::nowUs() < end) {
+        cycle();
+        if (each) each();
+        if (done()) return true;
+    }
+    return false;
+}
+
+void EvseBench::feedMeter(float amps) {
+    ActualCurrent c;
+    c.l1 = amps;
+    c.l2 = evse.getActivePhases() == 3 ? amps : 0.0f;
+    c.l3 = evse.getActivePhases() == 3 ? amps : 0.0f;
+    evse.updateActualCurrent(c);
+}
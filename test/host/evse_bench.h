@@ -0,0 +1,59 @@
+/*****************************************************************************
+ * @file evse_bench.h
+ * The EVSE task on the host: Pilot, EvseCharge and its relays, the RCM and
+ * a vehicle on the pilot line.
+ *
+ * @details
+ * cycle() is one pass of evseLoopTask (frame wait, EvseCharge::loop(),
+ * frame release) followed by the vehicle model. The RCM is begun with its
+ * test coil wired to the sensor input, so the pre-charge self-test passes
+ * and a trip is a host::setInput() on PIN_BENCH_RCM_IN. Controllers that
+ * run after EvseCharge in the task (solar, scheduler) go in the per-cycle
+ * hook of runMs() / runUntil().
+ *
+ * Call host::reset() before constructing a bench.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef EVSE_BENCH_H_
+#define EVSE_BENCH_H_
+
+#include <functional>
+#include "host.h"
+#include "pilot_line.h"
+#include "EvseCharge.h"
+#include "Rcm.h"
+
+// RCM wiring from rcm.cpp (file-local constants there)
+constexpr int PIN_BENCH_RCM_TEST = 26;
+constexpr int PIN_BENCH_RCM_IN   = 25;
+
+class EvseBench {
+public:
+    explicit EvseBench(const ChargingSettings& settings = ChargingSettings());
+
+    PilotLine line;
+    Pilot pilot;
+    EvseCharge evse;
+
+    // One pass of the EVSE task loop plus the vehicle model; true if a frame arrived
+    bool cycle();
+    // Cycles for `ms` of simulated time, calling `each` after every cycle
+    void runMs(uint32_t ms, const std::function<void()>& each = nullptr);
+    // Cycles until `done` holds; false if `timeoutMs` passes first
+    bool runUntil(const std::function<bool()>& done, uint32_t timeoutMs,
+                  const std::function<void()>& each = nullptr);
+
+    // Physical main contactor output
+    bool contactorClosed() const { return host::pinLevel(PIN_RELAY_OUT) != 0; }
+    // Per-phase current the vehicle draws right now
+    float drawA() const { return line.drawA(contactorClosed()); }
+    // Puts `amps` per phase on the connected phases into updateActualCurrent()
+    void feedMeter(float amps);
+};
+
+#endif
@@ -0,0 +1,426 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host implementation of the Arduino, ESP-IDF and FreeRTOS calls made by the
+ *              safety modules: simulated clock, GPIO with interrupts, LEDC, a continuous
+ *              ADC that produces DMA frames as time passes, and task notifications.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "host.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_rom_gpio.h>
+#include <hal/gpio_ll.h>
+#include <esp_adc/adc_continuous.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <deque>
+#include <vector>
+
+HardwareSerial Serial;
+gpio_dev_t GPIO;
+
+namespace {
+
+constexpr int PINS = 64;
+constexpr uint64_t BOOT_US = 1000000ULL;    // millis() == 0 means "never" in a few modules
+
+struct Pin {
+    int level;
+    void (*isr)();
+    void (*isrArg)(void*);
+    void* isrCtx;
+    int isrMode;
+    void (*hook)(int level);
+    bool ledc;
+    uint32_t duty;
+    uint32_t attaches;
+};
+
+struct Adc {
+    bool created;
+    bool running;
+    uint32_t frameBytes;
+    uint32_t poolBytes;
+    uint32_t rateHz;
+    uint8_t pattern[16];
+    int patternLen;
+    adc_continuous_evt_cbs_t cbs;
+    void* user;
+    uint64_t startUs;
+    uint64_t convIndex;
+    std::deque<std::vector<uint8_t>> pool;
+    uint32_t frames;
+    uint32_t overflows;
+};
+
+uint64_t g_nowUs = BOOT_US;
+Pin g_pins[PINS];
+Adc g_adc;
+host::AdcSignal g_signal = nullptr;
+void* g_signalCtx = nullptr;
+int g_adcPpm = 0;
+uint32_t g_notify = 0;
+uint32_t g_wakeups = 0;
+int g_semaphore = 0;
+bool g_log = getenv("EVSE_TEST_LOG") != nullptr;
+
+int g_calTable[4096];
+bool g_calBuilt = false;
+
+void buildCal() {
+    // Line fitting over ~75..3125 mV with a slight bow, like a real 12 dB curve
+    for (int raw = 0; raw < 4096; raw++) {
+        int64_t num = (int64_t)raw * 3050 * 80000 + (int64_t)raw * (4095 - raw) * 4095;
+        g_calTable[raw] = 75 + (int)((num + 4095LL * 40000) / (4095LL * 80000));
+    }
+    g_calBuilt = true;
+}
+
+double convTimeUs(uint64_t k) {
+    double rate = (double)g_adc.rateHz * (1.0 + g_adcPpm / 1e6);
+    return (double)g_adc.startUs + (double)k * 1e6 / rate;
+}
+
+uint32_t convPerFrame() {
+    return g_adc.frameBytes / SOC_ADC_DIGI_RESULT_BYTES;
+}
+
+// Produces every frame that completes at or before `target`
+void produceFrames(uint64_t target) {
+    while (g_adc.running && g_adc.rateHz > 0 && g_adc.patternLen > 0) {
+        uint32_t n = convPerFrame();
+        double endT = convTimeUs(g_adc.convIndex + n);
+        uint64_t end = (uint64_t)ceil(endT);
+        if (end > target) break;
+
+        std::vector<uint8_t> frame(g_adc.frameBytes);
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t k = g_adc.convIndex + i;
+            int ch = g_adc.pattern[k % g_adc.patternLen];
+            int raw = g_signal ? g_signal(ch, (uint64_t)convTimeUs(k), g_signalCtx) : 0;
+            if (raw < 0) raw = 0;
+            if (raw > 4095) raw = 4095;
+            adc_digi_output_data_t d{};
+#if CONFIG_IDF_TARGET_ESP32S3
+            d.type2.data = (uint32_t)raw;
+            d.type2.channel = (uint32_t)ch;
+#else
+            d.type1.data = (uint16_t)raw;
+            d.type1.channel = (uint16_t)ch;
+#endif
+            memcpy(&frame[i * SOC_ADC_DIGI_RESULT_BYTES], &d, SOC_ADC_DIGI_RESULT_BYTES);
+        }
+        g_adc.convIndex += n;
+        if (end > g_nowUs) g_nowUs = end;
+
+        adc_continuous_evt_data_t ev{ nullptr, g_adc.frameBytes };
+        if ((g_adc.pool.size() + 1) * g_adc.frameBytes > g_adc.poolBytes) {
+            g_adc.overflows++;
+            if (g_adc.cbs.on_pool_ovf) g_adc.cbs.on_pool_ovf((adc_continuous_handle_t)&g_adc, &ev, g_adc.user);
+            continue;
+        }
+        g_adc.pool.push_back(std::move(frame));
+        g_adc.frames++;
+        if (g_adc.cbs.on_conv_done) {
+            ev.conv_frame_buffer = g_adc.pool.back().data();
+            g_adc.cbs.on_conv_done((adc_continuous_handle_t)&g_adc, &ev, g_adc.user);
+        }
+    }
+}
+
+// Next moment something happens on its own (a DMA frame), or UINT64_MAX
+uint64_t nextEventUs() {
+    if (!g_adc.running || g_adc.rateHz == 0 || g_adc.patternLen == 0) return UINT64_MAX;
+    return (uint64_t)ceil(convTimeUs(g_adc.convIndex + convPerFrame()));
+}
+
+void setLevel(int pin, int level) {
+    if (pin < 0 || pin >= PINS) return;
+    Pin& p = g_pins[pin];
+    int old = p.level;
+    p.level = level ? 1 : 0;
+    if (p.hook) p.hook(p.level);
+    if ((p.isr || p.isrArg) && old != p.level) {
+        bool rising = p.level && !old;
+        if (p.isrMode == CHANGE || (p.isrMode == RISING && rising) || (p.isrMode == FALLING && !rising)) {
+            if (p.isr) p.isr();
+            else p.isrArg(p.isrCtx);
+        }
+    }
+}
+
+int analogChannel(int pin) {
+#if CONFIG_IDF_TARGET_ESP32S3
+    return (pin >= 1 && pin <= 10) ? pin - 1 : -1;     // ADC1_CH0..9
+#endif
+    switch (pin) {
+        case 36: return 0;
+        case 37: return 1;
+        case 38: return 2;
+        case 39: return 3;
+        case 32: return 4;
+        case 33: return 5;
+        case 34: return 6;
+        case 35: return 7;
+        default: return -1;
+    }
+}
+
+} // namespace
+
+/* =========================
+ * Test side
+ * ========================= */
+namespace host {
+
+void reset() {
+    g_nowUs = BOOT_US;
+    for (Pin& p : g_pins) p = Pin{};
+    g_adc.pool.clear();
+    g_adc = Adc{};
+    g_signal = nullptr;
+    g_signalCtx = nullptr;
+    g_adcPpm = 0;
+    g_notify = 0;
+    g_wakeups = 0;
+    g_semaphore = 0;
+}
+
+uint64_t nowUs() { return g_nowUs; }
+
+void advanceUs(uint64_t us) {
+    uint64_t target = g_nowUs + us;
+    produceFrames(target);
+    g_nowUs = target;
+}
+
+int pinLevel(int pin) { return (pin >= 0 && pin < PINS) ? g_pins[pin].level : 0; }
+void setInput(int pin, int level) { setLevel(pin, level); }
+void onPinWrite(int pin, void (*hook)(int)) { if (pin >= 0 && pin < PINS) g_pins[pin].hook = hook; }
+
+bool ledcOwnsPin(int pin) { return pin >= 0 && pin < PINS && g_pins[pin].ledc; }
+uint32_t ledcDuty(int pin) { return (pin >= 0 && pin < PINS) ? g_pins[pin].duty : 0; }
+uint32_t ledcAttachCount(int pin) { return (pin >= 0 && pin < PINS) ? g_pins[pin].attaches : 0; }
+
+void setAdcSignal(AdcSignal signal, void* ctx) { g_signal = signal; g_signalCtx = ctx; }
+bool adcRunning() { return g_adc.running; }
+uint32_t adcConvRateHz() { return g_adc.rateHz; }
+uint32_t adcFramesProduced() { return g_adc.frames; }
+uint32_t adcPoolOverflows() { return g_adc.overflows; }
+uint32_t adcFramePeriodUs() { return g_adc.rateHz ? (uint32_t)((uint64_t)convPerFrame() * 1000000ULL / g_adc.rateHz) : 0; }
+void setAdcClockPpm(int ppm) { g_adcPpm = ppm; }
+
+int calRawToMv(int raw) {
+    if (!g_calBuilt) buildCal();
+    if (raw < 0) raw = 0;
+    if (raw > 4095) raw = 4095;
+    return g_calTable[raw];
+}
+
+int calMvToRaw(int mv) {
+    if (!g_calBuilt) buildCal();
+    if (mv <= g_calTable[0]) return 0;
+    if (mv >= g_calTable[4095]) return 4095;
+    int lo = 0, hi = 4095;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (g_calTable[mid] <= mv) lo = mid; else hi = mid;
+    }
+    return (mv - g_calTable[lo] <= g_calTable[hi] - mv) ? lo : hi;
+}
+
+uint32_t taskWakeups() { return g_wakeups; }
+
+} // namespace host
+
+/* =========================
+ * Arduino core
+ * ========================= */
+size_t HardwareSerial::write(uint8_t c) {
+    if (g_log) putchar(c);
+    return 1;
+}
+
+unsigned long millis() { return (unsigned long)(g_nowUs / 1000ULL); }
+unsigned long micros() { return (unsigned long)g_nowUs; }
+void delay(unsigned long ms) { host::advanceMs(ms); }
+void delayMicroseconds(unsigned int us) { host::advanceUs(us); }
+int64_t esp_timer_get_time() { return (int64_t)g_nowUs; }
+
+void pinMode(int pin, int mode) {
+    if (pin < 0 || pin >= PINS) return;
+    if (mode == OUTPUT) g_pins[pin].ledc = false;          // Back to the GPIO matrix
+    if (mode == INPUT_PULLUP) g_pins[pin].level = 1;
+}
+void digitalWrite(int pin, int level) { setLevel(pin, level); }
+int digitalRead(int pin) { return host::pinLevel(pin); }
+int digitalPinToAnalogChannel(int pin) { return analogChannel(pin); }
+void attachInterrupt(int pin, void (*isr)(), int mode) {
+    if (pin < 0 || pin >= PINS) return;
+    g_pins[pin].isr = isr;
+    g_pins[pin].isrArg = nullptr;
+    g_pins[pin].isrMode = mode;
+}
+void attachInterruptArg(int pin, void (*isr)(void*), void* arg, int mode) {
+    if (pin < 0 || pin >= PINS) return;
+    g_pins[pin].isr = nullptr;
+    g_pins[pin].isrArg = isr;
+    g_pins[pin].isrCtx = arg;
+    g_pins[pin].isrMode = mode;
+}
+void detachInterrupt(int pin) {
+    if (pin < 0 || pin >= PINS) return;
+    g_pins[pin].isr = nullptr;
+    g_pins[pin].isrArg = nullptr;
+}
+int analogReadMilliVolts(int) { return 0; }
+
+bool ledcAttach(uint8_t pin, uint32_t, uint8_t) {
+    if (pin >= PINS) return false;
+    g_pins[pin].ledc = true;
+    g_pins[pin].duty = 0;
+    g_pins[pin].attaches++;
+    return true;
+}
+bool ledcDetach(uint8_t pin) {
+    if (pin >= PINS) return false;
+    g_pins[pin].ledc = false;
+    return true;
+}
+bool ledcWrite(uint8_t pin, uint32_t duty) {
+    if (pin >= PINS) return false;
+    g_pins[pin].duty = duty;
+    return true;
+}
+
+void esp_rom_gpio_connect_out_signal(uint32_t gpio, uint32_t, bool, bool) {
+    if (gpio < PINS) g_pins[gpio].ledc = false;
+}
+void gpio_ll_set_level(gpio_dev_t*, gpio_num_t gpio, uint32_t level) { setLevel(gpio, (int)level); }
+int gpio_ll_get_level(gpio_dev_t*, gpio_num_t gpio) { return host::pinLevel(gpio); }
+
+/* =========================
+ * ADC driver
+ * ========================= */
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* cfg, adc_continuous_handle_t* out) {
+    g_adc.pool.clear();
+    g_adc = Adc{};
+    g_adc.created = true;
+    g_adc.frameBytes = cfg->conv_frame_size;
+    g_adc.poolBytes = cfg->max_store_buf_size;
+    *out = (adc_continuous_handle_t)&g_adc;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_config(adc_continuous_handle_t, const adc_continuous_config_t* cfg) {
+    if (g_adc.running || cfg->pattern_num == 0 || cfg->pattern_num > 16) return ESP_FAIL;
+    if (cfg->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || cfg->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) return ESP_FAIL;
+    g_adc.rateHz = cfg->sample_freq_hz;
+    g_adc.patternLen = (int)cfg->pattern_num;
+    for (int i = 0; i < g_adc.patternLen; i++) g_adc.pattern[i] = cfg->adc_pattern[i].channel;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t, const adc_continuous_evt_cbs_t* cbs, void* user) {
+    g_adc.cbs = *cbs;
+    g_adc.user = user;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_start(adc_continuous_handle_t) {
+    g_adc.running = true;
+    g_adc.startUs = g_nowUs;
+    g_adc.convIndex = 0;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_stop(adc_continuous_handle_t) {
+    g_adc.running = false;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t) {
+    g_adc.running = false;
+    g_adc.created = false;
+    g_adc.pool.clear();
+    return ESP_OK;
+}
+esp_err_t adc_continuous_read(adc_continuous_handle_t, uint8_t* buf, uint32_t max, uint32_t* outLen, uint32_t) {
+    *outLen = 0;
+    if (g_adc.pool.empty()) return ESP_ERR_TIMEOUT;
+    while (!g_adc.pool.empty() && *outLen + g_adc.pool.front().size() <= max) {
+        memcpy(buf + *outLen, g_adc.pool.front().data(), g_adc.pool.front().size());
+        *outLen += g_adc.pool.front().size();
+        g_adc.pool.pop_front();
+    }
+    return ESP_OK;
+}
+esp_err_t adc_continuous_io_to_channel(int io, adc_unit_t* unit, adc_channel_t* channel) {
+    int ch = analogChannel(io);
+    if (ch < 0) return ESP_FAIL;
+    *unit = ADC_UNIT_1;
+    *channel = (adc_channel_t)ch;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t*, adc_oneshot_unit_handle_t*) { return ESP_OK; }
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t, adc_channel_t, const adc_oneshot_chan_cfg_t*) { return ESP_OK; }
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t, adc_channel_t, int* out) { *out = 0; return ESP_OK; }
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t*, adc_cali_handle_t* out) {
+    *out = (adc_cali_handle_t)&g_calTable;
+    return ESP_OK;
+}
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t*, adc_cali_handle_t* out) {
+    *out = (adc_cali_handle_t)&g_calTable;
+    return ESP_OK;
+}
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t, int raw, int* mv) {
+    *mv = host::calRawToMv(raw);
+    return ESP_OK;
+}
+
+/* =========================
+ * FreeRTOS (single task)
+ * ========================= */
+SemaphoreHandle_t xSemaphoreCreateBinary() { return (SemaphoreHandle_t)&g_semaphore; }
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken) {
+    *(int*)sem = 1;
+    if (woken) *woken = pdFALSE;
+    return pdTRUE;
+}
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    if (*(int*)sem) {
+        *(int*)sem = 0;
+        return pdTRUE;
+    }
+    if (ticks) host::advanceMs(ticks);
+    if (*(int*)sem) {
+        *(int*)sem = 0;
+        return pdTRUE;
+    }
+    return pdFALSE;
+}
+void vTaskDelay(TickType_t ticks) {
+    host::advanceMs(ticks);
+    g_wakeups++;
+}
+TickType_t xTaskGetTickCount() { return (TickType_t)(g_nowUs / 1000ULL); }
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t* woken) {
+    g_notify++;
+    if (woken) *woken = pdTRUE;
+}
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    uint64_t deadline = g_nowUs + (uint64_t)ticks * 1000ULL;
+    while (g_notify == 0) {
+        uint64_t next = nextEventUs();
+        if (next > deadline) {
+            host::advanceUs(deadline - g_nowUs);
+            break;
+        }
+        host::advanceUs(next > g_nowUs ? next - g_nowUs : 0);
+    }
+    g_wakeups++;
+    uint32_t n = g_notify;
+    if (n) g_notify = clear ? 0 : n - 1;
+    return n;
+}
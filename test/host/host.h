@@ -0,0 +1,73 @@
+/*****************************************************************************
+ * @file host.h
+ * Simulated ESP32 peripherals for the host tests.
+ *
+ * @details
+ * The firmware modules are compiled unchanged against the headers in
+ * test/stubs; this file is the test side of those stubs. Time only moves
+ * when a test (or a blocking FreeRTOS call) advances it, and the continuous
+ * ADC produces its DMA frames as time passes: every conversion is sampled
+ * from the signal function at its own timestamp, the frame-done callback
+ * runs at the frame boundary and the pool overflows like the driver's when
+ * nobody reads it. Everything is single-threaded and deterministic.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+
+namespace host {
+
+// Back to power-on: clock at 1 s, pins low, no LEDC, ADC stopped, hooks cleared
+void reset();
+
+uint64_t nowUs();
+void advanceUs(uint64_t us);
+inline void advanceMs(uint32_t ms) { advanceUs((uint64_t)ms * 1000ULL); }
+
+/* =========================
+ * GPIO
+ * ========================= */
+int pinLevel(int pin);                          // Output level (GPIO matrix, not LEDC)
+void setInput(int pin, int level);              // Drives an input; runs an attached ISR on its edge
+void onPinWrite(int pin, void (*hook)(int level)); // Wiring, e.g. a test coil to a sensor
+
+/* =========================
+ * LEDC
+ * ========================= */
+bool ledcOwnsPin(int pin);                      // Attached and routed to the pin
+uint32_t ledcDuty(int pin);
+uint32_t ledcAttachCount(int pin);
+
+/* =========================
+ * Continuous ADC
+ * ========================= */
+// Raw 12-bit code seen by `channel` at time tUs
+typedef int (*AdcSignal)(int channel, uint64_t tUs, void* ctx);
+void setAdcSignal(AdcSignal signal, void* ctx);
+bool adcRunning();
+uint32_t adcConvRateHz();
+uint32_t adcFramesProduced();
+uint32_t adcPoolOverflows();
+uint32_t adcFramePeriodUs();
+// Clock of the ADC relative to esp_timer, in ppm (sample phase drifts against the PWM)
+void setAdcClockPpm(int ppm);
+
+// Fake line-fitting calibration, monotonic; the inverse gives the code for a voltage
+int calRawToMv(int raw);
+int calMvToRaw(int mv);
+
+/* =========================
+ * FreeRTOS
+ * ========================= */
+uint32_t taskWakeups();                         // ulTaskNotifyTake() / vTaskDelay() returns
+
+}
+
+#endif
@@ -0,0 +1,17 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host stand-in for the NVS-backed parts of EvseConfig.cpp used by the EVSE
+ *              task (lifetime energy register), kept in memory.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "EvseConfig.h"
+
+static uint64_t g_lifetimeMwh = 0;
+
+uint64_t loadLifetimeEnergy() { return g_lifetimeMwh; }
+void saveLifetimeEnergy(uint64_t milliWh) { g_lifetimeMwh = milliWh; }
@@ -0,0 +1,132 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host model of the control pilot line and the vehicle behind it. Produces
+ *              the raw ADC code for any instant from the LEDC / GPIO drive and the vehicle
+ *              state, with edge slew, ringing, noise and spikes.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "pilot_line.h"
+#include "host.h"
+#include "Pilot.h"
+
+PilotLine::PilotLine() {
+    host::setAdcSignal(signal, this);
+}
+
+bool PilotLine::pwmActive() const {
+    return host::ledcOwnsPin(PIN_PILOT_PWM_OUT) && host::ledcDuty(PIN_PILOT_PWM_OUT) > 0;
+}
+
+// Vehicle side of each J1772 state: +12V source through 1k into the vehicle's resistors
+int PilotLine::highMv() const {
+    switch (state) {
+        case VEHICLE_NOT_CONNECTED:              return 12000;
+        case VEHICLE_CONNECTED:                  return 9000;
+        case VEHICLE_READY:                      return 6000;
+        case VEHICLE_READY_VENTILATION_REQUIRED: return 3000;
+        case VEHICLE_NO_POWER:                   return 0;
+        case VEHICLE_ERROR:                      return 9000;
+        default:                                 return -12000;
+    }
+}
+
+// The vehicle diode blocks the -12V half, so it is unloaded in every state but E, and F
+// (modelled as the fault the diode check looks for: the negative half never appears)
+int PilotLine::lowMv() const {
+    if (state == VEHICLE_ERROR) return highMv();
+    return state == VEHICLE_NO_POWER ? 0 : -12000;
+}
+
+int PilotLine::pilotMvToRaw(int mv) {
+    float adMv = (float)mv / SCALE + ZERO_OFFSET_MV;
+    return host::calMvToRaw((int)lroundf(adMv));
+}
+
+float PilotLine::offeredA() const {
+    if (!pwmActive()) return 0.0f;
+    float duty = (float)host::ledcDuty(PIN_PILOT_PWM_OUT) * 100.0f / (float)PILOT_PWM_MAX_DUTY;
+    if (duty <= J1772_LOW_RANGE_MAX_DUTY) return duty * J1772_LOW_RANGE_FACTOR;
+    return (duty - J1772_HIGH_RANGE_OFFSET) * J1772_HIGH_RANGE_FACTOR;
+}
+
+float PilotLine::drawA(bool contactorClosed) const {
+    if (!contactorClosed || state != VEHICLE_READY || !pwmActive()) return 0.0f;
+    float a = offeredA();
+    return a < vehicleMaxA ? a : vehicleMaxA;
+}
+
+void PilotLine::update() {
+    if (!vehicleModel) return;
+    uint64_t now = host::nowUs();
+    bool pwm = pwmActive();
+    if (pwm != _lastPwm) {
+        _lastPwm = pwm;
+        if (pwm) _pwmSinceUs = now;
+        else _staticSinceUs = now;
+    }
+    if (!plugged) {
+        state = VEHICLE_NOT_CONNECTED;
+        return;
+    }
+    if (state == VEHICLE_NOT_CONNECTED) state = VEHICLE_CONNECTED;
+    if (state == VEHICLE_CONNECTED && pwm && wantsCharge && now - _pwmSinceUs >= closeS2Ms * 1000ULL) {
+        state = VEHICLE_READY;
+    } else if (state == VEHICLE_READY) {
+        if (!wantsCharge || (!pwm && now - _staticSinceUs >= openS2Ms * 1000ULL)) state = VEHICLE_CONNECTED;
+    }
+}
+
+// xorshift64*: same sequence on every run
+double PilotLine::uniform() {
+    _rng ^= _rng >> 12;
+    _rng ^= _rng << 25;
+    _rng ^= _rng >> 27;
+    return (double)((_rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+float PilotLine::gauss() {
+    double u1 = uniform(), u2 = uniform();
+    if (u1 < 1e-12) u1 = 1e-12;
+    return (float)(sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+// Damped oscillation left on the line once an edge has slewed, as a fraction of the step:
+// the plateau is first overshot by ringPct and the error decays with ringTauUs
+float PilotLine::ring(uint32_t sinceEdgeUs) const {
+    if (ringPct <= 0.0f) return 0.0f;
+    float t = (float)sinceEdgeUs;
+    return ringPct / 100.0f * expf(-t / ringTauUs) * cosf(2.0f * (float)M_PI * t / ringPeriodUs);
+}
+
+int PilotLine::sample(uint64_t tUs) {
+    int hi = highMv();
+    int lo = lowMv();
+    float f;                                        // 1 = high plateau, 0 = low plateau
+    if (pwmActive()) {
+        uint32_t highUs = (uint32_t)((uint64_t)host::ledcDuty(PIN_PILOT_PWM_OUT) * PILOT_PWM_PERIOD_US / PILOT_PWM_MAX_DUTY);
+        uint32_t p = (uint32_t)(tUs % PILOT_PWM_PERIOD_US);
+        if (p < edgeUs) f = (float)p / (float)edgeUs;
+        else if (p < highUs) f = 1.0f + ring(p - edgeUs);
+        else if (p < highUs + edgeUs) f = 1.0f - (float)(p - highUs) / (float)edgeUs;
+        else f = -ring(p - highUs - edgeUs);
+    } else {
+        f = host::pinLevel(PIN_PILOT_PWM_OUT) ? 1.0f : 0.0f;
+    }
+    int raw = pilotMvToRaw(lo + (int)lroundf(f * (float)(hi - lo)));
+    raw += (int)lroundf(gauss() * noiseRaw);
+    if (spikesPerFrame > 0.0f && uniform() < spikesPerFrame / (double)ADC_SAMPLES_COUNT) {
+        raw += uniform() < 0.5 ? spikeRaw : -spikeRaw;
+    }
+    return raw < 0 ? 0 : raw > ADC_RAW_CODES - 1 ? ADC_RAW_CODES - 1 : raw;
+}
+
+int PilotLine::signal(int channel, uint64_t tUs, void* ctx) {
+    PilotLine* self = (PilotLine*)ctx;
+    if (channel != digitalPinToAnalogChannel(PIN_PILOT_IN)) return 0;
+    return self->sample(tUs);
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************
+ * @file pilot_line.h
+ * Control pilot line and vehicle model for the host tests.
+ *
+ * @details
+ * Turns what the firmware drives on PIN_PILOT_PWM_OUT (LEDC duty or a static
+ * GPIO level) and the vehicle's S2 / diode state into the raw code the ADC
+ * converts at a given instant: J1772 plateau voltages, the board divider
+ * (ZERO_OFFSET_MV / SCALE from Pilot.h) and the fake calibration inverted,
+ * a finite edge slew with optional damped ringing after each edge, gaussian
+ * noise and occasional single-sample spikes.
+ *
+ * The optional vehicle model reacts like a car: it closes S2 (B -> C) a
+ * while after PWM appears and opens it again after the pilot goes back to
+ * a static +12V, drawing the offered current (capped at its own maximum)
+ * only while the contactor is closed.
+ *
+ * @copyright (C) Noel Vellemans 2026
+ * @license GNU General Public License v2.0 (GPLv2)
+ * @version 1.0.0
+ * @date 2026-01-02
+ ******************************************************************************/
+
+#ifndef PILOT_LINE_H_
+#define PILOT_LINE_H_
+
+#include <stdint.h>
+#include "EvseTypes.h"
+
+class PilotLine {
+public:
+    // Attaches itself as the ADC signal source
+    PilotLine();
+
+    // Line level presented by the vehicle side (A..E; F = State B with no negative half)
+    VEHICLE_STATE_T state = VEHICLE_NOT_CONNECTED;
+    float noiseRaw = 4.0f;          // Gaussian sigma, raw codes
+    float spikesPerFrame = 0.0f;    // Single-sample outliers, average per 128 conversions
+    int spikeRaw = 600;             // Outlier amplitude (either sign), raw codes
+    uint32_t edgeUs = 4;            // Linear slew time of each PWM edge
+    float ringPct = 0.0f;           // Overshoot after each edge, % of the step (0 = none)
+    float ringPeriodUs = 4.0f;      // Ringing period
+    float ringTauUs = 2.0f;         // Ringing decay time constant
+
+    // Vehicle model (used when enabled; otherwise `state` is set by the test)
+    bool vehicleModel = false;
+    bool plugged = false;
+    bool wantsCharge = true;
+    float vehicleMaxA = 32.0f;
+    uint32_t closeS2Ms = 500;       // PWM seen -> S2 closed (B -> C)
+    uint32_t openS2Ms = 300;        // Static +12V seen -> S2 open (C -> B)
+
+    // Advances the vehicle model to now (call once per EVSE cycle)
+    void update();
+    // Current the vehicle draws per phase: the offer while it is in C and the contactor is closed
+    float drawA(bool contactorClosed) const;
+    // Offered current read back from the LEDC duty, 0 = no PWM
+    float offeredA() const;
+
+    // Noise-free pilot-side plateaus for the present drive and state (mV)
+    int highMv() const;
+    int lowMv() const;
+    // Raw code of a pilot-side voltage (divider + inverse calibration, clipped)
+    static int pilotMvToRaw(int mv);
+
+private:
+    static int signal(int channel, uint64_t tUs, void* ctx);
+    int sample(uint64_t tUs);
+    bool pwmActive() const;
+    float ring(uint32_t sinceEdgeUs) const;
+    double uniform();
+    float gauss();
+
+    uint64_t _rng = 0x9E3779B97F4A7C15ULL;
+    uint64_t _pwmSinceUs = 0;
+    uint64_t _staticSinceUs = 0;
+    bool _lastPwm = false;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host build of the Arduino core subset used by the safety modules. Time,
+ *              GPIO and interrupts are simulated in host/host.cpp.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp32-hal-ledc.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int level);
+int digitalRead(int pin);
+int digitalPinToAnalogChannel(int pin);
+inline int digitalPinToInterrupt(int pin) { return pin; }
+void attachInterrupt(int pin, void (*isr)(), int mode);
+void attachInterruptArg(int pin, void (*isr)(void*), void* arg, int mode);
+void detachInterrupt(int pin);
+int analogReadMilliVolts(int pin);
+
+#define constrain(a, l, h) ((a) < (l) ? (l) : ((a) > (h) ? (h) : (a)))
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t n) {
+        for (size_t i = 0; i < n; i++) write(buf[i]);
+        return n;
+    }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t println(const char* s) { size_t n = print(s); return n + write('\n'); }
+    size_t print(int v) { char b[16]; snprintf(b, sizeof(b), "%d", v); return print(b); }
+    size_t println(int v) { char b[16]; snprintf(b, sizeof(b), "%d", v); return println(b); }
+};
+
+class Stream : public Print {};
+
+// Logger output: dropped unless EVSE_TEST_LOG is set in the environment
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+};
+extern HardwareSerial Serial;
+
+class String {
+    std::string s;
+public:
+    String() {}
+    String(const char* c) : s(c ? c : "") {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+    String(float v, int d = 2) { char b[32]; snprintf(b, sizeof(b), "%.*f", d, v); s = b; }
+    String(double v, int d = 2) { char b[32]; snprintf(b, sizeof(b), "%.*f", d, v); s = b; }
+    const char* c_str() const { return s.c_str(); }
+    size_t length() const { return s.size(); }
+    String operator+(const String& o) const { String r; r.s = s + o.s; return r; }
+    String& operator+=(const String& o) { s += o.s; return *this; }
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator!=(const String& o) const { return s != o.s; }
+};
+inline String operator+(const char* a, const String& b) { return String(a) + b; }
@@ -0,0 +1,12 @@
+#pragma once
+#include "hal/adc_types.h"
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_TIMEOUT 0x107
+typedef struct adc_oneshot_unit_ctx_t* adc_oneshot_unit_handle_t;
+typedef struct { adc_unit_t unit_id; } adc_oneshot_unit_init_cfg_t;
+typedef struct { adc_atten_t atten; adc_bitwidth_t bitwidth; } adc_oneshot_chan_cfg_t;
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t*, adc_oneshot_unit_handle_t*);
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t, adc_channel_t, const adc_oneshot_chan_cfg_t*);
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t, adc_channel_t, int*);
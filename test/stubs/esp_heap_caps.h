@@ -0,0 +1,8 @@
+#pragma once
+#include <stdlib.h>
+#define MALLOC_CAP_8BIT 0x04
+#define MALLOC_CAP_DMA 0x08
+#define MALLOC_CAP_SPIRAM 0x400
+#define MALLOC_CAP_INTERNAL 0x800
+inline void* heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void heap_caps_free(void* p) { free(p); }
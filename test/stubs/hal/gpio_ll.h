@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+typedef int gpio_num_t;
+struct gpio_dev_t { uint32_t unused; };
+extern gpio_dev_t GPIO;
+void gpio_ll_set_level(gpio_dev_t* hw, gpio_num_t gpio_num, uint32_t level);
+int gpio_ll_get_level(gpio_dev_t* hw, gpio_num_t gpio_num);
@@ -0,0 +1,6 @@
+#pragma once
+// Host build: the classic ESP32 register layout (TYPE1 DMA results, 20 kHz ADC floor), or
+// ESP32-S3 (TYPE2 results, 611 Hz floor) when built with -DCONFIG_IDF_TARGET_ESP32S3=1
+#ifndef CONFIG_IDF_TARGET_ESP32S3
+#define CONFIG_IDF_TARGET_ESP32 1
+#endif
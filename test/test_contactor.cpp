@@ -0,0 +1,187 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host test of the contactor feedback, built with the main contactor's
+ *              auxiliary contact fitted (RELAY_FB_PIN, see the Makefile).
+ *
+ *              Through the EVSE task: a contact that welds mid-session (still closed after
+ *              the coil is released) and one that never closes are each reported, open the
+ *              coil, end the session and lock out; a start is refused until the fault is
+ *              gone and the vehicle has been unplugged. Then a bare relay with known close
+ *              and open delays: every operation must land in its RELAY_HIST_EDGES_MS bin,
+ *              timed to the feedback edge even when the relay polls well after it.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "check.h"
+#include "evse_bench.h"
+
+static_assert(PIN_RELAY_FB_IN >= 0, "build with RELAY_FB_PIN set");
+
+static constexpr uint32_t POLL_LATE_US = 3000;      // Relay polls this long after the edge
+
+// Main contactor: the aux contact (low = closed) follows the coil without delay, unless
+// the contacts are welded shut or the contactor never pulls in
+static bool welded = false;
+static bool stuckOpen = false;
+static int coilCloses = 0;
+static void contactor(int coil) {
+    if (coil) coilCloses++;
+    bool closed = welded || (coil && !stuckOpen);
+    host::setInput(PIN_RELAY_FB_IN, closed ? 0 : 1);
+}
+
+static EvseSnapshot snap(EvseBench& bench) { return bench.evse.getSnapshot(); }
+
+static bool startCharging(EvseBench& bench) {
+    bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+    return bench.runUntil([&] { return bench.contactorClosed() && bench.drawA() > 0.0f; }, 10000);
+}
+
+// Start refused: no coil pulse, no session
+static void checkStartRefused(EvseBench& bench) {
+    int closes = coilCloses;
+    bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+    bench.runMs(5000);
+    CHECK_EQ(coilCloses, closes);
+    CHECK(!bench.contactorClosed());
+    CHECK(snap(bench).state != STATE_CHARGING);
+    CHECK(snap(bench).lockout);
+}
+
+static void replug(EvseBench& bench) {
+    bench.line.plugged = false;
+    bench.runMs(1000);
+    bench.line.plugged = true;
+    bench.runMs(1000);
+}
+
+// Bare relay: one operation whose aux contact moves `delayUs` after the coil
+static uint32_t operate(Relay& relay, bool close, uint32_t delayUs) {
+    if (close) relay.close();
+    else relay.open();
+    relay.loop();
+    relay.loop();                                   // Contact not there yet: still awaiting
+    host::advanceUs(delayUs);
+    host::setInput(PIN_RELAY_FB_IN, close ? 0 : 1);
+    host::advanceUs(POLL_LATE_US);
+    relay.loop();
+    host::advanceMs(3000);                          // Past the anti-chatter delay
+    return close ? relay.getTiming().lastCloseUs : relay.getTiming().lastOpenUs;
+}
+
+static int binOf(uint32_t us) {
+    int bin = 0;
+    while (bin < RELAY_HIST_BINS - 1 && us > (uint32_t)RELAY_HIST_EDGES_MS[bin] * 1000UL) bin++;
+    return bin;
+}
+
+int main()
+{
+    ChargingSettings cs;
+    cs.maxCurrent = 16.0f;
+    cs.softStart = false;
+
+    // Welded: the coil is released at stop, the contact stays closed
+    {
+        host::reset();
+        welded = stuckOpen = false;
+        host::onPinWrite(PIN_RELAY_OUT, contactor);
+        EvseBench bench(cs);
+        bench.line.plugged = true;
+        bench.runMs(1000);
+        CHECK(startCharging(bench));
+        CHECK_EQ(snap(bench).contactorFault, RELAY_FAULT_NONE);
+
+        welded = true;
+        bench.evse.post(EVSE_CMD_STOP, EVSE_SRC_WEB);
+        bench.runMs(RELAY_FB_TIMEOUT_MS + 100);
+        CHECK(!bench.contactorClosed());
+        CHECK_EQ(host::pinLevel(PIN_RELAY_FB_IN), 0);
+        CHECK_EQ(snap(bench).contactorFault, RELAY_FAULT_WELDED);
+        CHECK(snap(bench).lockout);
+        checkStartRefused(bench);
+
+        // Unplugging does not clear a weld that is still there
+        replug(bench);
+        CHECK_EQ(snap(bench).contactorFault, RELAY_FAULT_WELDED);
+        checkStartRefused(bench);
+
+        // Repaired: the fault clears, the next session needs an unplug
+        welded = false;
+        host::setInput(PIN_RELAY_FB_IN, 1);
+        bench.runMs(100);
+        CHECK_EQ(snap(bench).contactorFault, RELAY_FAULT_NONE);
+        checkStartRefused(bench);
+        replug(bench);
+        CHECK(startCharging(bench));
+        CHECK_EQ(snap(bench).contactorFault, RELAY_FAULT_NONE);
+    }
+
+    // Fails to close: the coil pulls, the contact stays open
+    {
+        host::reset();
+        welded = false;
+        stuckOpen = true;
+        coilCloses = 0;
+        host::onPinWrite(PIN_RELAY_OUT, contactor);
+        EvseBench bench(cs);
+        bench.line.plugged = true;
+        bench.runMs(1000);
+        bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+        bench.runMs(2000);
+        CHECK_EQ(coilCloses, 1);
+        CHECK(!bench.contactorClosed());
+        CHECK(snap(bench).state != STATE_CHARGING);
+        CHECK(snap(bench).lockout);
+        // The coil is released, so the feedback agrees again; the lockout must still hold
+        CHECK_EQ(snap(bench).contactorFault, RELAY_FAULT_NONE);
+        checkStartRefused(bench);
+
+        stuckOpen = false;
+        replug(bench);
+        CHECK(startCharging(bench));
+    }
+
+    // Known switching delays into the histograms
+    {
+        host::reset();
+        welded = stuckOpen = false;
+        Relay relay(PIN_RELAY_OUT, "RELAY", PIN_RELAY_FB_IN);
+        relay.setup(LOW);
+        host::advanceMs(300);
+        relay.loop();                               // Initial open state confirmed (counted)
+        const RelayTiming base = relay.getTiming();
+
+        static const uint32_t delaysMs[] = { 8, 12, 18, 25, 40, 60, 90, 150 };
+        printf("Contactor timing: feedback %lu us after each edge\n", (unsigned long)POLL_LATE_US);
+        printf("  delay ms |  close us bin |   open us bin\n");
+        for (uint32_t ms : delaysMs) {
+            RelayTiming before = relay.getTiming();
+            uint32_t closeUs = operate(relay, true, ms * 1000);
+            uint32_t openUs = operate(relay, false, ms * 1000);
+            const RelayTiming& t = relay.getTiming();
+            int bin = binOf(ms * 1000);
+            printf("  %8lu | %8lu %3d | %8lu %3d\n", (unsigned long)ms, (unsigned long)closeUs, binOf(closeUs),
+                   (unsigned long)openUs, binOf(openUs));
+            CHECK_EQ(closeUs, ms * 1000);
+            CHECK_EQ(openUs, ms * 1000);
+            CHECK_EQ(t.closeHist[bin], before.closeHist[bin] + 1);
+            CHECK_EQ(t.openHist[bin], before.openHist[bin] + 1);
+        }
+        const RelayTiming& t = relay.getTiming();
+        for (int bin = 0; bin < RELAY_HIST_BINS; bin++) {
+            CHECK_EQ(t.closeHist[bin], base.closeHist[bin] + 1);
+            CHECK_EQ(t.openHist[bin], base.openHist[bin] + 1);
+        }
+        CHECK_EQ(t.closeOps, base.closeOps + 8);
+        CHECK_EQ(t.openOps, base.openOps + 8);
+        CHECK_EQ(t.maxCloseUs, 150000u);
+        CHECK_EQ(relay.getFault(), RELAY_FAULT_NONE);
+    }
+
+    return checkResult("test_contactor");
+}
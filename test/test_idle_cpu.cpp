@@ -0,0 +1,145 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Idle benchmark of the pilot path in the EVSE task, full-rate profile vs the
+ *              presence-watch profile, in State A with no vehicle. Reports per second of
+ *              simulated time: ADC frame interrupts, EVSE task wakeups and timeouts, pilot
+ *              samples processed and the host CPU time spent in Pilot::read(). Built for
+ *              ESP32 and (build/s3/) ESP32-S3, whose ADC floors differ (20kHz vs 611Hz).
+ *
+ *              Also checks that the frame wait never times out in either profile, that
+ *              the watch profile batches wakeups to PILOT_WATCH_WAKE_MS and that a plug-in
+ *              is still seen within the A -> B dwell plus one batch.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include <time.h>
+#include "check.h"
+#include "host.h"
+#include "pilot_line.h"
+#include "Pilot.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+static const char* TARGET = "ESP32-S3";
+#else
+static const char* TARGET = "ESP32";
+#endif
+
+struct Load {
+    double irqPerS, wakePerS, timeoutPerS, samplesPerS, readCpuUsPerS;
+    uint32_t overflows;
+};
+
+static uint64_t cpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// One pass of the EVSE task loop, pilot part only (as in evseLoopTask)
+static uint64_t g_readNs = 0;
+static VEHICLE_STATE_T taskPass(Pilot& pilot)
+{
+    bool frame = pilot.waitForFrame(pilot.getFrameTimeoutMs());
+    uint64_t t0 = cpuNs();
+    VEHICLE_STATE_T s = pilot.read();
+    g_readNs += cpuNs() - t0;
+    if (frame) pilot.frameProcessed();
+    return s;
+}
+
+static Load measure(Pilot& pilot, uint32_t ms)
+{
+    uint32_t frames0 = host::adcFramesProduced();
+    uint32_t wake0 = pilot.getFrameWakeups(), tmo0 = pilot.getFrameTimeouts();
+    uint32_t ovf0 = pilot.getPoolOverflows();
+    g_readNs = 0;
+    uint64_t end = host::nowUs() + (uint64_t)ms * 1000ULL;
+    while (host::nowUs() < end) taskPass(pilot);
+
+    double s = ms / 1000.0;
+    Load l;
+    l.irqPerS = (host::adcFramesProduced() - frames0) / s;
+    l.wakePerS = (pilot.getFrameWakeups() - wake0) / s;
+    l.timeoutPerS = (pilot.getFrameTimeouts() - tmo0) / s;
+    l.samplesPerS = l.irqPerS * (ADC_READ_BYTE_LEN / SOC_ADC_DIGI_RESULT_BYTES);
+    l.readCpuUsPerS = g_readNs / 1000.0 / s;
+    l.overflows = pilot.getPoolOverflows() - ovf0;
+    return l;
+}
+
+static void report(const char* name, const Pilot& pilot, const Load& l)
+{
+    printf("  %-5s %6lu Hz | %7.1f %7.1f %6.2f | %8.0f | %8.1f | %5lu ms\n", name,
+           (unsigned long)pilot.getPilotSampleRate(), l.irqPerS, l.wakePerS, l.timeoutPerS, l.samplesPerS,
+           l.readCpuUsPerS, (unsigned long)pilot.getFrameTimeoutMs());
+}
+
+int main()
+{
+    host::reset();
+    PilotLine line;
+    line.vehicleModel = true;
+    Pilot pilot;
+    pilot.begin();
+    pilot.standby();                        // +12V static, as EvseCharge::setup() leaves it
+    pilot.attachFrameTask((TaskHandle_t)&pilot);
+
+    printf("%s idle (State A, no PWM), per second of simulated time\n", TARGET);
+    printf("  profile  pilot rate |  ADC irq  wakeup timeout |  samples | read() us | timeout\n");
+
+    // Full rate until PILOT_WATCH_ENTER_MS of idle has passed
+    taskPass(pilot);
+    CHECK(!pilot.isWatchProfile());
+    Load full = measure(pilot, PILOT_WATCH_ENTER_MS - 500);
+    CHECK(!pilot.isWatchProfile());
+    report("FULL", pilot, full);
+
+    measure(pilot, 1000);
+    CHECK(pilot.isWatchProfile());
+    Load watch = measure(pilot, 10000);
+    CHECK(pilot.isWatchProfile());
+    report("WATCH", pilot, watch);
+    printf("  watch / full: irq %.2f, wakeups %.2f, samples %.2f, read() CPU %.2f\n",
+           watch.irqPerS / full.irqPerS, watch.wakePerS / full.wakePerS, watch.samplesPerS / full.samplesPerS,
+           watch.readCpuUsPerS / full.readCpuUsPerS);
+
+    // Every wait ends with a frame, no frame is lost
+    CHECK(full.timeoutPerS == 0.0);
+    CHECK(watch.timeoutPerS == 0.0);
+    CHECK_EQ(full.overflows, 0);
+    CHECK_EQ(watch.overflows, 0);
+
+    // Full rate: one wakeup per frame. Watch: batched to PILOT_WATCH_WAKE_MS (or one frame
+    // when a single frame already takes longer)
+    CHECK_NEAR(full.wakePerS, full.irqPerS, 1.0);
+    double framePeriodS = 1.0 / watch.irqPerS;
+    double expectWake = framePeriodS * 1000.0 >= PILOT_WATCH_WAKE_MS
+                        ? watch.irqPerS : 1000.0 / PILOT_WATCH_WAKE_MS;
+    CHECK(watch.wakePerS <= expectWake * 1.25);
+    CHECK(watch.wakePerS < full.wakePerS / 4);
+
+    // Plug-in from the watch profile: committed within the A -> B dwell plus one watch wakeup
+    // and one full-rate frame, and back at full rate
+    uint64_t t0 = host::nowUs();
+    line.plugged = true;
+    line.update();
+    uint64_t detectUs = 0;
+    while (host::nowUs() - t0 < 500000) {
+        if (taskPass(pilot) == VEHICLE_CONNECTED) { detectUs = host::nowUs() - t0; break; }
+    }
+    uint32_t wakeMs = pilot.getFrameTimeoutMs() - PILOT_FRAME_TIMEOUT_MS;
+    printf("  plug-in seen after %.1f ms (dwell %lu ms), profile %s\n", detectUs / 1000.0,
+           (unsigned long)PILOT_DWELL_PLUG_MS, pilot.isWatchProfile() ? "WATCH" : "FULL");
+    CHECK(detectUs > 0);
+    CHECK(detectUs <= (PILOT_DWELL_PLUG_MS + PILOT_WATCH_WAKE_MS + 2 * wakeMs + 2) * 1000ULL);
+    CHECK(!pilot.isWatchProfile());
+
+    char name[40];
+    snprintf(name, sizeof(name), "test_idle_cpu (%s)", TARGET);
+    return checkResult(name);
+}
@@ -0,0 +1,353 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host test of 1-phase / 3-phase switching through the real EVSE task, built
+ *              with a phase contactor fitted (PHASE_RELAY_PIN, see the Makefile).
+ *
+ *              The sequence STOPPING (pilot +12V until the vehicle leaves C or
+ *              PHASE_SWITCH_STOP_TIMEOUT_MS) -> SETTLING (phase contactor switched with the main
+ *              contactor open, held PHASE_SWITCH_SETTLE_MS) -> IDLE is checked from the pins:
+ *              mid-charge, with a vehicle that ignores +12V, cancelled, re-targeted while
+ *              settling and during a low-limit pause. Then the solar controller's choice:
+ *              hysteresis, dwell and the minimum gap between switches.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "check.h"
+#include "evse_bench.h"
+#include "EvseSolar.h"
+
+static_assert(PIN_PHASE_RELAY_OUT >= 0, "build with PHASE_RELAY_PIN set");
+
+static constexpr float VOLTS = 230.0f;
+
+static bool phaseContactorClosed() { return host::pinLevel(PIN_PHASE_RELAY_OUT) != 0; }
+static float msSince(uint64_t us) { return (float)(host::nowUs() - us) / 1000.0f; }
+static float msBetween(uint64_t fromUs, uint64_t toUs) { return (float)(toUs - fromUs) / 1000.0f; }
+
+// Edges on the contactor pins and the published switching flag, sampled every EVSE cycle
+struct Trace {
+    EvseBench& bench;
+    bool main = false, phase = false, switching = false;
+    int phaseEdges = 0;
+    int phaseEdgesUnderLoad = 0;                    // Phase contactor moved with the main one closed
+    int switchStarts = 0;
+    uint64_t phaseEdgeUs = 0, mainOpenUs = 0, mainCloseUs = 0, switchStartUs = 0, switchEndUs = 0;
+    uint64_t standbyUs = 0;                         // First cycle at static +12V while switching
+
+    explicit Trace(EvseBench& b) : bench(b) { reset(); }
+
+    void reset() {
+        main = bench.contactorClosed();
+        phase = phaseContactorClosed();
+        switching = bench.evse.getSnapshot().phaseSwitching;
+        phaseEdges = phaseEdgesUnderLoad = switchStarts = 0;
+        phaseEdgeUs = mainOpenUs = mainCloseUs = switchStartUs = switchEndUs = standbyUs = 0;
+    }
+
+    void operator()() {
+        uint64_t now = host::nowUs();
+        bool m = bench.contactorClosed();
+        bool p = phaseContactorClosed();
+        bool s = bench.evse.getSnapshot().phaseSwitching;
+        if (p != phase) {
+            phaseEdges++;
+            phaseEdgeUs = now;
+            if (m || main) phaseEdgesUnderLoad++;
+        }
+        if (m != main) (m ? mainCloseUs : mainOpenUs) = now;
+        if (s != switching) {
+            if (s) {
+                switchStarts++;
+                switchStartUs = now;
+            } else {
+                switchEndUs = now;
+            }
+        }
+        if (s && !standbyUs && bench.line.offeredA() == 0.0f) standbyUs = now;
+        main = m;
+        phase = p;
+        switching = s;
+    }
+};
+
+static bool charging(EvseBench& bench) {
+    return bench.evse.getState() == STATE_CHARGING && bench.contactorClosed() && bench.drawA() > 0.0f;
+}
+
+static void plugAndStart(EvseBench& bench) {
+    bench.line.plugged = true;
+    bench.runMs(1000);
+    bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+    CHECK(bench.runUntil([&] { return charging(bench); }, 10000));
+}
+
+/* =========================
+ * Sequence
+ * ========================= */
+
+static void midCharge()
+{
+    host::reset();
+    ChargingSettings cs;
+    cs.maxCurrent = 16.0f;
+    cs.softStart = false;
+    EvseBench bench(cs);
+    CHECK(bench.evse.canSwitchPhases());
+    CHECK_EQ(bench.evse.getActivePhases(), 3);
+    CHECK(phaseContactorClosed());
+    plugAndStart(bench);
+    bench.runMs(5000);                              // Past the main contactor's anti-chatter
+
+    // 3 -> 1 while drawing 16 A
+    Trace t(bench);
+    uint64_t t0 = host::nowUs();
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 1);
+    CHECK(bench.runUntil([&] { return t.switchEndUs && charging(bench); }, 30000, std::ref(t)));
+    printf("  3 -> 1 mid-charge         : +12V after %4.0f ms, main open after %4.0f ms, phase contactor "
+           "%4.0f ms later, settled %5.0f ms, charging again after %5.0f ms\n",
+           msBetween(t0, t.standbyUs), msBetween(t0, t.mainOpenUs), msBetween(t.mainOpenUs, t.phaseEdgeUs),
+           msBetween(t.phaseEdgeUs, t.switchEndUs), msBetween(t0, t.mainCloseUs));
+    CHECK_EQ(t.switchStarts, 1);
+    CHECK(msBetween(t0, t.standbyUs) < 50.0f);
+    // STOPPING: the vehicle left C (S2 opens 300 ms after +12V), long before the timeout
+    CHECK(msBetween(t0, t.mainOpenUs) >= bench.line.openS2Ms);
+    CHECK(msBetween(t0, t.mainOpenUs) < PHASE_SWITCH_STOP_TIMEOUT_MS);
+    // SETTLING: one phase contactor edge, with the main contactor open, held for the settle time
+    CHECK_EQ(t.phaseEdges, 1);
+    CHECK_EQ(t.phaseEdgesUnderLoad, 0);
+    CHECK(!phaseContactorClosed());
+    CHECK(t.phaseEdgeUs >= t.mainOpenUs);
+    CHECK(msBetween(t.phaseEdgeUs, t.switchEndUs) >= PHASE_SWITCH_SETTLE_MS);
+    CHECK(msBetween(t.phaseEdgeUs, t.switchEndUs) < PHASE_SWITCH_SETTLE_MS + 100);
+    CHECK(t.mainCloseUs > t.switchEndUs);
+    // IDLE: 1-phase at the full limit
+    CHECK_EQ(bench.evse.getActivePhases(), 1);
+    CHECK_EQ(bench.evse.getSnapshot().phases, 1);
+    CHECK_EQ(bench.evse.getPhaseSwitchCount(), 1u);
+    CHECK_NEAR(bench.drawA(), 16.0f, 0.1f);
+
+    // 1 -> 3 with a vehicle that ignores +12V: the main contactor opens under load after
+    // the IEC 61851 reaction time
+    bench.runMs(5000);
+    bench.line.openS2Ms = 60000;
+    t.reset();
+    t0 = host::nowUs();
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 3);
+    CHECK(bench.runUntil([&] { return t.phaseEdges > 0; }, 10000, std::ref(t)));
+    printf("  1 -> 3, vehicle stays in C: main open after %4.0f ms\n", msBetween(t0, t.mainOpenUs));
+    CHECK(msBetween(t0, t.mainOpenUs) >= PHASE_SWITCH_STOP_TIMEOUT_MS);
+    CHECK(msBetween(t0, t.mainOpenUs) < PHASE_SWITCH_STOP_TIMEOUT_MS + 50);
+    CHECK_EQ(t.phaseEdgesUnderLoad, 0);
+    bench.line.openS2Ms = 300;
+    CHECK(bench.runUntil([&] { return t.switchEndUs && charging(bench); }, 30000, std::ref(t)));
+    CHECK(phaseContactorClosed());
+    CHECK_EQ(bench.evse.getActivePhases(), 3);
+    CHECK_EQ(bench.evse.getPhaseSwitchCount(), 2u);
+
+    // Cancelled while stopping: back to the same phases, the phase contactor never moves
+    bench.runMs(5000);
+    t.reset();
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 1);
+    bench.runMs(100, std::ref(t));
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 3);
+    CHECK(bench.runUntil([&] { return !t.switching && charging(bench); }, 10000, std::ref(t)));
+    bench.runMs(1000, std::ref(t));
+    CHECK_EQ(t.phaseEdges, 0);
+    CHECK_EQ(bench.evse.getActivePhases(), 3);
+    CHECK_EQ(bench.evse.getPhaseSwitchCount(), 2u);
+
+    // Re-targeted while settling: switched back without closing the main contactor in
+    // between, settled again, nothing counted
+    bench.runMs(5000);
+    t.reset();
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 1);
+    CHECK(bench.runUntil([&] { return t.phaseEdges == 1; }, 10000, std::ref(t)));
+    uint64_t firstEdgeUs = t.phaseEdgeUs;
+    bench.runMs(2000, std::ref(t));
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 3);
+    CHECK(bench.runUntil([&] { return t.switchEndUs && charging(bench); }, 40000, std::ref(t)));
+    printf("  1 while settling -> 3     : switched back %5.0f ms after the first switch, settled %5.0f ms\n",
+           msBetween(firstEdgeUs, t.phaseEdgeUs), msBetween(t.phaseEdgeUs, t.switchEndUs));
+    CHECK_EQ(t.phaseEdges, 2);
+    CHECK_EQ(t.phaseEdgesUnderLoad, 0);
+    CHECK_EQ(t.switchStarts, 1);
+    CHECK(msBetween(firstEdgeUs, t.phaseEdgeUs) >= PHASE_SWITCH_SETTLE_MS);
+    CHECK(msBetween(t.phaseEdgeUs, t.switchEndUs) >= PHASE_SWITCH_SETTLE_MS);
+    CHECK(t.mainCloseUs > t.switchEndUs);
+    CHECK_EQ(bench.evse.getActivePhases(), 3);
+    CHECK_EQ(bench.evse.getPhaseSwitchCount(), 2u);
+}
+
+static void duringLowLimitPause()
+{
+    host::reset();
+    ChargingSettings cs;
+    cs.maxCurrent = 16.0f;
+    cs.softStart = false;
+    cs.disableAtLowLimit = true;                    // Strict: below 6 A the contactor opens
+    cs.lowLimitResumeDelayMs = 30000;
+    EvseBench bench(cs);
+    plugAndStart(bench);
+    bench.runMs(5000);
+
+    // Limit below 6 A: paused with the contactor open
+    bench.evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_WEB, 40);
+    CHECK(bench.runUntil([&] { return !bench.contactorClosed(); }, 5000));
+    uint64_t pausedUs = host::nowUs();
+    bench.runMs(2000);
+
+    // Nothing to stop: the phase contactor switches at once, then settles
+    Trace t(bench);
+    uint64_t t0 = host::nowUs();
+    bench.evse.post(EVSE_CMD_SET_PHASES, EVSE_SRC_WEB, 1);
+    CHECK(bench.runUntil([&] { return t.switchEndUs != 0; }, 20000, std::ref(t)));
+    printf("  3 -> 1 in low-limit pause : phase contactor after %4.0f ms, settled %5.0f ms\n",
+           msBetween(t0, t.phaseEdgeUs), msBetween(t.phaseEdgeUs, t.switchEndUs));
+    CHECK(msBetween(t0, t.phaseEdgeUs) < 50.0f);
+    CHECK_EQ(t.phaseEdges, 1);
+    CHECK_EQ(t.phaseEdgesUnderLoad, 0);
+    CHECK(msBetween(t.phaseEdgeUs, t.switchEndUs) >= PHASE_SWITCH_SETTLE_MS);
+    CHECK_EQ(bench.evse.getActivePhases(), 1);
+
+    // Still below 6 A: the pause carries on, with its PWM back
+    bench.runMs(2000, std::ref(t));
+    CHECK(!bench.contactorClosed());
+    CHECK(bench.line.offeredA() > 0.0f);
+    CHECK_EQ(t.mainCloseUs, 0u);
+
+    // Enough current again: resumes 1-phase once the pause delay (counted from the pause,
+    // not from the switch) has run out
+    bench.evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_WEB, 100);
+    CHECK(bench.runUntil([&] { return charging(bench); }, 40000, std::ref(t)));
+    printf("  resumed 1-phase           : %5.0f ms after the pause began\n", msSince(pausedUs));
+    CHECK(msSince(pausedUs) >= cs.lowLimitResumeDelayMs);
+    CHECK(msSince(pausedUs) < cs.lowLimitResumeDelayMs + 2000);
+    CHECK_EQ(bench.evse.getSnapshot().phases, 1);
+    CHECK_NEAR(bench.drawA(), 10.0f, 0.1f);
+}
+
+/* =========================
+ * Solar phase choice
+ * ========================= */
+
+// Site whose surplus is set directly: what the charger may use is pvW - houseW, whatever
+// it draws; the meter reads every second
+struct Surplus {
+    EvseBench& bench;
+    EvseSolarController& solar;
+    Trace trace;
+    float availW = 0.0f;
+    uint64_t nextMeterUs;
+
+    Surplus(EvseBench& b, EvseSolarController& s) : bench(b), solar(s), trace(b) { nextMeterUs = host::nowUs(); }
+
+    void setPerPhase3(float amps) { availW = amps * VOLTS * 3.0f; }
+
+    void tick() {
+        if (host::nowUs() >= nextMeterUs) {
+            nextMeterUs += 1000000ULL;
+            float drawA = bench.drawA();
+            bench.feedMeter(drawA);
+            solar.updateGridPower(drawA * VOLTS * bench.evse.getActivePhases() - availW);
+        }
+        solar.loop();
+        trace();
+    }
+
+    void run(uint32_t ms) { bench.runMs(ms, [this] { tick(); }); }
+    // ms until a switch starts, -1 if none within `ms`
+    long untilSwitch(uint32_t ms) {
+        int starts = trace.switchStarts;
+        uint64_t t0 = host::nowUs();
+        if (!bench.runUntil([&] { return trace.switchStarts > starts; }, ms, [this] { tick(); })) return -1;
+        return (long)((host::nowUs() - t0) / 1000);
+    }
+    void finishSwitch() {
+        CHECK(bench.runUntil([&] { return !trace.switching && charging(bench); }, 30000, [this] { tick(); }));
+    }
+};
+
+static void solarChoice()
+{
+    host::reset();
+    ChargingSettings cs;
+    cs.maxCurrent = 16.0f;
+    cs.disableAtLowLimit = false;                   // Throttle: 1-phase whenever 3-phase < 6 A
+    EvseBench bench(cs);
+    EvseSolarController solar(bench.evse);
+    Surplus site(bench, solar);
+    SolarParams sp;
+    sp.enabled = true;
+    sp.autoPhase = true;
+    solar.setParams(sp);
+
+    site.setPerPhase3(8.0f);
+    bench.line.plugged = true;
+    site.run(1000);
+    bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+    site.run(120000);
+    CHECK(charging(bench));
+    CHECK_EQ(site.trace.switchStarts, 0);
+    CHECK_EQ(bench.evse.getActivePhases(), 3);
+
+    // Below 6 A per phase on three: 1-phase after the dwell. The charger's own draw comes
+    // from the EVSE meter, a reading behind the grid meter while the offer ramps down, so
+    // the controller sees the drop a few seconds late
+    site.setPerPhase3(5.0f);
+    long down = site.untilSwitch(120000);
+    printf("  5 A/phase on 3-phase      : 1-phase requested after %6.1f s (dwell %lu s)\n", down / 1000.0f,
+           SOLAR_PHASE_DWELL_MS / 1000);
+    CHECK(down >= (long)SOLAR_PHASE_DWELL_MS && down < (long)SOLAR_PHASE_DWELL_MS + 5000);
+    site.finishSwitch();
+    CHECK_EQ(bench.evse.getActivePhases(), 1);
+
+    // Hysteresis: 6.5 A per phase would run 3-phase, but not 1 A above the minimum; stays
+    // 1-phase well past the gap
+    site.setPerPhase3(MIN_CURRENT + SOLAR_PHASE_HYST_A / 2);
+    site.run(SOLAR_PHASE_MIN_GAP_MS + 100000);
+    CHECK_EQ(site.trace.switchStarts, 1);
+    CHECK_EQ(bench.evse.getActivePhases(), 1);
+
+    // Dwell: excursions above the threshold shorter than the dwell never switch
+    for (int i = 0; i < 6; i++) {
+        site.setPerPhase3(MIN_CURRENT + SOLAR_PHASE_HYST_A + 0.5f);
+        site.run(SOLAR_PHASE_DWELL_MS - 20000);
+        site.setPerPhase3(MIN_CURRENT + SOLAR_PHASE_HYST_A / 2);
+        site.run(10000);
+    }
+    CHECK_EQ(site.trace.switchStarts, 1);
+
+    // Held above it: back to 3-phase after the dwell
+    site.setPerPhase3(MIN_CURRENT + SOLAR_PHASE_HYST_A + 0.5f);
+    long up = site.untilSwitch(120000);
+    printf("  7.5 A/phase on 1-phase    : 3-phase requested after %6.1f s\n", up / 1000.0f);
+    CHECK(up >= (long)SOLAR_PHASE_DWELL_MS && up < (long)SOLAR_PHASE_DWELL_MS + 2000);
+    uint64_t lastSwitchUs = site.trace.switchStartUs;
+    site.finishSwitch();
+    CHECK_EQ(bench.evse.getActivePhases(), 3);
+
+    // Drop again straight away: the dwell is met after a minute, the gap holds it to five
+    site.setPerPhase3(5.0f);
+    CHECK(site.untilSwitch(SOLAR_PHASE_MIN_GAP_MS + 20000) >= 0);
+    float gapS = msBetween(lastSwitchUs, site.trace.switchStartUs) / 1000.0f;
+    printf("  5 A/phase right after     : 1-phase requested %6.1f s after the last switch (gap %lu s)\n", gapS,
+           SOLAR_PHASE_MIN_GAP_MS / 1000);
+    CHECK(gapS >= SOLAR_PHASE_MIN_GAP_MS / 1000.0f && gapS < SOLAR_PHASE_MIN_GAP_MS / 1000.0f + 2.0f);
+    site.finishSwitch();
+    CHECK_EQ(bench.evse.getActivePhases(), 1);
+    CHECK_EQ(site.trace.phaseEdgesUnderLoad, 0);
+}
+
+int main()
+{
+    printf("Phase switching (settle %lu ms, stop timeout %lu ms)\n", PHASE_SWITCH_SETTLE_MS,
+           PHASE_SWITCH_STOP_TIMEOUT_MS);
+    midCharge();
+    duringLowLimitPause();
+    solarChoice();
+    return checkResult("test_phase_switch");
+}
@@ -0,0 +1,147 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host test of the time-based pilot debounce in Pilot::read(): every
+ *              (from, to) transition between A..F commits no earlier than its dwell and at
+ *              most two DMA frames later, glitches shorter than the dwell never commit, and
+ *              setDebounceDwell() / resetDebounceDwell() change the timing per transition.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "check.h"
+#include "host.h"
+#include "pilot_line.h"
+#include "Pilot.h"
+
+static const VEHICLE_STATE_T STATES[] = {
+    VEHICLE_NOT_CONNECTED, VEHICLE_CONNECTED, VEHICLE_READY,
+    VEHICLE_READY_VENTILATION_REQUIRED, VEHICLE_NO_POWER, VEHICLE_ERROR,
+};
+static const char NAMES[] = "ABCDEF";
+
+static char name(VEHICLE_STATE_T s)
+{
+    for (int i = 0; i < 6; i++) if (STATES[i] == s) return NAMES[i];
+    return '?';
+}
+
+struct Bench {
+    PilotLine line;
+    Pilot pilot;
+
+    Bench() {
+        line.noiseRaw = 3.0f;
+        pilot.begin();
+        pilot.attachFrameTask((TaskHandle_t)&pilot);
+        pilot.currentLimit(16.0f);     // PWM on: the diode check (F) needs it, A..E do not care
+    }
+
+    VEHICLE_STATE_T frame() {
+        pilot.waitForFrame(PILOT_FRAME_TIMEOUT_MS);
+        VEHICLE_STATE_T s = pilot.read();
+        pilot.frameProcessed();
+        return s;
+    }
+
+    // Runs frames for `us`; returns false if the reported state ever differed from `expect`
+    bool holdFor(uint64_t us, VEHICLE_STATE_T expect) {
+        uint64_t end = host::nowUs() + us;
+        bool steady = true;
+        while (host::nowUs() < end) steady &= frame() == expect;
+        return steady;
+    }
+
+    bool settle(VEHICLE_STATE_T s) {
+        line.state = s;
+        uint64_t end = host::nowUs() + 500000;
+        while (host::nowUs() < end) {
+            if (frame() == s) return holdFor(20000, s);
+        }
+        return false;
+    }
+
+    // Microseconds from the line change until read() reports `to` (0 = never within 1s)
+    uint64_t latency(VEHICLE_STATE_T to) {
+        uint64_t t0 = host::nowUs();
+        line.state = to;
+        while (host::nowUs() - t0 < 1000000) {
+            if (frame() == to) return host::nowUs() - t0;
+        }
+        return 0;
+    }
+};
+
+int main()
+{
+    host::reset();
+    host::setAdcClockPpm(-53);
+    Bench b;
+    uint64_t frameUs = host::adcFramePeriodUs();
+
+    // 1. Every transition: dwell <= latency <= dwell + 2 frames (the first frame after the
+    //    change may still be mostly the old level)
+    printf("Commit latency per transition (us), dwell in brackets; frame = %lu us\n", (unsigned long)frameUs);
+    printf("from\\to");
+    for (VEHICLE_STATE_T to : STATES) printf("          %c", name(to));
+    printf("\n");
+    for (VEHICLE_STATE_T from : STATES) {
+        printf("   %c   ", name(from));
+        for (VEHICLE_STATE_T to : STATES) {
+            if (to == from) { printf("          -"); continue; }
+            CHECK(b.settle(from));
+            uint64_t dwellUs = (uint64_t)b.pilot.getDebounceDwell(from, to) * 1000ULL;
+            uint64_t lat = b.latency(to);
+            printf(" %5lu[%2lu]", (unsigned long)lat, (unsigned long)(dwellUs / 1000));
+            if (lat < dwellUs || lat > dwellUs + 2 * frameUs) {
+                fprintf(stderr, "  %c -> %c: latency %lu us, dwell %lu us\n", name(from), name(to),
+                        (unsigned long)lat, (unsigned long)dwellUs);
+            }
+            CHECK(lat >= dwellUs);
+            CHECK(lat <= dwellUs + 2 * frameUs);
+        }
+        printf("\n");
+    }
+
+    // 2. A glitch shorter than the dwell never commits (only dwells of several frames can
+    //    be probed this way; 3ms is shorter than one frame)
+    for (VEHICLE_STATE_T from : STATES) {
+        for (VEHICLE_STATE_T to : STATES) {
+            uint32_t dwellMs = b.pilot.getDebounceDwell(from, to);
+            if (to == from || dwellMs * 1000ULL < 4 * frameUs) continue;
+            CHECK(b.settle(from));
+            b.line.state = to;
+            b.holdFor(dwellMs * 1000ULL - 2 * frameUs, from);
+            b.line.state = from;
+            if (!b.holdFor(100000, from)) {
+                fprintf(stderr, "  %c -> %c glitch of %lu ms committed\n", name(from), name(to),
+                        (unsigned long)(dwellMs - 2 * frameUs / 1000));
+                CHECK(false);
+            }
+        }
+    }
+
+    // 3. Per-transition override: only B -> C changes
+    b.pilot.setDebounceDwell(VEHICLE_CONNECTED, VEHICLE_READY, 200);
+    CHECK_EQ(b.pilot.getDebounceDwell(VEHICLE_CONNECTED, VEHICLE_READY), 200);
+    CHECK_EQ(b.pilot.getDebounceDwell(VEHICLE_CONNECTED, VEHICLE_READY_VENTILATION_REQUIRED), PILOT_DWELL_DEFAULT_MS);
+    CHECK(b.settle(VEHICLE_CONNECTED));
+    uint64_t lat = b.latency(VEHICLE_READY);
+    CHECK(lat >= 200000 && lat <= 200000 + 2 * frameUs);
+    CHECK(b.settle(VEHICLE_CONNECTED));
+    lat = b.latency(VEHICLE_READY_VENTILATION_REQUIRED);
+    CHECK(lat >= PILOT_DWELL_DEFAULT_MS * 1000ULL && lat <= PILOT_DWELL_DEFAULT_MS * 1000ULL + 2 * frameUs);
+
+    // Out-of-range states are ignored
+    b.pilot.setDebounceDwell(VEHICLE_STATE_COUNT, VEHICLE_READY, 1);
+    CHECK_EQ(b.pilot.getDebounceDwell(VEHICLE_STATE_COUNT, VEHICLE_READY), 0);
+
+    b.pilot.resetDebounceDwell();
+    CHECK_EQ(b.pilot.getDebounceDwell(VEHICLE_CONNECTED, VEHICLE_READY), PILOT_DWELL_DEFAULT_MS);
+    CHECK_EQ(b.pilot.getDebounceDwell(VEHICLE_NOT_CONNECTED, VEHICLE_CONNECTED), PILOT_DWELL_PLUG_MS);
+    CHECK_EQ(b.pilot.getDebounceDwell(VEHICLE_READY, VEHICLE_NOT_CONNECTED), PILOT_DWELL_FAST_MS);
+
+    return checkResult("test_pilot_debounce");
+}
@@ -0,0 +1,45 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host test of the precomputed raw->mV table (Pilot::buildMvTable): every one
+ *              of the 4096 entries must equal the calibration + convertMv() formula it
+ *              replaces, saturated to int16 like the table.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "check.h"
+#include "host.h"
+#include "Pilot.h"
+
+static int formulaMv(int raw)
+{
+    float mv = ((float)host::calRawToMv(raw) - ZERO_OFFSET_MV) * SCALE;
+    if (mv > INT16_MAX) mv = INT16_MAX;
+    if (mv < INT16_MIN) mv = INT16_MIN;
+    return (int)(int16_t)mv;
+}
+
+int main()
+{
+    host::reset();
+    Pilot pilot;
+    pilot.begin();
+
+    int mismatches = 0;
+    for (int raw = 0; raw < ADC_RAW_CODES; raw++) {
+        if (pilot.rawToMv(raw) != formulaMv(raw)) {
+            if (mismatches++ < 8) CHECK_EQ(pilot.rawToMv(raw), formulaMv(raw));
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // Monotonic; the top reaches past +12 V and the bottom (clipped) is clearly negative for state F
+    for (int raw = 1; raw < ADC_RAW_CODES; raw++) CHECK(pilot.rawToMv(raw) >= pilot.rawToMv(raw - 1));
+    CHECK(pilot.rawToMv(0) < -6000);
+    CHECK(pilot.rawToMv(ADC_RAW_CODES - 1) > 12000);
+
+    return checkResult("test_pilot_table");
+}
@@ -0,0 +1,140 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host test of the RCM trip latch. The ISR fast path opens the contactor and
+ *              takes the pilot pin from the LEDC; until the latch is cleared (vehicle
+ *              unplugged) no relay may close and no queued duty may hand the pin back to the
+ *              LEDC, even after the EVSE task has been told about the trip. The ISR wakes
+ *              the EVSE task without waiting for a pilot frame, and the contactor's open
+ *              latency runs from the ISR to the feedback edge, not to the task's next poll.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "check.h"
+#include "evse_bench.h"
+
+extern Rcm rcm;
+
+static constexpr int PIN_FB = 18;                   // Aux contact of the bare relay below
+static constexpr uint32_t TASK_DELAY_US = 4000;     // ISR -> bare relay's owner picks the trip up
+static constexpr uint32_t CONTACT_OPEN_US = 9000;   // Coil released -> aux contact opens
+
+static void trip() {
+    host::setInput(PIN_BENCH_RCM_IN, 1);
+    host::setInput(PIN_BENCH_RCM_IN, 0);            // Residual current gone again at once
+}
+
+static bool pwmOnPilot() { return host::ledcOwnsPin(PIN_PILOT_PWM_OUT); }
+
+// Contactor with feedback: the aux contact follows the coil without delay, unless the test
+// moves it by hand
+static bool auxFollows = true;
+static void auxContact(int coil) { if (auxFollows) host::setInput(PIN_FB, coil ? 0 : 1); }
+
+int main()
+{
+    // Through the EVSE task: trip mid-charge, reported, still latched
+    {
+        host::reset();
+        ChargingSettings cs;
+        cs.maxCurrent = 16.0f;
+        cs.softStart = false;
+        EvseBench bench(cs);
+        bench.line.plugged = true;
+        bench.runMs(1000);
+        bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+        CHECK(bench.runUntil([&] { return bench.contactorClosed() && bench.drawA() > 0.0f; }, 10000));
+        CHECK(pwmOnPilot());
+
+        trip();
+        CHECK(Rcm::isLatched());
+        CHECK(!bench.contactorClosed());
+        CHECK(!pwmOnPilot());
+        CHECK_EQ(host::pinLevel(PIN_PILOT_PWM_OUT), 1);
+        CHECK(!bench.cycle());                      // Woken by the ISR, not by the next frame
+        CHECK_EQ(rcm.getTripStats().lastTaskUs, 0u);
+        bench.runMs(100);                           // Task: session stopped, lockout
+        CHECK(Rcm::isLatched());
+        CHECK_EQ(rcm.getTripStats().trips, 1u);
+
+        // Any task may queue a duty; it must not reach the pin
+        uint32_t attaches = host::ledcAttachCount(PIN_PILOT_PWM_OUT);
+        bench.pilot.currentLimitDa(100);
+        bench.runMs(1000);
+        CHECK(!pwmOnPilot());
+        CHECK_EQ(host::ledcAttachCount(PIN_PILOT_PWM_OUT), attaches);
+        CHECK_EQ(host::pinLevel(PIN_PILOT_PWM_OUT), 1);
+        CHECK(!bench.contactorClosed());
+
+        // Unplugged: lockout and latch cleared, the next session runs
+        bench.line.plugged = false;
+        CHECK(bench.runUntil([&] { return !Rcm::isLatched(); }, 5000));
+        bench.line.plugged = true;
+        bench.runMs(1000);
+        bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+        CHECK(bench.runUntil([&] { return bench.contactorClosed() && bench.drawA() > 0.0f; }, 10000));
+        CHECK(pwmOnPilot());
+    }
+
+    // A bare relay: refuses to close under the latch, and times the ISR's open
+    {
+        host::reset();
+        rcm.begin();
+        rcm.arm(true);
+        host::onPinWrite(PIN_RELAY_OUT, auxContact);
+        Relay relay(PIN_RELAY_OUT, "RELAY", PIN_FB);
+        relay.setup(LOW);
+        host::advanceMs(300);
+        relay.loop();
+        relay.close();
+        relay.loop();
+        host::advanceMs(300);
+        relay.loop();
+        CHECK(relay.isClosed());
+        CHECK_EQ(relay.getTiming().closeOps, 1u);
+
+        // The task reacts before the contact has opened and polls again after it has
+        uint32_t openOps = relay.getTiming().openOps;
+        auxFollows = false;
+        trip();
+        CHECK_EQ(host::pinLevel(PIN_RELAY_OUT), 0);
+        host::advanceUs(TASK_DELAY_US);
+        CHECK(rcm.isTriggered());
+        relay.open();
+        relay.loop();
+        CHECK_EQ(relay.getTiming().openOps, openOps);
+        host::advanceUs(CONTACT_OPEN_US - TASK_DELAY_US);
+        host::setInput(PIN_FB, 1);
+        host::advanceUs(TASK_DELAY_US);
+        relay.loop();
+        auxFollows = true;
+        CHECK(relay.isOpen());
+        CHECK_EQ(relay.getTiming().openOps, openOps + 1);
+        printf("RCM trip: open latency recorded %lu us (contact %lu us, polls %lu us after the ISR)\n",
+               (unsigned long)relay.getTiming().lastOpenUs, (unsigned long)CONTACT_OPEN_US,
+               (unsigned long)(CONTACT_OPEN_US + TASK_DELAY_US));
+        CHECK_EQ(relay.getTiming().lastOpenUs, CONTACT_OPEN_US);
+        CHECK_EQ(relay.getFault(), RELAY_FAULT_NONE);
+
+        // Reported, not cleared: still no close, however long
+        CHECK(!rcm.isTriggered());
+        CHECK(Rcm::isLatched());
+        relay.close();
+        for (int i = 0; i < 10; i++) {
+            host::advanceMs(1000);
+            relay.loop();
+        }
+        CHECK(!relay.isClosed());
+        CHECK_EQ(host::pinLevel(PIN_RELAY_OUT), 0);
+
+        rcm.clearLatch();
+        relay.loop();
+        CHECK(relay.isClosed());
+        CHECK_EQ(host::pinLevel(PIN_RELAY_OUT), 1);
+    }
+
+    return checkResult("test_rcm_latch");
+}
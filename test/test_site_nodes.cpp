@@ -0,0 +1,493 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host test of the site load balancer: N EvseSiteNode instances in one process
+ *              on an in-process multicast bus (optional packet loss, per-unit link and
+ *              power). Every step checks that the units with a vehicle drawing never hold
+ *              more than the site budget between them.
+ *
+ *              Per node count (and with 10% packet loss) it reports how long the site takes
+ *              to agree after a staggered boot, the plug -> allocation round trip, how fast
+ *              every unit falls back when the AP drops (link down, or silently) and how
+ *              long it takes to agree again. It also covers a reboot of the lowest-id unit
+ *              (listens before electing itself), an isolated unit, a single-unit site and
+ *              truncated allocation packets.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "check.h"
+#include "host.h"
+#include "EvseSiteNode.h"
+#include "Pilot.h"
+
+static constexpr uint32_t LOOP_MS = 5;              // Loop task period of every unit
+static constexpr uint32_t DRAW_DELAY_MS = 1000;     // Plug-in -> contactor closed (vehicle handshake)
+static constexpr uint16_t FALLBACK_DA = 60;
+
+/* =========================
+ * In-process multicast bus
+ * ========================= */
+
+struct Packet {
+    uint8_t data[sizeof(SiteAllocMsg)];
+    int len;
+};
+
+class SiteBus;
+
+class BusPort : public SiteTransport {
+public:
+    BusPort(SiteBus& b, uint32_t nodeId) : bus(b), id(nodeId) {}
+    bool linkUp() override { return link; }
+    uint32_t localId() override { return id; }
+    void send(const uint8_t* data, size_t len) override;
+    int receive(uint8_t* buf, size_t size) override {
+        if (inbox.empty()) return 0;
+        Packet p = inbox.front();
+        inbox.pop_front();
+        int n = p.len < (int)size ? p.len : (int)size;
+        memcpy(buf, p.data, n);
+        return n;
+    }
+    void close() override { inbox.clear(); }
+
+    SiteBus& bus;
+    uint32_t id;
+    bool link = true;
+    bool cut = false;                               // Multicast lost for this unit alone, link up
+    std::deque<Packet> inbox;
+};
+
+class SiteBus {
+public:
+    std::vector<BusPort*> ports;
+    float loss = 0.0f;
+    bool blackhole = false;                         // AP gone but the stations have not noticed
+    uint32_t sent = 0;
+    std::function<void(const uint8_t* data, size_t len)> onSend;
+
+    void deliver(BusPort* from, const uint8_t* data, size_t len) {
+        sent++;
+        if (onSend) onSend(data, len);
+        if (!from->link || from->cut || blackhole) return;
+        for (BusPort* to : ports) {
+            if (to == from || !to->link || to->cut) continue;
+            if (loss > 0.0f && uniform() < loss) continue;
+            Packet p;
+            memcpy(p.data, data, len);
+            p.len = (int)len;
+            to->inbox.push_back(p);
+        }
+    }
+
+private:
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    double uniform() {
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        return (double)((rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+    }
+};
+
+void BusPort::send(const uint8_t* data, size_t len) { bus.deliver(this, data, len); }
+
+/* =========================
+ * Site of N units
+ * ========================= */
+
+struct Unit {
+    BusPort port;
+    std::unique_ptr<EvseSiteNode> node;
+    bool powered = true;
+    bool active = false;
+    unsigned long activeSinceMs = 0;
+
+    Unit(SiteBus& bus, uint32_t id) : port(bus, id), node(new EvseSiteNode(port)) {}
+    bool drawing(unsigned long now) const { return powered && active && now - activeSinceMs >= DRAW_DELAY_MS; }
+};
+
+struct Site {
+    SiteBus bus;
+    std::vector<std::unique_ptr<Unit>> units;
+    SiteParams params;
+    uint32_t minId = 0xFFFFFFFF;
+    uint32_t allocsOverBudget = 0;
+    unsigned long overSinceMs = 0;                  // 0 = within budget
+    unsigned long longestOverMs = 0;
+    uint32_t worstDa = 0;
+
+    Site(int n, uint16_t siteDa, float loss) {
+        bus.loss = loss;
+        params.enabled = true;
+        params.siteDa = siteDa;
+        params.fallbackDa = FALLBACK_DA;
+        params.maxDa = 320;
+        for (int i = 0; i < n; i++) {
+            // Ids out of boot order, so the first unit up is not the coordinator
+            uint32_t id = 0x00A10000UL + (uint32_t)((i * 7 + 3) % n) * 0x11 + 1;
+            units.emplace_back(new Unit(bus, id));
+            bus.ports.push_back(&units.back()->port);
+            if (id < minId) minId = id;
+        }
+        bus.onSend = [this](const uint8_t* data, size_t len) { checkAlloc(data, len); };
+    }
+
+    Unit* find(uint32_t id) const {
+        for (auto& u : units) if (u->port.id == id) return u.get();
+        return nullptr;
+    }
+
+    // Every allocation sent must fit the budget for the units drawing now, with the
+    // fallback share of each unit the coordinator does not list
+    void checkAlloc(const uint8_t* data, size_t len) {
+        const SiteAllocMsg& msg = *(const SiteAllocMsg*)data;
+        if (msg.h.type != SITE_MSG_ALLOC || len < offsetof(SiteAllocMsg, entries) + msg.count * sizeof(SiteAllocEntry)) return;
+        unsigned long now = millis();
+        uint32_t sum = 0;
+        int listed = 0;
+        for (int i = 0; i < msg.count; i++) {
+            Unit* u = find(msg.entries[i].nodeId);
+            if (!u) continue;
+            listed++;
+            if (u->drawing(now)) sum += msg.entries[i].capDa;
+        }
+        for (auto& u : units) {
+            if (u->drawing(now) && !isListed(msg, u->port.id)) sum += FALLBACK_DA;
+        }
+        if (sum > params.siteDa) allocsOverBudget++;
+    }
+
+    static bool isListed(const SiteAllocMsg& msg, uint32_t id) {
+        for (int i = 0; i < msg.count; i++) if (msg.entries[i].nodeId == id) return true;
+        return false;
+    }
+
+    void powerOn(Unit& u) {
+        u.powered = true;
+        u.port.link = true;
+        u.node->configure(params);
+    }
+
+    void powerOff(Unit& u) {
+        u.powered = false;
+        u.port.link = false;
+        u.port.inbox.clear();
+        SiteParams off = params;
+        off.enabled = false;
+        u.node->configure(off);
+        u.node.reset(new EvseSiteNode(u.port));              // RAM is gone
+    }
+
+    void setActive(Unit& u, bool active) {
+        if (u.active != active) u.activeSinceMs = millis();
+        u.active = active;
+    }
+
+    // One loop pass of every powered unit, then the budget check
+    void step() {
+        host::advanceMs(LOOP_MS);
+        unsigned long now = millis();
+        for (auto& u : units) {
+            if (u->powered) u->node->loop(u->active, now);
+        }
+        uint32_t sum = drawnDa(now);
+        if (sum > params.siteDa) {
+            if (!overSinceMs) overSinceMs = now;
+            if (now - overSinceMs + LOOP_MS > longestOverMs) longestOverMs = now - overSinceMs + LOOP_MS;
+            if (sum > worstDa) worstDa = sum;
+        } else {
+            overSinceMs = 0;
+        }
+    }
+
+    uint32_t drawnDa(unsigned long now) const {
+        uint32_t sum = 0;
+        for (auto& u : units) {
+            if (u->drawing(now) && u->node->getCapDa() != EVSE_CAP_NONE) sum += u->node->getCapDa();
+        }
+        return sum;
+    }
+
+    void run(uint32_t ms) {
+        for (uint32_t t = 0; t < ms; t += LOOP_MS) step();
+    }
+
+    // Every powered unit follows the lowest live id, and none is on its fallback share
+    bool agreed() const {
+        uint32_t coord = 0xFFFFFFFF;
+        for (auto& u : units) {
+            if (u->powered && u->port.id < coord) coord = u->port.id;
+        }
+        for (auto& u : units) {
+            if (!u->powered) continue;
+            if (u->node->getCoordinatorId() != coord || u->node->isFallback()) return false;
+            if (u->node->getNodeCount() != poweredCount()) return false;
+        }
+        return true;
+    }
+
+    bool allFallback() const {
+        for (auto& u : units) {
+            if (u->powered && (!u->node->isFallback() || u->node->getCapDa() != FALLBACK_DA || u->node->isCoordinator())) return false;
+        }
+        return true;
+    }
+
+    int poweredCount() const {
+        int n = 0;
+        for (auto& u : units) n += u->powered ? 1 : 0;
+        return n;
+    }
+
+    // ms until `done` holds, -1 after `timeoutMs`
+    template <typename F> long until(F done, uint32_t timeoutMs) {
+        unsigned long t0 = millis();
+        while (millis() - t0 < timeoutMs) {
+            step();
+            if (done()) return (long)(millis() - t0);
+        }
+        return -1;
+    }
+};
+
+struct Report {
+    long bootMs, linkDownMs, linkBackMs, silentMs, silentBackMs;
+    unsigned long ackAvgMs, ackMaxMs, overMs;
+    double packetsPerNodeS;
+};
+
+// Every allocation fits the budget, and so do the caps the units hold: allocations reach
+// them one packet at a time, or not at all, so a raise waits until the lowered units have
+// reported their new caps
+static void checkBudget(const Site& site)
+{
+    CHECK_EQ(site.allocsOverBudget, 0);
+    CHECK_EQ(site.longestOverMs, 0);
+}
+
+static Report scenario(int n, float loss)
+{
+    host::reset();
+    // 10 A per unit: every unit on its fallback share at once still fits the supply
+    Site site(n, (uint16_t)(n * 100), loss);
+    Report r{};
+
+    // Staggered boot over one second
+    for (int i = 0; i < n; i++) site.units[i]->powered = false;
+    for (int i = 0; i < n; i++) {
+        site.powerOn(*site.units[i]);
+        site.run(1000 / n);
+    }
+    r.bootMs = site.until([&] { return site.agreed(); }, 10000);
+    CHECK(r.bootMs >= 0);
+    checkBudget(site);
+
+    // Vehicles arrive one at a time: plug -> allocation answering it
+    unsigned long ackSum = 0;
+    for (auto& u : site.units) {
+        site.setActive(*u, true);
+        site.run(2000);
+        unsigned long ack = u->node->getLastConvergeMs();
+        ackSum += ack;
+        if (ack > r.ackMaxMs) r.ackMaxMs = ack;
+    }
+    r.ackAvgMs = ackSum / n;
+    CHECK(site.agreed());
+    checkBudget(site);
+
+    uint32_t sent0 = site.bus.sent;
+    site.run(10000);
+    r.packetsPerNodeS = (site.bus.sent - sent0) / 10.0 / n;
+
+    // AP drops and every station sees its link go: fallback on the next pass
+    for (auto& u : site.units) u->port.link = false;
+    r.linkDownMs = site.until([&] { return site.allFallback(); }, 5000);
+    CHECK(r.linkDownMs >= 0 && r.linkDownMs <= (long)LOOP_MS);
+    site.run(5000);
+    CHECK(site.allFallback());
+    for (auto& u : site.units) u->port.link = true;
+    r.linkBackMs = site.until([&] { return site.agreed(); }, 10000);
+    CHECK(r.linkBackMs >= (long)SITE_PEER_TIMEOUT_MS);     // Everyone listens first
+    checkBudget(site);
+
+    // AP drops silently: the stations only notice that nobody answers any more. A unit
+    // alone on its site has nobody to miss.
+    r.silentMs = r.silentBackMs = -1;
+    if (n > 1) {
+        site.bus.blackhole = true;
+        r.silentMs = site.until([&] { return site.allFallback(); }, 10000);
+        CHECK(r.silentMs >= 0 && r.silentMs <= (long)(SITE_PEER_TIMEOUT_MS + SITE_ALLOC_TIMEOUT_MS + 2 * LOOP_MS));
+        site.run(5000);
+        CHECK(site.allFallback());
+        site.bus.blackhole = false;
+        r.silentBackMs = site.until([&] { return site.agreed(); }, 10000);
+        CHECK(r.silentBackMs >= 0);
+        checkBudget(site);
+    }
+
+    r.overMs = site.longestOverMs;
+    return r;
+}
+
+int main()
+{
+    printf("Site convergence vs node count (%lu ms loop, %lu ms heartbeat, ids out of boot order)\n",
+           (unsigned long)LOOP_MS, (unsigned long)SITE_HEARTBEAT_MS);
+    printf("  nodes loss |  boot  | plug->alloc avg max | AP drop: fallback agreed | silent: fallback agreed | over budget | pkt/s/node\n");
+    for (float loss : {0.0f, 0.1f}) {
+        for (int n : {1, 2, 4, 8, 12, 16}) {
+            Report r = scenario(n, loss);
+            printf("  %5d %3.0f%% | %5ld  |        %4lu %4lu   |         %5ld  %5ld   |        %5ld  %5ld   |   %5lu ms  | %5.1f\n",
+                   n, loss * 100.0f, r.bootMs, r.ackAvgMs, r.ackMaxMs, r.linkDownMs, r.linkBackMs, r.silentMs,
+                   r.silentBackMs, r.overMs, r.packetsPerNodeS);
+        }
+    }
+
+    // Reboot of the lowest-id unit: it listens first, the acting coordinator keeps the site
+    {
+        host::reset();
+        Site site(4, 400, 0.0f);
+        for (auto& u : site.units) site.powerOn(*u);
+        for (auto& u : site.units) site.setActive(*u, true);
+        CHECK(site.until([&] { return site.agreed(); }, 10000) >= 0);
+        Unit* low = site.find(site.minId);
+        CHECK(low->node->isCoordinator());
+
+        site.powerOff(*low);
+        site.run(3000);
+        CHECK(site.agreed());                       // Next-lowest took over
+        site.powerOn(*low);
+        bool electedEarly = false, overShare = false;
+        unsigned long t0 = millis();
+        while (millis() - t0 < SITE_PEER_TIMEOUT_MS - LOOP_MS) {
+            site.step();
+            electedEarly |= low->node->isCoordinator();
+            overShare |= low->node->isFallback() && low->node->getCapDa() != FALLBACK_DA;
+            for (auto& u : site.units) electedEarly |= u->node->getCoordinatorId() == site.minId;
+        }
+        CHECK(!electedEarly);
+        CHECK(!overShare);
+        CHECK(site.until([&] { return site.agreed(); }, 5000) >= 0);
+        CHECK(low->node->isCoordinator());
+        checkBudget(site);
+    }
+
+    // Isolated unit: multicast lost for it alone. It keeps its peers and the fallback share
+    // instead of electing itself; the rest reserves that share for it.
+    {
+        host::reset();
+        Site site(3, 300, 0.0f);
+        for (auto& u : site.units) site.powerOn(*u);
+        for (auto& u : site.units) site.setActive(*u, true);
+        CHECK(site.until([&] { return site.agreed(); }, 10000) >= 0);
+        Unit& lone = *site.units[0];
+        lone.port.cut = true;
+        site.run(20000);
+        CHECK(lone.node->isFallback());
+        CHECK(!lone.node->isCoordinator());
+        CHECK_EQ(lone.node->getCapDa(), FALLBACK_DA);
+        CHECK_EQ(lone.node->getNodeCount(), 1);
+        uint32_t othersDa = 0;
+        for (auto& u : site.units) {
+            if (u.get() == &lone) continue;
+            CHECK(!u->node->isFallback());
+            CHECK_EQ(u->node->getNodeCount(), 2);
+            othersDa += u->node->getCapDa();
+        }
+        CHECK(othersDa <= (uint32_t)(site.params.siteDa - FALLBACK_DA));
+        checkBudget(site);
+    }
+
+    // Single-unit site: after listening it supplies itself up to its maximum
+    {
+        host::reset();
+        Site site(1, 250, 0.0f);
+        Unit& u = *site.units[0];
+        site.powerOn(u);
+        site.setActive(u, true);
+        site.run(SITE_PEER_TIMEOUT_MS - LOOP_MS);
+        CHECK(u.node->isFallback());
+        CHECK(!u.node->isCoordinator());
+        site.run(100);
+        CHECK(u.node->isCoordinator());
+        CHECK_EQ(u.node->getCapDa(), 250);
+    }
+
+    // Tight budget: idle units keep 6 A only while the budget covers it; the rest wait at
+    // 0 A for the allocation their plug-in status triggers
+    {
+        host::reset();
+        Site site(4, 220, 0.1f);
+        for (auto& u : site.units) site.powerOn(*u);
+        CHECK(site.until([&] { return site.agreed(); }, 10000) >= 0);
+        site.run(1000);
+        uint32_t idleDa = 0;
+        int parked = 0;
+        for (auto& u : site.units) {
+            idleDa += u->node->getCapDa();
+            parked += u->node->getCapDa() == 0 ? 1 : 0;
+        }
+        CHECK_EQ(idleDa, 180);
+        CHECK_EQ(parked, 1);
+        for (int i = 0; i < 3; i++) {
+            Unit& u = *site.units[i];
+            site.setActive(u, true);
+            site.run(3000);
+            CHECK(u.node->getCapDa() >= MIN_CURRENT_DA);
+        }
+        checkBudget(site);
+    }
+
+    // Allocation packets: the entries the count announces must all be present
+    {
+        host::reset();
+        Site site(3, 300, 0.0f);
+        for (auto& u : site.units) site.powerOn(*u);
+        CHECK(site.until([&] { return site.agreed(); }, 10000) >= 0);
+        Unit* target = nullptr;
+        for (auto& u : site.units) if (!u->node->isCoordinator()) target = u.get();
+        uint16_t before = target->node->getCapDa();
+
+        SiteAllocMsg msg{};
+        msg.h = SiteHeader{ SITE_MAGIC, SITE_PROTO_VERSION, SITE_MSG_ALLOC, site.params.group, site.minId, 0 };
+        msg.budgetDa = 300;
+        msg.count = 3;
+        msg.entries[0] = SiteAllocEntry{ 0x12345678, 10, 0 };
+        msg.entries[1] = SiteAllocEntry{ 0x12345679, 10, 0 };
+        msg.entries[2] = SiteAllocEntry{ target->port.id, 123, 0 };
+        Packet p;
+        memcpy(p.data, &msg, sizeof(msg));
+
+        // Two entries short: the third would come from whatever the buffer held
+        p.len = (int)(offsetof(SiteAllocMsg, entries) + 1 * sizeof(SiteAllocEntry));
+        target->port.inbox.clear();
+        target->port.inbox.push_back(p);
+        target->node->loop(target->active, millis());
+        CHECK_EQ(target->node->getCapDa(), before);
+        // Count beyond the array
+        msg.count = SITE_MAX_NODES + 1;
+        memcpy(p.data, &msg, sizeof(msg));
+        p.len = (int)sizeof(msg);
+        target->port.inbox.push_back(p);
+        target->node->loop(target->active, millis());
+        CHECK_EQ(target->node->getCapDa(), before);
+        // Complete
+        msg.count = 3;
+        memcpy(p.data, &msg, sizeof(msg));
+        p.len = (int)(offsetof(SiteAllocMsg, entries) + 3 * sizeof(SiteAllocEntry));
+        target->port.inbox.push_back(p);
+        target->node->loop(target->active, millis());
+        CHECK_EQ(target->node->getCapDa(), 123);
+    }
+
+    return checkResult("test_site_nodes");
+}
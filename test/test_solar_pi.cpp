@@ -0,0 +1,283 @@
+/* =========================================================================================
+ * Project:     Evse-SyncCharge
+ * Description: Host plant-model test of the solar surplus PI loop (EvseSolarController)
+ *              closed through the real EVSE task: the posted limit goes through the
+ *              command queue, the ramp and the pilot, the vehicle draws what the PWM
+ *              offers through a slew-limited on-board charger, and a grid meter reports
+ *              house load + charger - PV once per second.
+ *
+ *              Covers steady tracking error, step response (up and down), anti-windup at
+ *              both ends of the output (maximum current and 0 A) and the headroom clamp
+ *              above a vehicle that draws less than offered. A report per scenario is
+ *              printed.
+ *
+ * Author:      Noel Vellemans
+ * Copyright:   (C) 2026 Noel Vellemans
+ * License:     GNU General Public License v2.0 (GPLv2)
+ * =========================================================================================
+ */
+
+#include "check.h"
+#include "evse_bench.h"
+#include "EvseSolar.h"
+
+static constexpr uint32_t METER_MS = 1000;          // Grid meter and EVSE meter interval
+static constexpr float OBC_SLEW_A_PER_S = 4.0f;     // On-board charger follows the pilot this fast
+static constexpr float METER_NOISE_W = 30.0f;       // Peak, uniform
+static constexpr float BAND_W = 150.0f;             // "On target": about 2 x 0.1 A on 3 phases
+
+struct Site {
+    EvseBench& bench;
+    EvseSolarController& solar;
+    float pvW = 0.0f;
+    float houseW = 500.0f;
+    float chargerA = 0.0f;                          // Per phase, what the vehicle really draws
+    uint64_t lastUs;
+    uint64_t nextMeterUs;
+    uint32_t rng = 12345;
+
+    // Filled by every meter reading
+    float lastGridW = 0.0f;
+    std::function<void(float gridW)> onReading;
+
+    Site(EvseBench& b, EvseSolarController& s) : bench(b), solar(s) {
+        lastUs = host::nowUs();
+        nextMeterUs = lastUs;
+    }
+
+    float wattsPerAmp() const { return 230.0f * bench.evse.getActivePhases(); }
+    float gridW() const { return houseW + chargerA * wattsPerAmp() - pvW; }
+
+    float noise() {
+        rng = rng * 1103515245u + 12345u;
+        return ((float)((rng >> 8) & 0xFFFF) / 32768.0f - 1.0f) * METER_NOISE_W;
+    }
+
+    // After every EVSE cycle: charger slew, meters, then the solar step as in evseLoopTask
+    void tick() {
+        uint64_t now = host::nowUs();
+        float maxStep = OBC_SLEW_A_PER_S * (float)(now - lastUs) / 1e6f;
+        lastUs = now;
+        float want = bench.drawA();
+        if (want > chargerA + maxStep) chargerA += maxStep;
+        else if (want < chargerA - maxStep) chargerA -= maxStep;
+        else chargerA = want;
+
+        if (now >= nextMeterUs) {
+            nextMeterUs += METER_MS * 1000ULL;
+            lastGridW = gridW() + noise();
+            bench.feedMeter(chargerA);
+            solar.updateGridPower(lastGridW);
+            if (onReading) onReading(lastGridW);
+        }
+        solar.loop();
+    }
+
+    void run(uint32_t ms) { bench.runMs(ms, [this] { tick(); }); }
+};
+
+// Grid error statistics over the meter readings of one window
+struct Tracking {
+    float meanAbsW = 0.0f, maxAbsW = 0.0f;
+    int n = 0;
+};
+
+static Tracking track(Site& site, uint32_t ms, int32_t targetW)
+{
+    double sum = 0.0;
+    Tracking t;
+    site.onReading = [&](float w) {
+        float e = fabsf(w - (float)targetW);
+        sum += e;
+        if (e > t.maxAbsW) t.maxAbsW = e;
+        t.n++;
+    };
+    site.run(ms);
+    site.onReading = nullptr;
+    if (t.n) t.meanAbsW = (float)(sum / t.n);
+    return t;
+}
+
+// Seconds from now until the grid reading enters the band around targetW without leaving
+// twice the band again; also the worst excursion past the target on the far side
+struct Step {
+    float settleS = -1.0f;
+    float overshootW = 0.0f;
+};
+
+static Step stepResponse(Site& site, uint32_t ms, int32_t targetW, bool importing)
+{
+    Step s;
+    uint64_t t0 = host::nowUs();
+    uint64_t enteredUs = 0;
+    site.onReading = [&](float w) {
+        float e = w - (float)targetW;
+        // Coming down from import the far side is export, and the other way round
+        float past = importing ? -e : e;
+        if (past > s.overshootW && enteredUs) s.overshootW = past;
+        if (fabsf(e) <= BAND_W) {
+            if (!enteredUs) enteredUs = host::nowUs();
+        } else if (enteredUs && fabsf(e) > 2 * BAND_W) {
+            enteredUs = 0;                      // Left the band again: not settled yet
+        }
+    };
+    site.run(ms);
+    site.onReading = nullptr;
+    if (enteredUs) s.settleS = (float)(enteredUs - t0) / 1e6f;
+    return s;
+}
+
+int main()
+{
+    host::reset();
+    ChargingSettings cs;
+    cs.maxCurrent = 16.0f;
+    cs.disableAtLowLimit = false;               // Throttle mode: the PI output is used as is
+    EvseBench bench(cs);
+    EvseSolarController solar(bench.evse);
+    Site site(bench, solar);
+
+    SolarParams sp;
+    sp.enabled = true;
+    sp.targetW = 0;
+    solar.setParams(sp);
+
+    // Plug in and start; the controller takes the limit from the first reading
+    site.pvW = 6000.0f;
+    bench.line.plugged = true;
+    site.run(1000);
+    bench.evse.post(EVSE_CMD_START, EVSE_SRC_WEB);
+    site.run(60000);
+    CHECK(bench.evse.getState() == STATE_CHARGING);
+    CHECK(bench.contactorClosed());
+    CHECK(solar.isActive());
+
+    printf("Solar PI through the EVSE task: Kp %.2f, Ki %.2f, %lu ms meter, %.0f A/s charger slew\n",
+           sp.kp, sp.ki, (unsigned long)METER_MS, OBC_SLEW_A_PER_S);
+
+    // 1. Tracking: steady PV, then a house load that keeps moving by 400 W
+    Tracking steady = track(site, 60000, sp.targetW);
+    printf("  tracking, steady load     : mean |grid| %5.0f W, max %5.0f W, offer %.1f A\n",
+           steady.meanAbsW, steady.maxAbsW, solar.getOfferDa() / 10.0f);
+    CHECK(steady.meanAbsW < 80.0f);
+    CHECK(steady.maxAbsW < BAND_W);
+    Tracking moving;
+    {
+        double sum = 0.0;
+        int n = 0;
+        for (int i = 0; i < 6; i++) {
+            site.houseW = (i & 1) ? 900.0f : 500.0f;
+            Tracking t = track(site, 30000, sp.targetW);
+            sum += t.meanAbsW * t.n;
+            n += t.n;
+            if (t.maxAbsW > moving.maxAbsW) moving.maxAbsW = t.maxAbsW;
+        }
+        moving.meanAbsW = (float)(sum / n);
+        site.houseW = 500.0f;
+    }
+    printf("  tracking, 400 W load steps: mean |grid| %5.0f W, max %5.0f W\n", moving.meanAbsW, moving.maxAbsW);
+    CHECK(moving.meanAbsW < 150.0f);
+    CHECK(moving.maxAbsW < 600.0f);
+    site.run(30000);
+
+    // 2. Step response: +3 kW of PV (surplus up, grid goes to export) and back. Kp takes
+    //    about half the step at once, the rest decays with the integral time 1/Ki: settled
+    //    within five of those, without crossing the target by more than the band
+    float settleMaxS = 5.0f / sp.ki;
+    site.pvW = 9000.0f;
+    Step up = stepResponse(site, 90000, sp.targetW, false);
+    printf("  step +3 kW PV             : settled in %5.1f s, overshoot %4.0f W import\n", up.settleS, up.overshootW);
+    CHECK(up.settleS > 0.0f && up.settleS < settleMaxS);
+    CHECK(up.overshootW < BAND_W);
+    site.pvW = 6000.0f;
+    Step down = stepResponse(site, 90000, sp.targetW, true);
+    printf("  step -3 kW PV             : settled in %5.1f s, overshoot %4.0f W export\n", down.settleS, down.overshootW);
+    CHECK(down.settleS > 0.0f && down.settleS < settleMaxS);
+    CHECK(down.overshootW < BAND_W);
+
+    // 3. Anti-windup, top: five minutes of surplus far above 16 A, then back to 6 kW. The
+    //    output sits at the clamp and must come down as fast as from an unsaturated state.
+    site.pvW = 20000.0f;
+    site.run(300000);
+    CHECK_EQ(solar.getOfferDa(), 160);
+    CHECK_EQ(bench.evse.getSnapshot().currentLimitDa, 160);
+    site.pvW = 6000.0f;
+    Step unwindTop = stepResponse(site, 90000, sp.targetW, true);
+    printf("  after 5 min at 16 A clamp : settled in %5.1f s (plain step %.1f s)\n", unwindTop.settleS, down.settleS);
+    CHECK(unwindTop.settleS > 0.0f && unwindTop.settleS <= down.settleS + 2.0f);
+
+    // Anti-windup, bottom: import with the output held at 0 A. The pilot cannot offer less
+    // than 6 A, so the vehicle keeps drawing that and the loop has to climb back through
+    // the dead zone; how long the clamp lasted must not matter.
+    Step unwindLow[2];
+    const uint32_t clampMs[2] = {30000, 300000};
+    for (int i = 0; i < 2; i++) {
+        site.pvW = 0.0f;
+        site.run(clampMs[i]);
+        CHECK_EQ(solar.getOfferDa(), 0);
+        CHECK_EQ(bench.evse.getSnapshot().currentLimitDa, 0);
+        CHECK(site.chargerA <= MIN_CURRENT + 0.1f);
+        site.pvW = 6000.0f;
+        unwindLow[i] = stepResponse(site, 90000, sp.targetW, false);
+        printf("  after %3lu s at 0 A clamp  : settled in %5.1f s\n", (unsigned long)(clampMs[i] / 1000),
+               unwindLow[i].settleS);
+        CHECK(unwindLow[i].settleS > 0.0f && unwindLow[i].settleS < settleMaxS);
+    }
+    CHECK(fabsf(unwindLow[1].settleS - unwindLow[0].settleS) <= 2.0f);
+
+    // 4. Headroom clamp: the vehicle takes at most 10 A while 21 A of surplus is exported;
+    //    the offer stays within SOLAR_HEADROOM_A of the draw instead of running to 16 A
+    bench.line.vehicleMaxA = 10.0f;
+    site.pvW = 15000.0f;
+    site.run(20000);
+    uint16_t maxOfferDa = 0, maxLimitDa = 0;
+    bench.runMs(120000, [&] {
+        site.tick();
+        maxOfferDa = std::max(maxOfferDa, solar.getOfferDa());
+        maxLimitDa = std::max(maxLimitDa, bench.evse.getSnapshot().currentLimitDa);
+    });
+    uint16_t ceilingDa = ampsToDeciamps(10.0f + SOLAR_HEADROOM_A);
+    printf("  vehicle capped at 10 A    : offer max %.1f A, applied max %.1f A (ceiling %.1f A), draw %.1f A\n",
+           maxOfferDa / 10.0f, maxLimitDa / 10.0f, ceilingDa / 10.0f, site.chargerA);
+    CHECK(maxOfferDa <= ceilingDa + 1);
+    CHECK(maxLimitDa <= ceilingDa + 1);
+    CHECK_NEAR(site.chargerA, 10.0f, 0.1f);
+
+    // The vehicle lifts its own limit: the offer follows the draw up to the maximum
+    bench.line.vehicleMaxA = 32.0f;
+    site.run(30000);
+    printf("  vehicle limit lifted      : offer %.1f A, draw %.1f A\n", solar.getOfferDa() / 10.0f, site.chargerA);
+    CHECK_EQ(solar.getOfferDa(), 160);
+    CHECK_NEAR(site.chargerA, 16.0f, 0.2f);
+
+    // 5. Hand-back: at dusk the offer drops to 0 A; disabling the controller restores the
+    //    limit it took over (the maximum here). Disabled under a schedule window, the
+    //    window keeps the limit until it ends.
+    site.pvW = 0.0f;
+    site.run(60000);
+    CHECK_EQ(solar.getOfferDa(), 0);
+    CHECK_EQ(bench.evse.getTargetLimitDa(), 0);
+    sp.enabled = false;
+    solar.setParams(sp);
+    site.run(2000);
+    CHECK(!solar.isActive());
+    CHECK_EQ(bench.evse.getTargetLimitDa(), 160);
+
+    sp.enabled = true;
+    solar.setParams(sp);
+    site.run(60000);
+    CHECK(solar.isActive());
+    CHECK_EQ(bench.evse.getTargetLimitDa(), 0);
+    bench.evse.setScheduleHold(true);
+    bench.evse.post(EVSE_CMD_SET_LIMIT, EVSE_SRC_SCHEDULE, 100);
+    sp.enabled = false;
+    solar.setParams(sp);
+    site.run(2000);
+    CHECK_EQ(bench.evse.getTargetLimitDa(), 100);
+    bench.evse.setScheduleHold(false);
+    site.run(2000);
+    CHECK_EQ(bench.evse.getTargetLimitDa(), 160);
+    printf("  hand-back after dusk      : limit %.1f A restored\n", bench.evse.getTargetLimitDa() / 10.0f);
+
+    return checkResult("test_solar_pi");
+}